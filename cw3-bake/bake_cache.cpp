@@ -0,0 +1,441 @@
+#include "bake_cache.hpp"
+
+#include <random>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	constexpr char kMeshMagic_[16] = "cw3-bake-mesh";
+	constexpr char kRecordHeader_[] = "cw3-bake-record";
+
+	// Buffer used when hashing files
+	constexpr std::size_t kReadChunk_ = std::size_t(1) << 20;
+
+	std::filesystem::path entry_path_( std::filesystem::path const& aCacheDir, char const* aPrefix, std::uint64_t aKey, char const* aSuffix );
+
+	void write_entry_( std::filesystem::path const&, void const*, std::size_t );
+	bool read_entry_( std::filesystem::path const&, std::vector<char>& );
+
+	// Sequential reader over a cache entry. All reads fail (and keep failing)
+	// once the end of the data is reached.
+	struct Reader_
+	{
+		char const* pos;
+		char const* end;
+		bool ok = true;
+
+		template< typename tType >
+		bool read( tType& aValue )
+		{
+			return read_bytes( &aValue, sizeof(tType) );
+		}
+
+		template< typename tType >
+		bool read_vector( std::vector<tType>& aValues, std::size_t aCount )
+		{
+			if( !ok || aCount > std::size_t(end-pos) / sizeof(tType) )
+				return ok = false;
+
+			aValues.resize( aCount );
+			return read_bytes( aValues.data(), aCount*sizeof(tType) );
+		}
+
+		bool read_bytes( void* aDst, std::size_t aBytes )
+		{
+			if( !ok || aBytes > std::size_t(end-pos) )
+				return ok = false;
+
+			std::memcpy( aDst, pos, aBytes );
+			pos += aBytes;
+			return true;
+		}
+	};
+
+	template< typename tType >
+	void append_( std::vector<char>& aOut, tType const* aData, std::size_t aCount )
+	{
+		auto const* bytes = reinterpret_cast<char const*>(aData);
+		aOut.insert( aOut.end(), bytes, bytes + aCount*sizeof(tType) );
+	}
+	template< typename tType >
+	void append_( std::vector<char>& aOut, tType const& aValue )
+	{
+		append_( aOut, &aValue, 1 );
+	}
+}
+
+//--    hash_bytes()                    ///{{{2///////////////////////////////
+std::uint64_t hash_bytes( void const* aData, std::size_t aBytes, std::uint64_t aSeed )
+{
+	// MurmurHash64A by Austin Appleby (public domain).
+	constexpr std::uint64_t m = 0xc6a4a7935bd1e995ull;
+	constexpr int r = 47;
+
+	std::uint64_t h = aSeed ^ (aBytes * m);
+
+	auto const* data = static_cast<unsigned char const*>(aData);
+	auto const* const end = data + (aBytes & ~std::size_t(7));
+
+	for( ; data != end; data += 8 )
+	{
+		std::uint64_t k;
+		std::memcpy( &k, data, sizeof(k) );
+
+		k *= m;
+		k ^= k >> r;
+		k *= m;
+
+		h ^= k;
+		h *= m;
+	}
+
+	switch( aBytes & 7 )
+	{
+		case 7: h ^= std::uint64_t(data[6]) << 48; [[fallthrough]];
+		case 6: h ^= std::uint64_t(data[5]) << 40; [[fallthrough]];
+		case 5: h ^= std::uint64_t(data[4]) << 32; [[fallthrough]];
+		case 4: h ^= std::uint64_t(data[3]) << 24; [[fallthrough]];
+		case 3: h ^= std::uint64_t(data[2]) << 16; [[fallthrough]];
+		case 2: h ^= std::uint64_t(data[1]) << 8; [[fallthrough]];
+		case 1: h ^= std::uint64_t(data[0]);
+		        h *= m;
+	}
+
+	h ^= h >> r;
+	h *= m;
+	h ^= h >> r;
+
+	return h;
+}
+
+//--    hash_file()                     ///{{{2///////////////////////////////
+bool hash_file( std::filesystem::path const& aPath, std::uint64_t& aHash )
+{
+	FILE* fin = std::fopen( aPath.string().c_str(), "rb" );
+	if( !fin )
+		return false;
+
+	// Hash the file in chunks. Each chunk's hash seeds the next one, so the
+	// result depends on the chunk size; it is fixed above.
+	std::vector<unsigned char> buffer( kReadChunk_ );
+
+	std::uint64_t hash = 0;
+	std::size_t bytes = 0;
+	while( 0 != (bytes = std::fread( buffer.data(), 1, buffer.size(), fin )) )
+		hash = hash_bytes( buffer.data(), bytes, hash );
+
+	bool const ok = !std::ferror( fin );
+	std::fclose( fin );
+
+	if( ok )
+		aHash = hash;
+
+	return ok;
+}
+
+//--    make_bake_record()              ///{{{2///////////////////////////////
+BakeRecord make_bake_record( std::uint64_t aParameters, std::vector<std::string> const& aInputs, std::vector<std::string> const& aOutputs )
+{
+	BakeRecord ret;
+	ret.parameters = aParameters;
+
+	auto const hash_all_ = [] (std::vector<std::string> const& aPaths, std::vector<BakeCacheFile>& aOut) {
+		for( auto const& path : aPaths )
+		{
+			std::uint64_t hash = 0;
+			if( !hash_file( path, hash ) )
+				throw lut::Error( "Unable to read '%s' for hashing", path.c_str() );
+
+			aOut.emplace_back( BakeCacheFile{ path, hash } );
+		}
+	};
+
+	hash_all_( aInputs, ret.inputs );
+	hash_all_( aOutputs, ret.outputs );
+
+	return ret;
+}
+
+//--    bake_record_is_current()        ///{{{2///////////////////////////////
+bool bake_record_is_current( BakeRecord const& aRecord )
+{
+	// Check outputs first: they are typically fewer, and a missing output is
+	// the cheapest possible mismatch.
+	for( auto const* files : { &aRecord.outputs, &aRecord.inputs } )
+	{
+		for( auto const& file : *files )
+		{
+			std::uint64_t hash = 0;
+			if( !hash_file( file.path, hash ) || hash != file.hash )
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//--    load_bake_record()              ///{{{2///////////////////////////////
+bool load_bake_record( std::filesystem::path const& aCacheDir, std::string const& aOutput, BakeRecord& aRecord )
+{
+	auto const key = hash_bytes( aOutput.data(), aOutput.size() );
+
+	std::vector<char> data;
+	if( !read_entry_( entry_path_( aCacheDir, "record-", key, ".txt" ), data ) )
+		return false;
+
+	data.push_back( '\0' );
+
+	// Format (text, one item per line):
+	//   cw3-bake-record VERSION
+	//   parameters HASH
+	//   input HASH PATH    (zero or more)
+	//   output HASH PATH   (zero or more)
+	BakeRecord record;
+
+	bool header = false;
+	for( char* line = data.data(); *line; )
+	{
+		char* eol = std::strchr( line, '\n' );
+		if( !eol )
+			return false; // truncated
+
+		*eol = '\0';
+
+		char kind[32];
+		std::uint64_t value = 0;
+		int consumed = 0;
+		if( 2 != std::sscanf( line, "%31s %" SCNx64 " %n", kind, &value, &consumed ) )
+			return false;
+
+		if( 0 == std::strcmp( kRecordHeader_, kind ) )
+		{
+			if( kBakeCacheVersion != value )
+				return false;
+
+			header = true;
+		}
+		else if( 0 == std::strcmp( "parameters", kind ) )
+			record.parameters = value;
+		else if( 0 == std::strcmp( "input", kind ) )
+			record.inputs.emplace_back( BakeCacheFile{ line + consumed, value } );
+		else if( 0 == std::strcmp( "output", kind ) )
+			record.outputs.emplace_back( BakeCacheFile{ line + consumed, value } );
+		else
+			return false;
+
+		line = eol+1;
+	}
+
+	if( !header )
+		return false;
+
+	aRecord = std::move(record);
+	return true;
+}
+
+//--    save_bake_record()              ///{{{2///////////////////////////////
+void save_bake_record( std::filesystem::path const& aCacheDir, std::string const& aOutput, BakeRecord const& aRecord )
+{
+	auto const key = hash_bytes( aOutput.data(), aOutput.size() );
+
+	std::string text;
+	char line[64];
+
+	std::snprintf( line, sizeof(line), "%s %" PRIx32 "\n", kRecordHeader_, kBakeCacheVersion );
+	text += line;
+	std::snprintf( line, sizeof(line), "parameters %016" PRIx64 "\n", aRecord.parameters );
+	text += line;
+
+	auto const write_files_ = [&] (char const* aKind, std::vector<BakeCacheFile> const& aFiles) {
+		for( auto const& file : aFiles )
+		{
+			std::snprintf( line, sizeof(line), "%s %016" PRIx64 " ", aKind, file.hash );
+			text += line;
+			text += file.path;
+			text += '\n';
+		}
+	};
+
+	write_files_( "input", aRecord.inputs );
+	write_files_( "output", aRecord.outputs );
+
+	write_entry_( entry_path_( aCacheDir, "record-", key, ".txt" ), text.data(), text.size() );
+}
+
+//--    load_cached_mesh()              ///{{{2///////////////////////////////
+bool load_cached_mesh( std::filesystem::path const& aCacheDir, std::uint64_t aKey, IndexedMesh& aMesh )
+{
+	std::vector<char> data;
+	if( !read_entry_( entry_path_( aCacheDir, "mesh-", aKey, ".bin" ), data ) )
+		return false;
+
+	// See save_cached_mesh() for the format
+	Reader_ in{ data.data(), data.data() + data.size() };
+
+	char magic[16];
+	std::uint32_t version = 0;
+	std::uint64_t key = 0;
+	in.read( magic );
+	in.read( version );
+	in.read( key );
+
+	if( !in.ok || 0 != std::memcmp( magic, kMeshMagic_, sizeof(magic) ) || kBakeCacheVersion != version || aKey != key )
+		return false;
+
+	std::uint32_t vertexCount = 0, tangentCount = 0, indexCount = 0, lodCount = 0;
+	in.read( vertexCount );
+	in.read( tangentCount );
+	in.read( indexCount );
+	in.read( lodCount );
+
+	if( 0 != tangentCount && vertexCount != tangentCount )
+		return false;
+
+	IndexedMesh mesh;
+	in.read( mesh.aabbMin );
+	in.read( mesh.aabbMax );
+
+	in.read_vector( mesh.vert, vertexCount );
+	in.read_vector( mesh.norm, vertexCount );
+	in.read_vector( mesh.text, vertexCount );
+	in.read_vector( mesh.tang, tangentCount );
+	in.read_vector( mesh.indices, indexCount );
+
+	for( std::uint32_t i = 0; i < lodCount && in.ok; ++i )
+	{
+		IndexedMeshLod lod{};
+
+		std::uint32_t count = 0;
+		in.read( count );
+		in.read( lod.error );
+		in.read_vector( lod.indices, count );
+
+		mesh.lods.emplace_back( std::move(lod) );
+	}
+
+	if( !in.ok || in.pos != in.end )
+		return false;
+
+	aMesh = std::move(mesh);
+	return true;
+}
+
+//--    save_cached_mesh()              ///{{{2///////////////////////////////
+void save_cached_mesh( std::filesystem::path const& aCacheDir, std::uint64_t aKey, IndexedMesh const& aMesh )
+{
+	// Format:
+	//  - char[16] : magic
+	//  - uint32_t : cache version
+	//  - uint64_t : key
+	//  - uint32_t : V = number of vertices
+	//  - uint32_t : T = number of tangents (zero or V)
+	//  - uint32_t : I = number of indices
+	//  - uint32_t : L = number of levels of detail (excluding the first)
+	//  - 2*vec3 : AABB min, max
+	//  - V*vec3, V*vec3, V*vec2 : positions, normals, texture coordinates
+	//  - T*vec4 : tangents
+	//  - I*uint32_t : indices
+	//  - repeat L times:
+	//    - uint32_t : N = number of indices
+	//    - float : error
+	//    - N*uint32_t : indices
+	std::vector<char> data;
+
+	append_( data, kMeshMagic_, sizeof(kMeshMagic_) );
+	append_( data, kBakeCacheVersion );
+	append_( data, aKey );
+
+	append_( data, std::uint32_t(aMesh.vert.size()) );
+	append_( data, std::uint32_t(aMesh.tang.size()) );
+	append_( data, std::uint32_t(aMesh.indices.size()) );
+	append_( data, std::uint32_t(aMesh.lods.size()) );
+
+	append_( data, aMesh.aabbMin );
+	append_( data, aMesh.aabbMax );
+
+	append_( data, aMesh.vert.data(), aMesh.vert.size() );
+	append_( data, aMesh.norm.data(), aMesh.norm.size() );
+	append_( data, aMesh.text.data(), aMesh.text.size() );
+	append_( data, aMesh.tang.data(), aMesh.tang.size() );
+	append_( data, aMesh.indices.data(), aMesh.indices.size() );
+
+	for( auto const& lod : aMesh.lods )
+	{
+		append_( data, std::uint32_t(lod.indices.size()) );
+		append_( data, lod.error );
+		append_( data, lod.indices.data(), lod.indices.size() );
+	}
+
+	write_entry_( entry_path_( aCacheDir, "mesh-", aKey, ".bin" ), data.data(), data.size() );
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	std::filesystem::path entry_path_( std::filesystem::path const& aCacheDir, char const* aPrefix, std::uint64_t aKey, char const* aSuffix )
+	{
+		char name[64];
+		std::snprintf( name, sizeof(name), "%s%016" PRIx64 "%s", aPrefix, aKey, aSuffix );
+		return aCacheDir / name;
+	}
+
+	void write_entry_( std::filesystem::path const& aPath, void const* aData, std::size_t aBytes )
+	{
+		std::filesystem::create_directories( aPath.parent_path() );
+
+		// Write to a uniquely named temporary and rename it into place. The
+		// rename replaces any existing entry atomically (on POSIX systems).
+		static thread_local std::mt19937_64 rng( std::random_device{}() );
+
+		auto temp = aPath;
+		temp += ".tmp" + std::to_string( rng() );
+
+		FILE* fof = std::fopen( temp.string().c_str(), "wb" );
+		if( !fof )
+			throw lut::Error( "Unable to open '%s' for writing", temp.string().c_str() );
+
+		auto const written = std::fwrite( aData, 1, aBytes, fof );
+		bool const ok = 0 == std::fclose( fof ) && written == aBytes;
+
+		std::error_code ec;
+		if( ok )
+			std::filesystem::rename( temp, aPath, ec );
+
+		if( !ok || ec )
+		{
+			std::filesystem::remove( temp, ec );
+			throw lut::Error( "Unable to write cache entry '%s'", aPath.string().c_str() );
+		}
+	}
+
+	bool read_entry_( std::filesystem::path const& aPath, std::vector<char>& aData )
+	{
+		FILE* fin = std::fopen( aPath.string().c_str(), "rb" );
+		if( !fin )
+			return false;
+
+		std::fseek( fin, 0, SEEK_END );
+		auto const size = std::ftell( fin );
+		std::fseek( fin, 0, SEEK_SET );
+
+		bool ok = size >= 0;
+		if( ok )
+		{
+			aData.resize( std::size_t(size) );
+			ok = aData.size() == std::fread( aData.data(), 1, aData.size(), fin );
+		}
+
+		std::fclose( fin );
+		return ok;
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,113 @@
+#ifndef BAKE_CACHE_HPP_3E1D7A52_96C4_4F0B_8A2D_51B7E0C94F13
+#define BAKE_CACHE_HPP_3E1D7A52_96C4_4F0B_8A2D_51B7E0C94F13
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <string>
+#include <vector>
+#include <filesystem>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "index_mesh.hpp"
+
+//--    constants                               ///{{{1///////////////////////
+
+/* Default location of the bake cache, relative to the working directory.
+ * The cache only ever speeds up baking; it is safe to delete it at any time.
+ */
+constexpr char kBakeCacheDefaultDir[] = ".cw3-bake-cache";
+
+/* Version of the cached data. Bump this whenever a change to cw3-bake alters
+ * its results (without otherwise changing the file variant), so that stale
+ * cache entries are no longer reused.
+ */
+constexpr std::uint32_t kBakeCacheVersion = 4;
+
+//--    types                                   ///{{{1///////////////////////
+
+struct BakeCacheFile
+{
+	std::string path;
+	std::uint64_t hash;
+};
+
+/* Record of a single bake: a hash of the bake parameters plus the content
+ * hashes of all files that were read and written. The bake can be skipped if
+ * none of these have changed since.
+ */
+struct BakeRecord
+{
+	std::uint64_t parameters = 0;
+
+	std::vector<BakeCacheFile> inputs;
+	std::vector<BakeCacheFile> outputs;
+};
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Fast non-cryptographic 64-bit hash (MurmurHash64A). Hashes can be chained
+ * by passing the previous result as aSeed.
+ */
+std::uint64_t hash_bytes(
+	void const*,
+	std::size_t aBytes,
+	std::uint64_t aSeed = 0
+);
+
+/* Hash the contents of a file. Returns false if the file cannot be read.
+ */
+bool hash_file(
+	std::filesystem::path const&,
+	std::uint64_t& aHash
+);
+
+/* Create a record by hashing the listed files. Throws lut::Error if any of
+ * them cannot be read.
+ */
+BakeRecord make_bake_record(
+	std::uint64_t aParameters,
+	std::vector<std::string> const& aInputs,
+	std::vector<std::string> const& aOutputs
+);
+
+/* Check whether all files listed in a record still exist with the recorded
+ * contents.
+ */
+bool bake_record_is_current( BakeRecord const& );
+
+/* Load/store the record of the bake that produced aOutput. Loading returns
+ * false if there is no (valid) record.
+ */
+bool load_bake_record(
+	std::filesystem::path const& aCacheDir,
+	std::string const& aOutput,
+	BakeRecord&
+);
+void save_bake_record(
+	std::filesystem::path const& aCacheDir,
+	std::string const& aOutput,
+	BakeRecord const&
+);
+
+/* Load/store an indexed mesh (including its levels of detail) under aKey.
+ * The key should be a hash of everything the mesh was computed from.
+ * Loading returns false if there is no (valid) entry for the key.
+ *
+ * Entries are written to a temporary file first and then renamed, so
+ * concurrent bakes and interrupted runs never leave partial entries behind.
+ */
+bool load_cached_mesh(
+	std::filesystem::path const& aCacheDir,
+	std::uint64_t aKey,
+	IndexedMesh&
+);
+void save_cached_mesh(
+	std::filesystem::path const& aCacheDir,
+	std::uint64_t aKey,
+	IndexedMesh const&
+);
+
+#endif // BAKE_CACHE_HPP_3E1D7A52_96C4_4F0B_8A2D_51B7E0C94F13
@@ -0,0 +1,621 @@
+/* benchmark.hxx is included at the end of main.cpp when building the
+ * cw3-bake-bench target (CW3_BAKE_BENCHMARK=1), in place of the baker's
+ * main(). It times the individual bake stages on synthetic inputs of
+ * increasing size. The stages are local to main.cpp, which is why this is
+ * not a separate translation unit.
+ *
+ * Two kinds of models are generated, each as a Wavefront OBJ (+ MTL) file:
+ *  - "soup": a single mesh with a single material
+ *  - "multi": many meshes with many (textured) materials
+ * Both are tessellated height fields whose triangles share corners, so that
+ * indexing has vertices to merge. Results are written as JSON.
+ */
+
+//--    include                                 ///{{{1///////////////////////
+#include <cmath>
+
+//--    types                                   ///{{{1///////////////////////
+namespace
+{
+	enum class BenchModel_
+	{
+		soup,
+		multi
+	};
+
+	struct BenchOptions_
+	{
+		std::vector<std::size_t> sizes{ 10'000, 100'000, 1'000'000, 10'000'000, 50'000'000 }; // soup vertices
+		std::size_t materials = 64; // of "multi" models; two meshes each
+		std::size_t repeat = 1;
+
+		std::string output = "cw3-bake-bench.json";
+		std::string workDir; // empty = a temporary directory
+
+		BakeOptions_ bake;
+	};
+
+	// Results of one model; stage times are the minimum over all repeats
+	struct BenchCase_
+	{
+		BenchModel_ model;
+		std::size_t targetVertices;
+
+		std::size_t soupVertices = 0;
+		std::size_t meshes = 0;
+		std::size_t materials = 0;
+		std::size_t indexedVertices = 0;
+		std::size_t textures = 0;
+		std::uintmax_t objBytes = 0;
+		std::uintmax_t outputBytes = 0;
+
+		std::vector<std::pair<char const*,double>> seconds;
+	};
+
+	// local functions:
+	BenchOptions_ parse_bench_options_( int aArgc, char* aArgv[] );
+
+	std::uintmax_t write_synthetic_obj_(
+		std::filesystem::path const& aObjPath,
+		BenchModel_,
+		std::size_t aVertices,
+		std::size_t aMaterials
+	);
+
+	BenchCase_ run_bench_case_(
+		std::filesystem::path const& aWorkDir,
+		BenchModel_,
+		std::size_t aVertices,
+		BenchOptions_ const&
+	);
+
+	void write_bench_json_(
+		char const* aPath,
+		std::vector<BenchCase_> const&,
+		BenchOptions_ const&
+	);
+
+	char const* bench_model_name_( BenchModel_ );
+}
+
+//--    main()                                  ///{{{1///////////////////////
+int main( int aArgc, char* aArgv[] ) try
+{
+	auto const options = parse_bench_options_( aArgc, aArgv );
+
+	auto const workDir = options.workDir.empty()
+		? std::filesystem::temp_directory_path() / "cw3-bake-bench"
+		: std::filesystem::path( options.workDir )
+		;
+
+	std::filesystem::create_directories( workDir );
+
+	std::vector<BenchCase_> cases;
+	for( auto const size : options.sizes )
+	{
+		for( auto const model : { BenchModel_::soup, BenchModel_::multi } )
+		{
+			auto const& result = cases.emplace_back( run_bench_case_( workDir, model, size, options ) );
+
+			double total = 0.0;
+			std::printf( "%-5s %9zu vertices:", bench_model_name_( model ), result.soupVertices );
+			for( auto const& [stage, seconds] : result.seconds )
+			{
+				std::printf( " %s %.1f ms,", stage, seconds * 1000.0 );
+				total += seconds;
+			}
+			std::printf( " total %.1f ms\n", total * 1000.0 );
+			std::fflush( stdout );
+
+			// Keep partial results in case a later (larger) case fails
+			write_bench_json_( options.output.c_str(), cases, options );
+		}
+	}
+
+	std::printf( "Results written to '%s'\n", options.output.c_str() );
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level exception [%s]:\n%s\nBye.\n", typeid(eErr).name(), eErr.what() );
+	return 1;
+}
+
+//--    $ parse_bench_options_()                ///{{{1///////////////////////
+namespace
+{
+	std::size_t parse_count_( char const* aOption, char const* aValue )
+	{
+		// Decimal count with an optional K (10^3) or M (10^6) suffix
+		char* end = nullptr;
+		auto const value = std::strtoull( aValue, &end, 10 );
+
+		std::size_t scale = 1;
+		if( end && ('k' == *end || 'K' == *end) )
+			scale = 1'000, ++end;
+		else if( end && ('m' == *end || 'M' == *end) )
+			scale = 1'000'000, ++end;
+
+		if( !end || end == aValue || *end || 0 == value )
+			throw lut::Error( "%s: invalid count '%s'", aOption, aValue );
+
+		return std::size_t(value) * scale;
+	}
+
+	BenchOptions_ parse_bench_options_( int aArgc, char* aArgv[] )
+	{
+		// Options of the benchmark itself are handled here; all others are
+		// passed on to parse_options_(), so that the bake can be configured
+		// like that of cw3-bake. Levels of detail are off unless requested:
+		// simplification takes far longer than everything else combined, and
+		// would make the larger sizes impractical.
+		BenchOptions_ ret;
+
+		static char lodsOption[] = "--lods", lodsDefault[] = "1";
+		std::vector<char*> bakeArgs{ aArgv[0], lodsOption, lodsDefault };
+		for( int i = 1; i < aArgc; ++i )
+		{
+			auto const has_value_ = [&] {
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected a value", aArgv[i] );
+				return true;
+			};
+
+			if( 0 == std::strcmp( "--sizes", aArgv[i] ) && has_value_() )
+			{
+				ret.sizes.clear();
+
+				std::stringstream list( aArgv[++i] );
+				for( std::string item; std::getline( list, item, ',' ); )
+					ret.sizes.emplace_back( parse_count_( "--sizes", item.c_str() ) );
+			}
+			else if( 0 == std::strcmp( "--materials", aArgv[i] ) && has_value_() )
+			{
+				ret.materials = parse_count_( aArgv[i], aArgv[i+1] );
+				++i;
+			}
+			else if( 0 == std::strcmp( "--repeat", aArgv[i] ) && has_value_() )
+			{
+				ret.repeat = parse_count_( aArgv[i], aArgv[i+1] );
+				++i;
+			}
+			else if( (0 == std::strcmp( "-o", aArgv[i] ) || 0 == std::strcmp( "--output", aArgv[i] )) && has_value_() )
+			{
+				ret.output = aArgv[++i];
+			}
+			else if( 0 == std::strcmp( "--work-dir", aArgv[i] ) && has_value_() )
+			{
+				ret.workDir = aArgv[++i];
+			}
+			else if( 0 == std::strcmp( "-h", aArgv[i] ) || 0 == std::strcmp( "--help", aArgv[i] ) )
+			{
+				std::printf( "Usage: %s [options]\n", aArgv[0] );
+				std::printf( "\n" );
+				std::printf( "Times each stage of the bake on synthetic models, from a triangle soup\n" );
+				std::printf( "with a single material to models with many meshes and materials.\n" );
+				std::printf( "\n" );
+				std::printf( "Options:\n" );
+				std::printf( "  --sizes LIST         triangle soup vertices per model, comma-separated;\n" );
+				std::printf( "                       K and M suffixes are accepted (default:\n" );
+				std::printf( "                       10K,100K,1M,10M,50M)\n" );
+				std::printf( "  --materials N        materials of the multi-material models (default: %zu)\n", ret.materials );
+				std::printf( "  --repeat N           bake each model N times and keep the fastest time\n" );
+				std::printf( "                       of each stage (default: 1)\n" );
+				std::printf( "  -o, --output FILE    write results as JSON to FILE (default: %s)\n", ret.output.c_str() );
+				std::printf( "  --work-dir DIR       put the generated models into DIR (default: a\n" );
+				std::printf( "                       temporary directory)\n" );
+				std::printf( "  -h, --help           show this message\n" );
+				std::printf( "\n" );
+				std::printf( "Bake options of cw3-bake (e.g. --jobs, --lods, --merge, --qtangent,\n" );
+				std::printf( "--compress) are accepted as well. Unlike cw3-bake, the default is --lods 1\n" );
+				std::printf( "(no levels of detail). The bake cache is never used.\n" );
+				std::exit( 0 );
+			}
+			else
+			{
+				bakeArgs.emplace_back( aArgv[i] );
+			}
+		}
+
+		ret.bake = parse_options_( int(bakeArgs.size()), bakeArgs.data() );
+		ret.bake.cacheDir.clear();
+
+		if( ret.sizes.empty() )
+			throw lut::Error( "--sizes: expected at least one size" );
+
+		return ret;
+	}
+}
+
+//--    $ write_synthetic_obj_()                ///{{{1///////////////////////
+namespace
+{
+	// Buffered output of formatted text; much faster than fprintf() per line
+	class TextWriter_
+	{
+		public:
+			explicit TextWriter_( std::filesystem::path const& aPath )
+				: mFile( std::fopen( aPath.string().c_str(), "wb" ) )
+			{
+				if( !mFile )
+					throw lut::Error( "Unable to open '%s' for writing", aPath.string().c_str() );
+
+				mBuffer.reserve( kBufferSize );
+			}
+
+			~TextWriter_()
+			{
+				std::fclose( mFile );
+			}
+
+			TextWriter_( TextWriter_ const& ) = delete;
+			TextWriter_& operator=( TextWriter_ const& ) = delete;
+
+			void print( char const* aFmt, ... )
+			{
+				char line[256];
+
+				va_list args;
+				va_start( args, aFmt );
+				int const length = std::vsnprintf( line, sizeof(line), aFmt, args );
+				va_end( args );
+
+				assert( length >= 0 && std::size_t(length) < sizeof(line) );
+				mBuffer.insert( mBuffer.end(), line, line + length );
+
+				if( mBuffer.size() >= kBufferSize - sizeof(line) )
+					flush();
+			}
+
+			void flush()
+			{
+				checked_write_( mFile, mBuffer.size(), mBuffer.data() );
+				mBuffer.clear();
+			}
+
+		private:
+			static constexpr std::size_t kBufferSize = 1 << 20;
+
+			FILE* mFile;
+			std::vector<char> mBuffer;
+	};
+
+	std::uintmax_t write_synthetic_obj_( std::filesystem::path const& aObjPath, BenchModel_ aModel, std::size_t aVertices, std::size_t aMaterials )
+	{
+		// Each mesh is a grid of n x n quads, i.e. 6n^2 soup vertices. The
+		// meshes are placed next to each other along x. Pairs of materials
+		// share their textures, which find_unique_textures_() has to notice.
+		std::size_t const materials = BenchModel_::soup == aModel ? 1 : std::max<std::size_t>( aMaterials, 1 );
+		std::size_t const meshes = BenchModel_::soup == aModel ? 1 : 2 * materials;
+
+		std::size_t const perMesh = std::max<std::size_t>( aVertices / meshes, 6 );
+		std::size_t const n = std::max<std::size_t>( std::size_t(std::lround( std::sqrt( perMesh / 6.0 ) )), 1 );
+
+		auto mtlPath = aObjPath;
+		mtlPath.replace_extension( "mtl" );
+
+		{
+			TextWriter_ mtl( mtlPath );
+			for( std::size_t i = 0; i < materials; ++i )
+			{
+				mtl.print( "newmtl material%zu\n", i );
+				mtl.print( "Kd %g %g %g\n", (i % 7) / 7.0, (i % 5) / 5.0, (i % 3) / 3.0 );
+				mtl.print( "Pr %g\nPm %g\n", 0.25 + (i % 4) / 8.0, double(i % 2) );
+
+				if( BenchModel_::multi == aModel )
+				{
+					std::size_t const tex = i / 2;
+					mtl.print( "map_Kd basecolor%zu.png\n", tex );
+					mtl.print( "map_Pr roughness%zu.png\n", tex );
+					mtl.print( "map_Pm metalness%zu.png\n", tex );
+					mtl.print( "norm normal%zu.png\n", tex );
+				}
+			}
+			mtl.flush();
+		}
+
+		TextWriter_ obj( aObjPath );
+		obj.print( "mtllib %s\n", mtlPath.filename().string().c_str() );
+
+		std::size_t first = 1; // OBJ indices are one-based
+		for( std::size_t mesh = 0; mesh < meshes; ++mesh )
+		{
+			obj.print( "o mesh%zu\nusemtl material%zu\n", mesh, mesh % materials );
+
+			// Height field z = a sin(kx) cos(ky) over [0,1]^2
+			constexpr double a = 0.1, k = 12.0;
+			double const x0 = 1.25 * mesh;
+
+			for( std::size_t y = 0; y <= n; ++y )
+			{
+				for( std::size_t x = 0; x <= n; ++x )
+				{
+					double const u = double(x) / n, v = double(y) / n;
+					obj.print( "v %.6f %.6f %.6f\n", x0 + u, v, a * std::sin( k*u ) * std::cos( k*v ) );
+				}
+			}
+
+			for( std::size_t y = 0; y <= n; ++y )
+			{
+				for( std::size_t x = 0; x <= n; ++x )
+					obj.print( "vt %.6f %.6f\n", double(x) / n, double(y) / n );
+			}
+
+			for( std::size_t y = 0; y <= n; ++y )
+			{
+				for( std::size_t x = 0; x <= n; ++x )
+				{
+					double const u = double(x) / n, v = double(y) / n;
+					glm::dvec3 const normal = glm::normalize( glm::dvec3(
+						-a * k * std::cos( k*u ) * std::cos( k*v ),
+						a * k * std::sin( k*u ) * std::sin( k*v ),
+						1.0
+					) );
+					obj.print( "vn %.5f %.5f %.5f\n", normal.x, normal.y, normal.z );
+				}
+			}
+
+			for( std::size_t y = 0; y < n; ++y )
+			{
+				for( std::size_t x = 0; x < n; ++x )
+				{
+					std::size_t const i0 = first + y*(n+1) + x, i1 = i0 + 1;
+					std::size_t const i2 = i0 + (n+1), i3 = i2 + 1;
+
+					obj.print( "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", i0, i0, i0, i1, i1, i1, i3, i3, i3 );
+					obj.print( "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n", i0, i0, i0, i3, i3, i3, i2, i2, i2 );
+				}
+			}
+
+			first += (n+1) * (n+1);
+		}
+
+		obj.flush();
+
+		return std::filesystem::file_size( aObjPath ) + std::filesystem::file_size( mtlPath );
+	}
+}
+
+//--    $ run_bench_case_()                     ///{{{1///////////////////////
+namespace
+{
+	BenchCase_ run_bench_case_( std::filesystem::path const& aWorkDir, BenchModel_ aModel, std::size_t aVertices, BenchOptions_ const& aOptions )
+	{
+		BenchCase_ ret;
+		ret.model = aModel;
+		ret.targetVertices = aVertices;
+
+		auto const objPath = aWorkDir / (std::string( "bench-" ) + bench_model_name_( aModel ) + ".obj");
+		auto const meshPath = aWorkDir / (std::string( "bench-" ) + bench_model_name_( aModel ) + ".comp5822mesh");
+
+		ret.objBytes = write_synthetic_obj_( objPath, aModel, aVertices, aOptions.materials );
+
+		auto const& bake = aOptions.bake;
+
+		// The stages report their statistics; keep those out of the results
+		std::string log;
+		gModelLog_ = &log;
+
+		for( std::size_t run = 0; run < aOptions.repeat; ++run )
+		{
+			std::size_t stage = 0;
+			auto t0 = Clock_::now();
+			auto const lap_ = [&] (char const* aStage) {
+				auto const t1 = Clock_::now();
+				double const seconds = std::chrono::duration<double>( t1 - t0 ).count();
+
+				if( 0 == run )
+					ret.seconds.emplace_back( aStage, seconds );
+				else
+					ret.seconds[stage].second = std::min( ret.seconds[stage].second, seconds );
+
+				++stage;
+				log.clear();
+				t0 = Clock_::now();
+			};
+
+			// Load and prepare the model
+			auto model = load_wavefront_obj( objPath.string().c_str() );
+			lap_( "load_wavefront_obj" );
+
+			model = normalize_( std::move(model), glm::mat4x4( 1.f ) );
+			lap_( "normalize" );
+
+			if( bake.mergeByMaterial )
+			{
+				model = merge_by_material_( std::move(model) );
+				lap_( "merge_by_material" );
+			}
+
+			// Indexing: all meshes concurrently (as the baker does it), and
+			// the largest mesh on its own, on a single thread
+			std::vector<IndexedMesh> indexed( model.meshes.size() );
+			std::vector<std::size_t> all( model.meshes.size() );
+			for( std::size_t i = 0; i < all.size(); ++i )
+				all[i] = i;
+
+			index_meshes_( indexed, model, all, bake.jobs );
+			lap_( "index_meshes" );
+
+			std::size_t largest = 0;
+			for( std::size_t i = 0; i < model.meshes.size(); ++i )
+			{
+				if( model.meshes[i].vertexCount > model.meshes[largest].vertexCount )
+					largest = i;
+			}
+
+			TriangleSoup soup;
+			{
+				auto const& imesh = model.meshes[largest];
+				auto const begin = imesh.vertexStartIndex, end = begin + imesh.vertexCount;
+
+				soup.vert.assign( model.positions.begin() + begin, model.positions.begin() + end );
+				soup.norm.assign( model.normals.begin() + begin, model.normals.begin() + end );
+				soup.text.assign( model.texcoords.begin() + begin, model.texcoords.begin() + end );
+			}
+
+			t0 = Clock_::now();
+			[[maybe_unused]] auto const single = make_indexed_mesh( soup, kIndexErrorTolerance );
+			lap_( "make_indexed_mesh" );
+
+			// Remaining mesh processing, as in process_model_()
+			generate_tangents_( indexed, all, bake.jobs );
+			lap_( "generate_tangents" );
+
+			generate_lods_( indexed, all, bake );
+			lap_( "generate_lods" );
+
+			optimize_meshes_( indexed, bake );
+			lap_( "optimize_meshes" );
+
+			auto const quantized = quantize_meshes_( indexed, bake );
+			lap_( "quantize_meshes" );
+
+			auto const meshlets = build_meshlets_( indexed, bake.jobs );
+			lap_( "build_meshlets" );
+
+			auto const unique = find_unique_textures_( model );
+			lap_( "find_unique_textures" );
+
+			// Output
+			auto const textures = new_paths_( unique, "bench-tex", false );
+
+			t0 = Clock_::now();
+			FILE* fof = std::fopen( meshPath.string().c_str(), "wb" );
+			if( !fof )
+				throw lut::Error( "Unable to open '%s' for writing", meshPath.string().c_str() );
+
+			try
+			{
+				write_model_data_( fof, model, indexed, quantized, meshlets, textures, bake );
+			}
+			catch( ... )
+			{
+				std::fclose( fof );
+				throw;
+			}
+
+			std::fclose( fof );
+			lap_( "write_model_data" );
+
+			// Statistics (identical for all runs)
+			ret.soupVertices = model.positions.size();
+			ret.meshes = model.meshes.size();
+			ret.materials = model.materials.size();
+			ret.textures = unique.size();
+
+			ret.indexedVertices = 0;
+			for( auto const& mesh : indexed )
+				ret.indexedVertices += mesh.vert.size();
+		}
+
+		gModelLog_ = nullptr;
+
+		ret.outputBytes = std::filesystem::file_size( meshPath );
+
+		// The inputs of the larger cases take up a lot of space
+		std::filesystem::remove( objPath );
+		std::filesystem::remove( std::filesystem::path( objPath ).replace_extension( "mtl" ) );
+		std::filesystem::remove( meshPath );
+
+		return ret;
+	}
+}
+
+//--    $ write_bench_json_()                   ///{{{1///////////////////////
+namespace
+{
+	void write_bench_json_( char const* aPath, std::vector<BenchCase_> const& aCases, BenchOptions_ const& aOptions )
+	{
+		// Format:
+		// {
+		//   "benchmark": "cw3-bake",
+		//   "build": "release" or "debug",
+		//   "jobs": N, "repeat": N,
+		//   "options": { bake options },
+		//   "cases": [
+		//     { "model": "soup" or "multi", "target_vertices": N, ...,
+		//       "seconds": { stage: seconds, ... }, "total_seconds": T },
+		//     ...
+		//   ]
+		// }
+		FILE* fof = std::fopen( aPath, "wb" );
+		if( !fof )
+			throw lut::Error( "Unable to open '%s' for writing", aPath );
+
+		auto const& bake = aOptions.bake;
+
+#		if defined(NDEBUG)
+		char const* const build = "release";
+#		else
+		char const* const build = "debug";
+#		endif
+
+		std::fprintf( fof, "{\n" );
+		std::fprintf( fof, "  \"benchmark\": \"cw3-bake\",\n" );
+		std::fprintf( fof, "  \"build\": \"%s\",\n", build );
+		std::fprintf( fof, "  \"jobs\": %zu,\n", bake.jobs );
+		std::fprintf( fof, "  \"repeat\": %zu,\n", aOptions.repeat );
+		std::fprintf( fof, "  \"options\": { \"lods\": %zu, \"lod_error\": %g, \"overdraw\": %g, \"merge\": %s, \"qtangent\": %s, \"compress\": %s },\n",
+			bake.lodLevels,
+			double(bake.lodError),
+			double(bake.overdrawThreshold),
+			bake.mergeByMaterial ? "true" : "false",
+			TangentFrameEncoding::qtangent == bake.tangentFrames ? "true" : "false",
+			bake.compressStreams ? "true" : "false"
+		);
+		std::fprintf( fof, "  \"cases\": [\n" );
+
+		for( std::size_t i = 0; i < aCases.size(); ++i )
+		{
+			auto const& c = aCases[i];
+
+			std::fprintf( fof, "    {\n" );
+			std::fprintf( fof, "      \"model\": \"%s\",\n", bench_model_name_( c.model ) );
+			std::fprintf( fof, "      \"target_vertices\": %zu,\n", c.targetVertices );
+			std::fprintf( fof, "      \"soup_vertices\": %zu,\n", c.soupVertices );
+			std::fprintf( fof, "      \"indexed_vertices\": %zu,\n", c.indexedVertices );
+			std::fprintf( fof, "      \"meshes\": %zu,\n", c.meshes );
+			std::fprintf( fof, "      \"materials\": %zu,\n", c.materials );
+			std::fprintf( fof, "      \"textures\": %zu,\n", c.textures );
+			std::fprintf( fof, "      \"obj_bytes\": %ju,\n", c.objBytes );
+			std::fprintf( fof, "      \"output_bytes\": %ju,\n", c.outputBytes );
+			std::fprintf( fof, "      \"seconds\": {" );
+
+			double total = 0.0;
+			for( std::size_t s = 0; s < c.seconds.size(); ++s )
+			{
+				std::fprintf( fof, "%s\n        \"%s\": %.6f", s ? "," : "", c.seconds[s].first, c.seconds[s].second );
+				total += c.seconds[s].second;
+			}
+
+			std::fprintf( fof, "\n      },\n" );
+			std::fprintf( fof, "      \"total_seconds\": %.6f\n", total );
+			std::fprintf( fof, "    }%s\n", i+1 < aCases.size() ? "," : "" );
+		}
+
+		std::fprintf( fof, "  ]\n" );
+		std::fprintf( fof, "}\n" );
+
+		if( std::ferror( fof ) )
+		{
+			std::fclose( fof );
+			throw lut::Error( "Error writing '%s'", aPath );
+		}
+
+		std::fclose( fof );
+	}
+
+	char const* bench_model_name_( BenchModel_ aModel )
+	{
+		switch( aModel )
+		{
+			case BenchModel_::soup: return "soup";
+			case BenchModel_::multi: return "multi";
+		}
+
+		return "?";
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,713 @@
+#include "block_compress.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define BLOCK_COMPRESS_SSE2_ 1
+#	include <emmintrin.h>
+#else
+#	define BLOCK_COMPRESS_SSE2_ 0
+#endif
+
+#include "parallel.hpp"
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	enum class Kind_
+	{
+		none,
+		bc1,
+		bc3,
+		bc4,
+		bc5,
+		bc7
+	};
+
+	// Texels of one 4x4 block, one array per channel (R, G, B, A), each in
+	// row-major order. Values are in [0, 255].
+	struct Block_
+	{
+		alignas(16) float c[4][16];
+	};
+
+	struct Palette_
+	{
+		std::size_t size;
+		float entry[16][4];
+	};
+
+	// Weights of the second endpoint for each index
+	constexpr float kBC1Weights_[4] = { 0.f, 1.f, 1.f/3, 2.f/3 };
+	constexpr float kBC4Weights_[8] = { 0.f, 1.f, 1.f/7, 2.f/7, 3.f/7, 4.f/7, 5.f/7, 6.f/7 };
+	constexpr int kBC7Weights_[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	// Four lanes; the kernels process four texels of a block at a time.
+#	if BLOCK_COMPRESS_SSE2_
+	struct F4_
+	{
+		__m128 v;
+	};
+
+	inline F4_ load4_( float const* aPtr ) { return { _mm_load_ps( aPtr ) }; }
+	inline void store4_( float* aPtr, F4_ aX ) { _mm_store_ps( aPtr, aX.v ); }
+	inline F4_ splat4_( float aX ) { return { _mm_set1_ps( aX ) }; }
+
+	inline F4_ operator+( F4_ aX, F4_ aY ) { return { _mm_add_ps( aX.v, aY.v ) }; }
+	inline F4_ operator-( F4_ aX, F4_ aY ) { return { _mm_sub_ps( aX.v, aY.v ) }; }
+	inline F4_ operator*( F4_ aX, F4_ aY ) { return { _mm_mul_ps( aX.v, aY.v ) }; }
+
+	inline F4_ min4_( F4_ aX, F4_ aY ) { return { _mm_min_ps( aX.v, aY.v ) }; }
+
+	// Per lane: aX < aY ? aIfLess : aOtherwise
+	inline F4_ select_less4_( F4_ aX, F4_ aY, F4_ aIfLess, F4_ aOtherwise )
+	{
+		__m128 const mask = _mm_cmplt_ps( aX.v, aY.v );
+		return { _mm_or_ps( _mm_and_ps( mask, aIfLess.v ), _mm_andnot_ps( mask, aOtherwise.v ) ) };
+	}
+#	else // !BLOCK_COMPRESS_SSE2_
+	struct F4_
+	{
+		float v[4];
+	};
+
+	inline F4_ load4_( float const* aPtr ) { return { { aPtr[0], aPtr[1], aPtr[2], aPtr[3] } }; }
+	inline void store4_( float* aPtr, F4_ aX ) { for( int i = 0; i < 4; ++i ) aPtr[i] = aX.v[i]; }
+	inline F4_ splat4_( float aX ) { return { { aX, aX, aX, aX } }; }
+
+	inline F4_ operator+( F4_ aX, F4_ aY ) { for( int i = 0; i < 4; ++i ) aX.v[i] += aY.v[i]; return aX; }
+	inline F4_ operator-( F4_ aX, F4_ aY ) { for( int i = 0; i < 4; ++i ) aX.v[i] -= aY.v[i]; return aX; }
+	inline F4_ operator*( F4_ aX, F4_ aY ) { for( int i = 0; i < 4; ++i ) aX.v[i] *= aY.v[i]; return aX; }
+
+	inline F4_ min4_( F4_ aX, F4_ aY ) { for( int i = 0; i < 4; ++i ) aX.v[i] = std::min( aX.v[i], aY.v[i] ); return aX; }
+
+	inline F4_ select_less4_( F4_ aX, F4_ aY, F4_ aIfLess, F4_ aOtherwise )
+	{
+		for( int i = 0; i < 4; ++i )
+			aOtherwise.v[i] = aX.v[i] < aY.v[i] ? aIfLess.v[i] : aOtherwise.v[i];
+		return aOtherwise;
+	}
+#	endif // ~ BLOCK_COMPRESS_SSE2_
+
+	Kind_ kind_( std::uint32_t aFormat );
+
+	void load_block_(
+		std::uint8_t const* aRGBA, std::uint32_t aWidth, std::uint32_t aHeight,
+		std::uint32_t aBlockX, std::uint32_t aBlockY,
+		Block_&
+	);
+
+	float fit_indices_(
+		Block_ const&, std::size_t aFirst, std::size_t aCount,
+		Palette_ const&,
+		std::uint8_t aIndices[16]
+	);
+
+	void fit_line_(
+		Block_ const&, std::size_t aCount,
+		float aEnd0[4], float aEnd1[4]
+	);
+	bool refit_line_(
+		Block_ const&, std::size_t aFirst, std::size_t aCount,
+		std::uint8_t const aIndices[16], float const* aWeights,
+		float aEnd0[4], float aEnd1[4]
+	);
+
+	void encode_bc1_( Block_ const&, std::uint8_t* aOut );
+	void encode_bc4_( Block_ const&, std::size_t aChannel, std::uint8_t* aOut );
+	void encode_bc7_( Block_ const&, std::uint8_t* aOut );
+}
+
+//--    is_block_format()               ///{{{2///////////////////////////////
+bool is_block_format( std::uint32_t aFormat )
+{
+	return Kind_::none != kind_( aFormat );
+}
+
+//--    block_bytes()                   ///{{{2///////////////////////////////
+std::size_t block_bytes( std::uint32_t aFormat )
+{
+	switch( kind_( aFormat ) )
+	{
+		case Kind_::bc1: return 8;
+		case Kind_::bc4: return 8;
+		case Kind_::bc3: return 16;
+		case Kind_::bc5: return 16;
+		case Kind_::bc7: return 16;
+		case Kind_::none: break;
+	}
+
+	throw lut::Error( "Format %u is not a supported block-compressed format", aFormat );
+}
+
+//--    compress_blocks()               ///{{{2///////////////////////////////
+std::vector<std::uint8_t> compress_blocks( std::uint32_t aFormat, std::uint8_t const* aRGBA, std::uint32_t aWidth, std::uint32_t aHeight, std::size_t aJobs )
+{
+	assert( aRGBA );
+	assert( aWidth > 0 && aHeight > 0 );
+
+	auto const kind = kind_( aFormat );
+	auto const blockSize = block_bytes( aFormat );
+
+	std::uint32_t const blocksX = (aWidth + 3) / 4;
+	std::uint32_t const blocksY = (aHeight + 3) / 4;
+
+	std::vector<std::uint8_t> ret( std::size_t(blocksX) * blocksY * blockSize );
+
+	parallel_for( blocksY, aJobs, [&] (std::size_t aRow) {
+		Block_ block;
+
+		for( std::uint32_t bx = 0; bx < blocksX; ++bx )
+		{
+			load_block_( aRGBA, aWidth, aHeight, bx, std::uint32_t(aRow), block );
+
+			std::uint8_t* out = ret.data() + (aRow*blocksX + bx) * blockSize;
+			switch( kind )
+			{
+				case Kind_::bc1:
+					encode_bc1_( block, out );
+					break;
+				case Kind_::bc3:
+					encode_bc4_( block, 3, out );
+					encode_bc1_( block, out+8 );
+					break;
+				case Kind_::bc4:
+					encode_bc4_( block, 0, out );
+					break;
+				case Kind_::bc5:
+					encode_bc4_( block, 0, out );
+					encode_bc4_( block, 1, out+8 );
+					break;
+				case Kind_::bc7:
+					encode_bc7_( block, out );
+					break;
+				case Kind_::none:
+					assert( false );
+					break;
+			}
+		}
+	} );
+
+	return ret;
+}
+
+//--    compress_mip_texture()          ///{{{2///////////////////////////////
+void compress_mip_texture( MipTexture& aTexture, std::uint32_t aFormat, std::size_t aJobs )
+{
+	assert( kTextureFormatRGBA8Srgb == aTexture.format || kTextureFormatRGBA8Unorm == aTexture.format );
+
+	for( auto& level : aTexture.levels )
+		level.data = compress_blocks( aFormat, level.data.data(), level.width, level.height, aJobs );
+
+	aTexture.format = aFormat;
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	Kind_ kind_( std::uint32_t aFormat )
+	{
+		switch( aFormat )
+		{
+			case kTextureFormatBC1Unorm: return Kind_::bc1;
+			case kTextureFormatBC1Srgb: return Kind_::bc1;
+			case kTextureFormatBC3Unorm: return Kind_::bc3;
+			case kTextureFormatBC3Srgb: return Kind_::bc3;
+			case kTextureFormatBC4Unorm: return Kind_::bc4;
+			case kTextureFormatBC5Unorm: return Kind_::bc5;
+			case kTextureFormatBC7Unorm: return Kind_::bc7;
+			case kTextureFormatBC7Srgb: return Kind_::bc7;
+		}
+
+		return Kind_::none;
+	}
+
+	void load_block_( std::uint8_t const* aRGBA, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aBlockX, std::uint32_t aBlockY, Block_& aBlock )
+	{
+		for( std::uint32_t y = 0; y < 4; ++y )
+		{
+			auto const sy = std::min( aBlockY*4 + y, aHeight-1 );
+			for( std::uint32_t x = 0; x < 4; ++x )
+			{
+				auto const sx = std::min( aBlockX*4 + x, aWidth-1 );
+				std::uint8_t const* texel = aRGBA + (std::size_t(sy)*aWidth + sx) * 4;
+
+				for( std::size_t c = 0; c < 4; ++c )
+					aBlock.c[c][y*4+x] = float(texel[c]);
+			}
+		}
+	}
+
+	float fit_indices_( Block_ const& aBlock, std::size_t aFirst, std::size_t aCount, Palette_ const& aPalette, std::uint8_t aIndices[16] )
+	{
+		// Pick the palette entry with the smallest squared error for each
+		// texel. Ties go to the lowest index.
+		alignas(16) float errors[4], indices[4];
+
+		float total = 0.f;
+		for( std::size_t t = 0; t < 16; t += 4 )
+		{
+			F4_ best = splat4_( std::numeric_limits<float>::max() );
+			F4_ bestIndex = splat4_( 0.f );
+
+			for( std::size_t e = 0; e < aPalette.size; ++e )
+			{
+				F4_ error = splat4_( 0.f );
+				for( std::size_t c = 0; c < aCount; ++c )
+				{
+					F4_ const diff = load4_( aBlock.c[aFirst+c] + t ) - splat4_( aPalette.entry[e][c] );
+					error = error + diff*diff;
+				}
+
+				bestIndex = select_less4_( error, best, splat4_( float(e) ), bestIndex );
+				best = min4_( error, best );
+			}
+
+			store4_( errors, best );
+			store4_( indices, bestIndex );
+
+			for( std::size_t i = 0; i < 4; ++i )
+			{
+				total += errors[i];
+				aIndices[t+i] = std::uint8_t(indices[i]);
+			}
+		}
+
+		return total;
+	}
+
+	void fit_line_( Block_ const& aBlock, std::size_t aCount, float aEnd0[4], float aEnd1[4] )
+	{
+		// Principal axis of the texels in the first aCount channels (power
+		// iteration on the covariance matrix). The endpoints are the extreme
+		// projections onto the axis.
+		assert( aCount <= 4 );
+
+		float mean[4] = {};
+		for( std::size_t c = 0; c < aCount; ++c )
+		{
+			for( std::size_t i = 0; i < 16; ++i )
+				mean[c] += aBlock.c[c][i];
+			mean[c] /= 16.f;
+		}
+
+		float cov[4][4] = {};
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			for( std::size_t a = 0; a < aCount; ++a )
+			{
+				for( std::size_t b = 0; b < aCount; ++b )
+					cov[a][b] += (aBlock.c[a][i] - mean[a]) * (aBlock.c[b][i] - mean[b]);
+			}
+		}
+
+		// Start from the row of the channel with the largest variance
+		std::size_t largest = 0;
+		for( std::size_t c = 1; c < aCount; ++c )
+		{
+			if( cov[c][c] > cov[largest][largest] )
+				largest = c;
+		}
+
+		float axis[4] = {};
+		for( std::size_t c = 0; c < aCount; ++c )
+			axis[c] = cov[largest][c];
+
+		for( int iter = 0; iter < 8; ++iter )
+		{
+			float next[4] = {};
+			float length = 0.f;
+			for( std::size_t a = 0; a < aCount; ++a )
+			{
+				for( std::size_t b = 0; b < aCount; ++b )
+					next[a] += cov[a][b] * axis[b];
+				length += next[a]*next[a];
+			}
+
+			if( !(length > 1e-12f) )
+				break;
+
+			length = std::sqrt( length );
+			for( std::size_t c = 0; c < aCount; ++c )
+				axis[c] = next[c] / length;
+		}
+
+		float tmin = 0.f, tmax = 0.f;
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			float t = 0.f;
+			for( std::size_t c = 0; c < aCount; ++c )
+				t += (aBlock.c[c][i] - mean[c]) * axis[c];
+
+			tmin = std::min( tmin, t );
+			tmax = std::max( tmax, t );
+		}
+
+		for( std::size_t c = 0; c < aCount; ++c )
+		{
+			aEnd0[c] = std::clamp( mean[c] + tmax*axis[c], 0.f, 255.f );
+			aEnd1[c] = std::clamp( mean[c] + tmin*axis[c], 0.f, 255.f );
+		}
+	}
+
+	bool refit_line_( Block_ const& aBlock, std::size_t aFirst, std::size_t aCount, std::uint8_t const aIndices[16], float const* aWeights, float aEnd0[4], float aEnd1[4] )
+	{
+		// Least-squares endpoints for fixed indices. Each texel is modelled
+		// as (1-w)*end0 + w*end1, where w is the weight of its index.
+		float aa = 0.f, ab = 0.f, bb = 0.f;
+		float ra[4] = {}, rb[4] = {};
+
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			float const w = aWeights[aIndices[i]];
+			float const a = 1.f - w;
+
+			aa += a*a;
+			ab += a*w;
+			bb += w*w;
+
+			for( std::size_t c = 0; c < aCount; ++c )
+			{
+				ra[c] += a * aBlock.c[aFirst+c][i];
+				rb[c] += w * aBlock.c[aFirst+c][i];
+			}
+		}
+
+		float const det = aa*bb - ab*ab;
+		if( !(det > 1e-4f) )
+			return false; // all texels use the same weight
+
+		for( std::size_t c = 0; c < aCount; ++c )
+		{
+			aEnd0[c] = std::clamp( (ra[c]*bb - rb[c]*ab) / det, 0.f, 255.f );
+			aEnd1[c] = std::clamp( (rb[c]*aa - ra[c]*ab) / det, 0.f, 255.f );
+		}
+
+		return true;
+	}
+}
+
+namespace
+{
+	std::uint16_t pack565_( float const aColor[3] )
+	{
+		auto const q = [] (float aX, int aMax) {
+			return std::uint16_t(std::clamp( int(aX * aMax / 255.f + 0.5f), 0, aMax ));
+		};
+
+		return std::uint16_t(q( aColor[0], 31 ) << 11 | q( aColor[1], 63 ) << 5 | q( aColor[2], 31 ));
+	}
+
+	void unpack565_( std::uint16_t aColor, float aOut[3] )
+	{
+		unsigned const r = aColor >> 11, g = (aColor >> 5) & 63, b = aColor & 31;
+		aOut[0] = float((r << 3) | (r >> 2));
+		aOut[1] = float((g << 2) | (g >> 4));
+		aOut[2] = float((b << 3) | (b >> 2));
+	}
+
+	float try_bc1_( Block_ const& aBlock, std::uint16_t aColor0, std::uint16_t aColor1, std::uint8_t aIndices[16] )
+	{
+		// Four-colour palette. With equal endpoints there is only one colour
+		// (and BC1 would be in three-colour mode, where index 0 still
+		// selects the first endpoint).
+		Palette_ palette;
+		palette.size = aColor0 == aColor1 ? 1 : 4;
+
+		unpack565_( aColor0, palette.entry[0] );
+		unpack565_( aColor1, palette.entry[1] );
+		for( std::size_t c = 0; c < 3; ++c )
+		{
+			palette.entry[2][c] = (2.f*palette.entry[0][c] + palette.entry[1][c]) / 3.f;
+			palette.entry[3][c] = (palette.entry[0][c] + 2.f*palette.entry[1][c]) / 3.f;
+		}
+
+		return fit_indices_( aBlock, 0, 3, palette, aIndices );
+	}
+
+	void encode_bc1_( Block_ const& aBlock, std::uint8_t* aOut )
+	{
+		float end0[4], end1[4];
+		fit_line_( aBlock, 3, end0, end1 );
+
+		std::uint16_t color0 = pack565_( end0 ), color1 = pack565_( end1 );
+
+		std::uint8_t indices[16];
+		float error = try_bc1_( aBlock, color0, color1, indices );
+
+		for( int iter = 0; iter < 2 && error > 0.f; ++iter )
+		{
+			if( !refit_line_( aBlock, 0, 3, indices, kBC1Weights_, end0, end1 ) )
+				break;
+
+			auto const c0 = pack565_( end0 ), c1 = pack565_( end1 );
+			if( c0 == color0 && c1 == color1 )
+				break;
+
+			std::uint8_t candidate[16];
+			auto const candidateError = try_bc1_( aBlock, c0, c1, candidate );
+			if( !(candidateError < error) )
+				break;
+
+			color0 = c0;
+			color1 = c1;
+			error = candidateError;
+			std::copy( candidate, candidate+16, indices );
+		}
+
+		// Four-colour mode requires color0 > color1
+		if( color0 < color1 )
+		{
+			std::swap( color0, color1 );
+			for( auto& index : indices )
+				index ^= 1;
+		}
+
+		std::uint32_t bits = 0;
+		for( std::size_t i = 0; i < 16; ++i )
+			bits |= std::uint32_t(indices[i]) << (2*i);
+
+		aOut[0] = std::uint8_t(color0);
+		aOut[1] = std::uint8_t(color0 >> 8);
+		aOut[2] = std::uint8_t(color1);
+		aOut[3] = std::uint8_t(color1 >> 8);
+		for( std::size_t i = 0; i < 4; ++i )
+			aOut[4+i] = std::uint8_t(bits >> (8*i));
+	}
+}
+
+namespace
+{
+	float try_bc4_( Block_ const& aBlock, std::size_t aChannel, int aEnd0, int aEnd1, std::uint8_t aIndices[16] )
+	{
+		// aEnd0 > aEnd1 selects eight interpolated values, otherwise there
+		// are six plus the constants 0 and 255.
+		Palette_ palette;
+		palette.size = 8;
+		palette.entry[0][0] = float(aEnd0);
+		palette.entry[1][0] = float(aEnd1);
+
+		if( aEnd0 > aEnd1 )
+		{
+			for( int i = 2; i < 8; ++i )
+				palette.entry[i][0] = float((8-i)*aEnd0 + (i-1)*aEnd1) / 7.f;
+		}
+		else
+		{
+			for( int i = 2; i < 6; ++i )
+				palette.entry[i][0] = float((6-i)*aEnd0 + (i-1)*aEnd1) / 5.f;
+
+			palette.entry[6][0] = 0.f;
+			palette.entry[7][0] = 255.f;
+		}
+
+		return fit_indices_( aBlock, aChannel, 1, palette, aIndices );
+	}
+
+	void encode_bc4_( Block_ const& aBlock, std::size_t aChannel, std::uint8_t* aOut )
+	{
+		float const* values = aBlock.c[aChannel];
+
+		float lo = 255.f, hi = 0.f;
+		float innerLo = 255.f, innerHi = 0.f; // excluding 0 and 255
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			lo = std::min( lo, values[i] );
+			hi = std::max( hi, values[i] );
+
+			if( values[i] > 0.f && values[i] < 255.f )
+			{
+				innerLo = std::min( innerLo, values[i] );
+				innerHi = std::max( innerHi, values[i] );
+			}
+		}
+
+		int bestEnd0 = 0, bestEnd1 = 0;
+		std::uint8_t best[16];
+		float bestError = std::numeric_limits<float>::max();
+
+		auto const try_ = [&] (int aEnd0, int aEnd1) {
+			std::uint8_t indices[16];
+			auto const error = try_bc4_( aBlock, aChannel, aEnd0, aEnd1, indices );
+			if( error < bestError )
+			{
+				bestEnd0 = aEnd0;
+				bestEnd1 = aEnd1;
+				bestError = error;
+				std::copy( indices, indices+16, best );
+			}
+		};
+
+		// Eight-value mode spanning the whole range. Six-value mode can do
+		// better for blocks that contain (some) 0s or 255s.
+		try_( int(hi + 0.5f), int(lo + 0.5f) );
+
+		if( innerLo <= innerHi && (lo == 0.f || hi == 255.f) )
+			try_( int(innerLo + 0.5f), int(innerHi + 0.5f) );
+
+		for( int iter = 0; iter < 2 && bestError > 0.f && bestEnd0 > bestEnd1; ++iter )
+		{
+			float end0[4], end1[4];
+			if( !refit_line_( aBlock, aChannel, 1, best, kBC4Weights_, end0, end1 ) )
+				break;
+
+			int const e0 = int(end0[0] + 0.5f), e1 = int(end1[0] + 0.5f);
+			if( e0 <= e1 || (e0 == bestEnd0 && e1 == bestEnd1) )
+				break;
+
+			auto const previous = bestError;
+			try_( e0, e1 );
+			if( !(bestError < previous) )
+				break;
+		}
+
+		std::uint64_t bits = 0;
+		for( std::size_t i = 0; i < 16; ++i )
+			bits |= std::uint64_t(best[i]) << (3*i);
+
+		aOut[0] = std::uint8_t(bestEnd0);
+		aOut[1] = std::uint8_t(bestEnd1);
+		for( std::size_t i = 0; i < 6; ++i )
+			aOut[2+i] = std::uint8_t(bits >> (8*i));
+	}
+}
+
+namespace
+{
+	struct BC7Mode6_
+	{
+		int end[2][4]; // 7 bits per channel
+		int pbit[2];
+		std::uint8_t indices[16];
+		float error;
+	};
+
+	void try_bc7_( Block_ const& aBlock, float const aEnd0[4], float const aEnd1[4], BC7Mode6_& aBest )
+	{
+		// Each endpoint is stored with seven bits per channel plus a shared
+		// eighth (least significant) "p-bit". The endpoints are independent,
+		// so pick each p-bit by the quantization error of its endpoint.
+		float const* const ends[2] = { aEnd0, aEnd1 };
+
+		int pbit[2] = {}, end[2][4] = {}, full[2][4] = {};
+		for( std::size_t e = 0; e < 2; ++e )
+		{
+			float bestError = std::numeric_limits<float>::max();
+			for( int p = 0; p < 2; ++p )
+			{
+				int q[4];
+				float error = 0.f;
+				for( std::size_t c = 0; c < 4; ++c )
+				{
+					q[c] = std::clamp( int((ends[e][c] - p) / 2.f + 0.5f), 0, 127 );
+					float const d = ends[e][c] - float(q[c] << 1 | p);
+					error += d*d;
+				}
+
+				if( error < bestError )
+				{
+					bestError = error;
+					pbit[e] = p;
+					for( std::size_t c = 0; c < 4; ++c )
+					{
+						end[e][c] = q[c];
+						full[e][c] = q[c] << 1 | p;
+					}
+				}
+			}
+		}
+
+		Palette_ palette;
+		palette.size = 16;
+		for( std::size_t i = 0; i < 16; ++i )
+		{
+			int const w = kBC7Weights_[i];
+			for( std::size_t c = 0; c < 4; ++c )
+				palette.entry[i][c] = float(((64-w)*full[0][c] + w*full[1][c] + 32) >> 6);
+		}
+
+		std::uint8_t indices[16];
+		auto const error = fit_indices_( aBlock, 0, 4, palette, indices );
+		if( error < aBest.error )
+		{
+			std::copy( &end[0][0], &end[0][0]+8, &aBest.end[0][0] );
+			aBest.pbit[0] = pbit[0];
+			aBest.pbit[1] = pbit[1];
+			std::copy( indices, indices+16, aBest.indices );
+			aBest.error = error;
+		}
+	}
+
+	void encode_bc7_( Block_ const& aBlock, std::uint8_t* aOut )
+	{
+		BC7Mode6_ best{};
+		best.error = std::numeric_limits<float>::max();
+
+		float end0[4], end1[4];
+		fit_line_( aBlock, 4, end0, end1 );
+		try_bc7_( aBlock, end0, end1, best );
+
+		float weights[16];
+		for( std::size_t i = 0; i < 16; ++i )
+			weights[i] = kBC7Weights_[i] / 64.f;
+
+		for( int iter = 0; iter < 2 && best.error > 0.f; ++iter )
+		{
+			if( !refit_line_( aBlock, 0, 4, best.indices, weights, end0, end1 ) )
+				break;
+
+			auto const previous = best.error;
+			try_bc7_( aBlock, end0, end1, best );
+			if( !(best.error < previous) )
+				break;
+		}
+
+		// The most significant index bit of the first texel is implied to be
+		// zero. Swap the endpoints if necessary.
+		if( best.indices[0] & 8 )
+		{
+			for( std::size_t c = 0; c < 4; ++c )
+				std::swap( best.end[0][c], best.end[1][c] );
+			std::swap( best.pbit[0], best.pbit[1] );
+
+			for( auto& index : best.indices )
+				index = std::uint8_t(15 - index);
+		}
+
+		// Fields are stored starting from the least significant bit of the
+		// first byte.
+		std::fill_n( aOut, 16, std::uint8_t(0) );
+
+		std::size_t bit = 0;
+		auto const put_ = [&] (unsigned aValue, std::size_t aBits) {
+			for( std::size_t i = 0; i < aBits; ++i, ++bit )
+				aOut[bit/8] |= std::uint8_t(((aValue >> i) & 1) << (bit%8));
+		};
+
+		put_( 1u << 6, 7 ); // mode 6
+
+		for( std::size_t c = 0; c < 4; ++c )
+		{
+			put_( unsigned(best.end[0][c]), 7 );
+			put_( unsigned(best.end[1][c]), 7 );
+		}
+
+		put_( unsigned(best.pbit[0]), 1 );
+		put_( unsigned(best.pbit[1]), 1 );
+
+		put_( best.indices[0], 3 );
+		for( std::size_t i = 1; i < 16; ++i )
+			put_( best.indices[i], 4 );
+
+		assert( 128 == bit );
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
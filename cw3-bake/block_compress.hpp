@@ -0,0 +1,64 @@
+#ifndef BLOCK_COMPRESS_HPP_8D2C6F14_E57B_4A09_93C1_6B0F2E7D45A8
+#define BLOCK_COMPRESS_HPP_8D2C6F14_E57B_4A09_93C1_6B0F2E7D45A8
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "mip_texture.hpp"
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Check whether aFormat (a VkFormat value) is one of the block-compressed
+ * formats supported by compress_blocks():
+ *  - BC1 (RGB, 4 bpp): opaque colour
+ *  - BC3 (RGBA, 8 bpp): colour with alpha; BC1 colour plus a BC4 alpha block
+ *  - BC4 (R, 4 bpp): single-channel data
+ *  - BC5 (RG, 8 bpp): two independent BC4 channels
+ *  - BC7 (RGBA, 8 bpp): colour with or without alpha
+ * Both UNORM and SRGB variants are accepted where they exist.
+ */
+bool is_block_format( std::uint32_t aFormat );
+
+/* Size of one 4x4 block of aFormat in bytes (8 or 16).
+ */
+std::size_t block_bytes( std::uint32_t aFormat );
+
+/* Encode an RGBA8 image (tightly packed rows) as 4x4 blocks of aFormat. The
+ * result holds ceil(w/4) * ceil(h/4) blocks in row-major order, as expected
+ * by vkCmdCopyBufferToImage(). Blocks that extend past the edge of the image
+ * replicate the edge texels.
+ *
+ * BC4 reads the red channel, BC5 red and green. For sRGB formats, colour is
+ * compared in sRGB space, i.e., as stored.
+ *
+ * The kernels operate on four texels at a time (SSE2 where available, plain
+ * C++ otherwise); rows of blocks are distributed over up to aJobs threads.
+ * The output does not depend on the number of threads.
+ *
+ * BC7 blocks only use mode 6 (a single RGBA line with 16 levels and 7+1 bit
+ * endpoints). It needs no partition search, which keeps encoding fast. It is
+ * clearly better than BC1 on smooth gradients, but falls behind a complete
+ * BC7 encoder on blocks that contain several unrelated colours.
+ */
+std::vector<std::uint8_t> compress_blocks(
+	std::uint32_t aFormat,
+	std::uint8_t const* aRGBA,
+	std::uint32_t aWidth,
+	std::uint32_t aHeight,
+	std::size_t aJobs
+);
+
+/* Encode all levels of an RGBA8 texture as aFormat (in place).
+ */
+void compress_mip_texture(
+	MipTexture&,
+	std::uint32_t aFormat,
+	std::size_t aJobs
+);
+
+#endif // BLOCK_COMPRESS_HPP_8D2C6F14_E57B_4A09_93C1_6B0F2E7D45A8
@@ -1,7 +1,7 @@
 #include "index_mesh.hpp"
 
 #include <numeric>
-#include <unordered_map>
+#include <algorithm>
 
 #include <cstddef>
 
@@ -13,6 +13,9 @@ namespace
 	constexpr float kAABBMarginFactor = 10.f;
 	constexpr std::size_t kSparseGridMaxSize = 1024*1024;
 
+	constexpr float kVicinityMaxLoad = 0.5f;
+	constexpr std::size_t kVicinityMinCells = 64;
+
 	// Discretize mesh positions
 	struct DiscretizedPosition_
 	{
@@ -28,12 +31,32 @@ namespace
 		float scale;
 	};
 
-	// hash discretized mesh positions
-	using VicinityKey_ = std::size_t;
-	inline VicinityKey_ hash_discretized_position_( DiscretizedPosition_ const& aPos );
+	// key discretized mesh positions
+	using VicinityKey_ = std::uint64_t;
+	inline VicinityKey_ key_discretized_position_( DiscretizedPosition_ const& aPos );
+
+	// generate vicinity map
+	/* The vicinity map groups vertex indices by grid cell. The indices are
+	 * stored in a single flat array, sorted by cell. An open-addressing hash
+	 * table (linear probing) maps each occupied cell to its range in that
+	 * array. Compared to a node-based multimap, this needs a handful of
+	 * bytes per vertex instead of one heap allocation per vertex, and a
+	 * lookup touches one table slot plus a contiguous run of indices.
+	 */
+	struct VicinityCell_
+	{
+		VicinityKey_ key;
+		std::uint32_t begin, end;
+	};
+
+	struct VicinityMap_
+	{
+		std::vector<VicinityCell_> cells; // size is a power of two
+		std::vector<std::uint32_t> vertices;
+
+		inline VicinityCell_ const* find( VicinityKey_ ) const;
+	};
 
-	// generate vicinity map 
-	using VicinityMap_ = std::unordered_multimap<VicinityKey_,std::size_t>;
 	void build_vicinity_map_( 
 		VicinityMap_&, 
 		Discretizer_ const&,
@@ -74,7 +97,7 @@ IndexedMesh make_indexed_mesh( TriangleSoup const& aSoup, float aErrorTolerance
 {
 	// compute bounding volume
 	glm::vec3 bmin( std::numeric_limits<float>::max() );
-	glm::vec3 bmax( std::numeric_limits<float>::min() );
+	glm::vec3 bmax( std::numeric_limits<float>::lowest() );
 
 	for( std::size_t vert = 0; vert < aSoup.vert.size(); ++vert )
 	{
@@ -204,28 +227,117 @@ namespace
 
 namespace
 {
-	std::hash<VicinityKey_> gHash_;
+	// Discretized coordinates are at most kSparseGridMaxSize (=2^20), and
+	// neighbour lookups step one cell outside of that range in either
+	// direction. Biasing by one and packing 21 bits per axis therefore
+	// gives a unique key for every cell that can be queried.
+	constexpr unsigned kKeyBitsPerAxis_ = 21;
+	constexpr std::uint64_t kKeyAxisMask_ = (std::uint64_t(1) << kKeyBitsPerAxis_) - 1;
+	constexpr VicinityKey_ kEmptyKey_ = ~VicinityKey_(0);
+
+	static_assert( kSparseGridMaxSize+2 <= kKeyAxisMask_, "Grid too large for vicinity keys" );
+
+	inline VicinityKey_ key_discretized_position_( DiscretizedPosition_ const& aDP )
+	{
+		std::uint64_t const x = std::uint64_t(std::int64_t(aDP.x)+1) & kKeyAxisMask_;
+		std::uint64_t const y = std::uint64_t(std::int64_t(aDP.y)+1) & kKeyAxisMask_;
+		std::uint64_t const z = std::uint64_t(std::int64_t(aDP.z)+1) & kKeyAxisMask_;
+		return x | (y << kKeyBitsPerAxis_) | (z << (2*kKeyBitsPerAxis_));
+	}
 
-	inline VicinityKey_ hash_discretized_position_( DiscretizedPosition_ const& aDP )
+	inline std::size_t slot_( VicinityKey_ aKey, std::size_t aMask )
 	{
-		// Based on boost::hash_combine.
-		std::size_t hash = gHash_(aDP.x);
-		hash ^= gHash_(aDP.y) + 0x9e3779b9 + (hash<<6) + (hash>>2);
-		hash ^= gHash_(aDP.z) + 0x9e3779b9 + (hash<<6) + (hash>>2);
-		return hash;
+		// Fibonacci hashing; the high bits are the well-mixed ones.
+		return std::size_t((aKey * 0x9e3779b97f4a7c15ull) >> 32) & aMask;
+	}
+
+	inline
+	VicinityCell_ const* VicinityMap_::find( VicinityKey_ aKey ) const
+	{
+		std::size_t const mask = cells.size()-1;
+		for( std::size_t i = slot_( aKey, mask ); ; i = (i+1) & mask )
+		{
+			auto const& cell = cells[i];
+			if( aKey == cell.key )
+				return &cell;
+			if( kEmptyKey_ == cell.key )
+				return nullptr;
+		}
 	}
 }
 
 namespace
 {
+	VicinityCell_& find_or_insert_( std::vector<VicinityCell_>& aCells, VicinityKey_ aKey )
+	{
+		std::size_t const mask = aCells.size()-1;
+		for( std::size_t i = slot_( aKey, mask ); ; i = (i+1) & mask )
+		{
+			auto& cell = aCells[i];
+			if( aKey == cell.key )
+				return cell;
+
+			if( kEmptyKey_ == cell.key )
+			{
+				cell.key = aKey;
+				return cell;
+			}
+		}
+	}
+
 	void build_vicinity_map_( VicinityMap_& aMap, Discretizer_ const& aD, std::vector<glm::vec3> const& aPositions )
 	{
+		VicinityCell_ const emptyCell{ kEmptyKey_, 0, 0 };
+
+		// Meshes typically have several soup vertices per cell, so start
+		// out small and grow the table as cells are discovered.
+		std::size_t capacity = kVicinityMinCells;
+		while( float(capacity) * kVicinityMaxLoad < float(aPositions.size()/4) )
+			capacity *= 2;
+
+		aMap.cells.assign( capacity, emptyCell );
+
+		// Count the vertices in each cell. Counts are kept in 'end' for now.
+		std::size_t occupied = 0;
 		for( std::size_t index = 0; index < aPositions.size(); ++index )
 		{
-			DiscretizedPosition_ dp = aD.discretize( aPositions[index] );
-			VicinityKey_ vk = hash_discretized_position_( dp );
+			VicinityKey_ const vk = key_discretized_position_( aD.discretize( aPositions[index] ) );
+
+			auto& cell = find_or_insert_( aMap.cells, vk );
+			if( 0 == cell.end++ )
+				++occupied;
+
+			if( float(occupied) > float(aMap.cells.size()) * kVicinityMaxLoad )
+			{
+				std::vector<VicinityCell_> grown( 2*aMap.cells.size(), emptyCell );
+				for( auto const& old : aMap.cells )
+				{
+					if( kEmptyKey_ != old.key )
+						find_or_insert_( grown, old.key ) = old;
+				}
 
-			aMap.insert( std::make_pair(vk, index) );
+				aMap.cells = std::move(grown);
+			}
+		}
+
+		// Turn counts into ranges
+		std::uint32_t offset = 0;
+		for( auto& cell : aMap.cells )
+		{
+			auto const count = cell.end;
+			cell.begin = cell.end = offset;
+			offset += count;
+		}
+
+		// Scatter vertex indices into their cell's range. 'end' is used as
+		// the insertion cursor and ends up one past the cell's last vertex.
+		aMap.vertices.resize( aPositions.size() );
+		for( std::size_t index = 0; index < aPositions.size(); ++index )
+		{
+			VicinityKey_ const vk = key_discretized_position_( aD.discretize( aPositions[index] ) );
+
+			auto& cell = find_or_insert_( aMap.cells, vk );
+			aMap.vertices[cell.end++] = std::uint32_t(index);
 		}
 	}
 }
@@ -332,12 +444,16 @@ namespace
 			for( std::size_t j = 0; j < kNeighbourCount_; ++j )
 			{
 				DiscretizedPosition_ const dq = neighbour_( dp, j );
-				VicinityKey_ const vk = hash_discretized_position_( dq );
+				VicinityKey_ const vk = key_discretized_position_( dq );
+
+				// get vertices in this cell
+				VicinityCell_ const* cell = aVM.find( vk );
+				if( !cell )
+					continue;
 
-				// get vertices in this bucket
-				for( auto [it, jt] = aVM.equal_range( vk ); it != jt; ++it )
+				for( std::uint32_t k = cell->begin; k != cell->end; ++k )
 				{
-					std::size_t const idx =  it->second;
+					std::size_t const idx = aVM.vertices[k];
 
 					if( idx == i ) continue; // don't try to merge with self
 					if( ~std::size_t(0) != collapseMap[idx] ) continue; // don't remerge
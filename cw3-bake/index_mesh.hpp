@@ -10,7 +10,7 @@
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
-//#include <glm/vec4.hpp>
+#include <glm/vec4.hpp>
 
 //--    types                                   ///{{{1///////////////////////
 struct TriangleSoup
@@ -19,16 +19,27 @@ struct TriangleSoup
 	std::vector<glm::vec3> norm;
 	std::vector<glm::vec2> text;
 };
+struct IndexedMeshLod
+{
+	std::vector<std::uint32_t> indices;
+	float error; // in model units
+};
 struct IndexedMesh
 {
 	std::vector<glm::vec3> vert;
 	std::vector<glm::vec3> norm;
 	std::vector<glm::vec2> text;
 
-	//std::vector<glm::vec4> tangent; // Task 1.4
+	// xyz: tangent, w: handedness; empty until generate_tangents() (see
+	// tangent_space.hpp) has run
+	std::vector<glm::vec4> tang;
 
 	std::vector<std::uint32_t> indices;
 
+	// Coarser levels of detail, finest first (see simplify_mesh.hpp). They
+	// reference the vertices above.
+	std::vector<IndexedMeshLod> lods;
+
 	glm::vec3 aabbMin, aabbMax;
 
 	IndexedMesh();
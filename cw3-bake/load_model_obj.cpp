@@ -1,6 +1,9 @@
 #include "load_model_obj.hpp"
 
-#include <unordered_set>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
 
 #include <cassert>
 #include <cstring>
@@ -83,32 +86,53 @@ InputModel load_wavefront_obj( char const* aPath )
 	//
 	// Unfortunately, RapidOBJ exposes a per-face material index.
 
-	std::unordered_set<std::size_t> activeMaterials;
+	// Each shape is split into one mesh per material. The faces are bucketed
+	// with a counting pass followed by a single scatter pass, so the index
+	// list of each shape is only scanned twice, regardless of the number of
+	// materials. All vertex arrays are allocated once up front.
+	//
+	// Note: different shapes are kept separate here. For static meshes, the
+	// baker can merge them by material (see --merge).
+	std::size_t totalVertices = 0;
+	for( auto const& shape : result.shapes )
+		totalVertices += shape.mesh.indices.size();
+
+	ret.positions.resize( totalVertices );
+	ret.texcoords.resize( totalVertices );
+	ret.normals.resize( totalVertices );
+
+	std::vector<std::size_t> materialCounts( ret.materials.size(), 0 );
+	std::vector<std::size_t> materialCursors( ret.materials.size(), 0 );
+	std::vector<std::size_t> activeMaterials;
+
+	std::size_t firstShapeVertex = 0;
 	for( auto const& shape : result.shapes )
 	{
 		auto const& shapeName = shape.name;
+		auto const& indices = shape.mesh.indices;
 
-		// Scan shape for materials
+		// Count vertices per material
 		activeMaterials.clear();
 
-		for( std::size_t i = 0; i < shape.mesh.indices.size(); ++i )
+		for( std::size_t i = 0; i < indices.size(); i += 3 )
 		{
 			auto const faceId = i/3; // Always triangles; see Triangulate() above
 
 			assert( faceId < shape.mesh.material_ids.size() );
 			auto const matId = shape.mesh.material_ids[faceId];
 
-			assert( matId < int(ret.materials.size()) );
-			activeMaterials.emplace( matId );
+			assert( matId >= 0 && matId < int(ret.materials.size()) );
+			if( 0 == materialCounts[matId] )
+				activeMaterials.emplace_back( std::size_t(matId) );
+
+			materialCounts[matId] += 3;
 		}
 
-		// Process vertices for active material
-		// This does multiple passes over the vertex data, which is less than
-		// optimal...
-		//
-		// Note: we still keep different "shapes" separate. For static meshes,
-		// one could merge all vertices with the same material for a bit more
-		// efficient rendering.
+		// Assign each material a contiguous range of vertices. Materials are
+		// ordered by index, which keeps the output deterministic.
+		std::sort( activeMaterials.begin(), activeMaterials.end() );
+
+		std::size_t cursor = firstShapeVertex;
 		for( auto const matId : activeMaterials )
 		{
 			// Keep track of mesh names; this can be useful for debugging.
@@ -118,48 +142,82 @@ InputModel load_wavefront_obj( char const* aPath )
 			else
 				meshName = shapeName + "::" + ret.materials[matId].materialName;
 
-			// Extract this material's vertices.
-			auto const firstVertex = ret.positions.size();
-			
-			for( std::size_t i = 0; i < shape.mesh.indices.size(); ++i )
-			{
-				auto const faceId = i/3; // Always triangles; see Triangulate() above
-				auto const faceMat = std::size_t(shape.mesh.material_ids[faceId]);
-
-				if( faceMat != matId )
-					continue;
-
-				auto const& idx = shape.mesh.indices[i];
-
-				ret.positions.emplace_back( glm::vec3{
-					result.attributes.positions[idx.position_index*3+0],
-					result.attributes.positions[idx.position_index*3+1],
-					result.attributes.positions[idx.position_index*3+2]
-				} );
-
-				ret.texcoords.emplace_back( glm::vec2{
-					result.attributes.texcoords[idx.texcoord_index*2+0],
-					result.attributes.texcoords[idx.texcoord_index*2+1]
-				} );
-
-				ret.normals.emplace_back( glm::vec3{
-					result.attributes.normals[idx.normal_index*3+0],
-					result.attributes.normals[idx.normal_index*3+1],
-					result.attributes.normals[idx.normal_index*3+2]
-				} );
-			}
-
-			auto const vertexCount = ret.positions.size() - firstVertex;
-
 			ret.meshes.emplace_back( InputMeshInfo{
 				std::move(meshName),
 				matId,
-				firstVertex,
-				vertexCount
+				cursor,
+				materialCounts[matId]
 			} );
+
+			materialCursors[matId] = cursor;
+			cursor += materialCounts[matId];
+			materialCounts[matId] = 0; // reset for next shape
 		}
+
+		assert( cursor == firstShapeVertex + indices.size() );
+
+		// Scatter vertices into their material's range
+		for( std::size_t i = 0; i < indices.size(); ++i )
+		{
+			auto const faceId = i/3;
+			auto const matId = std::size_t(shape.mesh.material_ids[faceId]);
+			auto const out = materialCursors[matId]++;
+
+			auto const& idx = indices[i];
+
+			ret.positions[out] = glm::vec3{
+				result.attributes.positions[idx.position_index*3+0],
+				result.attributes.positions[idx.position_index*3+1],
+				result.attributes.positions[idx.position_index*3+2]
+			};
+
+			ret.texcoords[out] = glm::vec2{
+				result.attributes.texcoords[idx.texcoord_index*2+0],
+				result.attributes.texcoords[idx.texcoord_index*2+1]
+			};
+
+			ret.normals[out] = glm::vec3{
+				result.attributes.normals[idx.normal_index*3+0],
+				result.attributes.normals[idx.normal_index*3+1],
+				result.attributes.normals[idx.normal_index*3+2]
+			};
+		}
+
+		firstShapeVertex = cursor;
 	}
 
 	return ret;
 }
 
+
+std::string find_wavefront_mtllib( char const* aPath )
+{
+	assert( aPath );
+
+	std::ifstream fin( aPath, std::ios::binary );
+	if( !fin )
+		throw lut::Error( "Unable to open OBJ file '%s'", aPath );
+
+	// rapidobj resolves the library relative to the OBJ file's directory
+	char const* pathEnd = std::strrchr( aPath, '/' );
+	std::string const prefix = pathEnd
+		? std::string( aPath, pathEnd+1 )
+		: ""
+	;
+
+	std::string line;
+	while( std::getline( fin, line ) )
+	{
+		if( 0 != line.compare( 0, 6, "mtllib" ) || line.size() < 7 || (' ' != line[6] && '\t' != line[6]) )
+			continue;
+
+		auto const first = line.find_first_not_of( " \t", 7 );
+		auto const last = line.find_last_not_of( " \t\r" );
+		if( std::string::npos == first )
+			continue;
+
+		return prefix + line.substr( first, last-first+1 );
+	}
+
+	return std::string();
+}
@@ -1,10 +1,17 @@
 #ifndef LOAD_MODEL_OBJ_HPP_7FB6DF28_3D89_48DD_9FD8_4E53FB04723C
 #define LOAD_MODEL_OBJ_HPP_7FB6DF28_3D89_48DD_9FD8_4E53FB04723C
 
+#include <string>
+
 #include "input_model.hpp"
 
 // Load a Wavefront OBJ model
 InputModel load_wavefront_obj( char const* aPath );
 
+// Find the material library (mtllib) referenced by a Wavefront OBJ file. Like
+// the texture paths in InputModel, the returned path includes the directory
+// of aPath. Returns an empty string if there is no material library.
+std::string find_wavefront_mtllib( char const* aPath );
+
 #endif // LOAD_MODEL_OBJ_HPP_7FB6DF28_3D89_48DD_9FD8_4E53FB04723C
 
@@ -1,22 +1,43 @@
+#include <chrono>
+#include <algorithm>
+#include <limits>
 #include <iterator>
+#include <utility>
 #include <vector>
 #include <typeinfo>
 #include <exception>
 #include <filesystem>
 #include <system_error>
 #include <unordered_map>
+#include <unordered_set>
+
+#include <mutex>
+#include <fstream>
+#include <sstream>
 
 #include <cstdio>
+#include <cstdarg>
+#include <cstdlib>
 #include <cstring>
 
 #include <tgen.h>
 #include <glm/glm.hpp>
 
+#include "parallel.hpp"
+#include "bake_cache.hpp"
 #include "index_mesh.hpp"
 #include "input_model.hpp"
+#include "optimize_mesh.hpp"
+#include "meshlets.hpp"
+#include "mip_texture.hpp"
+#include "block_compress.hpp"
+#include "quantize_mesh.hpp"
+#include "simplify_mesh.hpp"
+#include "tangent_space.hpp"
 #include "load_model_obj.hpp"
 
 #include "../labutils/error.hpp"
+#include "../labutils/compression.hpp"
 namespace lut = labutils;
 
 namespace
@@ -39,70 +60,273 @@ namespace
 	 * Suggestion: use 'uid-tag'. For example, I would use "scsmbil-tan" to
 	 * indicate that this is a custom format by myself (=scsmbil) with
 	 * additional tangent space information.
+	 *
+	 * "compact-cw3" replaced "default-cw3": vertex data is quantized (see
+	 * quantize_mesh.hpp), and each mesh stores its dequantization parameters.
+	 * "compact-cw3-2" additionally stores 16-bit indices where possible.
+	 * "compact-cw3-3" adds a section with meshlets (see meshlets.hpp).
+	 * "compact-cw3-4" stores levels of detail (see simplify_mesh.hpp) and
+	 * groups the meshlets by level.
+	 * "compact-cw3-5" packs roughness, metalness and the alpha mask of each
+	 * material into a single texture (see find_unique_textures_()).
+	 * "compact-cw3-6" adds per-vertex tangents (see tangent_space.hpp),
+	 * optionally stored as QTangents instead of normal + tangent.
+	 * "compact-cw3-7" stores the same data in sections listed in a table at
+	 * the start of the file (see write_model_data_()), so that readers can
+	 * seek to any mesh directly.
+	 * "compact-cw3-7z" has the same layout, but the per-mesh sections are
+	 * compressed (see labutils/compression.hpp and --compress).
+	 */
+	constexpr char kFileVariant[16] = "compact-cw3-7";
+	constexpr char kFileVariantCompressed[16] = "compact-cw3-7z";
+
+	/* Section types of "compact-cw3-7" files. Per-mesh sections (positions
+	 * and onwards) record the index of their mesh in the section table.
+	 * Readers should skip sections of unknown type.
 	 */
-	constexpr char kFileVariant[16] = "default-cw3";
+	constexpr std::uint32_t kSectionTextures = 1;
+	constexpr std::uint32_t kSectionMaterials = 2;
+	constexpr std::uint32_t kSectionMeshes = 3;
+	constexpr std::uint32_t kSectionPositions = 4;
+	constexpr std::uint32_t kSectionNormals = 5;
+	constexpr std::uint32_t kSectionTangents = 6;
+	constexpr std::uint32_t kSectionQTangents = 7;
+	constexpr std::uint32_t kSectionTexcoords = 8;
+	constexpr std::uint32_t kSectionIndices = 9;
+	constexpr std::uint32_t kSectionLevels = 10;
+	constexpr std::uint32_t kSectionMeshlets = 11;
+
+	constexpr std::uint32_t kSectionNoMesh = 0xffffffff;
+
+	/* Sections start at multiples of this many bytes. This keeps the vertex
+	 * and index data aligned for SIMD loads and for direct uploads from a
+	 * mapped file.
+	 */
+	constexpr std::size_t kSectionAlignment = 16;
 
 	/* Fallback texture for RGBA 1111 and Grayscale 1
 	 */
 	constexpr char kTextureFallbackR1[] = "assets-src/cw3/r1.png";
 	constexpr char kTextureFallbackRGBA1111[] = "assets-src/cw3/rgba1111.png";
 
+	/* Tolerance used when merging vertices during indexing
+	 */
+	constexpr float kIndexErrorTolerance = 1e-5f;
+
 	// types
+	using Clock_ = std::chrono::steady_clock;
+	using Millisecondsf_ = std::chrono::duration<float,std::milli>;
+
+	enum class TextureCompression_ : std::uint8_t
+	{
+		none, // RGBA8
+		bc1,  // BC1 for opaque colour, BC3 with alpha; BC5/BC7 for data
+		bc7   // BC7 for colour; BC5/BC7 for data
+	};
+
+	// One OBJ => mesh job; see --model and --manifest
+	struct ModelJob_
+	{
+		std::string output;
+		std::string input;
+	};
+
+	struct BakeOptions_
+	{
+		std::size_t jobs = 0; // 0 = use default_job_count()
+		float overdrawThreshold = 0.f; // 0 = no overdraw optimization
+		std::size_t lodLevels = kLodMaxLevels; // 1 = no levels of detail
+		float lodError = kLodTargetError;
+		bool mergeByMaterial = false;
+		TangentFrameEncoding tangentFrames = TangentFrameEncoding::normalTangent;
+		TextureCompression_ textureCompression = TextureCompression_::bc7;
+		std::string cacheDir = kBakeCacheDefaultDir; // empty = no bake cache
+		std::string textureDir; // empty = one texture directory per model
+		bool compressStreams = false;
+
+		std::vector<ModelJob_> models; // empty = the default model
+	};
+
+	// A section of the output file; see write_model_data_()
+	struct FileSection_
+	{
+		std::uint32_t type;
+		std::uint32_t mesh; // kSectionNoMesh if not per mesh
+		std::vector<std::uint8_t> data;
+		std::size_t stride = 1; // element size, for compress_sections_()
+	};
+
+	// Meshlets of each level of detail of a mesh, finest first
+	using LodMeshlets_ = std::vector<std::vector<Meshlet>>;
+
 	struct TextureInfo_
 	{
 		std::uint32_t uniqueId;
 		std::uint8_t channels;
 		std::string newPath;
+
+		// Packed textures: the images whose first channels make up red,
+		// green and (optionally) alpha; see packed_texture_key_(). Empty for
+		// all other textures, whose source is the image they are keyed by.
+		std::vector<std::string> sources;
+	};
+
+	// A texture container to bake; see bake_textures_()
+	struct TextureWork_
+	{
+		std::vector<std::string> sources; // one, or the packed channels
+		std::string container;
+		std::uint8_t channels;
+	};
+
+	// Results of process_model_(). The textures are baked separately, so
+	// that textures shared between models are only baked once.
+	struct ModelResult_
+	{
+		bool skipped = false;
+
+		std::uint64_t parameters = 0;
+		std::string mainPath;
+		std::vector<TextureWork_> textures;
+
+		// Files involved in this bake (see save_bake_record())
+		std::vector<std::string> inputs;
+		std::vector<std::string> outputs;
 	};
 
 	// local functions:
-	void process_model_(
+	BakeOptions_ parse_options_( int aArgc, char* aArgv[] );
+
+	std::vector<ModelJob_> read_manifest_( char const* aPath );
+
+	[[maybe_unused]] // by cw3-bake-bench
+	void bake_models_(
+		std::vector<ModelJob_> const&,
+		BakeOptions_ const&
+	);
+
+	ModelResult_ process_model_(
 		char const* aOutput,
 		char const* aInputOBJ,
+		BakeOptions_ const&,
 		glm::mat4x4 const& aStaticTransform = glm::mat4x4( 1.f ) //TODO
 	);
 
+	void report_( char const* aFmt, ... );
+
 
-	InputModel normalize_( InputModel );
+	InputModel normalize_(
+		InputModel,
+		glm::mat4x4 const& aStaticTransform
+	);
+
+	InputModel merge_by_material_( InputModel );
 
 
 	void write_model_data_(
 		FILE*,
 		InputModel const&,
 		std::vector<IndexedMesh> const&,
-		std::unordered_map<std::string,TextureInfo_> const&
+		std::vector<QuantizedMesh> const&,
+		std::vector<LodMeshlets_> const&,
+		std::unordered_map<std::string,TextureInfo_> const&,
+		BakeOptions_ const&
 	);
 
+	void compress_sections_( std::vector<FileSection_>&, std::size_t aJobs );
+
+
+	std::uint32_t index_bytes_( IndexedMesh const& );
 
-	std::vector<IndexedMesh> index_meshes_(
+	std::uint64_t parameters_hash_(
+		char const* aOutput,
+		char const* aInputOBJ,
+		BakeOptions_ const&,
+		glm::mat4x4 const& aStaticTransform
+	);
+	std::uint64_t mesh_key_(
+		InputModel const&,
+		std::size_t aMeshIndex,
+		BakeOptions_ const&
+	);
+
+	void index_meshes_(
+		std::vector<IndexedMesh>&,
 		InputModel const&,
-		float aErrorTolerance = 1e-5f
+		std::vector<std::size_t> const& aMeshIndices,
+		std::size_t aJobs,
+		float aErrorTolerance = kIndexErrorTolerance
+	);
+
+	void generate_tangents_(
+		std::vector<IndexedMesh>&,
+		std::vector<std::size_t> const& aMeshIndices,
+		std::size_t aJobs
+	);
+
+	void generate_lods_(
+		std::vector<IndexedMesh>&,
+		std::vector<std::size_t> const& aMeshIndices,
+		BakeOptions_ const&
+	);
+
+	void optimize_meshes_(
+		std::vector<IndexedMesh>&,
+		BakeOptions_ const&
+	);
+
+	std::vector<QuantizedMesh> quantize_meshes_(
+		std::vector<IndexedMesh> const&,
+		BakeOptions_ const&
+	);
+
+	std::vector<LodMeshlets_> build_meshlets_(
+		std::vector<IndexedMesh> const&,
+		std::size_t aJobs
 	);
 
 	std::unordered_map<std::string,TextureInfo_> find_unique_textures_(
 		InputModel const&
 	);
 
+	std::string packed_texture_key_( InputMaterialInfo const& );
+
 	std::unordered_map<std::string,TextureInfo_> new_paths_(
 		std::unordered_map<std::string,TextureInfo_>,
-		std::filesystem::path const& aTexDir
+		std::filesystem::path const& aTexDir,
+		bool aSharedDir
+	);
+
+	void bake_textures_(
+		std::vector<TextureWork_> const&,
+		BakeOptions_ const&
+	);
+
+	MipTexture make_texture_(
+		std::vector<std::string> const& aSources,
+		std::uint8_t aChannels,
+		BakeOptions_ const&
 	);
 }
 
 
-int main() try
+#if !CW3_BAKE_BENCHMARK // see benchmark.hxx
+int main( int aArgc, char* aArgv[] ) try
 {
-	process_model_(
-		"assets/cw3/ship.comp5822mesh",
-		"assets-src/cw3/NewShip.obj"
-	);
+	auto const options = parse_options_( aArgc, aArgv );
 
-#if 0
-	process_model_(
-		"assets/cw3/sponza-pbr.comp5822mesh",
-		"assets-src/cw2/sponza-pbr.obj"
-	);
-#endif
+	// Other models (e.g. assets-src/cw2/sponza-pbr.obj) are baked by listing
+	// them with --model or in a --manifest.
+	auto models = options.models;
+	if( models.empty() )
+	{
+		models.emplace_back( ModelJob_{
+			"assets/cw3/ship.comp5822mesh",
+			"assets-src/cw3/NewShip.obj"
+		} );
+	}
+
+	bake_models_( models, options );
 
 	return 0;
 }
@@ -111,288 +335,1419 @@ catch( std::exception const& eErr )
 	std::fprintf( stderr, "Top-level exception [%s]:\n%s\nBye.\n", typeid(eErr).name(), eErr.what() );
 	return 1;
 }
+#endif // ~ CW3_BAKE_BENCHMARK
 
 namespace
 {
-	void process_model_( char const* aOutput, char const* aInputOBJ, glm::mat4x4 const& aStaticTransform )
+	BakeOptions_ parse_options_( int aArgc, char* aArgv[] )
 	{
-		static constexpr std::size_t vertexSize = sizeof(float)*(3+3+2);
-
-		// Figure out output paths
-		std::filesystem::path const outname( aOutput );
-		std::filesystem::path const rootdir = outname.parent_path();
-		std::filesystem::path const basename = outname.stem();
-		std::filesystem::path const texdir = basename.string() + "-tex";
-
-		// Load input model
-		auto const model = normalize_( load_wavefront_obj( aInputOBJ ) );
-
-		std::size_t inputVerts = 0;
-		for( auto const& imesh : model.meshes )
-			inputVerts += imesh.vertexCount;
+		BakeOptions_ ret;
 
-		std::printf( "%s: %zu meshes, %zu materials\n", aInputOBJ, model.meshes.size(), model.materials.size() );
-		std::printf( " - triangle soup vertices: %zu => %zu kB\n", inputVerts, inputVerts*vertexSize/1024 );
-
-		// Index meshes
-		auto const indexed = index_meshes_( model );
-
-		std::size_t outputVerts = 0, outputIndices = 0;
-		for( auto const& mesh : indexed )
+		for( int i = 1; i < aArgc; ++i )
 		{
-			outputVerts += mesh.vert.size();
-			outputIndices += mesh.indices.size();
-		}
+			if( 0 == std::strcmp( "--jobs", aArgv[i] ) || 0 == std::strcmp( "-j", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected number of jobs", aArgv[i] );
 
-		std::printf( " - indexed vertices: %zu with %zu indices => %zu kB\n", outputVerts, outputIndices, (outputVerts*vertexSize + outputIndices*sizeof(std::uint32_t))/1024 );
+				char* end = nullptr;
+				auto const jobs = std::strtol( aArgv[i+1], &end, 10 );
+				if( !end || *end || jobs < 1 )
+					throw lut::Error( "%s: invalid number of jobs '%s'", aArgv[i], aArgv[i+1] );
 
-		// Find list of unique textures
-		auto const textures = new_paths_( find_unique_textures_( model ), texdir );
+				ret.jobs = std::size_t(jobs);
+				++i;
+			}
+			else if( 0 == std::strcmp( "--overdraw", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected ACMR threshold", aArgv[i] );
 
-		std::printf( " - unique textures: %zu\n", textures.size() );
+				char* end = nullptr;
+				auto const threshold = std::strtof( aArgv[i+1], &end );
+				if( !end || *end || !(threshold > 0.f) )
+					throw lut::Error( "%s: invalid ACMR threshold '%s'", aArgv[i], aArgv[i+1] );
 
-		// Ensure output directory exists
-		std::filesystem::create_directories( rootdir );
+				ret.overdrawThreshold = threshold;
+				++i;
+			}
+			else if( 0 == std::strcmp( "--lods", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected number of levels", aArgv[i] );
 
-		// Output mesh data
-		auto mainpath = rootdir / basename;
-		mainpath.replace_extension( "comp5822mesh" );
+				char* end = nullptr;
+				auto const levels = std::strtol( aArgv[i+1], &end, 10 );
+				if( !end || *end || levels < 1 || levels > 16 )
+					throw lut::Error( "%s: invalid number of levels '%s'", aArgv[i], aArgv[i+1] );
 
-		FILE* fof = std::fopen( mainpath.string().c_str(), "wb" );
-		if( !fof )
-			throw lut::Error( "Unable to open '%s' for writing", mainpath.string().c_str() );
+				ret.lodLevels = std::size_t(levels);
+				++i;
+			}
+			else if( 0 == std::strcmp( "--lod-error", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected relative error", aArgv[i] );
 
-		try
-		{
-			write_model_data_( fof, model, indexed, textures );
-		}
-		catch( ... )
-		{
-			std::fclose( fof );
-			throw;
-		}
+				char* end = nullptr;
+				auto const error = std::strtof( aArgv[i+1], &end );
+				if( !end || *end || !(error > 0.f) )
+					throw lut::Error( "%s: invalid relative error '%s'", aArgv[i], aArgv[i+1] );
 
-		std::fclose( fof );
+				ret.lodError = error;
+				++i;
+			}
+			else if( 0 == std::strcmp( "--merge", aArgv[i] ) )
+			{
+				ret.mergeByMaterial = true;
+			}
+			else if( 0 == std::strcmp( "--qtangent", aArgv[i] ) )
+			{
+				ret.tangentFrames = TangentFrameEncoding::qtangent;
+			}
+			else if( 0 == std::strcmp( "--compress", aArgv[i] ) )
+			{
+				ret.compressStreams = true;
+			}
+			else if( 0 == std::strcmp( "--bc", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected bc7, bc1 or none", aArgv[i] );
+
+				if( 0 == std::strcmp( "bc7", aArgv[i+1] ) )
+					ret.textureCompression = TextureCompression_::bc7;
+				else if( 0 == std::strcmp( "bc1", aArgv[i+1] ) )
+					ret.textureCompression = TextureCompression_::bc1;
+				else if( 0 == std::strcmp( "none", aArgv[i+1] ) )
+					ret.textureCompression = TextureCompression_::none;
+				else
+					throw lut::Error( "%s: invalid texture compression '%s'", aArgv[i], aArgv[i+1] );
+
+				++i;
+			}
+			else if( 0 == std::strcmp( "--cache", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc || !*aArgv[i+1] )
+					throw lut::Error( "%s: expected cache directory", aArgv[i] );
 
-		// Copy textures
-		std::filesystem::create_directories( rootdir / texdir );
+				ret.cacheDir = aArgv[i+1];
+				++i;
+			}
+			else if( 0 == std::strcmp( "--no-cache", aArgv[i] ) )
+			{
+				ret.cacheDir.clear();
+			}
+			else if( 0 == std::strcmp( "--model", aArgv[i] ) )
+			{
+				if( i+2 >= aArgc || !*aArgv[i+1] || !*aArgv[i+2] )
+					throw lut::Error( "%s: expected output mesh and input OBJ", aArgv[i] );
 
-		std::size_t errors = 0;
-		for( auto const& entry : textures )
-		{
-			auto const dest = rootdir / entry.second.newPath;
+				ret.models.emplace_back( ModelJob_{ aArgv[i+1], aArgv[i+2] } );
+				i += 2;
+			}
+			else if( 0 == std::strcmp( "--manifest", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc || !*aArgv[i+1] )
+					throw lut::Error( "%s: expected manifest file", aArgv[i] );
 
-			std::error_code ec;
-			bool ret = std::filesystem::copy_file( 
-				entry.first,
-				dest,
-				std::filesystem::copy_options::none,
-				ec
-			);
+				auto models = read_manifest_( aArgv[i+1] );
+				ret.models.insert( ret.models.end(), models.begin(), models.end() );
+				++i;
+			}
+			else if( 0 == std::strcmp( "--texture-dir", aArgv[i] ) )
+			{
+				if( i+1 >= aArgc || !*aArgv[i+1] )
+					throw lut::Error( "%s: expected texture directory", aArgv[i] );
 
-			if( !ret )
+				ret.textureDir = aArgv[i+1];
+				++i;
+			}
+			else if( 0 == std::strcmp( "--help", aArgv[i] ) || 0 == std::strcmp( "-h", aArgv[i] ) )
+			{
+				std::printf( "Usage: %s [options]\n", aArgv[0] );
+				std::printf( "Options:\n" );
+				std::printf( "  --model OUT IN       bake the OBJ file IN into the mesh OUT; may be repeated\n" );
+				std::printf( "                       (default: the coursework model)\n" );
+				std::printf( "  --manifest FILE      bake the models listed in FILE, one 'OUT IN' pair per\n" );
+				std::printf( "                       line ('#' starts a comment)\n" );
+				std::printf( "  --texture-dir DIR    put the textures of all models into DIR, so that\n" );
+				std::printf( "                       models share identical textures (default: one\n" );
+				std::printf( "                       directory next to each mesh)\n" );
+				std::printf( "  -j, --jobs N         bake using N threads (default: %zu); several models\n", default_job_count() );
+				std::printf( "                       are baked concurrently\n" );
+				std::printf( "  --overdraw LAMBDA    reorder triangle clusters to reduce overdraw; LAMBDA\n" );
+				std::printf( "                       is the ACMR at which clusters are split (higher means\n" );
+				std::printf( "                       less overdraw but more cache misses; try 0.75-1.0)\n" );
+				std::printf( "  --lods N             generate up to N levels of detail per mesh, including\n" );
+				std::printf( "                       the full-resolution one (default: %zu; 1 disables)\n", kLodMaxLevels );
+				std::printf( "  --lod-error E        maximum simplification error relative to the mesh\n" );
+				std::printf( "                       size (default: %g)\n", double(kLodTargetError) );
+				std::printf( "  --merge              merge all meshes that share a material into a single\n" );
+				std::printf( "                       mesh (one draw call per material)\n" );
+				std::printf( "  --qtangent           store normals and tangents as QTangents (8 bytes per\n" );
+				std::printf( "                       vertex instead of 12)\n" );
+				std::printf( "  --compress           compress the vertex, index and meshlet data of each\n" );
+				std::printf( "                       mesh (reports the ratio and decode throughput)\n" );
+				std::printf( "  --bc MODE            texture compression: bc7 (default), bc1 (BC1/BC3) or\n" );
+				std::printf( "                       none (uncompressed RGBA8); packed roughness and\n" );
+				std::printf( "                       metalness use BC5 (BC7 with an alpha mask)\n" );
+				std::printf( "  --cache DIR          keep the bake cache in DIR (default: %s); models\n", kBakeCacheDefaultDir );
+				std::printf( "                       whose inputs and options are unchanged are skipped,\n" );
+				std::printf( "                       and unchanged meshes reuse their indexing results\n" );
+				std::printf( "  --no-cache           always bake everything from scratch\n" );
+				std::printf( "  -h, --help           show this message\n" );
+				std::exit( 0 );
+			}
+			else
 			{
-				++errors;
-				std::fprintf( stderr, "copy_file(): '%s' failed: %s (%s)\n", dest.string().c_str(), ec.message().c_str(), ec.category().name() );
+				throw lut::Error( "Unknown argument '%s'. See --help.", aArgv[i] );
 			}
 		}
 
-		auto const total = textures.size();
-		std::printf( "Copied %zu textures out of %zu.\n", total-errors, total );
-		if( errors )
-		{
-			std::fprintf( stderr, "Some copies reported an error. Currently, the code will never overwrite existing files. The errors likely just indicate that the file was copied previously. Remove old files manually, if necessary.\n" );
-		}
+		if( 0 == ret.jobs )
+			ret.jobs = default_job_count();
+
+		return ret;
 	}
-}
 
-namespace
-{
-	InputModel normalize_( InputModel aModel )
+	std::vector<ModelJob_> read_manifest_( char const* aPath )
 	{
-		for( auto& mat : aModel.materials )
+		// One job per line: the output mesh and the input OBJ, separated by
+		// whitespace. Paths are relative to the working directory, like the
+		// ones given on the command line. Everything after a '#' is ignored.
+		std::ifstream fin( aPath );
+		if( !fin )
+			throw lut::Error( "Unable to open manifest '%s'", aPath );
+
+		std::vector<ModelJob_> ret;
+
+		std::string line;
+		for( std::size_t lineNumber = 1; std::getline( fin, line ); ++lineNumber )
 		{
-			if( mat.baseColorTexturePath.empty() )
-				mat.baseColorTexturePath = kTextureFallbackRGBA1111;
-			if( mat.roughnessTexturePath.empty() )
-				mat.roughnessTexturePath = kTextureFallbackR1;
-			if( mat.metalnessTexturePath.empty() )
-				mat.metalnessTexturePath = kTextureFallbackR1;
+			if( auto const comment = line.find( '#' ); std::string::npos != comment )
+				line.erase( comment );
+
+			std::istringstream sin( line );
+
+			ModelJob_ job;
+			if( !(sin >> job.output) )
+				continue; // empty line
+
+			std::string extra;
+			if( !(sin >> job.input) || (sin >> extra) )
+				throw lut::Error( "%s:%zu: expected output mesh and input OBJ", aPath, lineNumber );
+
+			ret.emplace_back( std::move(job) );
 		}
 
-		return aModel; // This should use the move constructor implicitly.
+		if( fin.bad() )
+			throw lut::Error( "Error reading manifest '%s'", aPath );
+
+		return ret;
 	}
 }
 
 namespace
 {
-	void checked_write_( FILE* aOut, std::size_t aBytes, void const* aData )
+	// Log of the model that the current thread is working on. Models baked
+	// concurrently would otherwise interleave their output; see report_().
+	thread_local std::string* gModelLog_ = nullptr;
+
+	void report_( char const* aFmt, ... )
 	{
-		auto const ret = std::fwrite( aData, 1, aBytes, aOut );
+		va_list args;
+		va_start( args, aFmt );
 
-		if( ret != aBytes )
-			throw lut::Error( "fwrite() failed: %zu instead of %zu", ret, aBytes );
-	}
+		if( !gModelLog_ )
+		{
+			std::vprintf( aFmt, args );
+		}
+		else
+		{
+			va_list copy;
+			va_copy( copy, args );
+			int const length = std::vsnprintf( nullptr, 0, aFmt, copy );
+			va_end( copy );
 
-	void write_string_( FILE* aOut, char const* aString )
-	{
-		// Write a string
-		// Format:
-		//  - uint32_t : N = length of string in bytes, including terminating '\0'
-		//  - N x char : string
-		std::uint32_t const length = std::uint32_t(std::strlen(aString)+1);
-		checked_write_( aOut, sizeof(std::uint32_t), &length );
+			if( length > 0 )
+			{
+				auto const offset = gModelLog_->size();
+				gModelLog_->resize( offset + std::size_t(length) + 1 );
+				std::vsnprintf( gModelLog_->data() + offset, std::size_t(length) + 1, aFmt, args );
+				gModelLog_->resize( offset + std::size_t(length) );
+			}
+		}
 
-		checked_write_( aOut, length, aString );
+		va_end( args );
 	}
 
-	void write_model_data_( FILE* aOut, InputModel const& aModel, std::vector<IndexedMesh> const& aIndexedMeshes, std::unordered_map<std::string,TextureInfo_> const& aTextures )
+	void bake_models_( std::vector<ModelJob_> const& aModels, BakeOptions_ const& aOptions )
 	{
-		// Write header
-		// Format:
-		//   - char[16] : file magic
-		//   - char[16] : file variant ID
-		checked_write_( aOut, sizeof(char)*16, kFileMagic );
-		checked_write_( aOut, sizeof(char)*16, kFileVariant );
-		
-		// Write list of unique textures
-		// Format:
-		//  - unit32_t : U = number of unique textures
-		//  - repeat U times:
-		//    - string : path to texture 
-		//    - uint8_t : number of channels in texture
-		std::vector<TextureInfo_ const*> orderedUnqiue( aTextures.size() );
-		for( auto const& tex : aTextures )
+		// Models are independent up to their textures. They are processed
+		// concurrently, each with its share of the jobs (a single model gets
+		// all of them, as before). Textures are collected from all models and
+		// baked afterwards; with --texture-dir, identical textures map to the
+		// same container, which is then baked only once.
+		std::unordered_set<std::string> outputs;
+		for( auto const& job : aModels )
 		{
-			assert( !orderedUnqiue[tex.second.uniqueId] );
-			orderedUnqiue[tex.second.uniqueId] = &tex.second;
+			if( !outputs.emplace( job.output ).second )
+				throw lut::Error( "'%s' is the output of more than one model", job.output.c_str() );
 		}
 
-		std::uint32_t const textureCount = std::uint32_t(orderedUnqiue.size());
-		checked_write_( aOut, sizeof(textureCount), &textureCount );
+		auto const t0 = Clock_::now();
 
-		for( auto const& tex : orderedUnqiue )
-		{
-			assert( tex );
-			write_string_( aOut, tex->newPath.c_str() );
+		std::size_t const modelJobs = std::min( aOptions.jobs, aModels.size() );
 
-			std::uint8_t channels = tex->channels;
-			checked_write_( aOut, sizeof(channels), &channels );
-		}
+		auto perModel = aOptions;
+		perModel.jobs = std::max<std::size_t>( 1, aOptions.jobs / std::max<std::size_t>( 1, modelJobs ) );
 
-		// Write material information
-		// Format:
-		//  - uint32_t : M = number of materials
-		//  - repeat M times:
-		//    - uin32_t : base color texture index
-		//    - uin32_t : roughness texture index
-		//    - uin32_t : metalness texture index
-		//    - uin32_t : alphaMask texture index (or 0xffffffff if none)
-		//    - uin32_t : normalMap texture index (or 0xffffffff if none)
-		//    - 3*float : base color (RGB)        NOTE: new in CW3
-		//    - 3*float : emissive color (RGB)    NOTE: new in CW3
-		//    - float   : base roughness          NOTE: new in CW3
-		//    - float   : base metalness          NOTE: new in CW3
-		std::uint32_t const materialCount = std::uint32_t(aModel.materials.size());
-		checked_write_( aOut, sizeof(materialCount), &materialCount );
+		// Output is buffered per model and printed once the model is done,
+		// unless there is only one.
+		bool const buffered = aModels.size() > 1;
 
-		for( auto const& mat : aModel.materials )
-		{
-			auto const write_tex_ = [&] (std::string const& aTexturePath ) {
-				if( aTexturePath.empty() )
-				{
-					static constexpr std::uint32_t sentinel = ~std::uint32_t(0);
-					checked_write_( aOut, sizeof(std::uint32_t), &sentinel );
-					return;
-				}
+		std::mutex outputMutex;
+		std::vector<ModelResult_> results( aModels.size() );
+		parallel_for( aModels.size(), modelJobs, [&] (std::size_t aItem) {
+			auto const& job = aModels[aItem];
 
-				auto const it = aTextures.find( aTexturePath );
-				assert( aTextures.end() != it );
+			std::string log;
+			gModelLog_ = buffered ? &log : nullptr;
 
-				checked_write_( aOut, sizeof(std::uint32_t), &it->second.uniqueId );
-			};
+			if( buffered )
+				report_( "[%zu/%zu] %s\n", aItem+1, aModels.size(), job.output.c_str() );
+
+			try
+			{
+				results[aItem] = process_model_( job.output.c_str(), job.input.c_str(), perModel );
+			}
+			catch( std::exception const& eErr )
+			{
+				gModelLog_ = nullptr;
+				throw lut::Error( "%s: %s", job.input.c_str(), eErr.what() );
+			}
 
-			write_tex_( mat.baseColorTexturePath );
-			write_tex_( mat.roughnessTexturePath );
-			write_tex_( mat.metalnessTexturePath );
-			write_tex_( mat.alphaMaskTexturePath );
-			write_tex_( mat.normalMapTexturePath );
+			gModelLog_ = nullptr;
 
-			checked_write_( aOut, sizeof(float)*3, &mat.baseColor.x );
-			checked_write_( aOut, sizeof(float)*3, &mat.emissiveColor.x );
-			checked_write_( aOut, sizeof(float), &mat.baseRoughness );
-			checked_write_( aOut, sizeof(float), &mat.baseMetalness );
+			if( buffered )
+			{
+				std::lock_guard<std::mutex> lock( outputMutex );
+				std::fputs( log.c_str(), stdout );
+				std::fflush( stdout );
+			}
+		} );
+
+		// Bake the textures of all models. Containers are identified by their
+		// path; two models only share a container if they also share its
+		// sources (see new_paths_()).
+		std::vector<TextureWork_> textures;
+		std::unordered_set<std::string> containers;
+		for( auto const& result : results )
+		{
+			for( auto const& item : result.textures )
+			{
+				if( containers.emplace( item.container ).second )
+					textures.emplace_back( item );
+			}
 		}
 
-		// Write mesh data
-		// Format:
-		//  - uint32_t : M = number of meshes
-		//  - repeat M times:
-		//    - uint32_t : material index
-		//    - uint32_t : V = number of vertices
-		//    - uint32_t : I = number of indices
-		//    - repeat V times: vec3 position
-		//    - repeat V times: vec3 normal
-		//    - repeat V times: vec2 texture coordinate
-		//    - repeat I times: uint32_t index
-		std::uint32_t const meshCount = std::uint32_t(aModel.meshes.size());
-		checked_write_( aOut, sizeof(meshCount), &meshCount );
+		for( auto const& item : textures )
+			std::filesystem::create_directories( std::filesystem::path( item.container ).parent_path() );
 
-		assert( aModel.meshes.size() == aIndexedMeshes.size() );
-		for( std::size_t i = 0; i < aModel.meshes.size(); ++i )
+		if( !textures.empty() )
 		{
-			auto const& mmesh = aModel.meshes[i];
+			if( buffered )
+				report_( "Textures of all models: %zu unique\n", textures.size() );
 
-			std::uint32_t materialIndex = std::uint32_t(mmesh.materialIndex);
-			checked_write_( aOut, sizeof(materialIndex), &materialIndex );
-
-			auto const& imesh = aIndexedMeshes[i];
+			bake_textures_( textures, aOptions );
+		}
 
-			std::uint32_t vertexCount = std::uint32_t(imesh.vert.size());
-			checked_write_( aOut, sizeof(vertexCount), &vertexCount );
-			std::uint32_t indexCount = std::uint32_t(imesh.indices.size());
-			checked_write_( aOut, sizeof(indexCount), &indexCount );
+		// Remember the bakes. (Failed bakes throw before reaching this point,
+		// so that they are retried next time.)
+		std::size_t skipped = 0;
+		std::unordered_set<std::string> inputFiles, outputFiles;
+		for( auto const& result : results )
+		{
+			if( result.skipped )
+			{
+				++skipped;
+				continue;
+			}
 
-			checked_write_( aOut, sizeof(glm::vec3)*vertexCount, imesh.vert.data() );
-			checked_write_( aOut, sizeof(glm::vec3)*vertexCount, imesh.norm.data() );
-			checked_write_( aOut, sizeof(glm::vec2)*vertexCount, imesh.text.data() );
+			if( !aOptions.cacheDir.empty() )
+				save_bake_record( aOptions.cacheDir, result.mainPath, make_bake_record( result.parameters, result.inputs, result.outputs ) );
 
-			checked_write_( aOut, sizeof(std::uint32_t)*indexCount, imesh.indices.data() );
+			inputFiles.insert( result.inputs.begin(), result.inputs.end() );
+			outputFiles.insert( result.outputs.begin(), result.outputs.end() );
 		}
+
+		auto const t1 = Clock_::now();
+
+		// Throughput. Files shared between models (materials, textures) are
+		// only counted once.
+		auto const total_size_ = [] (std::unordered_set<std::string> const& aPaths) {
+			std::uintmax_t bytes = 0;
+			for( auto const& path : aPaths )
+			{
+				std::error_code ec;
+				auto const size = std::filesystem::file_size( path, ec );
+				if( !ec )
+					bytes += size;
+			}
+			return bytes;
+		};
+
+		double const inputMB = double(total_size_( inputFiles )) / (1024.*1024.);
+		double const outputMB = double(total_size_( outputFiles )) / (1024.*1024.);
+
+		double const seconds = std::chrono::duration<double>( t1 - t0 ).count();
+		double const rate = seconds > 0. ? 1. / seconds : 0.;
+
+		std::size_t const baked = aModels.size() - skipped;
+		std::printf( "Baked %zu model(s) (%zu up to date) in %.2f s using %zu job(s): %.2f models/s, %.1f MB in (%.1f MB/s), %.1f MB out (%.1f MB/s)\n", baked, skipped, seconds, aOptions.jobs, baked*rate, inputMB, inputMB*rate, outputMB, outputMB*rate );
 	}
 }
 
 namespace
 {
-	std::vector<IndexedMesh> index_meshes_( InputModel const& aModel, float aErrorTolerance )
+	ModelResult_ process_model_( char const* aOutput, char const* aInputOBJ, BakeOptions_ const& aOptions, glm::mat4x4 const& aStaticTransform )
 	{
-		std::vector<IndexedMesh> indexed;
+		static constexpr std::size_t vertexSize = sizeof(float)*(3+3+2);
+		static constexpr std::size_t tangentVertexSize = sizeof(float)*(3+3+2+4);
 
-		for( auto const& imesh : aModel.meshes )
-		{
-			auto const endIndex = imesh.vertexStartIndex + imesh.vertexCount;
+		// Position, texture coordinate, and normal + tangent or QTangent
+		std::size_t const compactVertexSize = TangentFrameEncoding::qtangent == aOptions.tangentFrames
+			? sizeof(std::uint16_t)*(4+2+4)
+			: sizeof(std::uint16_t)*(4+2+2+4)
+			;
 
-			TriangleSoup soup;
+		// Figure out output paths
+		std::filesystem::path const outname( aOutput );
+		std::filesystem::path const rootdir = outname.parent_path();
+		std::filesystem::path const basename = outname.stem();
 
-			soup.vert.reserve( imesh.vertexCount );
-			for( std::size_t i = imesh.vertexStartIndex; i < endIndex; ++i )
-				soup.vert.emplace_back( aModel.positions[i] );
+		// Texture paths are stored relative to the mesh
+		bool const sharedTextures = !aOptions.textureDir.empty();
+		std::filesystem::path const texdir = sharedTextures
+			? std::filesystem::path( aOptions.textureDir ).lexically_relative( rootdir.empty() ? "." : rootdir )
+			: std::filesystem::path( basename.string() + "-tex" )
+			;
 
-			soup.text.reserve( imesh.vertexCount );
-			for( std::size_t i = imesh.vertexStartIndex; i < endIndex; ++i )
-				soup.text.emplace_back( aModel.texcoords[i] );
+		if( texdir.empty() )
+			throw lut::Error( "Cannot reach texture directory '%s' from '%s'", aOptions.textureDir.c_str(), rootdir.string().c_str() );
 
-			soup.norm.reserve( imesh.vertexCount );
-			for( std::size_t i = imesh.vertexStartIndex; i < endIndex; ++i )
-				soup.norm.emplace_back( aModel.normals[i] );
+		auto mainpath = rootdir / basename;
+		mainpath.replace_extension( "comp5822mesh" );
+
+		ModelResult_ ret;
+		ret.mainPath = mainpath.string();
 
+		// Skip the bake entirely if the parameters and all files involved in
+		// the previous bake are unchanged.
+		bool const useCache = !aOptions.cacheDir.empty();
+		ret.parameters = parameters_hash_( aOutput, aInputOBJ, aOptions, aStaticTransform );
 
-			indexed.emplace_back( make_indexed_mesh( soup, aErrorTolerance ) );
+		if( useCache )
+		{
+			BakeRecord record;
+			if( load_bake_record( aOptions.cacheDir, ret.mainPath, record ) && ret.parameters == record.parameters && bake_record_is_current( record ) )
+			{
+				report_( "%s: up to date, skipped\n", aInputOBJ );
+				ret.skipped = true;
+				return ret;
+			}
 		}
 
-		return indexed;
-	}
-}
+		// Load input model
+		auto model = normalize_( load_wavefront_obj( aInputOBJ ), aStaticTransform );
+
+		std::size_t inputVerts = 0;
+		for( auto const& imesh : model.meshes )
+			inputVerts += imesh.vertexCount;
+
+		report_( "%s: %zu meshes, %zu materials\n", aInputOBJ, model.meshes.size(), model.materials.size() );
+		report_( " - triangle soup vertices: %zu => %zu kB\n", inputVerts, inputVerts*vertexSize/1024 );
+
+		// Merge meshes by material. Each mesh is one draw call (and one set of
+		// descriptor binds) at runtime.
+		if( aOptions.mergeByMaterial )
+		{
+			auto const draws = model.meshes.size();
+			model = merge_by_material_( std::move(model) );
+
+			report_( " - draw calls: %zu => %zu (merged by material)\n", draws, model.meshes.size() );
+		}
+		else
+		{
+			report_( " - draw calls: %zu\n", model.meshes.size() );
+		}
+
+		// Index meshes. Meshes found in the bake cache already include their
+		// levels of detail; only the remaining ones are processed.
+		auto const indexStart = Clock_::now();
+
+		std::vector<IndexedMesh> indexed( model.meshes.size() );
+		std::vector<std::uint64_t> meshKeys( model.meshes.size() );
+		std::vector<std::size_t> pending;
+		for( std::size_t i = 0; i < model.meshes.size(); ++i )
+		{
+			meshKeys[i] = mesh_key_( model, i, aOptions );
+			if( !useCache || !load_cached_mesh( aOptions.cacheDir, meshKeys[i], indexed[i] ) )
+				pending.emplace_back( i );
+		}
+
+		index_meshes_( indexed, model, pending, aOptions.jobs );
+
+		auto const indexTime = std::chrono::duration_cast<Millisecondsf_>( Clock_::now() - indexStart ).count();
+
+		std::size_t outputVerts = 0, outputIndices = 0;
+		for( auto const& mesh : indexed )
+		{
+			outputVerts += mesh.vert.size();
+			outputIndices += mesh.indices.size();
+		}
+
+		report_( " - indexed vertices: %zu with %zu indices => %zu kB\n", outputVerts, outputIndices, (outputVerts*vertexSize + outputIndices*sizeof(std::uint32_t))/1024 );
+		report_( " - indexing took %.2f ms using %zu job(s)\n", indexTime, aOptions.jobs );
+
+		if( useCache )
+			report_( " - bake cache: reused %zu of %zu meshes\n", indexed.size()-pending.size(), indexed.size() );
+
+		// Generate tangents. This may split vertices (see tangent_space.hpp),
+		// so it must happen before the levels of detail are generated.
+		generate_tangents_( indexed, pending, aOptions.jobs );
+
+		// Generate levels of detail. These reference the full-resolution
+		// vertices, so this must happen before the vertex order is fixed.
+		generate_lods_( indexed, pending, aOptions );
+
+		if( useCache )
+		{
+			for( auto const i : pending )
+				save_cached_mesh( aOptions.cacheDir, meshKeys[i], indexed[i] );
+		}
+
+		// Optimize meshes
+		optimize_meshes_( indexed, aOptions );
+
+		// Quantize vertex data
+		auto const quantized = quantize_meshes_( indexed, aOptions );
+
+		std::size_t finalVerts = 0;
+		for( auto const& mesh : indexed )
+			finalVerts += mesh.vert.size();
+
+		report_( " - compact vertices: %zu => %zu kB (%zu bytes per vertex instead of %zu)\n", finalVerts, finalVerts*compactVertexSize/1024, compactVertexSize, tangentVertexSize );
+
+		std::size_t narrowMeshes = 0, allIndices = 0, indexBytes = 0;
+		for( auto const& mesh : indexed )
+		{
+			auto const bytes = index_bytes_( mesh );
+			if( sizeof(std::uint16_t) == bytes )
+				++narrowMeshes;
+
+			std::size_t count = mesh.indices.size();
+			for( auto const& lod : mesh.lods )
+				count += lod.indices.size();
+
+			allIndices += count;
+			indexBytes += bytes * count;
+		}
+
+		report_( " - 16-bit indices in %zu of %zu meshes (all levels): %zu => %zu kB\n", narrowMeshes, indexed.size(), allIndices*sizeof(std::uint32_t)/1024, indexBytes/1024 );
+
+		// Split into meshlets for GPU culling
+		auto const meshlets = build_meshlets_( indexed, aOptions.jobs );
+
+		// Find list of unique textures
+		auto const textures = new_paths_( find_unique_textures_( model ), texdir, sharedTextures );
+
+		report_( " - unique textures: %zu\n", textures.size() );
+
+		// Ensure output directory exists
+		std::filesystem::create_directories( rootdir );
+
+		// Output mesh data
+		FILE* fof = std::fopen( mainpath.string().c_str(), "wb" );
+		if( !fof )
+			throw lut::Error( "Unable to open '%s' for writing", mainpath.string().c_str() );
+
+		try
+		{
+			write_model_data_( fof, model, indexed, quantized, meshlets, textures, aOptions );
+		}
+		catch( ... )
+		{
+			std::fclose( fof );
+			throw;
+		}
+
+		std::fclose( fof );
+
+		// Textures to bake (see bake_models_()) and files involved in this
+		// bake
+		ret.inputs.emplace_back( aInputOBJ );
+		ret.outputs.emplace_back( ret.mainPath );
+
+		if( auto const mtllib = find_wavefront_mtllib( aInputOBJ ); !mtllib.empty() )
+			ret.inputs.emplace_back( mtllib );
+
+		for( auto const& entry : textures )
+		{
+			auto const& info = entry.second;
+			auto sources = info.sources.empty() ? std::vector<std::string>{ entry.first } : info.sources;
+			auto const container = (rootdir / info.newPath).lexically_normal().string();
+
+			ret.inputs.insert( ret.inputs.end(), sources.begin(), sources.end() );
+			ret.outputs.emplace_back( container );
+
+			ret.textures.emplace_back( TextureWork_{ std::move(sources), container, info.channels } );
+		}
+
+		return ret;
+	}
+}
+
+namespace
+{
+	InputModel normalize_( InputModel aModel, glm::mat4x4 const& aStaticTransform )
+	{
+		// Static transform. Normals use the inverse transpose; a mirroring
+		// transform flips the triangle winding, which is undone by swapping
+		// the last two corners of each triangle.
+		if( glm::mat4x4( 1.f ) != aStaticTransform )
+		{
+			glm::mat3 const normalMatrix = glm::transpose( glm::inverse( glm::mat3( aStaticTransform ) ) );
+
+			for( auto& pos : aModel.positions )
+				pos = glm::vec3( aStaticTransform * glm::vec4( pos, 1.f ) );
+
+			for( auto& nrm : aModel.normals )
+			{
+				auto const n = normalMatrix * nrm;
+				auto const len = glm::length( n );
+				nrm = len > 0.f ? n / len : n;
+			}
+
+			if( glm::determinant( glm::mat3( aStaticTransform ) ) < 0.f )
+			{
+				for( auto const& mesh : aModel.meshes )
+				{
+					assert( 0 == mesh.vertexCount % 3 );
+					for( std::size_t i = 0; i < mesh.vertexCount; i += 3 )
+					{
+						auto const v = mesh.vertexStartIndex + i;
+						std::swap( aModel.positions[v+1], aModel.positions[v+2] );
+						std::swap( aModel.normals[v+1], aModel.normals[v+2] );
+						std::swap( aModel.texcoords[v+1], aModel.texcoords[v+2] );
+					}
+				}
+			}
+		}
+
+		for( auto& mat : aModel.materials )
+		{
+			if( mat.baseColorTexturePath.empty() )
+				mat.baseColorTexturePath = kTextureFallbackRGBA1111;
+			if( mat.roughnessTexturePath.empty() )
+				mat.roughnessTexturePath = kTextureFallbackR1;
+			if( mat.metalnessTexturePath.empty() )
+				mat.metalnessTexturePath = kTextureFallbackR1;
+
+			// Texture paths are relative to the OBJ file, e.g.
+			// "assets-src/x/../tex/a.png". Textures are identified by their
+			// path (see find_unique_textures_() and new_paths_()), so models
+			// in different directories must spell a shared texture the same
+			// way.
+			for( auto* path : { &mat.baseColorTexturePath, &mat.roughnessTexturePath, &mat.metalnessTexturePath, &mat.alphaMaskTexturePath, &mat.normalMapTexturePath } )
+			{
+				if( !path->empty() )
+					*path = std::filesystem::path( *path ).lexically_normal().generic_string();
+			}
+		}
+
+		return aModel; // This should use the move constructor implicitly.
+	}
+
+	InputModel merge_by_material_( InputModel aModel )
+	{
+		// Group meshes by material. Materials are visited in the order in
+		// which they are first used, so that the output order is stable.
+		std::vector<std::size_t> order;
+		std::vector<std::vector<std::size_t>> groups( aModel.materials.size() );
+		for( std::size_t i = 0; i < aModel.meshes.size(); ++i )
+		{
+			auto const mat = aModel.meshes[i].materialIndex;
+			assert( mat < groups.size() );
+
+			if( groups[mat].empty() )
+				order.emplace_back( mat );
+
+			groups[mat].emplace_back( i );
+		}
+
+		InputModel ret;
+		ret.modelSourcePath = std::move(aModel.modelSourcePath);
+		ret.materials = std::move(aModel.materials);
+
+		ret.positions.reserve( aModel.positions.size() );
+		ret.normals.reserve( aModel.normals.size() );
+		ret.texcoords.reserve( aModel.texcoords.size() );
+
+		for( auto const mat : order )
+		{
+			auto const firstVertex = ret.positions.size();
+
+			for( auto const meshIndex : groups[mat] )
+			{
+				auto const& mesh = aModel.meshes[meshIndex];
+				assert( 0 == mesh.vertexCount % 3 );
+
+				for( std::size_t i = 0; i < mesh.vertexCount; ++i )
+				{
+					auto const v = mesh.vertexStartIndex + i;
+
+					ret.positions.emplace_back( aModel.positions[v] );
+					ret.normals.emplace_back( aModel.normals[v] );
+					ret.texcoords.emplace_back( aModel.texcoords[v] );
+				}
+			}
+
+			ret.meshes.emplace_back( InputMeshInfo{
+				ret.materials[mat].materialName,
+				mat,
+				firstVertex,
+				ret.positions.size() - firstVertex
+			} );
+		}
+
+		return ret;
+	}
+}
+
+namespace
+{
+	void checked_write_( FILE* aOut, std::size_t aBytes, void const* aData )
+	{
+		auto const ret = std::fwrite( aData, 1, aBytes, aOut );
+
+		if( ret != aBytes )
+			throw lut::Error( "fwrite() failed: %zu instead of %zu", ret, aBytes );
+	}
+
+	template< typename tType >
+	void append_( std::vector<std::uint8_t>& aOut, tType const* aData, std::size_t aCount = 1 )
+	{
+		auto const* bytes = reinterpret_cast<std::uint8_t const*>(aData);
+		aOut.insert( aOut.end(), bytes, bytes + sizeof(tType)*aCount );
+	}
+
+	void append_string_( std::vector<std::uint8_t>& aOut, std::string const& aString )
+	{
+		// Append a string
+		// Format:
+		//  - uint32_t : N = length of string in bytes, including terminating '\0'
+		//  - N x char : string
+		std::uint32_t const length = std::uint32_t(aString.size()+1);
+		append_( aOut, &length );
+		append_( aOut, aString.c_str(), length );
+	}
+
+	void write_model_data_( FILE* aOut, InputModel const& aModel, std::vector<IndexedMesh> const& aIndexedMeshes, std::vector<QuantizedMesh> const& aQuantizedMeshes, std::vector<LodMeshlets_> const& aMeshlets, std::unordered_map<std::string,TextureInfo_> const& aTextures, BakeOptions_ const& aOptions )
+	{
+		// The file consists of a header with a table of sections, followed
+		// by the sections themselves. Each section starts at a multiple of
+		// kSectionAlignment bytes; the gaps are zero. The sections are
+		// collected in memory first, so that the table can be written up
+		// front.
+		std::vector<FileSection_> sections;
+
+		// Texture section (kSectionTextures)
+		// Format:
+		//  - unit32_t : U = number of unique textures
+		//  - repeat U times:
+		//    - string : path to texture 
+		//    - uint8_t : number of channels in texture
+		std::vector<TextureInfo_ const*> orderedUnqiue( aTextures.size() );
+		for( auto const& tex : aTextures )
+		{
+			assert( !orderedUnqiue[tex.second.uniqueId] );
+			orderedUnqiue[tex.second.uniqueId] = &tex.second;
+		}
+
+		{
+			FileSection_ section{ kSectionTextures, kSectionNoMesh, {} };
+
+			std::uint32_t const textureCount = std::uint32_t(orderedUnqiue.size());
+			append_( section.data, &textureCount );
+
+			for( auto const& tex : orderedUnqiue )
+			{
+				assert( tex );
+				append_string_( section.data, tex->newPath );
+
+				std::uint8_t channels = tex->channels;
+				append_( section.data, &channels );
+			}
+
+			sections.emplace_back( std::move(section) );
+		}
+
+		// Material section (kSectionMaterials)
+		// Format:
+		//  - repeat for each material (52 bytes each):
+		//    - uin32_t : base color texture index
+		//    - uin32_t : roughness texture index (packed: R) NOTE: compact-cw3-5
+		//    - uin32_t : metalness texture index (packed: G) NOTE: compact-cw3-5
+		//    - uin32_t : alphaMask texture index (packed: A; or 0xffffffff if none)
+		//    - uin32_t : normalMap texture index (or 0xffffffff if none)
+		//    - 3*float : base color (RGB)        NOTE: new in CW3
+		//    - 3*float : emissive color (RGB)    NOTE: new in CW3
+		//    - float   : base roughness          NOTE: new in CW3
+		//    - float   : base metalness          NOTE: new in CW3
+		{
+			FileSection_ section{ kSectionMaterials, kSectionNoMesh, {} };
+
+			for( auto const& mat : aModel.materials )
+			{
+				auto const append_tex_ = [&] (std::string const& aTexturePath ) {
+					if( aTexturePath.empty() )
+					{
+						static constexpr std::uint32_t sentinel = ~std::uint32_t(0);
+						append_( section.data, &sentinel );
+						return;
+					}
+
+					auto const it = aTextures.find( aTexturePath );
+					assert( aTextures.end() != it );
+
+					append_( section.data, &it->second.uniqueId );
+				};
+
+				// Roughness, metalness and the alpha mask all refer to the
+				// packed texture (channels R, G and A, respectively).
+				auto const packed = packed_texture_key_( mat );
+
+				append_tex_( mat.baseColorTexturePath );
+				append_tex_( packed );
+				append_tex_( packed );
+				append_tex_( mat.alphaMaskTexturePath.empty() ? std::string() : packed );
+				append_tex_( mat.normalMapTexturePath );
+
+				append_( section.data, &mat.baseColor.x, 3 );
+				append_( section.data, &mat.emissiveColor.x, 3 );
+				append_( section.data, &mat.baseRoughness );
+				append_( section.data, &mat.baseMetalness );
+			}
+
+			sections.emplace_back( std::move(section) );
+		}
+
+		// Mesh section (kSectionMeshes)
+		// Format:
+		//  - repeat for each mesh (56 bytes each):
+		//    - uint32_t : material index
+		//    - uint32_t : V = number of vertices
+		//    - uint32_t : I = number of indices (all levels of detail)
+		//    - uint32_t : B = bytes per index (2 or 4)
+		//    - uint32_t : F = tangent frame encoding (see TangentFrameEncoding)
+		//    - uint32_t : L = number of levels of detail (at least one)
+		//    - uint32_t : C = number of meshlets (all levels)
+		//    - uint32_t : reserved (zero)
+		//    - vec3 : position offset (AABB min)
+		//    - vec3 : position scale
+		//
+		// Followed by the data of each mesh, one section per stream. These
+		// record the index of their mesh.
+		//  - kSectionPositions : V x u16vec4 position (uint16, w unused)
+		//  - if F = 1 (normal + tangent):
+		//    - kSectionNormals : V x i16vec2 normal (snorm, octahedral)
+		//    - kSectionTangents : V x i16vec4 tangent (snorm, w = handedness)
+		//  - if F = 2 (QTangent):
+		//    - kSectionQTangents : V x i16vec4 QTangent (snorm)
+		//  - kSectionTexcoords : V x u16vec2 texture coordinate (half)
+		//  - kSectionIndices : I x uint16_t (B = 2) or uint32_t (B = 4) index
+		//  - kSectionLevels : L levels of detail (20 bytes each), finest first
+		//    - uint32_t : first index
+		//    - uint32_t : index count
+		//    - float : simplification error (model units)
+		//    - uint32_t : first meshlet
+		//    - uint32_t : meshlet count
+		//  - kSectionMeshlets : C meshlets (48 bytes each), grouped by level
+		//    - vec4 : bounding sphere (xyz = center, w = radius)
+		//    - vec4 : normal cone (xyz = axis, w = cutoff)
+		//    - uint32_t : first index
+		//    - uint32_t : index count
+		//    - 2*uint32_t : reserved (zero)
+		//
+		// The indices of all levels of detail are stored back to back, the
+		// full-resolution level first.
+		//
+		// With --compress ("compact-cw3-7z"), each per-mesh section instead
+		// holds a compressed stream (see labutils/compression.hpp) of the data
+		// above; the section size is that of the compressed stream.
+		assert( aModel.meshes.size() == aIndexedMeshes.size() );
+		assert( aModel.meshes.size() == aQuantizedMeshes.size() );
+		assert( aModel.meshes.size() == aMeshlets.size() );
+
+		FileSection_ meshSection{ kSectionMeshes, kSectionNoMesh, {} };
+		std::vector<FileSection_> meshData;
+
+		for( std::size_t i = 0; i < aModel.meshes.size(); ++i )
+		{
+			auto const& imesh = aIndexedMeshes[i];
+			auto const& qmesh = aQuantizedMeshes[i];
+			auto const meshIndex = std::uint32_t(i);
+
+			std::uint32_t const vertexCount = std::uint32_t(imesh.vert.size());
+			assert( qmesh.vert.size() == vertexCount );
+			assert( qmesh.tang.size() == vertexCount );
+
+			std::vector<std::uint32_t> indices( imesh.indices );
+			for( auto const& lod : imesh.lods )
+				indices.insert( indices.end(), lod.indices.begin(), lod.indices.end() );
+
+			std::uint32_t const indexCount = std::uint32_t(indices.size());
+			std::uint32_t const indexBytes = index_bytes_( imesh );
+
+			// Levels of detail and their meshlets
+			assert( aMeshlets[i].size() == 1 + imesh.lods.size() );
+
+			FileSection_ levels{ kSectionLevels, meshIndex, {}, 20 };
+			FileSection_ meshlets{ kSectionMeshlets, meshIndex, {}, 48 };
+
+			// The runtime reconstructs positions from 16-bit values; grow the
+			// spheres to cover the rounding error.
+			float const margin = 0.5f * glm::length( qmesh.positionScale );
+
+			std::uint32_t firstIndex = 0, meshletCount = 0;
+			for( std::size_t level = 0; level < aMeshlets[i].size(); ++level )
+			{
+				auto const& levelIndices = 0 == level ? imesh.indices : imesh.lods[level-1].indices;
+				float const error = 0 == level ? 0.f : imesh.lods[level-1].error;
+
+				std::uint32_t const levelIndexCount = std::uint32_t(levelIndices.size());
+				std::uint32_t const levelMeshletCount = std::uint32_t(aMeshlets[i][level].size());
+
+				append_( levels.data, &firstIndex );
+				append_( levels.data, &levelIndexCount );
+				append_( levels.data, &error );
+				append_( levels.data, &meshletCount );
+				append_( levels.data, &levelMeshletCount );
+
+				for( auto const& meshlet : aMeshlets[i][level] )
+				{
+					std::uint32_t const meshletFirst = firstIndex + meshlet.firstIndex;
+					glm::vec4 const sphere( meshlet.center, meshlet.radius + margin );
+					glm::vec4 const cone( meshlet.coneAxis, meshlet.coneCutoff );
+					std::uint32_t const reserved[2] = { 0, 0 };
+
+					append_( meshlets.data, &sphere.x, 4 );
+					append_( meshlets.data, &cone.x, 4 );
+					append_( meshlets.data, &meshletFirst );
+					append_( meshlets.data, &meshlet.indexCount );
+					append_( meshlets.data, reserved, 2 );
+				}
+
+				firstIndex += levelIndexCount;
+				meshletCount += levelMeshletCount;
+			}
+
+			// Mesh record
+			std::uint32_t const record[8] = {
+				std::uint32_t(aModel.meshes[i].materialIndex),
+				vertexCount,
+				indexCount,
+				indexBytes,
+				std::uint32_t(qmesh.frames),
+				std::uint32_t(aMeshlets[i].size()),
+				meshletCount,
+				0
+			};
+
+			append_( meshSection.data, record, 8 );
+			append_( meshSection.data, &qmesh.positionMin.x, 3 );
+			append_( meshSection.data, &qmesh.positionScale.x, 3 );
+
+			// Vertex and index streams
+			auto const add_stream_ = [&] (std::uint32_t aType, auto const& aValues) {
+				FileSection_ section{ aType, meshIndex, {}, sizeof(aValues[0]) };
+				append_( section.data, aValues.data(), aValues.size() );
+				meshData.emplace_back( std::move(section) );
+			};
+
+			add_stream_( kSectionPositions, qmesh.vert );
+			if( TangentFrameEncoding::normalTangent == qmesh.frames )
+			{
+				add_stream_( kSectionNormals, qmesh.norm );
+				add_stream_( kSectionTangents, qmesh.tang );
+			}
+			else
+			{
+				add_stream_( kSectionQTangents, qmesh.tang );
+			}
+			add_stream_( kSectionTexcoords, qmesh.text );
+
+			if( sizeof(std::uint16_t) == indexBytes )
+				add_stream_( kSectionIndices, std::vector<std::uint16_t>( indices.begin(), indices.end() ) );
+			else
+				add_stream_( kSectionIndices, indices );
+
+			meshData.emplace_back( std::move(levels) );
+			meshData.emplace_back( std::move(meshlets) );
+		}
+
+		sections.emplace_back( std::move(meshSection) );
+		std::move( meshData.begin(), meshData.end(), std::back_inserter( sections ) );
+
+		if( aOptions.compressStreams )
+			compress_sections_( sections, aOptions.jobs );
+
+		// Write header
+		// Format:
+		//   - char[16] : file magic
+		//   - char[16] : file variant ID
+		//   - uint32_t : S = number of sections   NOTE: new in compact-cw3-7
+		//   - uint32_t : reserved (zero)
+		//   - repeat S times:
+		//     - uint32_t : section type (kSection*)
+		//     - uint32_t : mesh index (0xffffffff if the section is not per mesh)
+		//     - uint64_t : offset from the start of the file
+		//     - uint64_t : size in bytes
+		std::uint32_t const sectionCount = std::uint32_t(sections.size());
+		std::uint32_t const reserved = 0;
+
+		checked_write_( aOut, sizeof(char)*16, kFileMagic );
+		checked_write_( aOut, sizeof(char)*16, aOptions.compressStreams ? kFileVariantCompressed : kFileVariant );
+		checked_write_( aOut, sizeof(sectionCount), &sectionCount );
+		checked_write_( aOut, sizeof(reserved), &reserved );
+
+		auto const align_ = [] (std::uint64_t aOffset) {
+			return (aOffset + kSectionAlignment-1) / kSectionAlignment * kSectionAlignment;
+		};
+
+		std::uint64_t offset = align_( 16+16+4+4 + sectionCount*(4+4+8+8) );
+		for( auto const& section : sections )
+		{
+			std::uint64_t const size = section.data.size();
+
+			checked_write_( aOut, sizeof(std::uint32_t), &section.type );
+			checked_write_( aOut, sizeof(std::uint32_t), &section.mesh );
+			checked_write_( aOut, sizeof(offset), &offset );
+			checked_write_( aOut, sizeof(size), &size );
+
+			offset = align_( offset + size );
+		}
+
+		// Write sections
+		static constexpr std::uint8_t zeros[kSectionAlignment] = {};
+
+		std::uint64_t written = 16+16+4+4 + sectionCount*(4+4+8+8);
+		for( auto const& section : sections )
+		{
+			checked_write_( aOut, std::size_t(align_( written ) - written), zeros );
+			checked_write_( aOut, section.data.size(), section.data.data() );
+
+			written = align_( written ) + section.data.size();
+		}
+	}
+}
+
+namespace
+{
+	std::uint32_t index_bytes_( IndexedMesh const& aMesh )
+	{
+		// Every index is less than the vertex count
+		return aMesh.vert.size() <= std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1
+			? sizeof(std::uint16_t)
+			: sizeof(std::uint32_t)
+			;
+	}
+
+	void compress_sections_( std::vector<FileSection_>& aSections, std::size_t aJobs )
+	{
+		// Compress the per-mesh sections. compress_stream() picks the best
+		// filter for each one; sections are independent, so this runs
+		// concurrently.
+		auto const t0 = Clock_::now();
+
+		std::vector<std::size_t> items;
+		for( std::size_t i = 0; i < aSections.size(); ++i )
+		{
+			if( kSectionNoMesh != aSections[i].mesh )
+				items.emplace_back( i );
+		}
+
+		std::vector<std::vector<std::uint8_t>> raw( items.size() );
+		parallel_for( items.size(), aJobs, [&] (std::size_t aItem) {
+			auto& section = aSections[items[aItem]];
+			auto compressed = lut::compress_stream( section.data.data(), section.data.size(), section.stride );
+
+			raw[aItem] = std::move(section.data);
+			section.data = std::move(compressed);
+		} );
+
+		auto const t1 = Clock_::now();
+
+		std::size_t rawBytes = 0, compressedBytes = 0;
+		for( std::size_t i = 0; i < items.size(); ++i )
+		{
+			rawBytes += raw[i].size();
+			compressedBytes += aSections[items[i]].data.size();
+		}
+
+		// Measure decompression, as the runtime does it: one thread, into
+		// preallocated buffers. Repeat until the measurement takes long
+		// enough to be meaningful. Also checks the round trip.
+		std::vector<std::vector<std::uint8_t>> decoded( items.size() );
+		for( std::size_t i = 0; i < items.size(); ++i )
+			decoded[i].resize( raw[i].size() );
+
+		std::vector<std::uint8_t> scratch;
+		std::size_t rounds = 0;
+
+		auto const t2 = Clock_::now();
+		auto t3 = t2;
+		do
+		{
+			for( std::size_t i = 0; i < items.size(); ++i )
+			{
+				auto const& section = aSections[items[i]];
+				lut::decompress_stream( section.data.data(), section.data.size(), decoded[i].data(), decoded[i].size(), scratch );
+			}
+
+			++rounds;
+			t3 = Clock_::now();
+		} while( t3 - t2 < std::chrono::milliseconds(50) );
+
+		for( std::size_t i = 0; i < items.size(); ++i )
+		{
+			if( decoded[i] != raw[i] )
+				throw lut::Error( "Compressed section %zu does not decompress to its original data", items[i] );
+		}
+
+		auto const decodeSeconds = std::chrono::duration<double>(t3 - t2).count();
+		report_( " - compressed %zu mesh sections: %.2f MB => %.2f MB (%.2fx) in %.0f ms; decompression %.2f GB/s\n",
+			items.size(),
+			rawBytes / (1024.*1024.),
+			compressedBytes / (1024.*1024.),
+			compressedBytes ? double(rawBytes) / compressedBytes : 0.,
+			std::chrono::duration_cast<Millisecondsf_>(t1-t0).count(),
+			rounds * double(rawBytes) / decodeSeconds / 1e9
+		);
+	}
+}
+
+namespace
+{
+	void index_meshes_( std::vector<IndexedMesh>& aIndexed, InputModel const& aModel, std::vector<std::size_t> const& aMeshIndices, std::size_t aJobs, float aErrorTolerance )
+	{
+		// Meshes are independent, so they can be indexed concurrently. Each
+		// result goes into its own slot, which keeps the output in the
+		// original mesh order regardless of which thread finishes first.
+		assert( aIndexed.size() == aModel.meshes.size() );
+
+		parallel_for( aMeshIndices.size(), aJobs, [&] (std::size_t aItem) {
+			auto const meshIndex = aMeshIndices[aItem];
+			auto const& imesh = aModel.meshes[meshIndex];
+			auto const endIndex = imesh.vertexStartIndex + imesh.vertexCount;
+
+			TriangleSoup soup;
+
+			soup.vert.reserve( imesh.vertexCount );
+			for( std::size_t i = imesh.vertexStartIndex; i < endIndex; ++i )
+				soup.vert.emplace_back( aModel.positions[i] );
+
+			soup.text.reserve( imesh.vertexCount );
+			for( std::size_t i = imesh.vertexStartIndex; i < endIndex; ++i )
+				soup.text.emplace_back( aModel.texcoords[i] );
+
+			soup.norm.reserve( imesh.vertexCount );
+			for( std::size_t i = imesh.vertexStartIndex; i < endIndex; ++i )
+				soup.norm.emplace_back( aModel.normals[i] );
+
+
+			aIndexed[meshIndex] = make_indexed_mesh( soup, aErrorTolerance );
+		} );
+	}
+}
+
+namespace
+{
+	std::uint64_t parameters_hash_( char const* aOutput, char const* aInputOBJ, BakeOptions_ const& aOptions, glm::mat4x4 const& aStaticTransform )
+	{
+		// Everything that affects the output of process_model_(), except for
+		// the contents of the files. The number of jobs does not matter, the
+		// results are identical.
+		auto h = hash_bytes( &kBakeCacheVersion, sizeof(kBakeCacheVersion) );
+		h = hash_bytes( kFileVariant, sizeof(kFileVariant), h );
+		h = hash_bytes( aOutput, std::strlen(aOutput), h );
+		h = hash_bytes( aInputOBJ, std::strlen(aInputOBJ), h );
+
+		h = hash_bytes( &aOptions.overdrawThreshold, sizeof(aOptions.overdrawThreshold), h );
+		h = hash_bytes( &aOptions.lodLevels, sizeof(aOptions.lodLevels), h );
+		h = hash_bytes( &aOptions.lodError, sizeof(aOptions.lodError), h );
+		h = hash_bytes( &aOptions.mergeByMaterial, sizeof(aOptions.mergeByMaterial), h );
+		h = hash_bytes( &aOptions.tangentFrames, sizeof(aOptions.tangentFrames), h );
+		h = hash_bytes( &aOptions.textureCompression, sizeof(aOptions.textureCompression), h );
+		h = hash_bytes( aOptions.textureDir.data(), aOptions.textureDir.size(), h );
+		h = hash_bytes( &aOptions.compressStreams, sizeof(aOptions.compressStreams), h );
+
+		h = hash_bytes( &aStaticTransform[0][0], sizeof(glm::mat4x4), h );
+		return h;
+	}
+
+	std::uint64_t mesh_key_( InputModel const& aModel, std::size_t aMeshIndex, BakeOptions_ const& aOptions )
+	{
+		// Everything that index_meshes_() and generate_lods_() depend on
+		auto const& imesh = aModel.meshes[aMeshIndex];
+		auto const first = imesh.vertexStartIndex, count = imesh.vertexCount;
+
+		auto h = hash_bytes( &kBakeCacheVersion, sizeof(kBakeCacheVersion) );
+		h = hash_bytes( &kIndexErrorTolerance, sizeof(kIndexErrorTolerance), h );
+		h = hash_bytes( &aOptions.lodLevels, sizeof(aOptions.lodLevels), h );
+		h = hash_bytes( &aOptions.lodError, sizeof(aOptions.lodError), h );
+
+		h = hash_bytes( aModel.positions.data() + first, count*sizeof(glm::vec3), h );
+		h = hash_bytes( aModel.normals.data() + first, count*sizeof(glm::vec3), h );
+		h = hash_bytes( aModel.texcoords.data() + first, count*sizeof(glm::vec2), h );
+		return h;
+	}
+}
+
+namespace
+{
+	void generate_tangents_( std::vector<IndexedMesh>& aMeshes, std::vector<std::size_t> const& aMeshIndices, std::size_t aJobs )
+	{
+		// Like indexing, this is independent per mesh. Meshes loaded from the
+		// bake cache already have their tangents.
+		auto const t0 = Clock_::now();
+
+		std::vector<std::size_t> split( aMeshIndices.size(), 0 );
+		parallel_for( aMeshIndices.size(), aJobs, [&] (std::size_t aItem) {
+			split[aItem] = generate_tangents( aMeshes[aMeshIndices[aItem]] );
+		} );
+
+		auto const t1 = Clock_::now();
+
+		std::size_t splitTotal = 0;
+		for( auto const count : split )
+			splitTotal += count;
+
+		report_( " - tangents: generated for %zu meshes, %zu vertices split at mirrored texture coordinates\n", aMeshIndices.size(), splitTotal );
+		report_( " - tangent generation took %.2f ms\n", std::chrono::duration_cast<Millisecondsf_>(t1-t0).count() );
+	}
+}
+
+namespace
+{
+	void generate_lods_( std::vector<IndexedMesh>& aMeshes, std::vector<std::size_t> const& aMeshIndices, BakeOptions_ const& aOptions )
+	{
+		auto const t0 = Clock_::now();
+
+		parallel_for( aMeshIndices.size(), aOptions.jobs, [&] (std::size_t aItem) {
+			generate_lods( aMeshes[aMeshIndices[aItem]], aOptions.lodLevels, aOptions.lodError );
+		} );
+
+		auto const t1 = Clock_::now();
+
+		// Watertightness: simplification must not open the surface, so no
+		// level may have more open edges than the full-resolution mesh.
+		std::vector<std::size_t> cracked( aMeshIndices.size(), 0 );
+		parallel_for( aMeshIndices.size(), aOptions.jobs, [&] (std::size_t aItem) {
+			auto const& mesh = aMeshes[aMeshIndices[aItem]];
+			if( mesh.lods.empty() )
+				return;
+
+			auto const open = count_open_edges( mesh, mesh.indices );
+			for( auto const& lod : mesh.lods )
+			{
+				if( count_open_edges( mesh, lod.indices ) > open )
+					++cracked[aItem];
+			}
+		} );
+
+		std::size_t crackedTotal = 0;
+		for( auto const count : cracked )
+			crackedTotal += count;
+
+		// Triangles per level, summed over all meshes. Meshes that stop early
+		// count towards the deeper levels with their coarsest level.
+		std::vector<std::size_t> triangles( aOptions.lodLevels, 0 );
+		std::size_t levels = 0;
+		for( auto const& mesh : aMeshes )
+		{
+			levels += 1 + mesh.lods.size();
+			for( std::size_t level = 0; level < aOptions.lodLevels; ++level )
+			{
+				std::size_t count = mesh.indices.size();
+				if( level > 0 && !mesh.lods.empty() )
+					count = mesh.lods[std::min( level, mesh.lods.size() )-1].indices.size();
+
+				triangles[level] += count / 3;
+			}
+		}
+
+		report_( " - levels of detail (max %zu, error %g): %.1f levels per mesh, triangles", aOptions.lodLevels, double(aOptions.lodError), aMeshes.empty() ? 0. : double(levels)/aMeshes.size() );
+		for( std::size_t level = 0; level < triangles.size(); ++level )
+			report_( "%s%zu", level ? " => " : " ", triangles[level] );
+		report_( "\n" );
+
+		if( crackedTotal )
+			report_( " - warning: %zu levels of detail have open edges that the full-resolution meshes do not have\n", crackedTotal );
+
+		report_( " - simplification took %.2f ms\n", std::chrono::duration_cast<Millisecondsf_>(t1-t0).count() );
+	}
+}
+
+namespace
+{
+	void optimize_meshes_( std::vector<IndexedMesh>& aMeshes, BakeOptions_ const& aOptions )
+	{
+		bool const overdraw = aOptions.overdrawThreshold > 0.f;
+
+		VertexCacheStats before, after;
+		for( auto const& mesh : aMeshes )
+			before += analyze_vertex_cache( mesh.indices, mesh.vert.size() );
+
+		// Overdraw is measured per mesh after the vertex cache pass, so that
+		// the "before" number reflects what would be written without the
+		// additional cluster sort.
+		std::vector<OverdrawStats> overdrawBefore( aMeshes.size() ), overdrawAfter( aMeshes.size() );
+		std::vector<VertexFetchStats> fetchBefore( aMeshes.size() ), fetchAfter( aMeshes.size() );
+
+		auto const t0 = Clock_::now();
+
+		parallel_for( aMeshes.size(), aOptions.jobs, [&] (std::size_t aMeshIndex) {
+			auto& mesh = aMeshes[aMeshIndex];
+			if( !overdraw )
+			{
+				optimize_vertex_cache( mesh );
+			}
+			else
+			{
+				std::vector<std::uint32_t> clusters;
+				optimize_vertex_cache( mesh, kVertexCacheSize, &clusters );
+
+				overdrawBefore[aMeshIndex] = analyze_overdraw( mesh );
+				optimize_overdraw( mesh, clusters, aOptions.overdrawThreshold );
+				overdrawAfter[aMeshIndex] = analyze_overdraw( mesh );
+			}
+
+			// Vertex order must follow the final triangle order. Inputs that
+			// are already laid out coherently (e.g., generated grids) can
+			// occasionally do better than first-use order; keep those as-is.
+			fetchBefore[aMeshIndex] = analyze_vertex_fetch( mesh );
+
+			auto remapped = mesh;
+			optimize_vertex_fetch( remapped );
+
+			auto const fetch = analyze_vertex_fetch( remapped );
+			if( fetch.bytesFetched <= fetchBefore[aMeshIndex].bytesFetched )
+			{
+				mesh = std::move(remapped);
+				fetchAfter[aMeshIndex] = fetch;
+			}
+			else
+			{
+				fetchAfter[aMeshIndex] = fetchBefore[aMeshIndex];
+			}
+		} );
+
+		auto const t1 = Clock_::now();
+
+		for( auto const& mesh : aMeshes )
+			after += analyze_vertex_cache( mesh.indices, mesh.vert.size() );
+
+		report_( " - vertex cache (FIFO %zu): ACMR %.3f => %.3f, ATVR %.3f => %.3f\n", kVertexCacheSize, before.acmr(), after.acmr(), before.atvr(), after.atvr() );
+
+		VertexFetchStats vfBefore, vfAfter;
+		for( std::size_t i = 0; i < aMeshes.size(); ++i )
+		{
+			vfBefore += fetchBefore[i];
+			vfAfter += fetchAfter[i];
+		}
+
+		report_( " - vertex fetch (%zu B lines, %zu kB cache): overfetch %.3f => %.3f\n", kVertexFetchLineSize, kVertexFetchCacheSize/1024, vfBefore.overfetch(), vfAfter.overfetch() );
+
+		if( overdraw )
+		{
+			OverdrawStats odBefore, odAfter;
+			for( std::size_t i = 0; i < aMeshes.size(); ++i )
+			{
+				odBefore += overdrawBefore[i];
+				odAfter += overdrawAfter[i];
+			}
+
+			report_( " - overdraw (threshold %.2f): %.3f => %.3f\n", aOptions.overdrawThreshold, odBefore.overdraw(), odAfter.overdraw() );
+		}
+
+		report_( " - triangle reordering took %.2f ms\n", std::chrono::duration_cast<Millisecondsf_>(t1-t0).count() );
+	}
+}
+
+namespace
+{
+	std::vector<QuantizedMesh> quantize_meshes_( std::vector<IndexedMesh> const& aMeshes, BakeOptions_ const& aOptions )
+	{
+		std::vector<QuantizedMesh> ret( aMeshes.size() );
+		std::vector<QuantizationError> errors( aMeshes.size() );
+
+		parallel_for( aMeshes.size(), aOptions.jobs, [&] (std::size_t aMeshIndex) {
+			ret[aMeshIndex] = quantize_mesh( aMeshes[aMeshIndex], aOptions.tangentFrames );
+			measure_quantization_error( errors[aMeshIndex], aMeshes[aMeshIndex], ret[aMeshIndex] );
+		} );
+
+		QuantizationError error;
+		for( auto const& err : errors )
+		{
+			error.maxPosition = std::max( error.maxPosition, err.maxPosition );
+			error.maxNormalDegrees = std::max( error.maxNormalDegrees, err.maxNormalDegrees );
+			error.maxTangentDegrees = std::max( error.maxTangentDegrees, err.maxTangentDegrees );
+			error.maxTexCoord = std::max( error.maxTexCoord, err.maxTexCoord );
+		}
+
+		report_( " - quantization error (max): position %g, normal %.3f deg, tangent %.3f deg, texcoord %g\n", error.maxPosition, error.maxNormalDegrees, error.maxTangentDegrees, error.maxTexCoord );
+
+		return ret;
+	}
+}
+
+namespace
+{
+	std::vector<LodMeshlets_> build_meshlets_( std::vector<IndexedMesh> const& aMeshes, std::size_t aJobs )
+	{
+		std::vector<LodMeshlets_> ret( aMeshes.size() );
+
+		parallel_for( aMeshes.size(), aJobs, [&] (std::size_t aMeshIndex) {
+			auto const& mesh = aMeshes[aMeshIndex];
+
+			auto& levels = ret[aMeshIndex];
+			levels.emplace_back( build_meshlets( mesh, mesh.indices ) );
+			for( auto const& lod : mesh.lods )
+				levels.emplace_back( build_meshlets( mesh, lod.indices ) );
+		} );
+
+		std::size_t meshlets = 0, triangles = 0, cones = 0;
+		for( auto const& mesh : ret )
+		{
+			for( auto const& level : mesh )
+			{
+				meshlets += level.size();
+				for( auto const& meshlet : level )
+				{
+					triangles += meshlet.indexCount / 3;
+					if( meshlet.coneCutoff < 1.f )
+						++cones;
+				}
+			}
+		}
+
+		report_( " - meshlets (max %zu vertices, %zu triangles; all levels): %zu, %.1f triangles on average, %zu with a usable normal cone\n", kMeshletMaxVertices, kMeshletMaxTriangles, meshlets, meshlets ? float(triangles)/meshlets : 0.f, cones );
+
+		return ret;
+	}
+}
 
 namespace
 {
@@ -401,7 +1756,7 @@ namespace
 		std::unordered_map<std::string,TextureInfo_> unique;
 
 		std::uint32_t texid = 0;
-		auto const add_unique_ = [&] (std::string const& aPath, std::uint8_t aChannels)
+		auto const add_unique_ = [&] (std::string const& aPath, std::uint8_t aChannels, std::vector<std::string> aSources = {})
 		{
 			if( aPath.empty() )
 				return;
@@ -409,6 +1764,7 @@ namespace
 			TextureInfo_ info{};
 			info.uniqueId = texid;
 			info.channels = aChannels;
+			info.sources = std::move(aSources);
 
 			auto const [it, isNew] = unique.emplace( std::make_pair(aPath,info) );
 
@@ -419,24 +1775,73 @@ namespace
 		for( auto const& mat : aModel.materials )
 		{
 			add_unique_( mat.baseColorTexturePath, 4 );
-			add_unique_( mat.roughnessTexturePath, 1 ); 
-			add_unique_( mat.metalnessTexturePath, 1 ); 
-			add_unique_( mat.alphaMaskTexturePath, 4 );  // assume == baseColor
-			add_unique_( mat.normalMapTexturePath, 4 );  // eh...
+			add_unique_( mat.normalMapTexturePath, 3 );  // linear; see make_texture_()
+
+			// Roughness and metalness are single-channel; they are packed
+			// into one texture, together with the alpha mask if there is one.
+			// Materials that share all of these share the packed texture.
+			assert( !mat.roughnessTexturePath.empty() && !mat.metalnessTexturePath.empty() ); // see normalize_()
+
+			std::vector<std::string> sources{ mat.roughnessTexturePath, mat.metalnessTexturePath };
+			if( !mat.alphaMaskTexturePath.empty() )
+				sources.emplace_back( mat.alphaMaskTexturePath );
+
+			auto const channels = std::uint8_t(2 == sources.size() ? 2 : 4);
+			add_unique_( packed_texture_key_( mat ), channels, std::move(sources) );
 		}
 
 		return unique;
 	}
 
-	std::unordered_map<std::string,TextureInfo_> new_paths_( std::unordered_map<std::string,TextureInfo_> aTextures, std::filesystem::path const& aTexDir )
+	std::string packed_texture_key_( InputMaterialInfo const& aMaterial )
+	{
+		// Key of the packed texture in the map of unique textures. This is
+		// not a path; the '\n' separators cannot occur in real paths.
+		auto key = "packed\n" + aMaterial.roughnessTexturePath + "\n" + aMaterial.metalnessTexturePath;
+		if( !aMaterial.alphaMaskTexturePath.empty() )
+			key += "\n" + aMaterial.alphaMaskTexturePath;
+
+		return key;
+	}
+
+	std::unordered_map<std::string,TextureInfo_> new_paths_( std::unordered_map<std::string,TextureInfo_> aTextures, std::filesystem::path const& aTexDir, bool aSharedDir )
 	{
 		for( auto& entry : aTextures )
 		{
-			std::filesystem::path const originalPath( entry.first );
-			auto const filename = originalPath.filename();
+			// Textures are baked into containers with precomputed mip levels;
+			// see bake_textures_(). Packed textures are named after their
+			// sources, e.g. "rm-rough-metal" or "rma-rough-metal-mask".
+			auto& info = entry.second;
+
+			std::filesystem::path filename;
+			if( info.sources.empty() )
+			{
+				filename = std::filesystem::path( entry.first ).filename();
+			}
+			else
+			{
+				std::string name = 2 == info.sources.size() ? "rm" : "rma";
+				for( auto const& source : info.sources )
+					name += "-" + std::filesystem::path( source ).stem().string();
+
+				filename = name;
+			}
+
+			// In a shared directory, textures of other models may have the
+			// same name but different sources. The hash of the key (i.e., of
+			// the source paths) tells them apart, while identical textures
+			// still end up in the same container.
+			if( aSharedDir )
+			{
+				char suffix[24];
+				std::snprintf( suffix, sizeof(suffix), "-%016llx", static_cast<unsigned long long>(hash_bytes( entry.first.data(), entry.first.size() )) );
+
+				filename = filename.stem().string() + suffix;
+			}
+
+			filename.replace_extension( "comp5822tex" );
 			auto const newpath = aTexDir / filename;
 		
-			auto& info = entry.second;
 			info.newPath = newpath.string();
 		}
 
@@ -445,6 +1850,120 @@ namespace
 		// argument, NRVO is unlikely to occur.
 		return aTextures; 
 	}
-}
 
+	void bake_textures_( std::vector<TextureWork_> const& aWork, BakeOptions_ const& aOptions )
+	{
+		// Each unique texture is decoded once and stored with all its mip
+		// levels, so that the runtime only has to upload the data. The format
+		// follows from the channel count recorded by find_unique_textures_()
+		// (see make_texture_()); block-compressed textures take 4-8x less
+		// memory than RGBA8.
+		//
+		// Each container records a key derived from its source image and the
+		// compression settings. With the bake cache enabled, containers whose
+		// key is still current are not rebuilt.
+		//
+		// Textures are processed one at a time; the block encoder spreads
+		// each of them over all jobs instead.
+		auto const t0 = Clock_::now();
+
+		std::size_t baked = 0, compressed = 0, totalBytes = 0;
+		for( auto const& item : aWork )
+		{
+			auto key = hash_bytes( &kBakeCacheVersion, sizeof(kBakeCacheVersion) );
+			for( auto const& source : item.sources )
+			{
+				std::uint64_t sourceHash = 0;
+				if( !hash_file( source, sourceHash ) )
+					throw lut::Error( "Unable to read texture '%s'", source.c_str() );
+
+				key = hash_bytes( &sourceHash, sizeof(sourceHash), key );
+			}
+
+			key = hash_bytes( &aOptions.textureCompression, sizeof(aOptions.textureCompression), key );
+			key = hash_bytes( &item.channels, sizeof(item.channels), key );
+
+			std::uint64_t existing = 0;
+			if( !aOptions.cacheDir.empty() && read_texture_container_key( item.container.c_str(), existing ) && key == existing )
+				continue;
+
+			auto texture = make_texture_( item.sources, item.channels, aOptions );
+			write_texture_container( item.container.c_str(), texture, key );
+
+			++baked;
+			if( is_block_format( texture.format ) )
+				++compressed;
+
+			for( auto const& level : texture.levels )
+				totalBytes += level.data.size();
+		}
+
+		auto const t1 = Clock_::now();
+
+		report_( " - textures: baked %zu of %zu with mip levels (%zu unchanged), %zu block-compressed => %zu kB\n", baked, aWork.size(), aWork.size()-baked, compressed, totalBytes/1024 );
+		report_( " - texture baking took %.2f ms\n", std::chrono::duration_cast<Millisecondsf_>(t1-t0).count() );
+	}
+
+	MipTexture make_texture_( std::vector<std::string> const& aSources, std::uint8_t aChannels, BakeOptions_ const& aOptions )
+	{
+		// Colour is sRGB, as before. Roughness and metalness were sampled
+		// through sRGB views as well, but BC5 has no sRGB variant; packed
+		// textures are therefore converted to linear, so that the shaders see
+		// the same values.
+		//
+		// Packed textures become BC5 (roughness and metalness) or linear BC7
+		// (with the alpha mask).
+		if( aSources.size() > 1 )
+		{
+			auto texture = make_packed_mip_texture( aSources[0].c_str(), aSources[1].c_str(), aSources.size() > 2 ? aSources[2].c_str() : nullptr );
+
+			if( TextureCompression_::none != aOptions.textureCompression )
+				compress_mip_texture( texture, 2 == aChannels ? kTextureFormatBC5Unorm : kTextureFormatBC7Unorm, aOptions.jobs );
+
+			return texture;
+		}
+
+		char const* source = aSources[0].c_str();
+
+		// Normal maps hold directions, not colours. They are neither decoded
+		// from sRGB nor stored as sRGB (the three channels are recorded by
+		// find_unique_textures_()).
+		if( 3 == aChannels )
+		{
+			auto texture = make_mip_texture( source, kTextureFormatRGBA8Unorm, false );
+
+			if( TextureCompression_::bc7 == aOptions.textureCompression )
+				compress_mip_texture( texture, kTextureFormatBC7Unorm, aOptions.jobs );
+			else if( TextureCompression_::bc1 == aOptions.textureCompression )
+				compress_mip_texture( texture, kTextureFormatBC1Unorm, aOptions.jobs );
+
+			return texture;
+		}
+
+		if( TextureCompression_::none == aOptions.textureCompression )
+			return make_mip_texture( source, kTextureFormatRGBA8Srgb );
+
+		auto texture = make_mip_texture( source, kTextureFormatRGBA8Srgb );
+
+		std::uint32_t format = kTextureFormatBC7Srgb;
+		if( TextureCompression_::bc1 == aOptions.textureCompression )
+		{
+			// BC1 has (at most) one bit of alpha; use BC3 if there is any
+			// transparency at all.
+			auto const& base = texture.levels[0].data;
+
+			bool opaque = true;
+			for( std::size_t i = 3; i < base.size() && opaque; i += 4 )
+				opaque = 255 == base[i];
+
+			format = opaque ? kTextureFormatBC1Srgb : kTextureFormatBC3Srgb;
+		}
+
+		compress_mip_texture( texture, format, aOptions.jobs );
+		return texture;
+	}
+}
 
+#if CW3_BAKE_BENCHMARK
+#	include "benchmark.hxx"
+#endif // ~ CW3_BAKE_BENCHMARK
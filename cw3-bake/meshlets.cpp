@@ -0,0 +1,155 @@
+#include "meshlets.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	void compute_bounds_(
+		Meshlet&,
+		IndexedMesh const&,
+		std::vector<std::uint32_t> const& aIndices,
+		std::vector<std::uint32_t> const& aVertices
+	);
+}
+
+//--    build_meshlets()                ///{{{2///////////////////////////////
+std::vector<Meshlet> build_meshlets( IndexedMesh const& aMesh, std::vector<std::uint32_t> const& aIndices, std::size_t aMaxVertices, std::size_t aMaxTriangles )
+{
+	assert( aMaxVertices >= 3 && aMaxTriangles >= 1 );
+
+	auto const& indices = aIndices;
+	std::size_t const triangleCount = indices.size() / 3;
+
+	std::vector<Meshlet> ret;
+
+	// Vertices of the current meshlet; marks[v] == ret.size()+1 if v is in
+	// the current meshlet.
+	std::vector<std::size_t> marks( aMesh.vert.size(), 0 );
+	std::vector<std::uint32_t> vertices;
+	vertices.reserve( aMaxVertices );
+
+	std::size_t first = 0;
+	for( std::size_t tri = 0; tri <= triangleCount; ++tri )
+	{
+		std::size_t const mark = ret.size()+1;
+
+		bool flush = tri == triangleCount || tri - first == aMaxTriangles;
+		if( !flush )
+		{
+			std::size_t added = 0;
+			for( std::size_t j = 0; j < 3; ++j )
+				added += mark != marks[indices[tri*3+j]];
+
+			flush = vertices.size() + added > aMaxVertices;
+		}
+
+		if( flush && tri > first )
+		{
+			Meshlet meshlet{};
+			meshlet.firstIndex = std::uint32_t(first*3);
+			meshlet.indexCount = std::uint32_t((tri-first)*3);
+			compute_bounds_( meshlet, aMesh, aIndices, vertices );
+
+			ret.emplace_back( meshlet );
+
+			vertices.clear();
+			first = tri;
+		}
+
+		if( tri == triangleCount )
+			break;
+
+		std::size_t const current = ret.size()+1;
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			auto const v = indices[tri*3+j];
+			if( current != marks[v] )
+			{
+				marks[v] = current;
+				vertices.push_back( v );
+			}
+		}
+	}
+
+	return ret;
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	void compute_bounds_( Meshlet& aMeshlet, IndexedMesh const& aMesh, std::vector<std::uint32_t> const& aIndices, std::vector<std::uint32_t> const& aVertices )
+	{
+		assert( !aVertices.empty() );
+
+		// Bounding sphere: center of the AABB, radius to the farthest vertex.
+		// Not minimal, but cheap and tight enough for culling.
+		glm::vec3 bmin( std::numeric_limits<float>::max() );
+		glm::vec3 bmax( std::numeric_limits<float>::lowest() );
+		for( auto const v : aVertices )
+		{
+			bmin = glm::min( bmin, aMesh.vert[v] );
+			bmax = glm::max( bmax, aMesh.vert[v] );
+		}
+
+		glm::vec3 const center = 0.5f * (bmin + bmax);
+
+		float radius = 0.f;
+		for( auto const v : aVertices )
+			radius = std::max( radius, glm::length( aMesh.vert[v] - center ) );
+
+		aMeshlet.center = center;
+		aMeshlet.radius = radius;
+
+		// Normal cone from the geometric normals of the triangles. (Shading
+		// normals do not matter for back-face culling.)
+		std::size_t const begin = aMeshlet.firstIndex, end = begin + aMeshlet.indexCount;
+
+		std::vector<glm::vec3> normals;
+		normals.reserve( aMeshlet.indexCount / 3 );
+
+		glm::vec3 axis( 0.f );
+		for( std::size_t i = begin; i < end; i += 3 )
+		{
+			auto const& p0 = aMesh.vert[aIndices[i+0]];
+			auto const& p1 = aMesh.vert[aIndices[i+1]];
+			auto const& p2 = aMesh.vert[aIndices[i+2]];
+
+			auto const n = glm::cross( p1-p0, p2-p0 );
+			float const len = glm::length( n );
+			if( len <= 0.f )
+				continue; // degenerate; never rasterized
+
+			normals.emplace_back( n / len );
+			axis += n / len;
+		}
+
+		aMeshlet.coneAxis = glm::vec3( 0.f, 0.f, 1.f );
+		aMeshlet.coneCutoff = 1.f;
+
+		float const axisLength = glm::length( axis );
+		if( normals.empty() || axisLength <= 0.f )
+			return;
+
+		axis /= axisLength;
+
+		float minDot = 1.f;
+		for( auto const& n : normals )
+			minDot = std::min( minDot, glm::dot( axis, n ) );
+
+		aMeshlet.coneAxis = axis;
+
+		// With a spread of 90 degrees or more, some triangle always faces the
+		// camera. Keep the test disabled in that case.
+		if( minDot > 0.f )
+			aMeshlet.coneCutoff = std::sqrt( 1.f - minDot*minDot );
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
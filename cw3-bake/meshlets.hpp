@@ -0,0 +1,66 @@
+#ifndef MESHLETS_HPP_42E176E0_77A1_4D3B_8A43_60D30C17D95D
+#define MESHLETS_HPP_42E176E0_77A1_4D3B_8A43_60D30C17D95D
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+
+#include "index_mesh.hpp"
+
+//--    constants                               ///{{{1///////////////////////
+
+/* Meshlet size limits. 64 vertices and 124 triangles are the values commonly
+ * recommended for NVIDIA hardware (124 rather than 126 or 128 keeps the
+ * primitive index data of a mesh shader meshlet in 128-byte blocks).
+ */
+constexpr std::size_t kMeshletMaxVertices = 64;
+constexpr std::size_t kMeshletMaxTriangles = 124;
+
+//--    types                                   ///{{{1///////////////////////
+
+/* A meshlet is a contiguous range of the mesh's index buffer, together with
+ * culling information.
+ *
+ * The normal cone allows back-face culling of the whole meshlet: it is
+ * invisible from a camera at position C if
+ *
+ *   dot( center - C, coneAxis ) >= coneCutoff * length( center - C ) + radius
+ *
+ * coneCutoff is the sine of the cone's half angle. It is set to 1 if the
+ * triangles' normals do not fit into a cone of less than 90 degrees, which
+ * disables the test.
+ */
+struct Meshlet
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+
+	glm::vec3 center;
+	float radius;
+
+	glm::vec3 coneAxis;
+	float coneCutoff;
+};
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Split the triangles in aIndices, which reference the vertices of aMesh,
+ * into meshlets. Meshlet index ranges are relative to aIndices. Triangles are
+ * taken in their current order (so this should run after any triangle
+ * reordering), and a new meshlet is started whenever adding the next
+ * triangle would exceed one of the limits.
+ */
+std::vector<Meshlet> build_meshlets(
+	IndexedMesh const&,
+	std::vector<std::uint32_t> const& aIndices,
+	std::size_t aMaxVertices = kMeshletMaxVertices,
+	std::size_t aMaxTriangles = kMeshletMaxTriangles
+);
+
+#endif // MESHLETS_HPP_42E176E0_77A1_4D3B_8A43_60D30C17D95D
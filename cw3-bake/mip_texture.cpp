@@ -0,0 +1,403 @@
+#include "mip_texture.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include <stb_image.h>
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	constexpr char kTextureMagic_[16] = "\0\0COMP5822Mtex";
+	constexpr char kTextureVariant_[16] = "mips-1";
+
+	constexpr std::size_t kLevelAlignment_ = 16;
+
+	constexpr std::size_t kChannels_ = 4; // always RGBA
+
+	struct Image_
+	{
+		std::uint32_t width = 0, height = 0;
+		int channelsInFile = 0;
+		std::vector<std::uint8_t> rgba;
+	};
+
+	struct Tap_
+	{
+		std::uint32_t index;
+		float weight;
+	};
+
+	Image_ load_image_( char const* aPath );
+
+	std::vector<MipLevel> make_levels_(
+		MipLevel aBase,
+		std::vector<float> aLinear,
+		bool aSrgb
+	);
+
+	void quantize_( std::vector<float> const& aLinear, bool aSrgb, std::vector<std::uint8_t>& aOut );
+
+	std::vector<std::vector<Tap_>> box_taps_( std::uint32_t aSrcSize, std::uint32_t aDstSize );
+
+	void downsample_(
+		std::vector<float> const& aSrc, std::uint32_t aSrcWidth, std::uint32_t aSrcHeight,
+		std::vector<float>& aDst, std::uint32_t aDstWidth, std::uint32_t aDstHeight
+	);
+
+	float srgb_to_linear_( float );
+	float linear_to_srgb_( float );
+
+	void checked_write_( FILE*, std::size_t, void const* );
+}
+
+//--    make_mip_texture()              ///{{{2///////////////////////////////
+MipTexture make_mip_texture( char const* aPath, std::uint32_t aFormat, bool aSrgbSource )
+{
+	assert( aPath );
+	assert( kTextureFormatRGBA8Srgb == aFormat || kTextureFormatRGBA8Unorm == aFormat );
+	assert( aSrgbSource || kTextureFormatRGBA8Unorm == aFormat );
+
+	auto image = load_image_( aPath );
+
+	MipLevel base;
+	base.width = image.width;
+	base.height = image.height;
+	base.data = std::move(image.rgba);
+
+	// Convert to linear floats for filtering
+	float decode[256];
+	for( std::size_t i = 0; i < 256; ++i )
+		decode[i] = aSrgbSource ? srgb_to_linear_( i / 255.f ) : i / 255.f;
+
+	std::vector<float> linear( base.data.size() );
+	for( std::size_t i = 0; i < base.data.size(); ++i )
+		linear[i] = (3 == i % kChannels_) ? base.data[i] / 255.f : decode[base.data[i]];
+
+	// sRGB source data stored as linear UNORM needs converting
+	bool const srgb = kTextureFormatRGBA8Srgb == aFormat;
+	if( aSrgbSource != srgb )
+		quantize_( linear, srgb, base.data );
+
+	MipTexture ret;
+	ret.format = aFormat;
+	ret.levels = make_levels_( std::move(base), std::move(linear), srgb );
+	return ret;
+}
+
+//--    make_packed_mip_texture()       ///{{{2///////////////////////////////
+MipTexture make_packed_mip_texture( char const* aRed, char const* aGreen, char const* aAlpha, bool aSrgbSource )
+{
+	assert( aRed && aGreen );
+
+	Image_ sources[3];
+	sources[0] = load_image_( aRed );
+	sources[1] = load_image_( aGreen );
+	if( aAlpha )
+		sources[2] = load_image_( aAlpha );
+
+	std::uint32_t width = 0, height = 0;
+	for( auto const& source : sources )
+	{
+		width = std::max( width, source.width );
+		height = std::max( height, source.height );
+	}
+
+	float decode[256];
+	for( std::size_t i = 0; i < 256; ++i )
+		decode[i] = aSrgbSource ? srgb_to_linear_( i / 255.f ) : i / 255.f;
+
+	// Nearest-neighbour lookup of texel (x,y) of the packed texture in a
+	// source, so that sources of different sizes line up.
+	auto const sample_ = [width, height] (Image_ const& aSource, std::uint32_t aX, std::uint32_t aY, std::size_t aChannel) {
+		auto const sx = std::uint32_t(std::uint64_t(aX) * aSource.width / width);
+		auto const sy = std::uint32_t(std::uint64_t(aY) * aSource.height / height);
+		return aSource.rgba[(std::size_t(sy)*aSource.width + sx)*kChannels_ + aChannel];
+	};
+
+	// The alpha mask comes from the alpha channel of its image if it has
+	// one, and from the grey/red value otherwise.
+	std::size_t const alphaChannel = (2 == sources[2].channelsInFile || 4 == sources[2].channelsInFile) ? 3 : 0;
+
+	std::vector<float> linear( std::size_t(width)*height*kChannels_ );
+	for( std::uint32_t y = 0; y < height; ++y )
+	{
+		for( std::uint32_t x = 0; x < width; ++x )
+		{
+			float* texel = linear.data() + (std::size_t(y)*width + x)*kChannels_;
+			texel[0] = decode[sample_( sources[0], x, y, 0 )];
+			texel[1] = decode[sample_( sources[1], x, y, 0 )];
+			texel[2] = 0.f;
+			texel[3] = aAlpha ? sample_( sources[2], x, y, alphaChannel ) / 255.f : 1.f;
+		}
+	}
+
+	MipLevel base;
+	base.width = width;
+	base.height = height;
+	quantize_( linear, false, base.data );
+
+	MipTexture ret;
+	ret.format = kTextureFormatRGBA8Unorm;
+	ret.levels = make_levels_( std::move(base), std::move(linear), false );
+	return ret;
+}
+
+//--    write_texture_container()       ///{{{2///////////////////////////////
+void write_texture_container( char const* aPath, MipTexture const& aTexture, std::uint64_t aSourceKey )
+{
+	assert( aPath );
+	assert( !aTexture.levels.empty() );
+
+	FILE* fof = std::fopen( aPath, "wb" );
+	if( !fof )
+		throw lut::Error( "Unable to open '%s' for writing", aPath );
+
+	try
+	{
+		checked_write_( fof, sizeof(char)*16, kTextureMagic_ );
+		checked_write_( fof, sizeof(char)*16, kTextureVariant_ );
+
+		std::uint32_t const header[4] = {
+			aTexture.format,
+			aTexture.levels[0].width,
+			aTexture.levels[0].height,
+			std::uint32_t(aTexture.levels.size())
+		};
+		checked_write_( fof, sizeof(header), header );
+		checked_write_( fof, sizeof(aSourceKey), &aSourceKey );
+
+		// Level table
+		auto const align_ = [] (std::uint64_t aOffset) {
+			return (aOffset + kLevelAlignment_-1) / kLevelAlignment_ * kLevelAlignment_;
+		};
+
+		std::uint64_t offset = 16 + 16 + sizeof(header) + sizeof(aSourceKey) + aTexture.levels.size() * 2*sizeof(std::uint64_t);
+
+		std::vector<std::uint64_t> offsets;
+		for( auto const& level : aTexture.levels )
+		{
+			offset = align_( offset );
+			offsets.emplace_back( offset );
+
+			std::uint64_t const entry[2] = { offset, level.data.size() };
+			checked_write_( fof, sizeof(entry), entry );
+
+			offset += level.data.size();
+		}
+
+		// Texel data
+		std::uint64_t written = 16 + 16 + sizeof(header) + sizeof(aSourceKey) + aTexture.levels.size() * 2*sizeof(std::uint64_t);
+		for( std::size_t i = 0; i < aTexture.levels.size(); ++i )
+		{
+			static constexpr char zeros[kLevelAlignment_] = {};
+			checked_write_( fof, std::size_t(offsets[i] - written), zeros );
+
+			auto const& data = aTexture.levels[i].data;
+			checked_write_( fof, data.size(), data.data() );
+
+			written = offsets[i] + data.size();
+		}
+	}
+	catch( ... )
+	{
+		std::fclose( fof );
+		throw;
+	}
+
+	std::fclose( fof );
+}
+
+//--    read_texture_container_key()    ///{{{2///////////////////////////////
+bool read_texture_container_key( char const* aPath, std::uint64_t& aSourceKey )
+{
+	FILE* fin = std::fopen( aPath, "rb" );
+	if( !fin )
+		return false;
+
+	char magic[16], variant[16];
+	std::uint32_t header[4];
+	std::uint64_t key = 0;
+
+	bool const ok = 1 == std::fread( magic, sizeof(magic), 1, fin )
+		&& 1 == std::fread( variant, sizeof(variant), 1, fin )
+		&& 1 == std::fread( header, sizeof(header), 1, fin )
+		&& 1 == std::fread( &key, sizeof(key), 1, fin )
+		&& 0 == std::memcmp( magic, kTextureMagic_, sizeof(magic) )
+		&& 0 == std::strncmp( variant, kTextureVariant_, sizeof(variant) )
+	;
+
+	std::fclose( fin );
+
+	if( ok )
+		aSourceKey = key;
+
+	return ok;
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	Image_ load_image_( char const* aPath )
+	{
+		// Note: stbi_set_flip_vertically_on_load() is global state. Use the
+		// thread-local variant, since textures may be baked concurrently.
+		stbi_set_flip_vertically_on_load_thread( 1 );
+
+		int widthi = 0, heighti = 0, channelsi = 0;
+		stbi_uc* data = stbi_load( aPath, &widthi, &heighti, &channelsi, int(kChannels_) );
+		if( !data )
+			throw lut::Error( "%s: unable to load texture image (%s)", aPath, stbi_failure_reason() );
+
+		Image_ ret;
+		ret.width = std::uint32_t(widthi);
+		ret.height = std::uint32_t(heighti);
+		ret.channelsInFile = channelsi;
+		ret.rgba.assign( data, data + std::size_t(ret.width)*ret.height*kChannels_ );
+
+		stbi_image_free( data );
+		return ret;
+	}
+
+	std::vector<MipLevel> make_levels_( MipLevel aBase, std::vector<float> aLinear, bool aSrgb )
+	{
+		// aLinear holds the base level as linear floats. Each level is
+		// filtered from the floats of the previous one.
+		std::vector<MipLevel> ret;
+
+		std::uint32_t w = aBase.width, h = aBase.height;
+		ret.emplace_back( std::move(aBase) );
+
+		std::vector<float> next;
+		while( w > 1 || h > 1 )
+		{
+			std::uint32_t const nw = std::max( w/2, 1u );
+			std::uint32_t const nh = std::max( h/2, 1u );
+
+			downsample_( aLinear, w, h, next, nw, nh );
+
+			MipLevel level;
+			level.width = nw;
+			level.height = nh;
+			quantize_( next, aSrgb, level.data );
+
+			ret.emplace_back( std::move(level) );
+
+			std::swap( aLinear, next );
+			w = nw;
+			h = nh;
+		}
+
+		return ret;
+	}
+
+	void quantize_( std::vector<float> const& aLinear, bool aSrgb, std::vector<std::uint8_t>& aOut )
+	{
+		aOut.resize( aLinear.size() );
+		for( std::size_t i = 0; i < aLinear.size(); ++i )
+		{
+			float v = std::clamp( aLinear[i], 0.f, 1.f );
+			if( aSrgb && 3 != i % kChannels_ )
+				v = linear_to_srgb_( v );
+
+			aOut[i] = std::uint8_t(v * 255.f + 0.5f);
+		}
+	}
+
+	std::vector<std::vector<Tap_>> box_taps_( std::uint32_t aSrcSize, std::uint32_t aDstSize )
+	{
+		// Each destination texel covers the source interval
+		// [d*scale, (d+1)*scale). Source texels contribute in proportion to
+		// their overlap with that interval.
+		double const scale = double(aSrcSize) / aDstSize;
+
+		std::vector<std::vector<Tap_>> ret( aDstSize );
+		for( std::uint32_t d = 0; d < aDstSize; ++d )
+		{
+			double const begin = d * scale, end = (d+1) * scale;
+
+			auto const first = std::uint32_t(std::floor( begin ));
+			auto const last = std::min( std::uint32_t(std::ceil( end )), aSrcSize );
+
+			for( std::uint32_t s = first; s < last; ++s )
+			{
+				double const overlap = std::min( end, s+1. ) - std::max( begin, double(s) );
+				if( overlap > 0. )
+					ret[d].emplace_back( Tap_{ s, float(overlap / scale) } );
+			}
+		}
+
+		return ret;
+	}
+
+	void downsample_( std::vector<float> const& aSrc, std::uint32_t aSrcWidth, std::uint32_t aSrcHeight, std::vector<float>& aDst, std::uint32_t aDstWidth, std::uint32_t aDstHeight )
+	{
+		auto const htaps = box_taps_( aSrcWidth, aDstWidth );
+		auto const vtaps = box_taps_( aSrcHeight, aDstHeight );
+
+		// Horizontal pass: aSrcHeight rows of aDstWidth texels
+		std::vector<float> temp( std::size_t(aDstWidth)*aSrcHeight*kChannels_, 0.f );
+		for( std::uint32_t y = 0; y < aSrcHeight; ++y )
+		{
+			float const* src = aSrc.data() + std::size_t(y)*aSrcWidth*kChannels_;
+			float* dst = temp.data() + std::size_t(y)*aDstWidth*kChannels_;
+
+			for( std::uint32_t x = 0; x < aDstWidth; ++x )
+			{
+				for( auto const& tap : htaps[x] )
+				{
+					for( std::size_t c = 0; c < kChannels_; ++c )
+						dst[x*kChannels_+c] += tap.weight * src[tap.index*kChannels_+c];
+				}
+			}
+		}
+
+		// Vertical pass
+		std::size_t const rowSize = std::size_t(aDstWidth)*kChannels_;
+
+		aDst.assign( rowSize*aDstHeight, 0.f );
+		for( std::uint32_t y = 0; y < aDstHeight; ++y )
+		{
+			float* dst = aDst.data() + y*rowSize;
+
+			for( auto const& tap : vtaps[y] )
+			{
+				float const* src = temp.data() + tap.index*rowSize;
+				for( std::size_t i = 0; i < rowSize; ++i )
+					dst[i] += tap.weight * src[i];
+			}
+		}
+	}
+
+	float srgb_to_linear_( float aX )
+	{
+		return aX <= 0.04045f
+			? aX / 12.92f
+			: std::pow( (aX + 0.055f) / 1.055f, 2.4f )
+			;
+	}
+	float linear_to_srgb_( float aX )
+	{
+		return aX <= 0.0031308f
+			? aX * 12.92f
+			: 1.055f * std::pow( aX, 1.f/2.4f ) - 0.055f
+			;
+	}
+
+	void checked_write_( FILE* aOut, std::size_t aBytes, void const* aData )
+	{
+		auto const ret = std::fwrite( aData, 1, aBytes, aOut );
+
+		if( ret != aBytes )
+			throw lut::Error( "fwrite() failed: %zu instead of %zu", ret, aBytes );
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,124 @@
+#ifndef MIP_TEXTURE_HPP_C47A19E2_0F6B_4D83_B5E1_2A9D86F3C0B7
+#define MIP_TEXTURE_HPP_C47A19E2_0F6B_4D83_B5E1_2A9D86F3C0B7
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+//--    constants                               ///{{{1///////////////////////
+
+/* Texel formats of baked textures. The values are those of the corresponding
+ * VkFormat enumerants, so that the runtime can pass them to Vulkan directly.
+ */
+constexpr std::uint32_t kTextureFormatRGBA8Unorm = 37; // VK_FORMAT_R8G8B8A8_UNORM
+constexpr std::uint32_t kTextureFormatRGBA8Srgb = 43;  // VK_FORMAT_R8G8B8A8_SRGB
+
+// Block-compressed formats; see block_compress.hpp
+constexpr std::uint32_t kTextureFormatBC1Unorm = 131;  // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+constexpr std::uint32_t kTextureFormatBC1Srgb = 132;   // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+constexpr std::uint32_t kTextureFormatBC3Unorm = 137;  // VK_FORMAT_BC3_UNORM_BLOCK
+constexpr std::uint32_t kTextureFormatBC3Srgb = 138;   // VK_FORMAT_BC3_SRGB_BLOCK
+constexpr std::uint32_t kTextureFormatBC4Unorm = 139;  // VK_FORMAT_BC4_UNORM_BLOCK
+constexpr std::uint32_t kTextureFormatBC5Unorm = 141;  // VK_FORMAT_BC5_UNORM_BLOCK
+constexpr std::uint32_t kTextureFormatBC7Unorm = 145;  // VK_FORMAT_BC7_UNORM_BLOCK
+constexpr std::uint32_t kTextureFormatBC7Srgb = 146;   // VK_FORMAT_BC7_SRGB_BLOCK
+
+//--    types                                   ///{{{1///////////////////////
+
+struct MipLevel
+{
+	std::uint32_t width, height;
+	std::vector<std::uint8_t> data; // tightly packed rows
+};
+
+/* Texture with a complete mip chain, down to 1x1. Level sizes follow the
+ * Vulkan rules (each level is max(1, floor(previous/2)) in each dimension).
+ */
+struct MipTexture
+{
+	std::uint32_t format;
+	std::vector<MipLevel> levels;
+};
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Decode an image file (PNG, JPEG, ...; anything stb_image supports) and
+ * compute all its mip levels. The image is expanded to RGBA and flipped
+ * vertically, matching what labutils::load_image_texture2d() does at runtime.
+ *
+ * Mip levels are computed with an area-weighted box filter, which is exact
+ * for odd sizes (where a plain 2x2 average would shift the image). With
+ * aSrgbSource, the colour channels of the image are decoded from sRGB and
+ * filtering happens in linear space; alpha is always treated as linear. Each
+ * level is filtered from a floating point copy of the previous one, so
+ * rounding errors do not accumulate.
+ *
+ * kTextureFormatRGBA8Srgb stores the levels re-encoded as sRGB. With
+ * kTextureFormatRGBA8Unorm, they are stored linear, which converts sRGB
+ * sources for formats that have no sRGB variant (e.g. BC4).
+ *
+ * Throws lut::Error if the image cannot be loaded.
+ */
+MipTexture make_mip_texture(
+	char const* aPath,
+	std::uint32_t aFormat = kTextureFormatRGBA8Srgb,
+	bool aSrgbSource = true
+);
+
+/* Pack single channels of up to three images into one texture, stored as
+ * kTextureFormatRGBA8Unorm with all mip levels:
+ *  - red: first channel of aRed
+ *  - green: first channel of aGreen
+ *  - blue: zero
+ *  - alpha: alpha channel of aAlpha, or its first channel if the image has
+ *    no alpha; one if aAlpha is null
+ * With aSrgbSource, red and green are decoded from sRGB. The result is as
+ * large as the largest source; smaller sources are scaled up with
+ * nearest-neighbour sampling. Images are flipped like in make_mip_texture().
+ *
+ * Throws lut::Error if any of the images cannot be loaded.
+ */
+MipTexture make_packed_mip_texture(
+	char const* aRed,
+	char const* aGreen,
+	char const* aAlpha,
+	bool aSrgbSource = true
+);
+
+/* Write a texture container (.comp5822tex). The container holds all mip
+ * levels back to back, so the runtime can read them into a staging buffer
+ * and upload them with a single copy command. aSourceKey identifies the
+ * source image and settings; see read_texture_container_key().
+ *
+ * Format:
+ *  - char[16] : file magic
+ *  - char[16] : file variant ID
+ *  - uint32_t : format (VkFormat)
+ *  - uint32_t : width of level 0
+ *  - uint32_t : height of level 0
+ *  - uint32_t : L = number of mip levels
+ *  - uint64_t : source key
+ *  - repeat L times:
+ *    - uint64_t : offset of the level's data, from the start of the file
+ *    - uint64_t : size of the level's data in bytes
+ *  - texel data of all levels, each level starting at a multiple of 16 bytes
+ */
+void write_texture_container(
+	char const* aPath,
+	MipTexture const&,
+	std::uint64_t aSourceKey
+);
+
+/* Read the source key of an existing texture container. Returns false if the
+ * file does not exist or is not a (current) texture container.
+ */
+bool read_texture_container_key(
+	char const* aPath,
+	std::uint64_t& aSourceKey
+);
+
+#endif // MIP_TEXTURE_HPP_C47A19E2_0F6B_4D83_B5E1_2A9D86F3C0B7
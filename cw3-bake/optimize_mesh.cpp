@@ -0,0 +1,651 @@
+#include "optimize_mesh.hpp"
+
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	// Sentinel for "no vertex"
+	constexpr std::uint32_t kNoVertex_ = ~std::uint32_t(0);
+
+	// triangle adjacency
+	struct Adjacency_
+	{
+		std::vector<std::uint32_t> offsets; // V+1 entries
+		std::vector<std::uint32_t> triangles;
+	};
+
+	Adjacency_ build_adjacency_(
+		std::vector<std::uint32_t> const&,
+		std::size_t aVertexCount
+	);
+
+	// Tipsify
+	void tipsify_(
+		std::vector<std::uint32_t>& aIndices,
+		std::size_t aVertexCount,
+		std::size_t aCacheSize,
+		std::vector<std::uint32_t>* aClusters
+	);
+
+	std::uint32_t skip_dead_end_(
+		std::vector<std::uint32_t> const& aLiveCount,
+		std::vector<std::uint32_t>& aDeadEnds,
+		std::uint32_t& aCursor
+	);
+
+	// Overdraw
+	std::vector<std::uint32_t> split_clusters_(
+		std::vector<std::uint32_t> const& aIndices,
+		std::size_t aVertexCount,
+		std::vector<std::uint32_t> const& aHardBoundaries,
+		float aThreshold,
+		std::size_t aCacheSize
+	);
+
+	// Vertex fetch
+	std::size_t simulate_fetch_(
+		std::vector<std::uint32_t> const& aIndices,
+		std::size_t aStride,
+		std::size_t aLineSize,
+		std::size_t aCacheSize
+	);
+
+	void rasterize_(
+		OverdrawStats&,
+		IndexedMesh const&,
+		glm::vec3 const& aViewDir,
+		std::size_t aResolution,
+		std::vector<float>& aDepthScratch
+	);
+}
+
+//--    VertexCacheStats                ///{{{2///////////////////////////////
+float VertexCacheStats::acmr() const
+{
+	return triangles ? float(misses) / float(triangles) : 0.f;
+}
+float VertexCacheStats::atvr() const
+{
+	return vertices ? float(misses) / float(vertices) : 0.f;
+}
+
+VertexCacheStats& VertexCacheStats::operator+= ( VertexCacheStats const& aOther )
+{
+	triangles += aOther.triangles;
+	vertices += aOther.vertices;
+	misses += aOther.misses;
+	return *this;
+}
+
+//--    OverdrawStats                   ///{{{2///////////////////////////////
+float OverdrawStats::overdraw() const
+{
+	return covered ? float(shaded) / float(covered) : 0.f;
+}
+
+OverdrawStats& OverdrawStats::operator+= ( OverdrawStats const& aOther )
+{
+	covered += aOther.covered;
+	shaded += aOther.shaded;
+	return *this;
+}
+
+//--    VertexFetchStats                ///{{{2///////////////////////////////
+float VertexFetchStats::overfetch() const
+{
+	return bytesUsed ? float(bytesFetched) / float(bytesUsed) : 0.f;
+}
+
+VertexFetchStats& VertexFetchStats::operator+= ( VertexFetchStats const& aOther )
+{
+	bytesFetched += aOther.bytesFetched;
+	bytesUsed += aOther.bytesUsed;
+	return *this;
+}
+
+//--    analyze_vertex_cache()          ///{{{2///////////////////////////////
+VertexCacheStats analyze_vertex_cache( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount, std::size_t aCacheSize )
+{
+	assert( aCacheSize > 0 );
+
+	VertexCacheStats ret;
+	ret.triangles = aIndices.size() / 3;
+
+	// A vertex is in the FIFO if it entered less than aCacheSize misses ago.
+	std::vector<std::size_t> timestamps( aVertexCount, 0 );
+	std::vector<bool> used( aVertexCount, false );
+
+	std::size_t time = aCacheSize+1;
+	for( auto const index : aIndices )
+	{
+		assert( index < aVertexCount );
+
+		if( time - timestamps[index] > aCacheSize )
+		{
+			timestamps[index] = time++;
+			++ret.misses;
+		}
+
+		if( !used[index] )
+		{
+			used[index] = true;
+			++ret.vertices;
+		}
+	}
+
+	return ret;
+}
+
+//--    optimize_vertex_cache()         ///{{{2///////////////////////////////
+void optimize_vertex_cache( IndexedMesh& aMesh, std::size_t aCacheSize, std::vector<std::uint32_t>* aClusters )
+{
+	tipsify_( aMesh.indices, aMesh.vert.size(), aCacheSize, aClusters );
+
+	for( auto& lod : aMesh.lods )
+		tipsify_( lod.indices, aMesh.vert.size(), aCacheSize, nullptr );
+}
+
+//--    analyze_overdraw()              ///{{{2///////////////////////////////
+OverdrawStats analyze_overdraw( IndexedMesh const& aMesh, std::size_t aResolution )
+{
+	// Axis directions plus the diagonals of a cube. Back-face culling is
+	// enabled, so including opposite directions matters.
+	static glm::vec3 const kViews[] = {
+		{ 1.f, 0.f, 0.f }, { -1.f, 0.f, 0.f },
+		{ 0.f, 1.f, 0.f }, { 0.f, -1.f, 0.f },
+		{ 0.f, 0.f, 1.f }, { 0.f, 0.f, -1.f },
+
+		{ 1.f, 1.f, 1.f }, { 1.f, 1.f, -1.f },
+		{ 1.f, -1.f, 1.f }, { 1.f, -1.f, -1.f },
+		{ -1.f, 1.f, 1.f }, { -1.f, 1.f, -1.f },
+		{ -1.f, -1.f, 1.f }, { -1.f, -1.f, -1.f }
+	};
+
+	OverdrawStats ret;
+
+	std::vector<float> depth;
+	for( auto const& view : kViews )
+		rasterize_( ret, aMesh, glm::normalize( view ), aResolution, depth );
+
+	return ret;
+}
+
+//--    optimize_overdraw()             ///{{{2///////////////////////////////
+void optimize_overdraw( IndexedMesh& aMesh, std::vector<std::uint32_t> const& aClusters, float aThreshold, std::size_t aCacheSize )
+{
+	auto const& indices = aMesh.indices;
+	auto const triangleCount = indices.size() / 3;
+
+	auto const clusters = split_clusters_( indices, aMesh.vert.size(), aClusters, aThreshold, aCacheSize );
+	if( clusters.size() < 2 )
+		return;
+
+	// Per-cluster (and whole mesh) area-weighted centroids and normals
+	std::size_t const clusterCount = clusters.size();
+
+	std::vector<glm::vec3> centroids( clusterCount, glm::vec3( 0.f ) );
+	std::vector<glm::vec3> normals( clusterCount, glm::vec3( 0.f ) );
+	std::vector<float> areas( clusterCount, 0.f );
+
+	glm::vec3 meshCentroid( 0.f );
+	float meshArea = 0.f;
+
+	for( std::size_t c = 0; c < clusterCount; ++c )
+	{
+		std::size_t const end = c+1 < clusterCount ? clusters[c+1] : triangleCount;
+		for( std::size_t tri = clusters[c]; tri < end; ++tri )
+		{
+			auto const& p0 = aMesh.vert[indices[tri*3+0]];
+			auto const& p1 = aMesh.vert[indices[tri*3+1]];
+			auto const& p2 = aMesh.vert[indices[tri*3+2]];
+
+			auto const n = glm::cross( p1-p0, p2-p0 );
+			float const area = 0.5f * glm::length( n );
+
+			centroids[c] += area * (p0+p1+p2) / 3.f;
+			normals[c] += n;
+			areas[c] += area;
+		}
+
+		meshCentroid += centroids[c];
+		meshArea += areas[c];
+	}
+
+	if( meshArea > 0.f )
+		meshCentroid /= meshArea;
+
+	// Occlusion potential: clusters that lie far out along their own normal
+	// tend to occlude the rest of the mesh from most view directions.
+	std::vector<float> potential( clusterCount, 0.f );
+	for( std::size_t c = 0; c < clusterCount; ++c )
+	{
+		if( areas[c] <= 0.f )
+			continue;
+
+		float const len = glm::length( normals[c] );
+		if( len <= 0.f )
+			continue;
+
+		potential[c] = glm::dot( centroids[c]/areas[c] - meshCentroid, normals[c]/len );
+	}
+
+	std::vector<std::uint32_t> order( clusterCount );
+	std::iota( order.begin(), order.end(), 0 );
+	std::stable_sort( order.begin(), order.end(), [&] (std::uint32_t aA, std::uint32_t aB) {
+		return potential[aA] > potential[aB];
+	} );
+
+	// Emit clusters in the new order
+	std::vector<std::uint32_t> output;
+	output.reserve( indices.size() );
+
+	for( auto const c : order )
+	{
+		std::size_t const end = c+1 < clusterCount ? clusters[c+1] : triangleCount;
+		output.insert( output.end(), indices.begin() + clusters[c]*3, indices.begin() + end*3 );
+	}
+
+	assert( output.size() == indices.size() );
+	aMesh.indices = std::move(output);
+}
+
+//--    analyze_vertex_fetch()          ///{{{2///////////////////////////////
+VertexFetchStats analyze_vertex_fetch( IndexedMesh const& aMesh, std::size_t aLineSize, std::size_t aCacheSize )
+{
+	assert( aMesh.vert.size() == aMesh.norm.size() && aMesh.vert.size() == aMesh.text.size() );
+
+	assert( aMesh.tang.empty() || aMesh.vert.size() == aMesh.tang.size() );
+
+	std::size_t const strides[] = {
+		sizeof(decltype(aMesh.vert)::value_type),
+		sizeof(decltype(aMesh.norm)::value_type),
+		sizeof(decltype(aMesh.text)::value_type),
+		aMesh.tang.empty() ? 0 : sizeof(decltype(aMesh.tang)::value_type)
+	};
+
+	VertexFetchStats ret;
+	for( auto const stride : strides )
+	{
+		if( 0 == stride )
+			continue;
+
+		ret.bytesFetched += simulate_fetch_( aMesh.indices, stride, aLineSize, aCacheSize );
+		ret.bytesUsed += aMesh.vert.size() * stride;
+	}
+
+	return ret;
+}
+
+//--    optimize_vertex_fetch()         ///{{{2///////////////////////////////
+void optimize_vertex_fetch( IndexedMesh& aMesh )
+{
+	std::size_t const vertexCount = aMesh.vert.size();
+	assert( vertexCount == aMesh.norm.size() && vertexCount == aMesh.text.size() );
+	assert( aMesh.tang.empty() || vertexCount == aMesh.tang.size() );
+
+	std::vector<std::uint32_t> remap( vertexCount, kNoVertex_ );
+	std::uint32_t next = 0;
+
+	auto const remap_ = [&] (std::vector<std::uint32_t>& aIndices) {
+		for( auto& index : aIndices )
+		{
+			assert( index < vertexCount );
+			if( kNoVertex_ == remap[index] )
+				remap[index] = next++;
+
+			index = remap[index];
+		}
+	};
+
+	// Coarser levels only reference vertices of the full-resolution mesh,
+	// which therefore determines the order.
+	remap_( aMesh.indices );
+	for( auto& lod : aMesh.lods )
+		remap_( lod.indices );
+
+	std::vector<glm::vec3> vert( next ), norm( next );
+	std::vector<glm::vec2> text( next );
+	std::vector<glm::vec4> tang( aMesh.tang.empty() ? 0 : next );
+
+	for( std::size_t i = 0; i < vertexCount; ++i )
+	{
+		auto const dst = remap[i];
+		if( kNoVertex_ == dst )
+			continue;
+
+		vert[dst] = aMesh.vert[i];
+		norm[dst] = aMesh.norm[i];
+		text[dst] = aMesh.text[i];
+
+		if( !tang.empty() )
+			tang[dst] = aMesh.tang[i];
+	}
+
+	aMesh.vert = std::move(vert);
+	aMesh.norm = std::move(norm);
+	aMesh.text = std::move(text);
+	aMesh.tang = std::move(tang);
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	void tipsify_( std::vector<std::uint32_t>& aIndices, std::size_t aVertexCount, std::size_t aCacheSize, std::vector<std::uint32_t>* aClusters )
+	{
+		auto const& indices = aIndices;
+		auto const vertexCount = aVertexCount;
+		auto const triangleCount = indices.size() / 3;
+
+		if( triangleCount < 2 )
+			return;
+
+		auto const adj = build_adjacency_( indices, vertexCount );
+
+		// Live triangle count per vertex
+		std::vector<std::uint32_t> live( vertexCount );
+		for( std::size_t v = 0; v < vertexCount; ++v )
+			live[v] = adj.offsets[v+1] - adj.offsets[v];
+
+		// Cache time stamps; see analyze_vertex_cache().
+		std::vector<std::size_t> timestamps( vertexCount, 0 );
+		std::size_t time = aCacheSize+1;
+
+		std::vector<bool> emitted( triangleCount, false );
+		std::vector<std::uint32_t> deadEnds;
+		std::vector<std::uint32_t> candidates;
+
+		std::vector<std::uint32_t> output;
+		output.reserve( indices.size() );
+
+		if( aClusters )
+			aClusters->assign( 1, 0 );
+
+		std::uint32_t cursor = 0;
+		std::uint32_t fan = skip_dead_end_( live, deadEnds, cursor );
+
+		while( kNoVertex_ != fan )
+		{
+			candidates.clear();
+
+			// Emit all remaining triangles around the fanning vertex
+			for( auto i = adj.offsets[fan]; i < adj.offsets[fan+1]; ++i )
+			{
+				auto const tri = adj.triangles[i];
+				if( emitted[tri] )
+					continue;
+
+				for( std::size_t j = 0; j < 3; ++j )
+				{
+					auto const v = indices[tri*3+j];
+					output.push_back( v );
+
+					deadEnds.push_back( v );
+					candidates.push_back( v );
+
+					--live[v];
+
+					if( time - timestamps[v] > aCacheSize )
+						timestamps[v] = time++;
+				}
+
+				emitted[tri] = true;
+			}
+
+			// Pick the next fanning vertex: prefer the one that entered the
+			// cache the earliest and that will still be in the cache once all
+			// its remaining triangles are emitted.
+			std::uint32_t next = kNoVertex_;
+			std::size_t bestPriority = 0;
+			bool found = false;
+
+			for( auto const v : candidates )
+			{
+				if( 0 == live[v] )
+					continue;
+
+				std::size_t priority = 0;
+				if( time - timestamps[v] + 2*live[v] <= aCacheSize )
+					priority = time - timestamps[v];
+
+				if( !found || priority > bestPriority )
+				{
+					found = true;
+					bestPriority = priority;
+					next = v;
+				}
+			}
+
+			if( !found )
+			{
+				next = skip_dead_end_( live, deadEnds, cursor );
+
+				if( aClusters && kNoVertex_ != next )
+					aClusters->push_back( std::uint32_t(output.size()/3) );
+			}
+
+			fan = next;
+		}
+
+		assert( output.size() == indices.size() );
+		aIndices = std::move(output);
+	}
+
+	Adjacency_ build_adjacency_( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount )
+	{
+		Adjacency_ ret;
+		ret.offsets.assign( aVertexCount+1, 0 );
+
+		for( auto const index : aIndices )
+			++ret.offsets[index+1];
+
+		for( std::size_t v = 0; v < aVertexCount; ++v )
+			ret.offsets[v+1] += ret.offsets[v];
+
+		ret.triangles.resize( aIndices.size() );
+
+		std::vector<std::uint32_t> cursor( ret.offsets.begin(), ret.offsets.end()-1 );
+		for( std::size_t i = 0; i < aIndices.size(); ++i )
+			ret.triangles[cursor[aIndices[i]]++] = std::uint32_t(i/3);
+
+		return ret;
+	}
+}
+
+namespace
+{
+	std::uint32_t skip_dead_end_( std::vector<std::uint32_t> const& aLive, std::vector<std::uint32_t>& aDeadEnds, std::uint32_t& aCursor )
+	{
+		// Recently referenced vertices first; they are likely still cached.
+		while( !aDeadEnds.empty() )
+		{
+			auto const v = aDeadEnds.back();
+			aDeadEnds.pop_back();
+
+			if( aLive[v] > 0 )
+				return v;
+		}
+
+		// Otherwise, continue with the next vertex in input order.
+		for( ; aCursor < aLive.size(); ++aCursor )
+		{
+			if( aLive[aCursor] > 0 )
+				return aCursor;
+		}
+
+		return kNoVertex_;
+	}
+}
+namespace
+{
+	std::vector<std::uint32_t> split_clusters_( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount, std::vector<std::uint32_t> const& aHardBoundaries, float aThreshold, std::size_t aCacheSize )
+	{
+		std::size_t const triangleCount = aIndices.size() / 3;
+
+		std::vector<std::uint32_t> ret;
+		ret.reserve( aHardBoundaries.size() );
+
+		// The cache is treated as cold at the start of each cluster, since
+		// clusters may end up anywhere in the final order.
+		std::vector<std::size_t> timestamps( aVertexCount, 0 );
+		std::size_t time = aCacheSize+1;
+
+		std::size_t nextHard = 0;
+		std::size_t clusterMisses = 0, clusterStart = 0;
+
+		for( std::size_t tri = 0; tri < triangleCount; ++tri )
+		{
+			bool const hard = nextHard < aHardBoundaries.size() && aHardBoundaries[nextHard] == tri;
+			if( hard )
+				++nextHard;
+
+			if( hard || 0 == tri || clusterStart == tri )
+			{
+				if( ret.empty() || ret.back() != tri )
+					ret.push_back( std::uint32_t(tri) );
+
+				time += aCacheSize+1;
+				clusterMisses = 0;
+				clusterStart = tri;
+			}
+
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const v = aIndices[tri*3+j];
+				if( time - timestamps[v] > aCacheSize )
+				{
+					timestamps[v] = time++;
+					++clusterMisses;
+				}
+			}
+
+			// Soft boundary?
+			float const acmr = float(clusterMisses) / float(tri+1-clusterStart);
+			if( acmr < aThreshold )
+				clusterStart = tri+1;
+		}
+
+		return ret;
+	}
+}
+
+namespace
+{
+	std::size_t simulate_fetch_( std::vector<std::uint32_t> const& aIndices, std::size_t aStride, std::size_t aLineSize, std::size_t aCacheSize )
+	{
+		// Direct-mapped cache; each slot holds the address of a line (+1,
+		// so that zero marks an empty slot).
+		std::vector<std::size_t> lines( std::max<std::size_t>( 1, aCacheSize / aLineSize ), 0 );
+
+		std::size_t fetched = 0;
+		for( auto const index : aIndices )
+		{
+			std::size_t const begin = std::size_t(index) * aStride;
+			std::size_t const end = begin + aStride;
+
+			// An attribute may straddle two cache lines
+			for( std::size_t line = begin / aLineSize; line*aLineSize < end; ++line )
+			{
+				auto& slot = lines[line % lines.size()];
+				if( slot != line+1 )
+				{
+					slot = line+1;
+					fetched += aLineSize;
+				}
+			}
+		}
+
+		return fetched;
+	}
+}
+
+namespace
+{
+	void rasterize_( OverdrawStats& aStats, IndexedMesh const& aMesh, glm::vec3 const& aViewDir, std::size_t aResolution, std::vector<float>& aDepth )
+	{
+		// Orthonormal basis for an orthographic camera looking along aViewDir
+		glm::vec3 const helper = std::abs( aViewDir.y ) < 0.99f ? glm::vec3( 0.f, 1.f, 0.f ) : glm::vec3( 1.f, 0.f, 0.f );
+		glm::vec3 const right = glm::normalize( glm::cross( helper, aViewDir ) );
+		glm::vec3 const up = glm::cross( right, aViewDir );
+
+		// Fit the projected bounding box to the viewport
+		glm::vec2 lo( std::numeric_limits<float>::max() );
+		glm::vec2 hi( -std::numeric_limits<float>::max() );
+		for( auto const& p : aMesh.vert )
+		{
+			glm::vec2 const q( glm::dot( p, right ), glm::dot( p, up ) );
+			lo = glm::min( lo, q );
+			hi = glm::max( hi, q );
+		}
+
+		float const extent = std::max( hi.x - lo.x, hi.y - lo.y );
+		if( !(extent > 0.f) )
+			return;
+
+		float const scale = float(aResolution) / extent;
+
+		aDepth.assign( aResolution*aResolution, std::numeric_limits<float>::max() );
+
+		int const res = int(aResolution);
+		auto const& indices = aMesh.indices;
+		for( std::size_t i = 0; i+2 < indices.size(); i += 3 )
+		{
+			glm::vec3 s[3];
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const& p = aMesh.vert[indices[i+j]];
+				s[j].x = (glm::dot( p, right ) - lo.x) * scale;
+				s[j].y = (glm::dot( p, up ) - lo.y) * scale;
+				s[j].z = glm::dot( p, aViewDir );
+			}
+
+			// Back-face culling; front faces are counter-clockwise when
+			// looking along aViewDir. This also drops degenerate triangles.
+			float const area = (s[1].x-s[0].x)*(s[2].y-s[0].y) - (s[2].x-s[0].x)*(s[1].y-s[0].y);
+			if( area <= 0.f )
+				continue;
+
+			int const x0 = std::max( 0, int(std::floor( std::min( { s[0].x, s[1].x, s[2].x } ) )) );
+			int const y0 = std::max( 0, int(std::floor( std::min( { s[0].y, s[1].y, s[2].y } ) )) );
+			int const x1 = std::min( res-1, int(std::ceil( std::max( { s[0].x, s[1].x, s[2].x } ) )) );
+			int const y1 = std::min( res-1, int(std::ceil( std::max( { s[0].y, s[1].y, s[2].y } ) )) );
+
+			float const invArea = 1.f / area;
+			for( int y = y0; y <= y1; ++y )
+			{
+				for( int x = x0; x <= x1; ++x )
+				{
+					float const px = float(x) + 0.5f, py = float(y) + 0.5f;
+
+					float const w0 = (s[2].x-s[1].x)*(py-s[1].y) - (s[2].y-s[1].y)*(px-s[1].x);
+					float const w1 = (s[0].x-s[2].x)*(py-s[2].y) - (s[0].y-s[2].y)*(px-s[2].x);
+					float const w2 = (s[1].x-s[0].x)*(py-s[0].y) - (s[1].y-s[0].y)*(px-s[0].x);
+
+					if( w0 < 0.f || w1 < 0.f || w2 < 0.f )
+						continue;
+
+					float const z = (w0*s[0].z + w1*s[1].z + w2*s[2].z) * invArea;
+
+					float& d = aDepth[std::size_t(y)*aResolution + std::size_t(x)];
+					if( z < d )
+					{
+						if( std::numeric_limits<float>::max() == d )
+							++aStats.covered;
+
+						d = z;
+						++aStats.shaded;
+					}
+				}
+			}
+		}
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,149 @@
+#ifndef OPTIMIZE_MESH_HPP_E1E212D7_0B45_4683_88A1_C28CA03F5819
+#define OPTIMIZE_MESH_HPP_E1E212D7_0B45_4683_88A1_C28CA03F5819
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "index_mesh.hpp"
+
+//--    constants                               ///{{{1///////////////////////
+
+/* Size of the simulated post-transform vertex cache (FIFO). Real hardware
+ * differs between vendors and generations; 16 entries is a conservative
+ * choice that also works well for GPUs with larger caches.
+ */
+constexpr std::size_t kVertexCacheSize = 16;
+
+/* Resolution (in pixels along each side) of the software rasterizer used to
+ * estimate overdraw.
+ */
+constexpr std::size_t kOverdrawResolution = 256;
+
+/* Parameters of the simulated memory cache used to estimate vertex fetch
+ * efficiency. These roughly correspond to the L1/texture cache that serves
+ * vertex attribute fetches on desktop GPUs.
+ */
+constexpr std::size_t kVertexFetchLineSize = 64;
+constexpr std::size_t kVertexFetchCacheSize = 16*1024;
+
+//--    types                                   ///{{{1///////////////////////
+struct VertexCacheStats
+{
+	std::size_t triangles = 0;
+	std::size_t vertices = 0;
+	std::size_t misses = 0;
+
+	// Average cache miss ratio: transformed vertices per triangle. 0.5 is
+	// the theoretical optimum for large regular meshes, 3 the worst case.
+	float acmr() const;
+
+	// Average transform to vertex ratio: transformed vertices per unique
+	// vertex. 1 is optimal.
+	float atvr() const;
+
+	VertexCacheStats& operator+= ( VertexCacheStats const& );
+};
+
+struct OverdrawStats
+{
+	std::size_t covered = 0; // pixels covered by at least one fragment
+	std::size_t shaded = 0;  // fragments that passed the depth test
+
+	// Shaded fragments per covered pixel. 1 is optimal.
+	float overdraw() const;
+
+	OverdrawStats& operator+= ( OverdrawStats const& );
+};
+
+struct VertexFetchStats
+{
+	std::size_t bytesFetched = 0; // bytes transferred in whole cache lines
+	std::size_t bytesUsed = 0;    // size of the vertex data itself
+
+	// Fetched bytes per byte of vertex data. 1 is optimal; values above one
+	// indicate that cache lines are fetched more than once.
+	float overfetch() const;
+
+	VertexFetchStats& operator+= ( VertexFetchStats const& );
+};
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Simulate a FIFO post-transform cache with aCacheSize entries.
+ */
+VertexCacheStats analyze_vertex_cache(
+	std::vector<std::uint32_t> const& aIndices,
+	std::size_t aVertexCount,
+	std::size_t aCacheSize = kVertexCacheSize
+);
+
+/* Reorder the triangles of aMesh for post-transform cache locality. This
+ * uses the "Tipsify" algorithm from Sander et al., "Fast Triangle Reordering
+ * for Vertex Locality and Reduced Overdraw" (SIGGRAPH 2007), which runs in
+ * linear time. Only the order of the triangles changes; vertex data and the
+ * winding of each triangle are kept. Each level of detail in aMesh.lods is
+ * reordered on its own.
+ *
+ * If aClusters is non-null, it receives the index of the first triangle of
+ * each run that starts after a jump to a new region of the mesh. These are
+ * the points where the cache is effectively flushed, and therefore natural
+ * cluster boundaries for optimize_overdraw().
+ */
+void optimize_vertex_cache(
+	IndexedMesh&,
+	std::size_t aCacheSize = kVertexCacheSize,
+	std::vector<std::uint32_t>* aClusters = nullptr
+);
+
+/* Estimate overdraw by rendering aMesh with depth testing and back-face
+ * culling from a fixed set of orthographic view directions.
+ */
+OverdrawStats analyze_overdraw(
+	IndexedMesh const&,
+	std::size_t aResolution = kOverdrawResolution
+);
+
+/* Reorder the clusters of an already cache-optimized mesh to reduce overdraw
+ * (linear clustering and view-independent sorting from Sander et al.).
+ *
+ * aClusters are the boundaries reported by optimize_vertex_cache(). Clusters
+ * are split further at points where their own ACMR drops below aThreshold,
+ * so a higher threshold gives more, smaller clusters (less overdraw, more
+ * cache misses). A threshold of zero keeps only the hard boundaries.
+ * Clusters are then sorted so that outward-facing clusters far from the
+ * mesh's centroid, which are likely to occlude others, are drawn first.
+ */
+void optimize_overdraw(
+	IndexedMesh&,
+	std::vector<std::uint32_t> const& aClusters,
+	float aThreshold,
+	std::size_t aCacheSize = kVertexCacheSize
+);
+
+/* Simulate vertex attribute fetches through a direct-mapped cache, for each
+ * of the separate position, normal, texture coordinate and (if present)
+ * tangent streams.
+ */
+VertexFetchStats analyze_vertex_fetch(
+	IndexedMesh const&,
+	std::size_t aLineSize = kVertexFetchLineSize,
+	std::size_t aCacheSize = kVertexFetchCacheSize
+);
+
+/* Reorder the vertices of aMesh into the order in which they are first
+ * referenced by the index buffer, so that vertex fetches stream through
+ * memory. All attribute streams are permuted together and the indices are
+ * remapped; the triangle order is unchanged. Unreferenced vertices are
+ * dropped. This should therefore run after any triangle reordering.
+ *
+ * The order is determined by the full-resolution indices. The indices of
+ * the levels of detail are remapped accordingly.
+ */
+void optimize_vertex_fetch( IndexedMesh& );
+
+#endif // OPTIMIZE_MESH_HPP_E1E212D7_0B45_4683_88A1_C28CA03F5819
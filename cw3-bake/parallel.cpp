@@ -0,0 +1,72 @@
+#include "parallel.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <exception>
+
+//--    default_job_count()             ///{{{2///////////////////////////////
+std::size_t default_job_count()
+{
+	auto const hw = std::thread::hardware_concurrency();
+	return hw ? std::size_t(hw) : 1;
+}
+
+//--    parallel_for()                  ///{{{2///////////////////////////////
+void parallel_for( std::size_t aCount, std::size_t aJobs, std::function<void(std::size_t)> const& aBody )
+{
+	std::size_t const workers = std::min( aJobs, aCount );
+	if( workers <= 1 )
+	{
+		for( std::size_t i = 0; i < aCount; ++i )
+			aBody( i );
+
+		return;
+	}
+
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<bool> failed{ false };
+
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	auto const worker_ = [&] {
+		while( !failed.load( std::memory_order_relaxed ) )
+		{
+			std::size_t const item = next.fetch_add( 1, std::memory_order_relaxed );
+			if( item >= aCount )
+				break;
+
+			try
+			{
+				aBody( item );
+			}
+			catch( ... )
+			{
+				std::lock_guard<std::mutex> lock( errorMutex );
+				if( !error )
+					error = std::current_exception();
+
+				failed = true;
+			}
+		}
+	};
+
+	// The calling thread acts as one of the workers.
+	std::vector<std::thread> threads;
+	threads.reserve( workers-1 );
+	for( std::size_t i = 1; i < workers; ++i )
+		threads.emplace_back( worker_ );
+
+	worker_();
+
+	for( auto& thread : threads )
+		thread.join();
+
+	if( error )
+		std::rethrow_exception( error );
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
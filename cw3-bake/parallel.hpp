@@ -0,0 +1,35 @@
+#ifndef PARALLEL_HPP_50A15CE8_5079_4ACC_934C_016F830966C7
+#define PARALLEL_HPP_50A15CE8_5079_4ACC_934C_016F830966C7
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <functional>
+
+#include <cstddef>
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Number of worker threads used when none are requested explicitly. This is
+ * the number of hardware threads reported by the system (at least one).
+ */
+std::size_t default_job_count();
+
+/* Call aBody(i) for each i in [0, aCount) using up to aJobs threads.
+ *
+ * Items are handed out one at a time to whichever worker is free, so the
+ * order in which they are processed is unspecified. Callers that need
+ * deterministic output should write results into per-item slots and consume
+ * them in order afterwards.
+ *
+ * With aJobs <= 1 (or a single item), everything runs on the calling thread.
+ * If any invocation throws, the remaining items are skipped and the first
+ * exception is rethrown on the calling thread once all workers have finished.
+ */
+void parallel_for(
+	std::size_t aCount,
+	std::size_t aJobs,
+	std::function<void(std::size_t)> const& aBody
+);
+
+#endif // PARALLEL_HPP_50A15CE8_5079_4ACC_934C_016F830966C7
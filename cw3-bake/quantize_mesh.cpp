@@ -0,0 +1,263 @@
+#include "quantize_mesh.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+namespace
+{
+	constexpr float kUnorm16Max_ = 65535.f;
+
+	glm::i16vec2 encode_octahedral_( glm::vec3 );
+	glm::vec3 decode_octahedral_( glm::i16vec2 );
+
+	glm::i16vec4 encode_tangent_( glm::vec4 );
+	glm::vec4 decode_tangent_( glm::i16vec4 );
+
+	glm::i16vec4 encode_qtangent_( glm::vec3 aNormal, glm::vec4 aTangent );
+	void decode_qtangent_( glm::i16vec4, glm::vec3& aNormal, glm::vec4& aTangent );
+
+	float degrees_between_( glm::vec3, glm::vec3 );
+}
+
+//--    quantize_mesh()                 ///{{{2///////////////////////////////
+QuantizedMesh quantize_mesh( IndexedMesh const& aMesh, TangentFrameEncoding aFrames )
+{
+	std::size_t const vertexCount = aMesh.vert.size();
+	assert( vertexCount == aMesh.norm.size() && vertexCount == aMesh.text.size() );
+	assert( vertexCount == aMesh.tang.size() );
+
+	bool const qtangents = TangentFrameEncoding::qtangent == aFrames;
+
+	QuantizedMesh ret;
+	ret.frames = aFrames;
+
+	// Use the AABB computed during indexing. Merged vertices may be averaged
+	// positions; these always lie within the original bounds.
+	glm::vec3 bmin = aMesh.aabbMin, bmax = aMesh.aabbMax;
+	if( 0 == vertexCount )
+		bmin = bmax = glm::vec3( 0.f );
+
+	glm::vec3 const extent = glm::max( bmax - bmin, glm::vec3( 0.f ) );
+
+	ret.positionMin = bmin;
+	ret.positionScale = extent / kUnorm16Max_;
+
+	// Degenerate axes (e.g., flat meshes) are encoded as zero
+	glm::vec3 const invExtent(
+		extent.x > 0.f ? 1.f / extent.x : 0.f,
+		extent.y > 0.f ? 1.f / extent.y : 0.f,
+		extent.z > 0.f ? 1.f / extent.z : 0.f
+	);
+
+	ret.vert.resize( vertexCount );
+	ret.norm.resize( qtangents ? 0 : vertexCount );
+	ret.tang.resize( vertexCount );
+	ret.text.resize( vertexCount );
+
+	for( std::size_t i = 0; i < vertexCount; ++i )
+	{
+		glm::vec3 const rel = (aMesh.vert[i] - bmin) * invExtent;
+		ret.vert[i] = glm::u16vec4(
+			glm::packUnorm1x16( rel.x ),
+			glm::packUnorm1x16( rel.y ),
+			glm::packUnorm1x16( rel.z ),
+			0
+		);
+
+		if( qtangents )
+		{
+			ret.tang[i] = encode_qtangent_( aMesh.norm[i], aMesh.tang[i] );
+		}
+		else
+		{
+			ret.norm[i] = encode_octahedral_( aMesh.norm[i] );
+			ret.tang[i] = encode_tangent_( aMesh.tang[i] );
+		}
+
+		ret.text[i] = glm::u16vec2(
+			glm::packHalf1x16( aMesh.text[i].x ),
+			glm::packHalf1x16( aMesh.text[i].y )
+		);
+	}
+
+	return ret;
+}
+
+//--    measure_quantization_error()    ///{{{2///////////////////////////////
+void measure_quantization_error( QuantizationError& aError, IndexedMesh const& aMesh, QuantizedMesh const& aQuantized )
+{
+	std::size_t const vertexCount = aMesh.vert.size();
+	assert( vertexCount == aQuantized.vert.size() );
+
+	for( std::size_t i = 0; i < vertexCount; ++i )
+	{
+		auto const& q = aQuantized.vert[i];
+		glm::vec3 const pos = aQuantized.positionMin + aQuantized.positionScale * glm::vec3( q.x, q.y, q.z );
+
+		glm::vec3 const dp = glm::abs( pos - aMesh.vert[i] );
+		aError.maxPosition = std::max( aError.maxPosition, std::max( dp.x, std::max( dp.y, dp.z ) ) );
+
+		glm::vec3 normal;
+		glm::vec4 tangent;
+		if( TangentFrameEncoding::qtangent == aQuantized.frames )
+		{
+			decode_qtangent_( aQuantized.tang[i], normal, tangent );
+		}
+		else
+		{
+			normal = decode_octahedral_( aQuantized.norm[i] );
+			tangent = decode_tangent_( aQuantized.tang[i] );
+		}
+
+		if( glm::length( aMesh.norm[i] ) > 0.f )
+			aError.maxNormalDegrees = std::max( aError.maxNormalDegrees, degrees_between_( normal, aMesh.norm[i] ) );
+
+		if( i < aMesh.tang.size() )
+		{
+			float const degrees = (tangent.w < 0.f) != (aMesh.tang[i].w < 0.f)
+				? 180.f
+				: degrees_between_( glm::vec3( tangent ), glm::vec3( aMesh.tang[i] ) )
+				;
+			aError.maxTangentDegrees = std::max( aError.maxTangentDegrees, degrees );
+		}
+
+		glm::vec2 const tex( glm::unpackHalf1x16( aQuantized.text[i].x ), glm::unpackHalf1x16( aQuantized.text[i].y ) );
+		glm::vec2 const dt = glm::abs( tex - aMesh.text[i] );
+		aError.maxTexCoord = std::max( aError.maxTexCoord, std::max( dt.x, dt.y ) );
+	}
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	// See Cigolle et al., "A Survey of Efficient Representations for
+	// Independent Unit Vectors" (JCGT 2014). The decoder must match the one
+	// in cw3/shaders/bright.vert.
+	glm::i16vec2 encode_octahedral_( glm::vec3 aNormal )
+	{
+		float const l1 = std::abs( aNormal.x ) + std::abs( aNormal.y ) + std::abs( aNormal.z );
+		if( !(l1 > 0.f) )
+			return glm::i16vec2( 0, 0 ); // decodes to +Z
+
+		glm::vec2 p = glm::vec2( aNormal.x, aNormal.y ) / l1;
+		if( aNormal.z < 0.f )
+		{
+			glm::vec2 const sign( p.x >= 0.f ? 1.f : -1.f, p.y >= 0.f ? 1.f : -1.f );
+			p = (1.f - glm::abs( glm::vec2( p.y, p.x ) )) * sign;
+		}
+
+		return glm::i16vec2(
+			std::int16_t(glm::packSnorm1x16( p.x )),
+			std::int16_t(glm::packSnorm1x16( p.y ))
+		);
+	}
+
+	glm::vec3 decode_octahedral_( glm::i16vec2 aEncoded )
+	{
+		glm::vec2 const e(
+			glm::unpackSnorm1x16( std::uint16_t(aEncoded.x) ),
+			glm::unpackSnorm1x16( std::uint16_t(aEncoded.y) )
+		);
+
+		glm::vec3 n( e.x, e.y, 1.f - std::abs( e.x ) - std::abs( e.y ) );
+		float const t = std::max( -n.z, 0.f );
+		n.x += n.x >= 0.f ? -t : t;
+		n.y += n.y >= 0.f ? -t : t;
+
+		return glm::normalize( n );
+	}
+
+	glm::i16vec4 encode_tangent_( glm::vec4 aTangent )
+	{
+		glm::vec3 t( aTangent );
+		float const len = glm::length( t );
+		t = len > 0.f ? t / len : glm::vec3( 1.f, 0.f, 0.f );
+
+		return glm::i16vec4(
+			std::int16_t(glm::packSnorm1x16( t.x )),
+			std::int16_t(glm::packSnorm1x16( t.y )),
+			std::int16_t(glm::packSnorm1x16( t.z )),
+			std::int16_t(glm::packSnorm1x16( aTangent.w < 0.f ? -1.f : 1.f ))
+		);
+	}
+
+	glm::vec4 decode_tangent_( glm::i16vec4 aEncoded )
+	{
+		glm::vec3 const t(
+			glm::unpackSnorm1x16( std::uint16_t(aEncoded.x) ),
+			glm::unpackSnorm1x16( std::uint16_t(aEncoded.y) ),
+			glm::unpackSnorm1x16( std::uint16_t(aEncoded.z) )
+		);
+
+		return glm::vec4( glm::normalize( t ), aEncoded.w < 0 ? -1.f : 1.f );
+	}
+
+	// The decoder must match the one in cw3/shaders/bright.vert, and the
+	// encoder the one in cw3/baked_model.cpp.
+	glm::i16vec4 encode_qtangent_( glm::vec3 aNormal, glm::vec4 aTangent )
+	{
+		float const len = glm::length( aNormal );
+		glm::vec3 const n = len > 0.f ? aNormal / len : glm::vec3( 0.f, 0.f, 1.f );
+
+		// Re-orthogonalize; the tangent may be slightly off after averaging
+		glm::vec3 t = glm::vec3( aTangent ) - n * glm::dot( n, glm::vec3( aTangent ) );
+		if( !(glm::length( t ) > 1e-6f) )
+			t = std::abs( n.x ) < 0.9f ? glm::vec3( 1.f, 0.f, 0.f ) - n * n.x : glm::vec3( 0.f, 1.f, 0.f ) - n * n.y;
+		t = glm::normalize( t );
+
+		// Columns (t, n x t, n) form a rotation
+		glm::mat3 const frame( t, glm::cross( n, t ), n );
+		glm::quat q = glm::normalize( glm::quat_cast( frame ) );
+
+		if( q.w < 0.f )
+			q = -q;
+
+		constexpr float bias = 1.f / 32767.f; // smallest positive snorm16
+		if( q.w < bias )
+		{
+			float const scale = std::sqrt( 1.f - bias*bias );
+			q.x *= scale;
+			q.y *= scale;
+			q.z *= scale;
+			q.w = bias;
+		}
+
+		if( aTangent.w < 0.f )
+			q = -q;
+
+		return glm::i16vec4(
+			std::int16_t(glm::packSnorm1x16( q.x )),
+			std::int16_t(glm::packSnorm1x16( q.y )),
+			std::int16_t(glm::packSnorm1x16( q.z )),
+			std::int16_t(glm::packSnorm1x16( q.w ))
+		);
+	}
+
+	void decode_qtangent_( glm::i16vec4 aEncoded, glm::vec3& aNormal, glm::vec4& aTangent )
+	{
+		glm::quat q;
+		q.x = glm::unpackSnorm1x16( std::uint16_t(aEncoded.x) );
+		q.y = glm::unpackSnorm1x16( std::uint16_t(aEncoded.y) );
+		q.z = glm::unpackSnorm1x16( std::uint16_t(aEncoded.z) );
+		q.w = glm::unpackSnorm1x16( std::uint16_t(aEncoded.w) );
+		q = glm::normalize( q );
+
+		aNormal = q * glm::vec3( 0.f, 0.f, 1.f );
+		aTangent = glm::vec4( q * glm::vec3( 1.f, 0.f, 0.f ), aEncoded.w < 0 ? -1.f : 1.f );
+	}
+
+	float degrees_between_( glm::vec3 aX, glm::vec3 aY )
+	{
+		float const cosine = glm::dot( glm::normalize( aX ), glm::normalize( aY ) );
+		return glm::degrees( std::acos( glm::clamp( cosine, -1.f, 1.f ) ) );
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
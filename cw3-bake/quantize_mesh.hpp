@@ -0,0 +1,88 @@
+#ifndef QUANTIZE_MESH_HPP_6B336947_AE8C_4BA9_BCA9_80C4DB6F08D5
+#define QUANTIZE_MESH_HPP_6B336947_AE8C_4BA9_BCA9_80C4DB6F08D5
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <vector>
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/ext/vector_int2_sized.hpp>
+#include <glm/ext/vector_uint2_sized.hpp>
+#include <glm/ext/vector_int4_sized.hpp>
+#include <glm/ext/vector_uint4_sized.hpp>
+
+#include "index_mesh.hpp"
+
+//--    types                                   ///{{{1///////////////////////
+
+/* Encoding of the tangent frame (normal, tangent and handedness). The values
+ * are stored in the baked file.
+ *
+ * QTangents (Frey & Herzeg, "Spherical Skinning with Dual-Quaternions and
+ * QTangents", SIGGRAPH 2011 talk) store the whole frame as a unit quaternion
+ * that rotates the +X/+Z axes onto the tangent/normal. q and -q represent the
+ * same rotation, so the sign of w is free to hold the handedness; w is kept
+ * away from zero so that this sign survives quantization.
+ */
+enum class TangentFrameEncoding : std::uint32_t
+{
+	normalTangent = 1, // octahedral normal + tangent (snorm xyz, w = +-1)
+	qtangent = 2       // QTangent only (snorm xyzw)
+};
+
+/* Compact vertex data (24 or 20 bytes per vertex instead of 48):
+ *  - position: 4*uint16_t, xyz normalized to the mesh's AABB; w is padding
+ *    (three-component 16-bit formats are rarely supported for vertex input)
+ *  - normal: 2*int16_t, octahedral encoding, signed normalized
+ *  - tangent: 4*int16_t, signed normalized; xyz = direction, w = handedness
+ *  - texture coordinate: 2*uint16_t, IEEE half floats
+ *
+ * With TangentFrameEncoding::qtangent, norm is empty, and tang holds the
+ * QTangents instead.
+ *
+ * Positions are reconstructed as positionMin + positionScale * q, with q the
+ * raw 16-bit integers (0..65535); the runtime reads them as UINT, not UNORM.
+ */
+struct QuantizedMesh
+{
+	glm::vec3 positionMin;
+	glm::vec3 positionScale;
+
+	TangentFrameEncoding frames;
+
+	std::vector<glm::u16vec4> vert;
+	std::vector<glm::i16vec2> norm;
+	std::vector<glm::i16vec4> tang;
+	std::vector<glm::u16vec2> text;
+};
+
+struct QuantizationError
+{
+	float maxPosition = 0.f; // absolute, in model units
+	float maxNormalDegrees = 0.f;
+	float maxTangentDegrees = 0.f; // 180 if the handedness flips
+	float maxTexCoord = 0.f;
+};
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Requires tangents (see tangent_space.hpp).
+ */
+QuantizedMesh quantize_mesh(
+	IndexedMesh const&,
+	TangentFrameEncoding = TangentFrameEncoding::normalTangent
+);
+
+/* Decode aQuantized and compare against aMesh. Accumulates the maximum errors
+ * into aError.
+ */
+void measure_quantization_error(
+	QuantizationError& aError,
+	IndexedMesh const& aMesh,
+	QuantizedMesh const& aQuantized
+);
+
+#endif // QUANTIZE_MESH_HPP_6B336947_AE8C_4BA9_BCA9_80C4DB6F08D5
@@ -0,0 +1,695 @@
+#include "simplify_mesh.hpp"
+
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	/* Weight of the planes that keep open borders and attribute seams in
+	 * place, relative to the (area-weighted) planes of the triangles.
+	 */
+	constexpr double kBorderWeight_ = 10.0;
+	constexpr double kSeamWeight_ = 1.0;
+
+	constexpr std::uint32_t kNone_ = ~std::uint32_t(0);
+
+	/* Minimum reduction of the triangle count for a level of detail to be
+	 * kept; see generate_lods().
+	 */
+	constexpr float kLodMinReduction_ = 0.75f;
+
+	enum class VertexKind_ : std::uint8_t
+	{
+		manifold, // interior vertex; may collapse onto any neighbour
+		border,   // on exactly one open border; collapses along it only
+		seam,     // two vertices on an attribute seam; collapse along it
+		locked    // anything else (corners, non-manifold); never moves
+	};
+
+	struct Quadric_
+	{
+		// p^T A p + 2 b.p + c, with the symmetric matrix A stored as its
+		// upper triangle. The sum of the plane weights is used to turn
+		// this into an average squared distance.
+		double a00 = 0., a01 = 0., a02 = 0., a11 = 0., a12 = 0., a22 = 0.;
+		double b0 = 0., b1 = 0., b2 = 0.;
+		double c = 0.;
+		double weight = 0.;
+
+		Quadric_& operator+= ( Quadric_ const& );
+	};
+
+	// Connectivity in terms of positions (see position_remap_()), so that
+	// the vertices of an attribute seam are treated as one. Kinds and
+	// borders are per position. The open edges of the individual vertices
+	// describe the attribute seams.
+	struct Topology_
+	{
+		std::vector<VertexKind_> kinds;
+		std::vector<std::uint32_t> borderNext, borderPrev;
+		std::unordered_map<std::uint64_t,std::uint32_t> halfEdges;
+
+		std::vector<std::uint32_t> openNext, openPrev;
+		std::unordered_map<std::uint64_t,std::uint32_t> vertexEdges;
+
+		bool has_half_edge( std::uint32_t aFrom, std::uint32_t aTo ) const;
+		bool has_vertex_edge( std::uint32_t aFrom, std::uint32_t aTo ) const;
+	};
+
+	struct Adjacency_
+	{
+		std::vector<std::uint32_t> offsets; // V+1 entries
+		std::vector<std::uint32_t> triangles;
+	};
+
+	struct Collapse_
+	{
+		std::uint32_t from, to;
+		double error;
+	};
+
+	void add_plane_( Quadric_&, glm::dvec3 const& aNormal, double aOffset, double aWeight );
+	double evaluate_( Quadric_ const&, glm::vec3 const& );
+
+	std::vector<std::uint32_t> position_remap_( IndexedMesh const& );
+
+	std::vector<std::uint32_t> seam_siblings_(
+		std::vector<std::uint32_t> const& aRemap,
+		std::vector<std::uint32_t> const& aWedgeCounts
+	);
+
+	Topology_ classify_(
+		std::vector<std::uint32_t> const& aIndices,
+		std::vector<std::uint32_t> const& aRemap,
+		std::vector<std::uint32_t> const& aWedgeCounts,
+		std::vector<std::uint32_t> const& aSiblings
+	);
+
+	Adjacency_ build_adjacency_(
+		std::vector<std::uint32_t> const&,
+		std::size_t aVertexCount
+	);
+
+	bool can_collapse_(
+		Topology_ const&,
+		std::vector<std::uint32_t> const& aRemap,
+		std::vector<std::uint32_t> const& aSiblings,
+		std::uint32_t aFrom,
+		std::uint32_t aTo
+	);
+
+	std::uint32_t seam_target_(
+		Topology_ const&,
+		std::vector<std::uint32_t> const& aRemap,
+		std::vector<std::uint32_t> const& aSiblings,
+		std::uint32_t aFrom,
+		std::uint32_t aTo
+	);
+
+	bool has_flips_(
+		IndexedMesh const&,
+		std::vector<std::uint32_t> const& aIndices,
+		Adjacency_ const&,
+		std::vector<std::uint32_t> const& aRemap,
+		std::vector<std::uint32_t> const& aCollapseRemap,
+		std::uint32_t aFrom,
+		std::uint32_t aTo
+	);
+}
+
+//--    simplify_mesh()                 ///{{{2///////////////////////////////
+std::vector<std::uint32_t> simplify_mesh( IndexedMesh const& aMesh, std::size_t aTargetIndexCount, float aTargetError, float* aResultError )
+{
+	std::size_t const vertexCount = aMesh.vert.size();
+
+	// remap[v] is the first vertex with the same position as v
+	auto const remap = position_remap_( aMesh );
+
+	std::vector<std::uint32_t> wedges( vertexCount, 0 );
+	for( std::size_t v = 0; v < vertexCount; ++v )
+		++wedges[remap[v]];
+
+	auto const siblings = seam_siblings_( remap, wedges );
+
+	// Triangles with two corners at the same position cover no area
+	std::vector<std::uint32_t> indices;
+	indices.reserve( aMesh.indices.size() );
+
+	for( std::size_t i = 0; i+2 < aMesh.indices.size(); i += 3 )
+	{
+		auto const a = aMesh.indices[i+0], b = aMesh.indices[i+1], c = aMesh.indices[i+2];
+		if( remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a] )
+			continue;
+
+		indices.insert( indices.end(), { a, b, c } );
+	}
+
+	// Initial quadrics (per position): planes of the adjacent triangles,
+	// plus planes perpendicular to the triangles along open borders and
+	// attribute seams.
+	std::vector<Quadric_> quadrics( vertexCount );
+	{
+		auto const topology = classify_( indices, remap, wedges, siblings );
+
+		for( std::size_t i = 0; i < indices.size(); i += 3 )
+		{
+			glm::dvec3 const p[3] = {
+				glm::dvec3( aMesh.vert[indices[i+0]] ),
+				glm::dvec3( aMesh.vert[indices[i+1]] ),
+				glm::dvec3( aMesh.vert[indices[i+2]] )
+			};
+
+			auto const n = glm::cross( p[1]-p[0], p[2]-p[0] );
+			double const length = glm::length( n );
+			if( !(length > 0.) )
+				continue;
+
+			auto const normal = n / length;
+			for( std::size_t j = 0; j < 3; ++j )
+				add_plane_( quadrics[remap[indices[i+j]]], normal, -glm::dot( normal, p[0] ), 0.5*length );
+
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const va = indices[i+j], vb = indices[i+(j+1)%3];
+				if( topology.has_vertex_edge( vb, va ) )
+					continue;
+
+				// Open in terms of vertices: either an open border, or (if
+				// the positions are connected) an attribute seam.
+				auto const a = remap[va], b = remap[vb];
+				bool const border = !topology.has_half_edge( b, a );
+
+				auto const edge = p[(j+1)%3] - p[j];
+				auto const side = glm::cross( edge, normal );
+				double const sideLength = glm::length( side );
+				if( !(sideLength > 0.) )
+					continue;
+
+				auto const sideNormal = side / sideLength;
+				double const weight = (border ? kBorderWeight_ : kSeamWeight_) * glm::dot( edge, edge );
+
+				add_plane_( quadrics[a], sideNormal, -glm::dot( sideNormal, p[j] ), weight );
+				add_plane_( quadrics[b], sideNormal, -glm::dot( sideNormal, p[j] ), weight );
+			}
+		}
+	}
+
+	// Collapse edges in passes. Each pass ranks all candidate collapses by
+	// their error and performs the cheapest ones, skipping collapses that
+	// involve a vertex which has already been touched during the pass.
+	double const limit = double(aTargetError) * double(aTargetError);
+	double maxError = 0.;
+
+	std::vector<std::uint32_t> collapseRemap( vertexCount );
+	std::vector<bool> touched( vertexCount );
+	std::vector<Collapse_> collapses;
+
+	while( indices.size() > aTargetIndexCount )
+	{
+		auto const topology = classify_( indices, remap, wedges, siblings );
+		auto const adj = build_adjacency_( indices, vertexCount );
+
+		collapses.clear();
+		for( std::size_t i = 0; i < indices.size(); i += 3 )
+		{
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const a = indices[i+j], b = indices[i+(j+1)%3];
+
+				if( can_collapse_( topology, remap, siblings, a, b ) )
+					collapses.emplace_back( Collapse_{ a, b, evaluate_( quadrics[remap[a]], aMesh.vert[b] ) } );
+				if( can_collapse_( topology, remap, siblings, b, a ) )
+					collapses.emplace_back( Collapse_{ b, a, evaluate_( quadrics[remap[b]], aMesh.vert[a] ) } );
+			}
+		}
+
+		std::sort( collapses.begin(), collapses.end(), [] (Collapse_ const& aX, Collapse_ const& aY) {
+			if( aX.error != aY.error )
+				return aX.error < aY.error;
+			if( aX.from != aY.from )
+				return aX.from < aY.from;
+			return aX.to < aY.to;
+		} );
+
+		std::iota( collapseRemap.begin(), collapseRemap.end(), 0 );
+		std::fill( touched.begin(), touched.end(), false );
+
+		// Manifold and seam collapses remove two triangles, border
+		// collapses one
+		std::size_t const goal = (indices.size() - aTargetIndexCount) / 3;
+		std::size_t removed = 0, performed = 0;
+
+		for( auto const& collapse : collapses )
+		{
+			if( removed >= goal || collapse.error > limit )
+				break;
+
+			if( touched[collapse.from] || touched[collapse.to] )
+				continue;
+
+			if( has_flips_( aMesh, indices, adj, remap, collapseRemap, collapse.from, collapse.to ) )
+				continue;
+
+			// The other vertex of a seam moves along with it
+			if( VertexKind_::seam == topology.kinds[remap[collapse.from]] )
+			{
+				auto const from = siblings[collapse.from];
+				auto const to = seam_target_( topology, remap, siblings, collapse.from, collapse.to );
+				assert( kNone_ != to );
+
+				if( touched[from] || touched[to] )
+					continue;
+
+				if( has_flips_( aMesh, indices, adj, remap, collapseRemap, from, to ) )
+					continue;
+
+				collapseRemap[from] = to;
+				touched[from] = touched[to] = true;
+			}
+
+			collapseRemap[collapse.from] = collapse.to;
+			touched[collapse.from] = touched[collapse.to] = true;
+
+			quadrics[remap[collapse.to]] += quadrics[remap[collapse.from]];
+			maxError = std::max( maxError, collapse.error );
+
+			removed += VertexKind_::border == topology.kinds[remap[collapse.from]] ? 1 : 2;
+			++performed;
+		}
+
+		if( 0 == performed )
+			break;
+
+		std::size_t out = 0;
+		for( std::size_t i = 0; i < indices.size(); i += 3 )
+		{
+			auto const a = collapseRemap[indices[i+0]];
+			auto const b = collapseRemap[indices[i+1]];
+			auto const c = collapseRemap[indices[i+2]];
+
+			if( remap[a] == remap[b] || remap[b] == remap[c] || remap[c] == remap[a] )
+				continue;
+
+			indices[out++] = a;
+			indices[out++] = b;
+			indices[out++] = c;
+		}
+
+		indices.resize( out );
+	}
+
+	if( aResultError )
+		*aResultError = float(std::sqrt( maxError ));
+
+	return indices;
+}
+
+//--    generate_lods()                 ///{{{2///////////////////////////////
+void generate_lods( IndexedMesh& aMesh, std::size_t aMaxLevels, float aTargetError )
+{
+	aMesh.lods.clear();
+
+	glm::vec3 const extent = aMesh.aabbMax - aMesh.aabbMin;
+	float const scale = std::max( extent.x, std::max( extent.y, extent.z ) );
+	if( !(scale > 0.f) )
+		return;
+
+	float const targetError = aTargetError * scale;
+
+	// Each level is simplified from the full-resolution mesh, so that its
+	// error is measured against the original surface.
+	std::size_t previousCount = aMesh.indices.size();
+	float previousError = 0.f;
+
+	for( std::size_t level = 1; level < aMaxLevels; ++level )
+	{
+		std::size_t const target = (previousCount / 3 / 2) * 3;
+		if( 0 == target )
+			break;
+
+		float error = 0.f;
+		auto indices = simplify_mesh( aMesh, target, targetError, &error );
+
+		if( indices.empty() || float(indices.size()) > kLodMinReduction_ * float(previousCount) )
+			break;
+
+		// The runtime picks the coarsest level with an acceptable error; the
+		// errors must therefore not decrease from one level to the next.
+		error = std::max( error, previousError );
+
+		previousCount = indices.size();
+		previousError = error;
+
+		aMesh.lods.emplace_back( IndexedMeshLod{ std::move(indices), error } );
+	}
+}
+
+//--    count_open_edges()              ///{{{2///////////////////////////////
+std::size_t count_open_edges( IndexedMesh const& aMesh, std::vector<std::uint32_t> const& aIndices )
+{
+	auto const remap = position_remap_( aMesh );
+
+	std::unordered_map<std::uint64_t,std::uint32_t> halfEdges;
+	halfEdges.reserve( aIndices.size() );
+
+	for( std::size_t i = 0; i+2 < aIndices.size(); i += 3 )
+	{
+		for( std::size_t j = 0; j < 3; ++j )
+		{
+			auto const a = remap[aIndices[i+j]], b = remap[aIndices[i+(j+1)%3]];
+			if( a != b )
+				++halfEdges[(std::uint64_t(a) << 32) | b];
+		}
+	}
+
+	std::size_t ret = 0;
+	for( auto const& edge : halfEdges )
+	{
+		auto const a = std::uint32_t(edge.first >> 32);
+		auto const b = std::uint32_t(edge.first & 0xffffffffu);
+		if( 0 == halfEdges.count( (std::uint64_t(b) << 32) | a ) )
+			ret += edge.second;
+	}
+
+	return ret;
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	Quadric_& Quadric_::operator+= ( Quadric_ const& aOther )
+	{
+		a00 += aOther.a00; a01 += aOther.a01; a02 += aOther.a02;
+		a11 += aOther.a11; a12 += aOther.a12; a22 += aOther.a22;
+		b0 += aOther.b0; b1 += aOther.b1; b2 += aOther.b2;
+		c += aOther.c;
+		weight += aOther.weight;
+		return *this;
+	}
+
+	void add_plane_( Quadric_& aQuadric, glm::dvec3 const& aNormal, double aOffset, double aWeight )
+	{
+		auto const& n = aNormal;
+		double const d = aOffset, w = aWeight;
+
+		aQuadric.a00 += w * n.x * n.x;
+		aQuadric.a01 += w * n.x * n.y;
+		aQuadric.a02 += w * n.x * n.z;
+		aQuadric.a11 += w * n.y * n.y;
+		aQuadric.a12 += w * n.y * n.z;
+		aQuadric.a22 += w * n.z * n.z;
+
+		aQuadric.b0 += w * n.x * d;
+		aQuadric.b1 += w * n.y * d;
+		aQuadric.b2 += w * n.z * d;
+
+		aQuadric.c += w * d * d;
+		aQuadric.weight += w;
+	}
+
+	double evaluate_( Quadric_ const& aQuadric, glm::vec3 const& aPoint )
+	{
+		if( !(aQuadric.weight > 0.) )
+			return 0.;
+
+		double const x = aPoint.x, y = aPoint.y, z = aPoint.z;
+		auto const& q = aQuadric;
+
+		double const r = q.a00*x*x + q.a11*y*y + q.a22*z*z
+			+ 2.*(q.a01*x*y + q.a02*x*z + q.a12*y*z)
+			+ 2.*(q.b0*x + q.b1*y + q.b2*z)
+			+ q.c
+		;
+
+		// Rounding can make r slightly negative
+		return std::max( r, 0. ) / q.weight;
+	}
+
+	std::vector<std::uint32_t> position_remap_( IndexedMesh const& aMesh )
+	{
+		std::size_t const vertexCount = aMesh.vert.size();
+
+		std::vector<std::uint32_t> order( vertexCount );
+		std::iota( order.begin(), order.end(), 0 );
+
+		auto const less_ = [&] (std::uint32_t aX, std::uint32_t aY) {
+			auto const& x = aMesh.vert[aX];
+			auto const& y = aMesh.vert[aY];
+			if( x.x != y.x ) return x.x < y.x;
+			if( x.y != y.y ) return x.y < y.y;
+			if( x.z != y.z ) return x.z < y.z;
+			return aX < aY;
+		};
+		std::sort( order.begin(), order.end(), less_ );
+
+		std::vector<std::uint32_t> ret( vertexCount );
+		for( std::size_t i = 0; i < vertexCount; )
+		{
+			std::size_t j = i;
+			while( j < vertexCount && aMesh.vert[order[j]] == aMesh.vert[order[i]] )
+				ret[order[j++]] = order[i];
+
+			i = j;
+		}
+
+		return ret;
+	}
+
+	bool Topology_::has_half_edge( std::uint32_t aFrom, std::uint32_t aTo ) const
+	{
+		return halfEdges.count( (std::uint64_t(aFrom) << 32) | aTo ) > 0;
+	}
+
+	bool Topology_::has_vertex_edge( std::uint32_t aFrom, std::uint32_t aTo ) const
+	{
+		return vertexEdges.count( (std::uint64_t(aFrom) << 32) | aTo ) > 0;
+	}
+
+	std::vector<std::uint32_t> seam_siblings_( std::vector<std::uint32_t> const& aRemap, std::vector<std::uint32_t> const& aWedgeCounts )
+	{
+		// Positions shared by exactly two vertices may be part of a seam;
+		// link the two.
+		std::vector<std::uint32_t> ret( aRemap.size(), kNone_ );
+		for( std::size_t v = 0; v < aRemap.size(); ++v )
+		{
+			auto const first = aRemap[v];
+			if( 2 != aWedgeCounts[first] || first == v )
+				continue;
+
+			ret[v] = first;
+			ret[first] = std::uint32_t(v);
+		}
+
+		return ret;
+	}
+
+	Topology_ classify_( std::vector<std::uint32_t> const& aIndices, std::vector<std::uint32_t> const& aRemap, std::vector<std::uint32_t> const& aWedgeCounts, std::vector<std::uint32_t> const& aSiblings )
+	{
+		std::size_t const vertexCount = aRemap.size();
+
+		Topology_ ret;
+		ret.halfEdges.reserve( aIndices.size() );
+		ret.vertexEdges.reserve( aIndices.size() );
+
+		for( std::size_t i = 0; i < aIndices.size(); i += 3 )
+		{
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				auto const va = aIndices[i+j], vb = aIndices[i+(j+1)%3];
+				++ret.vertexEdges[(std::uint64_t(va) << 32) | vb];
+
+				auto const a = aRemap[va], b = aRemap[vb];
+				++ret.halfEdges[(std::uint64_t(a) << 32) | b];
+			}
+		}
+
+		// Open borders and non-manifold edges, per position
+		std::vector<std::uint32_t> borderOut( vertexCount, 0 ), borderIn( vertexCount, 0 );
+		std::vector<bool> nonManifold( vertexCount, false );
+
+		ret.borderNext.assign( vertexCount, kNone_ );
+		ret.borderPrev.assign( vertexCount, kNone_ );
+
+		for( auto const& edge : ret.halfEdges )
+		{
+			auto const a = std::uint32_t(edge.first >> 32);
+			auto const b = std::uint32_t(edge.first & 0xffffffffu);
+
+			if( edge.second > 1 )
+				nonManifold[a] = nonManifold[b] = true;
+
+			if( !ret.has_half_edge( b, a ) )
+			{
+				++borderOut[a];
+				++borderIn[b];
+				ret.borderNext[a] = b;
+				ret.borderPrev[b] = a;
+			}
+		}
+
+		// Open edges per vertex. Where the positions are connected, these
+		// are attribute seams.
+		std::vector<std::uint32_t> openOut( vertexCount, 0 ), openIn( vertexCount, 0 );
+
+		ret.openNext.assign( vertexCount, kNone_ );
+		ret.openPrev.assign( vertexCount, kNone_ );
+
+		for( auto const& edge : ret.vertexEdges )
+		{
+			auto const a = std::uint32_t(edge.first >> 32);
+			auto const b = std::uint32_t(edge.first & 0xffffffffu);
+
+			if( !ret.has_vertex_edge( b, a ) )
+			{
+				++openOut[a];
+				++openIn[b];
+				ret.openNext[a] = b;
+				ret.openPrev[b] = a;
+			}
+		}
+
+		ret.kinds.resize( vertexCount );
+		for( std::size_t v = 0; v < vertexCount; ++v )
+		{
+			if( aRemap[v] != v )
+				continue;
+
+			auto& kind = ret.kinds[v];
+
+			bool const border = 0 != borderOut[v] || 0 != borderIn[v];
+			if( nonManifold[v] )
+				kind = VertexKind_::locked;
+			else if( 1 != aWedgeCounts[v] && kNone_ == aSiblings[v] )
+			{
+				// Three or more vertices at this position, e.g. the corner
+				// of a hard-edged mesh. Moving only some of them would tear
+				// the surface open.
+				kind = VertexKind_::locked;
+			}
+			else if( kNone_ == aSiblings[v] )
+			{
+				// A single vertex at this position
+				if( !border )
+					kind = VertexKind_::manifold;
+				else if( 1 == borderOut[v] && 1 == borderIn[v] )
+					kind = VertexKind_::border;
+				else
+					kind = VertexKind_::locked;
+			}
+			else
+			{
+				// Two vertices: a seam passes through if each has exactly
+				// one open edge in either direction.
+				auto const w = aSiblings[v];
+				if( !border && 1 == openOut[v] && 1 == openIn[v] && 1 == openOut[w] && 1 == openIn[w] )
+					kind = VertexKind_::seam;
+				else
+					kind = VertexKind_::locked;
+			}
+		}
+
+		return ret;
+	}
+
+	Adjacency_ build_adjacency_( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount )
+	{
+		Adjacency_ ret;
+		ret.offsets.assign( aVertexCount+1, 0 );
+
+		for( auto const index : aIndices )
+			++ret.offsets[index+1];
+
+		for( std::size_t v = 0; v < aVertexCount; ++v )
+			ret.offsets[v+1] += ret.offsets[v];
+
+		ret.triangles.resize( aIndices.size() );
+
+		auto fill = ret.offsets;
+		for( std::size_t i = 0; i < aIndices.size(); ++i )
+			ret.triangles[fill[aIndices[i]]++] = std::uint32_t(i/3);
+
+		return ret;
+	}
+
+	bool can_collapse_( Topology_ const& aTopology, std::vector<std::uint32_t> const& aRemap, std::vector<std::uint32_t> const& aSiblings, std::uint32_t aFrom, std::uint32_t aTo )
+	{
+		auto const from = aRemap[aFrom], to = aRemap[aTo];
+
+		switch( aTopology.kinds[from] )
+		{
+			case VertexKind_::manifold:
+				return true;
+			case VertexKind_::border:
+				return to == aTopology.borderNext[from] || to == aTopology.borderPrev[from];
+			case VertexKind_::seam:
+				return kNone_ != seam_target_( aTopology, aRemap, aSiblings, aFrom, aTo );
+			case VertexKind_::locked:
+				return false;
+		}
+
+		return false;
+	}
+
+	std::uint32_t seam_target_( Topology_ const& aTopology, std::vector<std::uint32_t> const& aRemap, std::vector<std::uint32_t> const& aSiblings, std::uint32_t aFrom, std::uint32_t aTo )
+	{
+		// aFrom may only move along its seam. The same seam edge runs in the
+		// opposite direction on the other side, where the sibling of aFrom
+		// moves to the corresponding vertex at aTo's position.
+		auto const sibling = aSiblings[aFrom];
+		assert( kNone_ != sibling );
+
+		std::uint32_t target = kNone_;
+		if( aTo == aTopology.openNext[aFrom] )
+			target = aTopology.openPrev[sibling];
+		else if( aTo == aTopology.openPrev[aFrom] )
+			target = aTopology.openNext[sibling];
+
+		if( kNone_ == target || target == aTo || aRemap[target] != aRemap[aTo] )
+			return kNone_;
+
+		return target;
+	}
+
+	bool has_flips_( IndexedMesh const& aMesh, std::vector<std::uint32_t> const& aIndices, Adjacency_ const& aAdj, std::vector<std::uint32_t> const& aRemap, std::vector<std::uint32_t> const& aCollapseRemap, std::uint32_t aFrom, std::uint32_t aTo )
+	{
+		auto const& target = aMesh.vert[aTo];
+
+		for( auto i = aAdj.offsets[aFrom]; i < aAdj.offsets[aFrom+1]; ++i )
+		{
+			std::size_t const tri = aAdj.triangles[i];
+
+			std::uint32_t corners[3];
+			for( std::size_t j = 0; j < 3; ++j )
+				corners[j] = aCollapseRemap[aIndices[tri*3+j]];
+
+			// Triangles that contain the edge disappear
+			if( aRemap[corners[0]] == aRemap[aTo] || aRemap[corners[1]] == aRemap[aTo] || aRemap[corners[2]] == aRemap[aTo] )
+				continue;
+
+			glm::vec3 before[3], after[3];
+			for( std::size_t j = 0; j < 3; ++j )
+			{
+				before[j] = aMesh.vert[corners[j]];
+				after[j] = corners[j] == aFrom ? target : before[j];
+			}
+
+			auto const n0 = glm::cross( before[1]-before[0], before[2]-before[0] );
+			auto const n1 = glm::cross( after[1]-after[0], after[2]-after[0] );
+
+			if( glm::dot( n0, n1 ) <= 0.f )
+				return true;
+		}
+
+		return false;
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,76 @@
+#ifndef SIMPLIFY_MESH_HPP_0B9C2F6E_5A41_4E7D_9E0B_7D3C15A8F2E4
+#define SIMPLIFY_MESH_HPP_0B9C2F6E_5A41_4E7D_9E0B_7D3C15A8F2E4
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "index_mesh.hpp"
+
+//--    constants                               ///{{{1///////////////////////
+
+/* Maximum number of levels of detail per mesh, including the full-resolution
+ * mesh itself. Each coarser level aims for half the triangles of the
+ * previous one.
+ */
+constexpr std::size_t kLodMaxLevels = 5;
+
+/* Default limit on the simplification error, relative to the largest
+ * extent of the mesh's bounding box. Coarser levels are only generated while
+ * their error stays below this limit.
+ */
+constexpr float kLodTargetError = 5e-2f;
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Simplify aMesh by collapsing edges, using quadric error metrics (Garland &
+ * Heckbert, "Surface Simplification Using Quadric Error Metrics", SIGGRAPH
+ * 1997). Collapses always move a vertex onto one of its neighbours, so the
+ * returned index list references the existing vertices of aMesh; no vertex
+ * data is created or modified.
+ *
+ * Simplification stops once the index count reaches aTargetIndexCount or
+ * when the next collapse would exceed aTargetError (a distance, in the same
+ * units as the vertex positions). The error of the result is returned in
+ * aResultError if non-null. It is the quadric estimate, not a true Hausdorff
+ * distance, and can be somewhat lower than the actual deviation.
+ *
+ * Vertices on open borders and on attribute seams (two vertices at the same
+ * position) only move along the border or seam; both sides of a seam move
+ * together. Non-manifold vertices and more complex seams are never moved.
+ */
+std::vector<std::uint32_t> simplify_mesh(
+	IndexedMesh const&,
+	std::size_t aTargetIndexCount,
+	float aTargetError,
+	float* aResultError = nullptr
+);
+
+/* Fill aMesh.lods with up to aMaxLevels-1 coarser levels of detail. Each
+ * level halves the triangle count of the previous one. Generation stops
+ * early once a level no longer reduces the triangle count by at least a
+ * quarter, which happens when simplification reaches aTargetError (relative
+ * to the mesh's extent, see kLodTargetError).
+ */
+void generate_lods(
+	IndexedMesh&,
+	std::size_t aMaxLevels = kLodMaxLevels,
+	float aTargetError = kLodTargetError
+);
+
+/* Count the open edges of the triangles aIndices (referencing the vertices
+ * of aMesh), i.e. the edges that are used in only one direction. Vertices at
+ * the same position count as one, so attribute seams are not open edges.
+ * Simplification must not add open edges; a level with more of them than
+ * the full-resolution mesh has cracks.
+ */
+std::size_t count_open_edges(
+	IndexedMesh const&,
+	std::vector<std::uint32_t> const& aIndices
+);
+
+#endif // SIMPLIFY_MESH_HPP_0B9C2F6E_5A41_4E7D_9E0B_7D3C15A8F2E4
@@ -0,0 +1,168 @@
+#include "tangent_space.hpp"
+
+#include <cmath>
+#include <cassert>
+
+#include <tgen.h>
+#include <glm/glm.hpp>
+
+namespace
+{
+	constexpr std::uint32_t kNoVertex_ = ~std::uint32_t(0);
+
+	// +1 or -1; zero if the corner has no usable tangent frame
+	int corner_handedness_(
+		glm::dvec3 const& aNormal,
+		tgen::RealT const* aTangent,
+		tgen::RealT const* aBitangent
+	);
+
+	bool finite_( tgen::RealT const* aVec3 );
+
+	glm::vec3 any_perpendicular_( glm::vec3 const& );
+}
+
+//--    generate_tangents()             ///{{{2///////////////////////////////
+std::size_t generate_tangents( IndexedMesh& aMesh )
+{
+	std::size_t const vertexCount = aMesh.vert.size();
+	assert( vertexCount == aMesh.norm.size() && vertexCount == aMesh.text.size() );
+	assert( aMesh.lods.empty() );
+
+	// tgen works on doubles and std::size_t indices. The same indices serve
+	// as position and UV indices; the mesh is already welded.
+	std::vector<tgen::VIndexT> indices( aMesh.indices.begin(), aMesh.indices.end() );
+
+	std::vector<tgen::RealT> positions, texcoords;
+	positions.reserve( 3*vertexCount );
+	texcoords.reserve( 2*vertexCount );
+	for( std::size_t i = 0; i < vertexCount; ++i )
+	{
+		positions.insert( positions.end(), { aMesh.vert[i].x, aMesh.vert[i].y, aMesh.vert[i].z } );
+		texcoords.insert( texcoords.end(), { aMesh.text[i].x, aMesh.text[i].y } );
+	}
+
+	std::vector<tgen::RealT> cornerTangents, cornerBitangents;
+	tgen::computeCornerTSpace( indices, indices, positions, texcoords, cornerTangents, cornerBitangents );
+
+	// Find vertices whose corners disagree on the handedness. Bit 0 is set
+	// for right-handed corners, bit 1 for left-handed ones.
+	std::vector<std::int8_t> cornerSign( indices.size() );
+	std::vector<std::uint8_t> handedness( vertexCount, 0 );
+	for( std::size_t c = 0; c < indices.size(); ++c )
+	{
+		auto const v = indices[c];
+		auto const sign = corner_handedness_( glm::dvec3( aMesh.norm[v] ), &cornerTangents[3*c], &cornerBitangents[3*c] );
+
+		cornerSign[c] = std::int8_t(sign);
+		if( sign > 0 )
+			handedness[v] |= 1;
+		else if( sign < 0 )
+			handedness[v] |= 2;
+	}
+
+	// Split those; the left-handed corners move to the copy
+	std::vector<std::uint32_t> mirror( vertexCount, kNoVertex_ );
+	for( std::size_t c = 0; c < indices.size(); ++c )
+	{
+		auto const v = indices[c];
+		if( 3 != handedness[v] || cornerSign[c] >= 0 )
+			continue;
+
+		if( kNoVertex_ == mirror[v] )
+		{
+			mirror[v] = std::uint32_t(aMesh.vert.size());
+
+			// (Copies; the push_back()s may reallocate)
+			auto const vert = aMesh.vert[v];
+			auto const norm = aMesh.norm[v];
+			auto const text = aMesh.text[v];
+			aMesh.vert.push_back( vert );
+			aMesh.norm.push_back( norm );
+			aMesh.text.push_back( text );
+		}
+
+		indices[c] = mirror[v];
+		aMesh.indices[c] = mirror[v];
+	}
+
+	std::size_t const finalCount = aMesh.vert.size();
+
+	// Average per vertex
+	std::vector<tgen::RealT> tangents, bitangents;
+	tgen::computeVertexTSpace( indices, cornerTangents, cornerBitangents, finalCount, tangents, bitangents );
+
+	std::vector<tgen::RealT> normals;
+	normals.reserve( 3*finalCount );
+	for( auto const& n : aMesh.norm )
+	{
+		auto const nn = glm::normalize( glm::dvec3( n ) );
+		normals.insert( normals.end(), { nn.x, nn.y, nn.z } );
+	}
+
+	// orthogonalizeTSpace() replaces the bitangents by cross(N,T), after
+	// which computeTangent4D() would always report right-handed frames. It
+	// therefore gets the averaged bitangents instead.
+	auto const averagedBitangents = bitangents;
+	tgen::orthogonalizeTSpace( normals, tangents, bitangents );
+
+	std::vector<tgen::RealT> tangents4;
+	tgen::computeTangent4D( normals, tangents, averagedBitangents, tangents4 );
+
+	aMesh.tang.resize( finalCount );
+	for( std::size_t i = 0; i < finalCount; ++i )
+	{
+		// Vertices whose corners were all degenerate end up with NaNs
+		auto const* t = &tangents4[4*i];
+		if( finite_( t ) )
+		{
+			float const w = finite_( &averagedBitangents[3*i] ) ? float(t[3]) : 1.f;
+			aMesh.tang[i] = glm::vec4( float(t[0]), float(t[1]), float(t[2]), w );
+		}
+		else
+		{
+			aMesh.tang[i] = glm::vec4( any_perpendicular_( aMesh.norm[i] ), 1.f );
+		}
+	}
+
+	return finalCount - vertexCount;
+}
+
+
+//--    $ local functions               ///{{{2///////////////////////////////
+namespace
+{
+	int corner_handedness_( glm::dvec3 const& aNormal, tgen::RealT const* aTangent, tgen::RealT const* aBitangent )
+	{
+		glm::dvec3 const t( aTangent[0], aTangent[1], aTangent[2] );
+		glm::dvec3 const b( aBitangent[0], aBitangent[1], aBitangent[2] );
+
+		// Triangles with degenerate texture coordinates have zero tangents
+		// (see tgen::computeCornerTSpace()); they do not get a vote.
+		double const scale = glm::length( t ) * glm::length( b ) * glm::length( aNormal );
+		double const d = glm::dot( glm::cross( aNormal, t ), b );
+
+		if( !(std::abs( d ) > 1e-9 * scale) )
+			return 0;
+
+		return d > 0.0 ? 1 : -1;
+	}
+
+	bool finite_( tgen::RealT const* aVec3 )
+	{
+		return std::isfinite( aVec3[0] ) && std::isfinite( aVec3[1] ) && std::isfinite( aVec3[2] );
+	}
+
+	glm::vec3 any_perpendicular_( glm::vec3 const& aNormal )
+	{
+		float const len = glm::length( aNormal );
+		if( !(len > 0.f) )
+			return glm::vec3( 1.f, 0.f, 0.f );
+
+		glm::vec3 const n = aNormal / len;
+		glm::vec3 const axis = std::abs( n.x ) < 0.9f ? glm::vec3( 1.f, 0.f, 0.f ) : glm::vec3( 0.f, 1.f, 0.f );
+		return glm::normalize( axis - n * glm::dot( n, axis ) );
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,33 @@
+#ifndef TANGENT_SPACE_HPP_C41F0E7A_2B6D_4E93_A58C_9D07E3B16F52
+#define TANGENT_SPACE_HPP_C41F0E7A_2B6D_4E93_A58C_9D07E3B16F52
+
+//--//////////////////////////////////////////////////////////////////////////
+//--    include                                 ///{{{1///////////////////////
+
+#include <cstddef>
+
+#include "index_mesh.hpp"
+
+//--    functions                               ///{{{1///////////////////////
+
+/* Compute per-vertex tangents (aMesh.tang) with tgen. This runs on the
+ * indexed mesh, so that vertices are still welded by position, normal and
+ * texture coordinate only; tangents of the triangles sharing a vertex are
+ * averaged.
+ *
+ * The one exception are vertices shared by triangles with mirrored texture
+ * coordinates (opposite handedness), where averaging would cancel out the
+ * bitangent. Such vertices are split in two; the copy is appended to the
+ * vertex arrays and the left-handed triangles are redirected to it. Returns
+ * the number of vertices added this way.
+ *
+ * Tangents are orthogonalized against the normal. The w component holds the
+ * handedness (+1 or -1), i.e., bitangent = w * cross( normal, tangent.xyz ).
+ * Vertices without a usable tangent (e.g., degenerate texture coordinates)
+ * get an arbitrary tangent perpendicular to the normal.
+ *
+ * Must run before levels of detail are generated, as it may change indices.
+ */
+std::size_t generate_tangents( IndexedMesh& );
+
+#endif // TANGENT_SPACE_HPP_C41F0E7A_2B6D_4E93_A58C_9D07E3B16F52
@@ -0,0 +1,498 @@
+/* cw3-load-bench compares the ways of loading a baked model:
+ *  - "vectors": load_baked_model(), one std::vector per mesh array (wrapped
+ *               with view_baked_model(), which adds a few allocations)
+ *  - "mapped":  map_baked_model(), mesh arrays used in place in a mapping
+ *  - "arena":   load_baked_model_arena(), everything in a single block
+ *
+ * Each model is loaded --repeat times with each loader; the fastest time is
+ * kept. Heap use is measured by replacing the global operator new/delete
+ * (see below). After each load, every mesh array is copied once, like the
+ * upload to staging buffers does, which is when a mapping is paged in.
+ * Results are printed and written as JSON.
+ */
+
+//--    include                                 ///{{{1///////////////////////
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <typeinfo>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "../cw3/baked_model.hpp"
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+//--    heap accounting                         ///{{{1///////////////////////
+namespace
+{
+	// The benchmark is single-threaded; plain counters suffice.
+	struct HeapStats_
+	{
+		std::size_t allocations = 0;
+		std::size_t liveBytes = 0;
+		std::size_t peakBytes = 0;
+	};
+
+	HeapStats_ gHeap_;
+
+	// Each block starts with a header that records its size
+	constexpr std::size_t kHeapHeader_ = 16;
+
+	void* counted_alloc_( std::size_t aBytes )
+	{
+		auto* block = static_cast<unsigned char*>(std::malloc( aBytes + kHeapHeader_ ));
+		if( !block )
+			throw std::bad_alloc();
+
+		std::memcpy( block, &aBytes, sizeof(std::size_t) );
+
+		++gHeap_.allocations;
+		gHeap_.liveBytes += aBytes;
+		gHeap_.peakBytes = std::max( gHeap_.peakBytes, gHeap_.liveBytes );
+
+		return block + kHeapHeader_;
+	}
+	void counted_free_( void* aPtr ) noexcept
+	{
+		if( !aPtr )
+			return;
+
+		auto* block = static_cast<unsigned char*>(aPtr) - kHeapHeader_;
+
+		std::size_t bytes;
+		std::memcpy( &bytes, block, sizeof(std::size_t) );
+
+		gHeap_.liveBytes -= bytes;
+		std::free( block );
+	}
+}
+
+void* operator new( std::size_t aBytes ) { return counted_alloc_( aBytes ); }
+void* operator new[]( std::size_t aBytes ) { return counted_alloc_( aBytes ); }
+void operator delete( void* aPtr ) noexcept { counted_free_( aPtr ); }
+void operator delete[]( void* aPtr ) noexcept { counted_free_( aPtr ); }
+void operator delete( void* aPtr, std::size_t ) noexcept { counted_free_( aPtr ); }
+void operator delete[]( void* aPtr, std::size_t ) noexcept { counted_free_( aPtr ); }
+
+//--    types                                   ///{{{1///////////////////////
+namespace
+{
+	enum class Loader_
+	{
+		vectors,
+		mapped,
+		arena
+	};
+
+	constexpr Loader_ kLoaders_[] = { Loader_::vectors, Loader_::mapped, Loader_::arena };
+
+	struct BenchOptions_
+	{
+		std::vector<std::string> models;
+		std::size_t repeat = 5;
+
+		std::string output = "cw3-load-bench.json";
+	};
+
+	// Results of one loader on one model. Times are the minimum over all
+	// repeats; heap figures are from the first run.
+	struct BenchResult_
+	{
+		Loader_ loader;
+
+		double loadSeconds = 0.0;
+		double copySeconds = 0.0; // copy every mesh array once
+
+		std::size_t allocations = 0; // during the load
+		std::size_t heapPeakBytes = 0; // during the load
+		std::size_t heapHeldBytes = 0; // after the load
+	};
+
+	struct BenchCase_
+	{
+		std::string model;
+		std::uintmax_t fileBytes = 0;
+		std::size_t meshes = 0;
+		std::size_t vertices = 0;
+		std::size_t dataBytes = 0; // of the mesh arrays
+
+		std::vector<BenchResult_> results;
+	};
+
+	// local functions:
+	BenchOptions_ parse_bench_options_( int aArgc, char* aArgv[] );
+
+	BenchCase_ run_bench_case_( std::string const& aModel, BenchOptions_ const& );
+
+	void write_bench_json_(
+		char const* aPath,
+		std::vector<BenchCase_> const&,
+		BenchOptions_ const&
+	);
+
+	char const* loader_name_( Loader_ );
+}
+
+//--    main()                                  ///{{{1///////////////////////
+int main( int aArgc, char* aArgv[] ) try
+{
+	auto const options = parse_bench_options_( aArgc, aArgv );
+
+	std::vector<BenchCase_> cases;
+	for( auto const& model : options.models )
+	{
+		auto const& result = cases.emplace_back( run_bench_case_( model, options ) );
+
+		std::printf( "%s: %.1f MB, %zu meshes, %zu vertices, %.1f MB of mesh data\n",
+			result.model.c_str(),
+			result.fileBytes / (1024.0 * 1024.0),
+			result.meshes,
+			result.vertices,
+			result.dataBytes / (1024.0 * 1024.0)
+		);
+		std::printf( "  %-8s %10s %10s %12s %12s %12s\n", "loader", "load ms", "copy ms", "allocations", "heap peak", "heap held" );
+
+		for( auto const& r : result.results )
+		{
+			std::printf( "  %-8s %10.2f %10.2f %12zu %9.1f MB %9.1f MB\n",
+				loader_name_( r.loader ),
+				r.loadSeconds * 1000.0,
+				r.copySeconds * 1000.0,
+				r.allocations,
+				r.heapPeakBytes / (1024.0 * 1024.0),
+				r.heapHeldBytes / (1024.0 * 1024.0)
+			);
+		}
+
+		std::fflush( stdout );
+	}
+
+	write_bench_json_( options.output.c_str(), cases, options );
+	std::printf( "Results written to '%s'\n", options.output.c_str() );
+	return 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level exception [%s]:\n%s\nBye.\n", typeid(eErr).name(), eErr.what() );
+	return 1;
+}
+
+//--    $ parse_bench_options_()                ///{{{1///////////////////////
+namespace
+{
+	BenchOptions_ parse_bench_options_( int aArgc, char* aArgv[] )
+	{
+		BenchOptions_ ret;
+
+		for( int i = 1; i < aArgc; ++i )
+		{
+			auto const has_value_ = [&] {
+				if( i+1 >= aArgc )
+					throw lut::Error( "%s: expected a value", aArgv[i] );
+				return true;
+			};
+
+			if( 0 == std::strcmp( "--repeat", aArgv[i] ) && has_value_() )
+			{
+				char* end = nullptr;
+				auto const value = std::strtoull( aArgv[i+1], &end, 10 );
+				if( !end || *end || 0 == value )
+					throw lut::Error( "--repeat: invalid count '%s'", aArgv[i+1] );
+
+				ret.repeat = std::size_t(value);
+				++i;
+			}
+			else if( (0 == std::strcmp( "-o", aArgv[i] ) || 0 == std::strcmp( "--output", aArgv[i] )) && has_value_() )
+			{
+				ret.output = aArgv[++i];
+			}
+			else if( 0 == std::strcmp( "-h", aArgv[i] ) || 0 == std::strcmp( "--help", aArgv[i] ) )
+			{
+				std::printf( "Usage: %s [options] [MODEL...]\n", aArgv[0] );
+				std::printf( "\n" );
+				std::printf( "Loads each baked MODEL (default: assets/cw3/ship.comp5822mesh) with\n" );
+				std::printf( "load_baked_model(), map_baked_model() and load_baked_model_arena(), and\n" );
+				std::printf( "reports load times and heap use.\n" );
+				std::printf( "\n" );
+				std::printf( "Options:\n" );
+				std::printf( "  --repeat N           load each model N times per loader and keep the\n" );
+				std::printf( "                       fastest time (default: %zu)\n", ret.repeat );
+				std::printf( "  -o, --output FILE    write results as JSON to FILE (default: %s)\n", ret.output.c_str() );
+				std::printf( "  -h, --help           show this message\n" );
+				std::printf( "\n" );
+				std::printf( "Times are for warm file caches.\n" );
+				std::exit( 0 );
+			}
+			else if( '-' == aArgv[i][0] )
+			{
+				throw lut::Error( "Unknown option '%s'; see --help", aArgv[i] );
+			}
+			else
+			{
+				ret.models.emplace_back( aArgv[i] );
+			}
+		}
+
+		if( ret.models.empty() )
+			ret.models.emplace_back( "assets/cw3/ship.comp5822mesh" );
+
+		return ret;
+	}
+}
+
+//--    $ run_bench_case_()                     ///{{{1///////////////////////
+namespace
+{
+	using Clock_ = std::chrono::steady_clock;
+
+	double seconds_since_( Clock_::time_point aStart )
+	{
+		return std::chrono::duration<double>( Clock_::now() - aStart ).count();
+	}
+
+	BakedModelView load_( Loader_ aLoader, char const* aPath )
+	{
+		switch( aLoader )
+		{
+			case Loader_::vectors: return view_baked_model( load_baked_model( aPath ) );
+			case Loader_::mapped: return map_baked_model( aPath );
+			case Loader_::arena: return load_baked_model_arena( aPath );
+		}
+
+		throw lut::Error( "load_(): unknown loader" );
+	}
+
+	// Copies every mesh array into aDst, like an upload to staging buffers
+	template< typename tArray >
+	void copy_array_( tArray const& aArray, std::vector<unsigned char>& aDst )
+	{
+		std::size_t const bytes = aArray.size() * sizeof(aArray[0]);
+		if( bytes )
+			std::memcpy( aDst.data(), aArray.data(), bytes );
+	}
+
+	void copy_model_( BakedModelView const& aModel, std::vector<unsigned char>& aDst )
+	{
+		for( auto const& mesh : aModel.meshes )
+		{
+			copy_array_( mesh.positions, aDst );
+			copy_array_( mesh.texcoords, aDst );
+			copy_array_( mesh.frames, aDst );
+			copy_array_( mesh.indices, aDst );
+			copy_array_( mesh.meshlets, aDst );
+			copy_array_( mesh.lods, aDst );
+		}
+	}
+
+	template< typename tArray >
+	bool same_array_( tArray const& aA, tArray const& aB )
+	{
+		return aA.size() == aB.size() && (aA.empty() || 0 == std::memcmp( aA.data(), aB.data(), aA.size() * sizeof(aA[0]) ));
+	}
+
+	// The loaders must agree; otherwise the comparison is meaningless
+	void check_same_( BakedModelView const& aA, BakedModelView const& aB, char const* aPath )
+	{
+		bool same = aA.textures.size() == aB.textures.size()
+			&& same_array_( aA.materials, aB.materials )
+			&& aA.meshes.size() == aB.meshes.size()
+			;
+
+		for( std::size_t i = 0; same && i < aA.textures.size(); ++i )
+		{
+			same = 0 == std::strcmp( aA.textures[i].path, aB.textures[i].path )
+				&& aA.textures[i].channels == aB.textures[i].channels
+				;
+		}
+
+		for( std::size_t i = 0; same && i < aA.meshes.size(); ++i )
+		{
+			auto const& a = aA.meshes[i];
+			auto const& b = aB.meshes[i];
+
+			same = a.materialId == b.materialId
+				&& a.positionMin == b.positionMin
+				&& a.positionScale == b.positionScale
+				&& a.indexCount == b.indexCount
+				&& a.bytesPerIndex == b.bytesPerIndex
+				&& same_array_( a.positions, b.positions )
+				&& same_array_( a.texcoords, b.texcoords )
+				&& same_array_( a.frames, b.frames )
+				&& same_array_( a.indices, b.indices )
+				&& same_array_( a.meshlets, b.meshlets )
+				&& same_array_( a.lods, b.lods )
+				;
+		}
+
+		if( !same )
+			throw lut::Error( "%s: loaders returned different data", aPath );
+	}
+
+	BenchCase_ run_bench_case_( std::string const& aModel, BenchOptions_ const& aOptions )
+	{
+		BenchCase_ ret;
+		ret.model = aModel;
+		ret.fileBytes = std::filesystem::file_size( aModel );
+
+		// Reference data, and the size of the copy destination
+		auto const reference = load_( Loader_::vectors, aModel.c_str() );
+
+		std::size_t largestArray = 0;
+		for( auto const& mesh : reference.meshes )
+		{
+			std::size_t const arrays[] = {
+				mesh.positions.size() * sizeof(mesh.positions[0]),
+				mesh.texcoords.size() * sizeof(mesh.texcoords[0]),
+				mesh.frames.size() * sizeof(mesh.frames[0]),
+				mesh.indices.size(),
+				mesh.meshlets.size() * sizeof(mesh.meshlets[0]),
+				mesh.lods.size() * sizeof(mesh.lods[0])
+			};
+
+			for( auto const bytes : arrays )
+			{
+				largestArray = std::max( largestArray, bytes );
+				ret.dataBytes += bytes;
+			}
+
+			ret.vertices += mesh.positions.size();
+		}
+
+		ret.meshes = reference.meshes.size();
+
+		std::vector<unsigned char> copyDst( largestArray );
+
+		for( auto const loader : kLoaders_ )
+		{
+			BenchResult_ result;
+			result.loader = loader;
+			result.loadSeconds = result.copySeconds = std::numeric_limits<double>::infinity();
+
+			for( std::size_t r = 0; r < aOptions.repeat; ++r )
+			{
+				auto const allocationsBefore = gHeap_.allocations;
+				auto const liveBefore = gHeap_.liveBytes;
+				gHeap_.peakBytes = gHeap_.liveBytes;
+
+				auto const loadStart = Clock_::now();
+				auto const model = load_( loader, aModel.c_str() );
+				result.loadSeconds = std::min( result.loadSeconds, seconds_since_( loadStart ) );
+
+				if( 0 == r )
+				{
+					result.allocations = gHeap_.allocations - allocationsBefore;
+					result.heapPeakBytes = gHeap_.peakBytes - liveBefore;
+					result.heapHeldBytes = gHeap_.liveBytes - liveBefore;
+
+					check_same_( reference, model, aModel.c_str() );
+				}
+
+				auto const copyStart = Clock_::now();
+				copy_model_( model, copyDst );
+				result.copySeconds = std::min( result.copySeconds, seconds_since_( copyStart ) );
+			}
+
+			ret.results.emplace_back( result );
+		}
+
+		return ret;
+	}
+}
+
+//--    $ write_bench_json_()                   ///{{{1///////////////////////
+namespace
+{
+	void write_bench_json_( char const* aPath, std::vector<BenchCase_> const& aCases, BenchOptions_ const& aOptions )
+	{
+		// Format:
+		// {
+		//   "benchmark": "cw3-load",
+		//   "build": "release" or "debug",
+		//   "repeat": N,
+		//   "cases": [
+		//     { "model": path, "file_bytes": N, ..., "loaders": {
+		//         "vectors": { "load_seconds": T, ... }, ... } },
+		//     ...
+		//   ]
+		// }
+		FILE* fof = std::fopen( aPath, "wb" );
+		if( !fof )
+			throw lut::Error( "Unable to open '%s' for writing", aPath );
+
+#		if defined(NDEBUG)
+		char const* const build = "release";
+#		else
+		char const* const build = "debug";
+#		endif
+
+		std::fprintf( fof, "{\n" );
+		std::fprintf( fof, "  \"benchmark\": \"cw3-load\",\n" );
+		std::fprintf( fof, "  \"build\": \"%s\",\n", build );
+		std::fprintf( fof, "  \"repeat\": %zu,\n", aOptions.repeat );
+		std::fprintf( fof, "  \"cases\": [\n" );
+
+		for( std::size_t i = 0; i < aCases.size(); ++i )
+		{
+			auto const& c = aCases[i];
+
+			// Model paths are written as-is; they are not expected to
+			// contain characters that need escaping.
+			std::fprintf( fof, "    {\n" );
+			std::fprintf( fof, "      \"model\": \"%s\",\n", c.model.c_str() );
+			std::fprintf( fof, "      \"file_bytes\": %ju,\n", c.fileBytes );
+			std::fprintf( fof, "      \"meshes\": %zu,\n", c.meshes );
+			std::fprintf( fof, "      \"vertices\": %zu,\n", c.vertices );
+			std::fprintf( fof, "      \"data_bytes\": %zu,\n", c.dataBytes );
+			std::fprintf( fof, "      \"loaders\": {" );
+
+			for( std::size_t l = 0; l < c.results.size(); ++l )
+			{
+				auto const& r = c.results[l];
+				std::fprintf( fof, "%s\n        \"%s\": { \"load_seconds\": %.6f, \"copy_seconds\": %.6f, \"allocations\": %zu, \"heap_peak_bytes\": %zu, \"heap_held_bytes\": %zu }",
+					l ? "," : "",
+					loader_name_( r.loader ),
+					r.loadSeconds,
+					r.copySeconds,
+					r.allocations,
+					r.heapPeakBytes,
+					r.heapHeldBytes
+				);
+			}
+
+			std::fprintf( fof, "\n      }\n" );
+			std::fprintf( fof, "    }%s\n", i+1 < aCases.size() ? "," : "" );
+		}
+
+		std::fprintf( fof, "  ]\n" );
+		std::fprintf( fof, "}\n" );
+
+		if( std::ferror( fof ) )
+		{
+			std::fclose( fof );
+			throw lut::Error( "Error writing '%s'", aPath );
+		}
+
+		std::fclose( fof );
+	}
+
+	char const* loader_name_( Loader_ aLoader )
+	{
+		switch( aLoader )
+		{
+			case Loader_::vectors: return "vectors";
+			case Loader_::mapped: return "mapped";
+			case Loader_::arena: return "arena";
+		}
+
+		return "?";
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -1,18 +1,128 @@
 #include "MeshLoader.hpp"
 #include <limits>
+#include <algorithm>
 
 #include <cstring> // for std::memcpy()
+#include <cassert>
 
 #include "../labutils/error.hpp"
 #include "../labutils/vkutil.hpp"
 #include "../labutils/to_string.hpp"
 #include "glm/vec4.hpp"
+#include "glm/geometric.hpp"
 namespace lut = labutils;
 
-IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, BakedModel const& model, std::uint32_t meshIndex)
+namespace
 {
+	// Offsets of the payloads of a mesh in MeshStaging::buffer
+	struct StagingLayout_
+	{
+		VkDeviceSize positions, texcoords, frames, indices;
+		VkDeviceSize size;
+	};
+
+	VkDeviceSize align_staging_(VkDeviceSize aOffset)
+	{
+		return (aOffset + 15) & ~VkDeviceSize(15);
+	}
+
+	StagingLayout_ staging_layout_(BakedMeshView const& aMesh)
+	{
+		StagingLayout_ ret{};
+		ret.positions = 0;
+		ret.texcoords = align_staging_(ret.positions + aMesh.positions.size() * sizeof(glm::u16vec4));
+		ret.frames = align_staging_(ret.texcoords + aMesh.texcoords.size() * sizeof(glm::u16vec2));
+		ret.indices = align_staging_(ret.frames + aMesh.frames.size() * sizeof(glm::i16vec4));
+		ret.size = align_staging_(ret.indices + aMesh.indices.size());
+		return ret;
+	}
+
+	void ensure_staging_(lut::Allocator const& aAllocator, MeshStaging& aStaging, VkDeviceSize aSize)
+	{
+		if (aStaging.capacity >= aSize)
+			return;
+
+		aStaging.buffer = lut::create_buffer(
+			aAllocator,
+			aSize,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VMA_MEMORY_USAGE_CPU_TO_GPU,
+			VMA_ALLOCATION_CREATE_MAPPED_BIT
+		);
+		aStaging.mapped = lut::mapped_pointer(aAllocator, aStaging.buffer);
+		aStaging.capacity = aSize;
+	}
+}
+
+IndexedMesh create_indexed_mesh(lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, BakedModelView const& model, std::uint32_t meshIndex)
+{
+	MeshStaging staging;
+	return create_indexed_mesh(aContext, aAllocator, model, meshIndex, staging);
+}
+
+IndexedMesh create_indexed_mesh(lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, BakedModelView const& model, std::uint32_t meshIndex, MeshStaging& aStaging)
+{
+	IndexedMesh ret = describe_indexed_mesh(model, meshIndex);
+
+	// We need to ensure that the Vulkan resources are alive until all the
+//  transfers have completed. For simplicity, we will just wait for the
+//  operations to complete with a fence. A more complex solution might want
+//  to queue transfers, let these take place in the background while
+//  performing other tasks (see MeshResidency).
+
+	lut::Fence uploadComplete = lut::create_fence(aContext);
+
+	// Queue data uploads from staging buffers to the final buffers
+	// This uses a separate command pool for simplicity.
+	lut::CommandPool uploadPool = create_command_pool(aContext);
+	VkCommandBuffer uploadCmd = alloc_command_buffer(aContext, uploadPool.handle);
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
+	{
+		throw lut::Error("Beginning command buffer recording\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	record_indexed_mesh_upload(uploadCmd, aAllocator, model.meshes[meshIndex], aStaging, ret);
+
+	if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+	{
+		throw lut::Error("Ending command buffer recording\n"
+			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	// Submit transfer commands
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadCmd;
+	if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+	{
+		throw lut::Error("Submitting commands\n"
+			"vkQueueSubmit() returned %s", lut::to_string(res).c_str());
+	}
+	// Wait for commands to finish before we destroy the temporary resources
+	// required for the transfers (staging buffers, command pool, ...)
+	//
+	// The code doesnt destory the resources implicitly  the resources are
+	// destroyed by the destructors of the labutils wrappers for the various
+	// objects once we leave the functions scope.
+	if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+	{
+		throw lut::Error("Waiting for upload to complete\n"
+			"vkWaitForFences() returned %s", lut::to_string(res).c_str());
+	}
+
+	return ret;
+}
 
-	BakedMeshData mesh = model.meshes[meshIndex];
+IndexedMesh describe_indexed_mesh(BakedModelView const& model, std::uint32_t meshIndex)
+{
+	BakedMeshView const& mesh = model.meshes[meshIndex];
 	
 	//See if this is a foliage mesh
 	std::uint32_t materialId = model.meshes[meshIndex].materialId;
@@ -32,30 +142,72 @@ IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutil
 	}
 
 
+	IndexedMesh ret{
+		lut::Buffer{},
+		lut::Buffer{},
+		lut::Buffer{},
+		lut::Buffer{},
+		mesh.materialId,
+		mesh.indexCount,
+		isAlpha,
+		isNormalMap,
+		mesh.positionMin,
+		mesh.positionScale,
+		sizeof(std::uint16_t) == mesh.bytesPerIndex ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32
+	};
+	ret.lods.assign(mesh.lods.begin(), mesh.lods.end());
+
+	return ret;
+}
+
+VkDeviceSize indexed_mesh_bytes(BakedMeshView const& aMesh)
+{
+	return aMesh.positions.size() * sizeof(glm::u16vec4)
+		+ aMesh.texcoords.size() * sizeof(glm::u16vec2)
+		+ aMesh.frames.size() * sizeof(glm::i16vec4)
+		+ aMesh.indices.size();
+}
+
+VkDeviceSize indexed_mesh_staging_bytes(BakedMeshView const& aMesh)
+{
+	return staging_layout_(aMesh).size;
+}
+
+void record_indexed_mesh_upload(VkCommandBuffer uploadCmd, lut::Allocator const& aAllocator, BakedMeshView const& mesh, MeshStaging& aStaging, IndexedMesh& aMesh)
+{
+	ensure_staging_(aAllocator, aStaging, indexed_mesh_staging_bytes(mesh));
+	record_indexed_mesh_upload(uploadCmd, aAllocator, mesh, aStaging, 0, aMesh);
+}
+
+void record_indexed_mesh_upload(VkCommandBuffer uploadCmd, lut::Allocator const& aAllocator, BakedMeshView const& mesh, MeshStaging& aStaging, VkDeviceSize aStagingOffset, IndexedMesh& aMesh)
+{
+	StagingLayout_ const layout = staging_layout_(mesh);
+	assert(0 == aStagingOffset % 16 && aStagingOffset + layout.size <= aStaging.capacity);
+
 	lut::Buffer vertexPosGPU = lut::create_buffer(
 		aAllocator,
-		mesh.positions.size() * sizeof(glm::vec3),
+		mesh.positions.size() * sizeof(glm::u16vec4),
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
 	lut::Buffer texCoordGPU = lut::create_buffer(
 		aAllocator,
-		mesh.texcoords.size() * sizeof(glm::vec2),
+		mesh.texcoords.size() * sizeof(glm::u16vec2),
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
-	lut::Buffer normalGPU = lut::create_buffer(
+	lut::Buffer frameGPU = lut::create_buffer(
 		aAllocator,
-		mesh.normals.size() * sizeof(glm::vec3),
+		mesh.frames.size() * sizeof(glm::i16vec4),
 		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
 
 	lut::Buffer indicesGPU = lut::create_buffer(
 		aAllocator,
-		mesh.indices.size() * sizeof(std::uint32_t),
+		mesh.indices.size(),
 		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		VMA_MEMORY_USAGE_GPU_ONLY
 	);
@@ -63,102 +215,29 @@ IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutil
 
 
 	//===========================Staging buffer initialize==================================
-	lut::Buffer posStaging = lut::create_buffer(
-		aAllocator,
-		mesh.positions.size() * sizeof(glm::vec3),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_MEMORY_USAGE_CPU_TO_GPU
-	);
-
-	lut::Buffer texCoordStaging = lut::create_buffer(
-		aAllocator,
-		mesh.texcoords.size() * sizeof(glm::vec2),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_MEMORY_USAGE_CPU_TO_GPU
-	);
-
-	lut::Buffer normalStaging = lut::create_buffer(
-		aAllocator,
-		mesh.normals.size() * sizeof(glm::vec3),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_MEMORY_USAGE_CPU_TO_GPU
-	);
-
-	lut::Buffer indicesStaging = lut::create_buffer(
-		aAllocator,
-		mesh.indices.size() * sizeof(std::uint32_t),
-		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VMA_MEMORY_USAGE_CPU_TO_GPU
-	);
-
-
-	void* posPtr = nullptr;
-	if (auto const res = vmaMapMemory(aAllocator.allocator, posStaging.allocation, &posPtr); VK_SUCCESS != res)
-	{
-		throw lut::Error("Mapping memory for writing\n"
-			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
-	}
-	std::memcpy(posPtr, mesh.positions.data(), mesh.positions.size() * sizeof(glm::vec3));
-	vmaUnmapMemory(aAllocator.allocator, posStaging.allocation);
-
-
-	void* texPtr = nullptr;
-	if (auto const res = vmaMapMemory(aAllocator.allocator, texCoordStaging.allocation, &texPtr); VK_SUCCESS != res)
-	{
-		throw lut::Error("Mapping memory for writing\n"
-			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
-	}
-	std::memcpy(texPtr, mesh.texcoords.data(), mesh.texcoords.size() * sizeof(glm::vec2));
-	vmaUnmapMemory(aAllocator.allocator, texCoordStaging.allocation);
-
-
-	void* norPtr = nullptr;
-	if (auto const res = vmaMapMemory(aAllocator.allocator, normalStaging.allocation, &norPtr); VK_SUCCESS != res)
-	{
-		throw lut::Error("Mapping memory for writing\n"
-			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
-	}
-	std::memcpy(norPtr, mesh.normals.data(), mesh.normals.size() * sizeof(glm::vec3));
-	vmaUnmapMemory(aAllocator.allocator, normalStaging.allocation);
-
-
-
-	void* indicePtr = nullptr;
-	if (auto const res = vmaMapMemory(aAllocator.allocator, indicesStaging.allocation, &indicePtr); VK_SUCCESS != res)
+	// All four payloads share one persistently mapped staging buffer. With a
+	// mapped model, the copies below are the only reads of the file data.
+	auto* staging = static_cast<std::uint8_t*>(aStaging.mapped) + aStagingOffset;
+	std::memcpy(staging + layout.positions, mesh.positions.data(), mesh.positions.size() * sizeof(glm::u16vec4));
+	std::memcpy(staging + layout.texcoords, mesh.texcoords.data(), mesh.texcoords.size() * sizeof(glm::u16vec2));
+	std::memcpy(staging + layout.frames, mesh.frames.data(), mesh.frames.size() * sizeof(glm::i16vec4));
+	std::memcpy(staging + layout.indices, mesh.indices.data(), mesh.indices.size());
+
+	// No-op for host-coherent memory
+	if (auto const res = vmaFlushAllocation(aAllocator.allocator, aStaging.buffer.allocation, aStagingOffset, layout.size); VK_SUCCESS != res)
 	{
-		throw lut::Error("Mapping memory for writing\n"
-			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+		throw lut::Error("Flushing staging memory\n"
+			"vmaFlushAllocation() returned %s", lut::to_string(res).c_str());
 	}
-	std::memcpy(indicePtr, mesh.indices.data(), mesh.indices.size() * sizeof(std::uint32_t));
-	vmaUnmapMemory(aAllocator.allocator, indicesStaging.allocation);
 
+	aStaging.bytesWritten += indexed_mesh_bytes(mesh);
 
-	// We need to ensure that the Vulkan resources are alive until all the
-//  transfers have completed. For simplicity, we will just wait for the
-//  operations to complete with a fence. A more complex solution might want
-//  to queue transfers, let these take place in the background while
-//  performing other tasks.
-
-	lut::Fence uploadComplete = lut::create_fence(aContext);
-
-	// Queue data uploads from staging buffers to the final buffers
-	// This uses a separate command pool for simplicity.
-	lut::CommandPool uploadPool = create_command_pool(aContext);
-	VkCommandBuffer uploadCmd = alloc_command_buffer(aContext, uploadPool.handle);
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = 0;
-	beginInfo.pInheritanceInfo = nullptr;
-
-	if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
-	{
-		throw lut::Error("Beginning command buffer recording\n"
-			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
-	}
 
+	// Queue data uploads from the staging buffer to the final buffers
 	VkBufferCopy pcopy{};
-	pcopy.size = mesh.positions.size() * sizeof(glm::vec3);
-	vkCmdCopyBuffer(uploadCmd, posStaging.buffer, vertexPosGPU.buffer, 1, &pcopy);
+	pcopy.srcOffset = aStagingOffset + layout.positions;
+	pcopy.size = mesh.positions.size() * sizeof(glm::u16vec4);
+	vkCmdCopyBuffer(uploadCmd, aStaging.buffer.buffer, vertexPosGPU.buffer, 1, &pcopy);
 	lut::buffer_barrier(uploadCmd,
 		vertexPosGPU.buffer,
 		VK_ACCESS_TRANSFER_WRITE_BIT,
@@ -168,8 +247,9 @@ IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutil
 	);
 
 	VkBufferCopy tcopy{};
-	tcopy.size = mesh.texcoords.size() * sizeof(glm::vec2);
-	vkCmdCopyBuffer(uploadCmd, texCoordStaging.buffer, texCoordGPU.buffer, 1, &tcopy);
+	tcopy.srcOffset = aStagingOffset + layout.texcoords;
+	tcopy.size = mesh.texcoords.size() * sizeof(glm::u16vec2);
+	vkCmdCopyBuffer(uploadCmd, aStaging.buffer.buffer, texCoordGPU.buffer, 1, &tcopy);
 	lut::buffer_barrier(uploadCmd,
 		texCoordGPU.buffer,
 		VK_ACCESS_TRANSFER_WRITE_BIT,
@@ -179,10 +259,11 @@ IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutil
 	);
 
 	VkBufferCopy ncopy{};
-	ncopy.size = mesh.normals.size() * sizeof(glm::vec3);
-	vkCmdCopyBuffer(uploadCmd, normalStaging.buffer, normalGPU.buffer, 1, &ncopy);
+	ncopy.srcOffset = aStagingOffset + layout.frames;
+	ncopy.size = mesh.frames.size() * sizeof(glm::i16vec4);
+	vkCmdCopyBuffer(uploadCmd, aStaging.buffer.buffer, frameGPU.buffer, 1, &ncopy);
 	lut::buffer_barrier(uploadCmd,
-		normalGPU.buffer,
+		frameGPU.buffer,
 		VK_ACCESS_TRANSFER_WRITE_BIT,
 		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
 		VK_PIPELINE_STAGE_TRANSFER_BIT,
@@ -190,8 +271,9 @@ IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutil
 	);
 
 	VkBufferCopy icopy{};
-	icopy.size = mesh.indices.size() * sizeof(std::uint32_t);
-	vkCmdCopyBuffer(uploadCmd, indicesStaging.buffer, indicesGPU.buffer, 1, &icopy);
+	icopy.srcOffset = aStagingOffset + layout.indices;
+	icopy.size = mesh.indices.size();
+	vkCmdCopyBuffer(uploadCmd, aStaging.buffer.buffer, indicesGPU.buffer, 1, &icopy);
 	lut::buffer_barrier(uploadCmd,
 		indicesGPU.buffer,
 		VK_ACCESS_TRANSFER_WRITE_BIT,
@@ -200,47 +282,45 @@ IndexedMesh create_indexed_mesh(labutils::VulkanContext const& aContext, labutil
 		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
 	);
 
+	aMesh.pos = std::move(vertexPosGPU);
+	aMesh.texcoords = std::move(texCoordGPU);
+	aMesh.frames = std::move(frameGPU);
+	aMesh.indices = std::move(indicesGPU);
+}
 
-
-	if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
-	{
-		throw lut::Error("Ending command buffer recording\n"
-			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
-	}
-
-	// Submit transfer commands
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &uploadCmd;
-	if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
-	{
-		throw lut::Error("Submitting commands\n"
-			"vkQueueSubmit() returned %s", lut::to_string(res).c_str());
-	}
-	// Wait for commands to finish before we destroy the temporary resources
-	// required for the transfers (staging buffers, command pool, ...)
-	//
-	// The code doesnt destory the resources implicitly  the resources are
-	// destroyed by the destructors of the labutils wrappers for the various
-	// objects once we leave the functions scope.
-	if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+void select_lod_levels(std::vector<IndexedMesh>& aMeshes, glm::vec3 const& aCameraPos, float aPixelsPerUnit, float aPixelError, float aHysteresis)
+{
+	for (auto& mesh : aMeshes)
 	{
-		throw lut::Error("Waiting for upload to complete\n"
-			"vkWaitForFences() returned %s", lut::to_string(res).c_str());
+		if (mesh.lods.size() < 2)
+		{
+			mesh.lodLevel = 0;
+			continue;
+		}
+
+		// Bounding sphere of the mesh's AABB; distance to its closest point
+		glm::vec3 const extent = mesh.positionScale * 65535.f;
+		glm::vec3 const center = mesh.positionMin + 0.5f * extent;
+		float const radius = 0.5f * glm::length(extent);
+
+		float const distance = std::max(glm::length(center - aCameraPos) - radius, 1e-4f);
+		float const pixelsPerUnit = aPixelsPerUnit / distance;
+
+		// Errors grow with the level, see cw3-bake/simplify_mesh.hpp
+		auto const coarsest = [&](float aThreshold) {
+			std::uint32_t level = 0;
+			while (level+1 < mesh.lods.size() && mesh.lods[level+1].error * pixelsPerUnit <= aThreshold)
+				++level;
+			return level;
+		};
+
+		// Keep the current level while it lies between the levels chosen with
+		// a tightened and with a relaxed threshold
+		std::uint32_t const tight = coarsest(aPixelError * (1.f - aHysteresis));
+		std::uint32_t const loose = coarsest(aPixelError * (1.f + aHysteresis));
+
+		mesh.lodLevel = std::clamp(mesh.lodLevel, tight, loose);
 	}
-
-
-	return IndexedMesh{
-		std::move(vertexPosGPU),
-		std::move(texCoordGPU),
-		std::move(normalGPU),
-		std::move(indicesGPU),
-		mesh.materialId,
-		static_cast<uint32_t> (mesh.indices.size()),
-		isAlpha,
-		isNormalMap
-	};
 }
 
 
@@ -431,4 +511,112 @@ screenImage create_screen_image(labutils::VulkanContext const& aContext, labutil
 		std::move(indicesGPU),
 		static_cast<uint32_t> (indices.size())
 	};
-}
\ No newline at end of file
+}
+
+
+MeshletBuffers create_meshlet_buffers(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, BakedModelView const& model, std::vector<IndexedMesh>& aMeshes)
+{
+	//Gather meshlets of all meshes into a single array
+	std::vector<BakedMeshlet> meshlets;
+	for (std::size_t i = 0; i < aMeshes.size(); i++)
+	{
+		auto const& source = model.meshes[i].meshlets;
+
+		aMeshes[i].firstMeshlet = static_cast<std::uint32_t>(meshlets.size());
+		aMeshes[i].meshletCount = static_cast<std::uint32_t>(source.size());
+
+		meshlets.insert(meshlets.end(), source.begin(), source.end());
+	}
+
+	std::uint32_t const meshletCount = static_cast<std::uint32_t>(meshlets.size());
+
+	VkPhysicalDeviceFeatures features{};
+	vkGetPhysicalDeviceFeatures(aContext.physicalDevice, &features);
+	bool const multiDrawIndirect = VK_TRUE == features.multiDrawIndirect;
+
+	VkDeviceSize const meshletBytes = std::max<VkDeviceSize>(1, meshletCount) * sizeof(BakedMeshlet);
+	VkDeviceSize const drawBytes = std::max<VkDeviceSize>(1, meshletCount) * sizeof(VkDrawIndexedIndirectCommand);
+
+	lut::Buffer meshletGPU = lut::create_buffer(
+		aAllocator,
+		meshletBytes,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	lut::Buffer drawGPU = lut::create_buffer(
+		aAllocator,
+		drawBytes,
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	if (0 == meshletCount)
+		return MeshletBuffers{ std::move(meshletGPU), std::move(drawGPU), 0, multiDrawIndirect };
+
+	lut::Buffer meshletStaging = lut::create_buffer(
+		aAllocator,
+		meshletBytes,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU
+	);
+
+	void* meshletPtr = nullptr;
+	if (auto const res = vmaMapMemory(aAllocator.allocator, meshletStaging.allocation, &meshletPtr); VK_SUCCESS != res)
+	{
+		throw lut::Error("Mapping memory for writing\n"
+			"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+	}
+	std::memcpy(meshletPtr, meshlets.data(), meshlets.size() * sizeof(BakedMeshlet));
+	vmaUnmapMemory(aAllocator.allocator, meshletStaging.allocation);
+
+	lut::Fence uploadComplete = lut::create_fence(aContext);
+
+	lut::CommandPool uploadPool = create_command_pool(aContext);
+	VkCommandBuffer uploadCmd = alloc_command_buffer(aContext, uploadPool.handle);
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = 0;
+	beginInfo.pInheritanceInfo = nullptr;
+
+	if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
+	{
+		throw lut::Error("Beginning command buffer recording\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	VkBufferCopy mcopy{};
+	mcopy.size = meshlets.size() * sizeof(BakedMeshlet);
+	vkCmdCopyBuffer(uploadCmd, meshletStaging.buffer, meshletGPU.buffer, 1, &mcopy);
+	lut::buffer_barrier(uploadCmd,
+		meshletGPU.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+
+	if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+	{
+		throw lut::Error("Ending command buffer recording\n"
+			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &uploadCmd;
+	if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+	{
+		throw lut::Error("Submitting commands\n"
+			"vkQueueSubmit() returned %s", lut::to_string(res).c_str());
+	}
+
+	if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+	{
+		throw lut::Error("Waiting for upload to complete\n"
+			"vkWaitForFences() returned %s", lut::to_string(res).c_str());
+	}
+
+	return MeshletBuffers{ std::move(meshletGPU), std::move(drawGPU), meshletCount, multiDrawIndirect };
+}
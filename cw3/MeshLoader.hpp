@@ -15,27 +15,119 @@ struct IndexedMesh
 	bool isAlphaMask;
 	bool isNormalMap;
 
+	// Dequantization of the compact (uint16) positions, see baked_model.hpp
+	glm::vec3 positionMin;
+	glm::vec3 positionScale;
+
+	// 16-bit indices are used for meshes with few enough vertices
+	VkIndexType indexType;
+
+	// Range of this mesh's meshlets in MeshletBuffers; set by
+	// create_meshlet_buffers()
+	std::uint32_t firstMeshlet = 0;
+	std::uint32_t meshletCount = 0;
+
+	// Levels of detail (meshlet ranges relative to firstMeshlet), and the
+	// level drawn this frame; see select_lod_levels()
+	std::vector<BakedMeshLod> lods;
+	std::uint32_t lodLevel = 0;
+
+	// Empty (VK_NULL_HANDLE) while the mesh is not resident, see
+	// describe_indexed_mesh() and MeshResidency
 	labutils::Buffer pos;
 	labutils::Buffer texcoords;
-	labutils::Buffer normals;
+	labutils::Buffer frames; // QTangents (normal, tangent and handedness)
 	labutils::Buffer indices;
 
 
 	//Default constructor
-	IndexedMesh(labutils::Buffer pPos, labutils::Buffer pTexCoord, labutils::Buffer pNormal,
-		labutils::Buffer pIndices, std::uint32_t pMaterialId, std::uint32_t pIndexSize,bool isAlphaMask, bool isNormalMap)
-		:pos(std::move(pPos)),texcoords(std::move(pTexCoord)),normals(std::move(pNormal)),
-		indices(std::move(pIndices)),materialId(pMaterialId),indexSize(pIndexSize), isAlphaMask(isAlphaMask),isNormalMap(isNormalMap)
+	IndexedMesh(labutils::Buffer pPos, labutils::Buffer pTexCoord, labutils::Buffer pFrames,
+		labutils::Buffer pIndices, std::uint32_t pMaterialId, std::uint32_t pIndexSize,bool isAlphaMask, bool isNormalMap,
+		glm::vec3 pPositionMin, glm::vec3 pPositionScale, VkIndexType pIndexType)
+		:pos(std::move(pPos)),texcoords(std::move(pTexCoord)),frames(std::move(pFrames)),
+		indices(std::move(pIndices)),materialId(pMaterialId),indexSize(pIndexSize), isAlphaMask(isAlphaMask),isNormalMap(isNormalMap),
+		positionMin(pPositionMin), positionScale(pPositionScale), indexType(pIndexType)
 	{}
 
 
 	IndexedMesh(IndexedMesh&& other)noexcept :
-		pos(std::move(other.pos)), texcoords(std::move(other.texcoords)), normals(std::move(other.normals)),
-		indices(std::move(other.indices)), materialId(other.materialId), indexSize(other.indexSize), isAlphaMask(other.isAlphaMask), isNormalMap(other.isNormalMap)
+		pos(std::move(other.pos)), texcoords(std::move(other.texcoords)), frames(std::move(other.frames)),
+		indices(std::move(other.indices)), materialId(other.materialId), indexSize(other.indexSize), isAlphaMask(other.isAlphaMask), isNormalMap(other.isNormalMap),
+		positionMin(other.positionMin), positionScale(other.positionScale), indexType(other.indexType),
+		firstMeshlet(other.firstMeshlet), meshletCount(other.meshletCount),
+		lods(std::move(other.lods)), lodLevel(other.lodLevel)
+	{}
+};
+
+// Persistently mapped staging memory for mesh uploads. The payloads of a
+// mesh are written straight from the BakedModelView (i.e., from the mapped
+// file) into it; it grows to fit the largest mesh and is reused afterwards.
+// MeshResidency instead sizes it once and uses it as a ring (see the
+// overload of record_indexed_mesh_upload() that takes an offset).
+struct MeshStaging
+{
+	labutils::Buffer buffer;
+	void* mapped = nullptr;
+	VkDeviceSize capacity = 0;
+
+	// Host bytes written into the staging memory so far
+	std::uint64_t bytesWritten = 0;
+};
+
+IndexedMesh create_indexed_mesh(labutils::VulkanContext const&, labutils::Allocator const&, BakedModelView const&, std::uint32_t meshIndex, MeshStaging&);
+
+// As above, with staging memory for this mesh only
+IndexedMesh create_indexed_mesh(labutils::VulkanContext const&, labutils::Allocator const&, BakedModelView const&, std::uint32_t meshIndex);
+
+// Mesh without GPU buffers (material, dequantization, levels of detail)
+IndexedMesh describe_indexed_mesh(BakedModelView const&, std::uint32_t meshIndex);
+
+// Creates the GPU buffers of aMesh, writes the payloads of the source mesh
+// into aStaging and records the copies into the command buffer. Nothing is
+// submitted; aStaging must stay alive and unchanged until the copies have
+// completed.
+void record_indexed_mesh_upload(VkCommandBuffer, labutils::Allocator const&, BakedMeshView const&, MeshStaging&, IndexedMesh& aMesh);
+
+// As above, but writes the payloads at aStagingOffset (a multiple of 16)
+// instead of growing aStaging. indexed_mesh_staging_bytes() bytes starting
+// at aStagingOffset must fit into aStaging.
+void record_indexed_mesh_upload(VkCommandBuffer, labutils::Allocator const&, BakedMeshView const&, MeshStaging&, VkDeviceSize aStagingOffset, IndexedMesh& aMesh);
+
+// Size of the GPU buffers of a mesh
+VkDeviceSize indexed_mesh_bytes(BakedMeshView const&);
+
+// Staging memory used by an upload of the mesh (a multiple of 16)
+VkDeviceSize indexed_mesh_staging_bytes(BakedMeshView const&);
+
+// Pick IndexedMesh::lodLevel for each mesh: the coarsest level whose error,
+// projected onto the screen at the distance of the mesh's bounding sphere,
+// is at most aPixelError. aPixelsPerUnit is the size of one unit at distance
+// one, in pixels. A level only changes once the projected error leaves the
+// band aPixelError*(1 +- aHysteresis), so that meshes near a threshold do
+// not switch back and forth every frame.
+void select_lod_levels(std::vector<IndexedMesh>&, glm::vec3 const& aCameraPos, float aPixelsPerUnit, float aPixelError, float aHysteresis);
+
+// Meshlets of all meshes, for GPU culling (see shaders/cull.comp). The cull
+// pass writes one VkDrawIndexedIndirectCommand per meshlet into draws; culled
+// meshlets get an instance count of zero.
+struct MeshletBuffers
+{
+	labutils::Buffer meshlets;
+	labutils::Buffer draws;
+	std::uint32_t meshletCount;
+
+	// Whether the device supports multiDrawIndirect (see create_device() in
+	// labutils/vulkan_window.cpp). If not, the meshlets are drawn with one
+	// vkCmdDrawIndexedIndirect() each.
+	bool multiDrawIndirect;
+
+	MeshletBuffers(labutils::Buffer pMeshlets, labutils::Buffer pDraws, std::uint32_t pMeshletCount, bool pMultiDrawIndirect)
+		:meshlets(std::move(pMeshlets)), draws(std::move(pDraws)), meshletCount(pMeshletCount), multiDrawIndirect(pMultiDrawIndirect)
 	{}
 };
 
-IndexedMesh create_indexed_mesh(labutils::VulkanContext const&, labutils::Allocator const&, BakedModel const&,std::uint32_t meshIndex);
+// Also assigns IndexedMesh::firstMeshlet and meshletCount
+MeshletBuffers create_meshlet_buffers(labutils::VulkanContext const&, labutils::Allocator const&, BakedModelView const&, std::vector<IndexedMesh>&);
 
 struct screenImage
 {
@@ -1,21 +1,141 @@
 #include "baked_model.hpp"
 
+#include <array>
+#include <memory>
+#include <future>
+#include <type_traits>
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
 #include <cstdio>
 #include <cstring>
 
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
 #include "../labutils/error.hpp"
+#include "../labutils/compression.hpp"
+#include "../labutils/mapped_file.hpp"
 namespace lut = labutils;
 
 namespace
 {
 	// See cw2-bake/main.cpp for more info
 	constexpr char kFileMagic[16] = "\0\0COMP5822Mmesh";
-	constexpr char kFileVariant[16] = "default-cw3";
+	constexpr char kFileVariant[16] = "compact-cw3-7";
+	constexpr char kFileVariantCompressed[16] = "compact-cw3-7z";
+	constexpr char kFileVariantStream[16] = "compact-cw3-6";
+	constexpr char kFileVariantLegacy[16] = "default-cw3";
 
 	constexpr std::uint32_t kMaxString = 32 * 1024;
 
+	// Tangent frame encodings, see cw3-bake/quantize_mesh.hpp
+	constexpr std::uint32_t kFramesNormalTangent = 1;
+	constexpr std::uint32_t kFramesQTangent = 2;
+
+	// Section types of "compact-cw3-7" files, see cw3-bake/main.cpp
+	constexpr std::uint32_t kSectionTextures = 1;
+	constexpr std::uint32_t kSectionMaterials = 2;
+	constexpr std::uint32_t kSectionMeshes = 3;
+	constexpr std::uint32_t kSectionPositions = 4;
+	constexpr std::uint32_t kSectionNormals = 5;
+	constexpr std::uint32_t kSectionTangents = 6;
+	constexpr std::uint32_t kSectionQTangents = 7;
+	constexpr std::uint32_t kSectionTexcoords = 8;
+	constexpr std::uint32_t kSectionIndices = 9;
+	constexpr std::uint32_t kSectionLevels = 10;
+	constexpr std::uint32_t kSectionMeshlets = 11;
+
+	constexpr std::uint32_t kSectionTypeCount = 12;
+	constexpr std::uint32_t kSectionNoMesh = 0xffffffff;
+
+	// Entry of the section table
+	struct FileSection_
+	{
+		std::uint32_t type;
+		std::uint32_t mesh;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	static_assert(sizeof(FileSection_) == 24, "FileSection_ must match the section table entries");
+
+	// Fixed-size records of the materials, meshes and levels sections
+	constexpr std::size_t kMaterialRecordSize = 5 * sizeof(std::uint32_t) + 8 * sizeof(float);
+	constexpr std::size_t kMeshRecordSize = 8 * sizeof(std::uint32_t) + 2 * sizeof(glm::vec3);
+	constexpr std::size_t kLevelRecordSize = 5 * sizeof(std::uint32_t);
+
+	static_assert(sizeof(BakedMeshLod) == kLevelRecordSize, "BakedMeshLod must match the level records");
+
+	// A single block of memory, handed out front to back. The size of the
+	// block is the sum of all reserve() calls made before allocate_block().
+	class Arena_
+	{
+	public:
+		void reserve(std::size_t aBytes) noexcept;
+		void allocate_block();
+
+		template< typename tType >
+		tType* allocate(std::size_t aCount);
+
+		std::size_t capacity() const noexcept { return mCapacity; }
+
+	private:
+		std::unique_ptr<std::uint8_t[]> mBlock;
+		std::size_t mCapacity = 0, mUsed = 0;
+	};
+
+	// Storage of a BakedModelView returned by map_baked_model() or by
+	// load_baked_model_arena()
+	struct ModelStorage_
+	{
+		lut::MappedFile file; // empty unless the model is used in place
+		Arena_ arena;
+	};
+
+	// A "compact-cw3-7" file that is either mapped (and used in place), or
+	// read with fread()
+	struct SectionSource_
+	{
+		std::uint8_t const* mapped;
+		FILE* file;
+		std::uint64_t size;
+	};
+
+	// Unread part of a section
+	struct ByteRange_
+	{
+		std::uint8_t const* pos;
+		std::uint8_t const* end;
+
+		std::size_t size() const noexcept { return std::size_t(end - pos); }
+	};
+
 	// functions
+	void checked_read_(FILE*, std::size_t, void*);
+
+	std::string base_path_(char const*);
+
 	BakedModel load_baked_model_(FILE*, char const*);
+	BakedModelView load_sectioned_model_(SectionSource_ const&, std::shared_ptr<ModelStorage_>, BakedModel*, char const*, std::string const& aPrefix, bool aCompressed);
+
+	template< typename tType >
+	tType* array_storage_(BakedMeshData*, std::vector<tType> BakedMeshData::*, Arena_&, std::size_t aCount);
+
+	void narrow_legacy_indices_(BakedMeshData&, std::vector<std::uint32_t> const&);
+	void single_legacy_level_(BakedMeshData&);
+	void quantize_legacy_mesh_(BakedMeshData&, std::vector<glm::vec3> const&, std::vector<glm::vec3> const&, std::vector<glm::vec2> const&);
+	void convert_tangent_frames_(std::size_t aCount, glm::i16vec2 const*, glm::i16vec4 const*, glm::i16vec4*);
+
+	void touch_pages_(void const*, std::size_t);
+
+	bool valid_texture_ids_(BakedMaterialInfo const&, std::size_t aTextureCount);
+	bool valid_indices_(std::uint8_t const* aIndices, std::size_t aCount, std::uint32_t aBytesPerIndex, std::size_t aVertexCount);
+
+	glm::i16vec4 encode_qtangent_(glm::vec3 aNormal, glm::vec4 aTangent);
 }
 
 BakedModel load_baked_model(char const* aModelPath)
@@ -37,6 +157,113 @@ BakedModel load_baked_model(char const* aModelPath)
 	}
 }
 
+BakedModelView map_baked_model(char const* aModelPath)
+{
+	auto storage = std::make_shared<ModelStorage_>();
+	storage->file = lut::map_file(aModelPath);
+
+	// Verify file magic and variant
+	auto const* file = static_cast<std::uint8_t const*>(storage->file.data);
+	if (storage->file.size < 32 || 0 != std::memcmp(file, kFileMagic, 16))
+		throw lut::Error("map_baked_model(): %s: invalid file signature!", aModelPath);
+
+	SectionSource_ const source{ file, nullptr, storage->file.size };
+
+	if (0 == std::memcmp(file + 16, kFileVariant, 16))
+		return load_sectioned_model_(source, std::move(storage), nullptr, aModelPath, base_path_(aModelPath), false);
+	if (0 == std::memcmp(file + 16, kFileVariantCompressed, 16))
+		return load_sectioned_model_(source, std::move(storage), nullptr, aModelPath, base_path_(aModelPath), true);
+
+	// Older variants are read sequentially
+	storage.reset();
+	return view_baked_model(load_baked_model(aModelPath));
+}
+
+BakedModelView load_baked_model_arena(char const* aModelPath)
+{
+	FILE* fin = std::fopen(aModelPath, "rb");
+	if (!fin)
+		throw lut::Error("load_baked_model_arena(): unable to open '%s' for reading", aModelPath);
+
+	try
+	{
+		// Verify file magic and variant
+		char header[32];
+		checked_read_(fin, sizeof(header), header);
+
+		if (0 != std::memcmp(header, kFileMagic, 16))
+			throw lut::Error("load_baked_model_arena(): %s: invalid file signature!", aModelPath);
+
+		bool const compressed = 0 == std::memcmp(header + 16, kFileVariantCompressed, 16);
+		if (!compressed && 0 != std::memcmp(header + 16, kFileVariant, 16))
+		{
+			// Older variants are read sequentially
+			std::fclose(fin);
+			fin = nullptr;
+
+			return view_baked_model(load_baked_model(aModelPath));
+		}
+
+		if (0 != std::fseek(fin, 0, SEEK_END))
+			throw lut::Error("load_baked_model_arena(): %s: unable to determine file size", aModelPath);
+
+		SectionSource_ const source{ nullptr, fin, std::uint64_t(std::ftell(fin)) };
+
+		auto ret = load_sectioned_model_(source, std::make_shared<ModelStorage_>(), nullptr, aModelPath, base_path_(aModelPath), compressed);
+		std::fclose(fin);
+		return ret;
+	}
+	catch (...)
+	{
+		if (fin)
+			std::fclose(fin);
+		throw;
+	}
+}
+
+std::future<BakedModelView> load_baked_model_async(char const* aModelPath, bool aTouchMeshData)
+{
+	return std::async(std::launch::async, [path = std::string(aModelPath), aTouchMeshData] {
+		BakedModelView ret = map_baked_model(path.c_str());
+		if (!aTouchMeshData)
+			return ret;
+
+		// Fault in the mapped mesh data here, so that the file is read on
+		// this thread rather than when the meshes are uploaded
+		for (auto const& mesh : ret.meshes)
+			touch_baked_mesh(mesh);
+
+		return ret;
+	});
+}
+
+BakedModelView view_baked_model(BakedModel&& aModel)
+{
+	struct Owned_
+	{
+		BakedModel model;
+		std::vector<BakedTextureView> textures;
+		std::vector<BakedMeshView> meshes;
+	};
+
+	auto owned = std::make_shared<Owned_>();
+	owned->model = std::move(aModel);
+
+	for (auto const& texture : owned->model.textures)
+		owned->textures.emplace_back(BakedTextureView{ texture.path.c_str(), texture.channels });
+
+	owned->meshes.reserve(owned->model.meshes.size());
+	for (auto const& mesh : owned->model.meshes)
+		owned->meshes.emplace_back(view_baked_mesh(mesh));
+
+	BakedModelView ret;
+	ret.textures = owned->textures;
+	ret.materials = owned->model.materials;
+	ret.meshes = owned->meshes;
+	ret.storage = std::move(owned);
+	return ret;
+}
+
 namespace
 {
 	void checked_read_(FILE* aFin, std::size_t aBytes, void* aBuffer)
@@ -67,18 +294,125 @@ namespace
 		return ret;
 	}
 
-	BakedModel load_baked_model_(FILE* aFin, char const* aInputName)
+	void seek_(FILE* aFin, std::uint64_t aOffset)
 	{
-		BakedModel ret;
+		if (aOffset > std::uint64_t(std::numeric_limits<long>::max()) || 0 != std::fseek(aFin, long(aOffset), SEEK_SET))
+			throw lut::Error("seek_(): unable to seek to offset %llu", static_cast<unsigned long long>(aOffset));
+	}
 
-		// Figure out base path
+	void checked_read_(ByteRange_& aRange, std::size_t aBytes, void* aBuffer)
+	{
+		if (aBytes > aRange.size())
+			throw lut::Error("checked_read_(): expected %zu bytes, got %zu", aBytes, aRange.size());
+
+		std::memcpy(aBuffer, aRange.pos, aBytes);
+		aRange.pos += aBytes;
+	}
+
+	std::uint32_t read_uint32_(ByteRange_& aRange)
+	{
+		std::uint32_t ret;
+		checked_read_(aRange, sizeof(std::uint32_t), &ret);
+		return ret;
+	}
+	std::string read_string_(ByteRange_& aRange)
+	{
+		auto const length = read_uint32_(aRange);
+
+		if (length >= kMaxString)
+			throw lut::Error("read_string_(): unexpectedly long string (%u bytes)", length);
+
+		std::string ret;
+		ret.resize(length);
+
+		checked_read_(aRange, length, ret.data());
+		return ret;
+	}
+
+	// Bounds are checked by the caller
+	void read_bytes_(SectionSource_ const& aSource, std::uint64_t aOffset, std::size_t aBytes, void* aDst)
+	{
+		if (aSource.mapped)
+		{
+			std::memcpy(aDst, aSource.mapped + aOffset, aBytes);
+			return;
+		}
+
+		seek_(aSource.file, aOffset);
+		checked_read_(aSource.file, aBytes, aDst);
+	}
+
+	// The bytes of a section, in place if the file is mapped and read into
+	// aBuffer otherwise
+	ByteRange_ section_bytes_(SectionSource_ const& aSource, FileSection_ const& aSection, std::vector<std::uint8_t>& aBuffer)
+	{
+		if (aSource.mapped)
+			return ByteRange_{ aSource.mapped + aSection.offset, aSource.mapped + aSection.offset + aSection.size };
+
+		aBuffer.resize(std::size_t(aSection.size));
+		read_bytes_(aSource, aSection.offset, aBuffer.size(), aBuffer.data());
+		return ByteRange_{ aBuffer.data(), aBuffer.data() + aBuffer.size() };
+	}
+
+	void Arena_::reserve(std::size_t aBytes) noexcept
+	{
+		// Keep every allocation 16-byte aligned, like the file's sections
+		mCapacity += (aBytes + 15) & ~std::size_t(15);
+	}
+
+	void Arena_::allocate_block()
+	{
+		assert(!mBlock);
+
+		// Not value-initialized; every allocation is written by its user.
+		// new[] returns memory that is at least 16-byte aligned.
+		mBlock.reset(new std::uint8_t[mCapacity]);
+	}
+
+	template< typename tType >
+	tType* Arena_::allocate(std::size_t aCount)
+	{
+		static_assert(alignof(tType) <= 16 && std::is_trivially_destructible<tType>::value, "Arena_ never destroys its objects");
+
+		std::size_t const bytes = (aCount * sizeof(tType) + 15) & ~std::size_t(15);
+		if (bytes > mCapacity - mUsed)
+			throw lut::Error("Arena_::allocate(): %zu bytes exceed the %zu reserved bytes", mUsed + bytes, mCapacity);
+
+		auto* ret = reinterpret_cast<tType*>(mBlock.get() + mUsed);
+		mUsed += bytes;
+
+		std::uninitialized_default_construct_n(ret, aCount);
+		return ret;
+	}
+
+	std::string base_path_(char const* aInputName)
+	{
 		char const* pathBeg = aInputName;
 		char const* pathEnd = std::strrchr(pathBeg, '/');
 
-		std::string const prefix = pathEnd
+		return pathEnd
 			? std::string(pathBeg, pathEnd + 1)
 			: ""
 			;
+	}
+
+	template< typename tType >
+	tType* array_storage_(BakedMeshData* aMesh, std::vector<tType> BakedMeshData::* aArray, Arena_& aArena, std::size_t aCount)
+	{
+		if (!aMesh)
+			return aArena.allocate<tType>(aCount);
+
+		auto& vector = aMesh->*aArray;
+		vector.resize(aCount);
+		return vector.data();
+	}
+
+	BakedModel load_baked_model_(FILE* aFin, char const* aInputName)
+	{
+		BakedModel ret;
+
+		// Figure out base path
+		std::string const prefix = base_path_(aInputName);
 
 		// Read header and verify file magic and variant
 		char magic[16];
@@ -90,7 +424,19 @@ namespace
 		char variant[16];
 		checked_read_(aFin, 16, variant);
 
-		if (0 != std::memcmp(variant, kFileVariant, 16))
+		bool const compressed = 0 == std::memcmp(variant, kFileVariantCompressed, 16);
+		if (compressed || 0 == std::memcmp(variant, kFileVariant, 16))
+		{
+			if (0 != std::fseek(aFin, 0, SEEK_END))
+				throw lut::Error("load_baked_model_(): %s: unable to determine file size", aInputName);
+
+			SectionSource_ const source{ nullptr, aFin, std::uint64_t(std::ftell(aFin)) };
+			load_sectioned_model_(source, std::make_shared<ModelStorage_>(), &ret, aInputName, prefix, compressed);
+			return ret;
+		}
+
+		bool const legacy = 0 == std::memcmp(variant, kFileVariantLegacy, 16);
+		if (!legacy && 0 != std::memcmp(variant, kFileVariantStream, 16))
 			throw lut::Error("load_baked_model_(): %s: file variant is '%s', expected '%s'", aInputName, variant, kFileVariant);
 
 		// Read texture info
@@ -118,9 +464,8 @@ namespace
 			info.alphaMaskTextureId = read_uint32_(aFin);
 			info.normalMapTextureId = read_uint32_(aFin);
 
-			assert(info.baseColorTextureId < ret.textures.size());
-			assert(info.roughnessTextureId < ret.textures.size());
-			assert(info.metalnessTextureId < ret.textures.size());
+			if (!valid_texture_ids_(info, ret.textures.size()))
+				throw lut::Error("load_baked_model_(): %s: material refers to a texture beyond the %zu textures", aInputName, ret.textures.size());
 
 			// New for Coursework 3:
 			checked_read_(aFin, sizeof(float) * 3, &info.baseColor.x);
@@ -137,26 +482,128 @@ namespace
 		{
 			BakedMeshData data;
 			data.materialId = read_uint32_(aFin);
-			assert(data.materialId < ret.materials.size());
+			if (data.materialId >= ret.materials.size())
+				throw lut::Error("load_baked_model_(): %s: invalid material index %u", aInputName, data.materialId);
 
 			auto const V = read_uint32_(aFin);
 			auto const I = read_uint32_(aFin);
 
-			data.positions.resize(V);
-			checked_read_(aFin, V * sizeof(glm::vec3), data.positions.data());
+			data.indexCount = I;
+			data.bytesPerIndex = legacy ? sizeof(std::uint32_t) : read_uint32_(aFin);
+			if (sizeof(std::uint16_t) != data.bytesPerIndex && sizeof(std::uint32_t) != data.bytesPerIndex)
+				throw lut::Error("load_baked_model_(): %s: invalid index size %u", aInputName, data.bytesPerIndex);
+
+			auto const F = legacy ? 0 : read_uint32_(aFin);
+			if (!legacy && kFramesNormalTangent != F && kFramesQTangent != F)
+				throw lut::Error("load_baked_model_(): %s: invalid tangent frame encoding %u", aInputName, F);
+
+			if (legacy)
+			{
+				std::vector<glm::vec3> positions(V), normals(V);
+				std::vector<glm::vec2> texcoords(V);
+
+				checked_read_(aFin, V * sizeof(glm::vec3), positions.data());
+				checked_read_(aFin, V * sizeof(glm::vec3), normals.data());
+				checked_read_(aFin, V * sizeof(glm::vec2), texcoords.data());
+
+				quantize_legacy_mesh_(data, positions, normals, texcoords);
+			}
+			else
+			{
+				checked_read_(aFin, sizeof(glm::vec3), &data.positionMin.x);
+				checked_read_(aFin, sizeof(glm::vec3), &data.positionScale.x);
+
+				data.positions.resize(V);
+				checked_read_(aFin, V * sizeof(glm::u16vec4), data.positions.data());
+
+				if (kFramesQTangent == F)
+				{
+					data.frames.resize(V);
+					checked_read_(aFin, V * sizeof(glm::i16vec4), data.frames.data());
+				}
+				else
+				{
+					std::vector<glm::i16vec2> normals(V);
+					std::vector<glm::i16vec4> tangents(V);
+
+					checked_read_(aFin, V * sizeof(glm::i16vec2), normals.data());
+					checked_read_(aFin, V * sizeof(glm::i16vec4), tangents.data());
 
-			data.normals.resize(V);
-			checked_read_(aFin, V * sizeof(glm::vec3), data.normals.data());
+					data.frames.resize(V);
+					convert_tangent_frames_(V, normals.data(), tangents.data(), data.frames.data());
+				}
 
-			data.texcoords.resize(V);
-			checked_read_(aFin, V * sizeof(glm::vec2), data.texcoords.data());
+				data.texcoords.resize(V);
+				checked_read_(aFin, V * sizeof(glm::u16vec2), data.texcoords.data());
+			}
 
-			data.indices.resize(I);
-			checked_read_(aFin, I * sizeof(std::uint32_t), data.indices.data());
+			// Legacy indices are checked before they are narrowed, where an
+			// out-of-range index could wrap around
+			auto const check_indices_ = [&] (void const* aIndices, std::uint32_t aBytesPerIndex) {
+				if (!valid_indices_(static_cast<std::uint8_t const*>(aIndices), I, aBytesPerIndex, V))
+					throw lut::Error("load_baked_model_(): %s: index of mesh %u exceeds its %u vertices", aInputName, i, V);
+			};
+
+			if (legacy)
+			{
+				std::vector<std::uint32_t> indices(I);
+				checked_read_(aFin, I * sizeof(std::uint32_t), indices.data());
+				check_indices_(indices.data(), sizeof(std::uint32_t));
+
+				narrow_legacy_indices_(data, indices);
+				single_legacy_level_(data);
+			}
+			else
+			{
+				data.indices.resize(std::size_t(I) * data.bytesPerIndex);
+				checked_read_(aFin, data.indices.size(), data.indices.data());
+				check_indices_(data.indices.data(), data.bytesPerIndex);
+			}
 
 			ret.meshes.emplace_back(std::move(data));
 		}
 
+		// Read levels of detail and meshlets
+		if (!legacy)
+		{
+			for (auto& data : ret.meshes)
+			{
+				auto const L = read_uint32_(aFin);
+				if (0 == L)
+					throw lut::Error("load_baked_model_(): %s: mesh without levels of detail", aInputName);
+
+				data.lods.resize(L);
+
+				for (auto& lod : data.lods)
+				{
+					lod.firstIndex = read_uint32_(aFin);
+					lod.indexCount = read_uint32_(aFin);
+					checked_read_(aFin, sizeof(float), &lod.error);
+
+					if (std::uint64_t(lod.firstIndex) + lod.indexCount > data.indexCount)
+						throw lut::Error("load_baked_model_(): %s: level of detail exceeds index range", aInputName);
+
+					auto const C = read_uint32_(aFin);
+					lod.firstMeshlet = static_cast<std::uint32_t>(data.meshlets.size());
+					lod.meshletCount = C;
+
+					data.meshlets.resize(data.meshlets.size() + C);
+
+					for (std::size_t i = lod.firstMeshlet; i < data.meshlets.size(); ++i)
+					{
+						auto& meshlet = data.meshlets[i];
+						meshlet.firstIndex = read_uint32_(aFin);
+						meshlet.indexCount = read_uint32_(aFin);
+						checked_read_(aFin, sizeof(glm::vec4), &meshlet.sphere.x);
+						checked_read_(aFin, sizeof(glm::vec4), &meshlet.cone.x);
+
+						if (meshlet.firstIndex < lod.firstIndex || std::uint64_t(meshlet.firstIndex) + meshlet.indexCount > std::uint64_t(lod.firstIndex) + lod.indexCount)
+							throw lut::Error("load_baked_model_(): %s: meshlet exceeds index range", aInputName);
+					}
+				}
+			}
+		}
+
 		// Check
 		char byte;
 		auto const check = std::fread(&byte, 1, 1, aFin);
@@ -166,4 +613,592 @@ namespace
 
 		return ret;
 	}
+
+	// Loads into aModel if it is non-null; the mesh arrays of the returned
+	// view then refer to the vectors of aModel.
+	BakedModelView load_sectioned_model_(SectionSource_ const& aSource, std::shared_ptr<ModelStorage_> aStorage, BakedModel* aModel, char const* aInputName, std::string const& aPrefix, bool aCompressed)
+	{
+		std::uint64_t const fileSize = aSource.size;
+		bool const inPlace = nullptr != aSource.mapped && !aCompressed;
+
+		assert(!aModel || !aSource.mapped);
+
+		// Read the section table. Sections must lie within the file; sections
+		// of unknown type are skipped.
+		if (fileSize < 40)
+			throw lut::Error("load_sectioned_model_(): %s: truncated header", aInputName);
+
+		std::uint32_t tableHeader[2];
+		read_bytes_(aSource, 32, sizeof(tableHeader), tableHeader);
+
+		auto const sectionCount = tableHeader[0]; // [1] is reserved
+		if (sectionCount > (fileSize - 40) / sizeof(FileSection_))
+			throw lut::Error("load_sectioned_model_(): %s: invalid section count %u", aInputName, sectionCount);
+
+		std::vector<FileSection_> table(sectionCount);
+		read_bytes_(aSource, 40, table.size() * sizeof(FileSection_), table.data());
+
+		std::array<FileSection_ const*, kSectionTypeCount> modelSections{};
+		for (auto const& section : table)
+		{
+			if (section.offset > fileSize || section.size > fileSize - section.offset)
+				throw lut::Error("load_sectioned_model_(): %s: section %u exceeds the file", aInputName, section.type);
+
+			if (kSectionNoMesh == section.mesh && section.type < kSectionTypeCount)
+			{
+				if (modelSections[section.type])
+					throw lut::Error("load_sectioned_model_(): %s: duplicate section %u", aInputName, section.type);
+
+				modelSections[section.type] = &section;
+			}
+		}
+
+		std::vector<std::uint8_t> buffer;
+		auto const model_section_ = [&] (std::uint32_t aType) -> ByteRange_ {
+			if (!modelSections[aType])
+				throw lut::Error("load_sectioned_model_(): %s: missing section %u", aInputName, aType);
+
+			return section_bytes_(aSource, *modelSections[aType], buffer);
+		};
+
+		// Read texture info. The paths are moved to the arena below.
+		auto textures = model_section_(kSectionTextures);
+
+		auto const textureCount = read_uint32_(textures);
+		if (textureCount > textures.size())
+			throw lut::Error("load_sectioned_model_(): %s: invalid texture count %u", aInputName, textureCount);
+
+		std::vector<std::string> texturePaths(textureCount);
+		std::vector<std::uint8_t> textureChannels(textureCount);
+		for (std::uint32_t i = 0; i < textureCount; ++i)
+		{
+			texturePaths[i] = aPrefix + read_string_(textures);
+			checked_read_(textures, sizeof(std::uint8_t), &textureChannels[i]);
+		}
+
+		// Read material info
+		auto materials = model_section_(kSectionMaterials);
+		if (0 != materials.size() % kMaterialRecordSize)
+			throw lut::Error("load_sectioned_model_(): %s: invalid material section size", aInputName);
+
+		std::vector<BakedMaterialInfo> materialInfos(materials.size() / kMaterialRecordSize);
+		for (auto& info : materialInfos)
+		{
+			info.baseColorTextureId = read_uint32_(materials);
+			info.roughnessTextureId = read_uint32_(materials);
+			info.metalnessTextureId = read_uint32_(materials);
+			info.alphaMaskTextureId = read_uint32_(materials);
+			info.normalMapTextureId = read_uint32_(materials);
+
+			if (!valid_texture_ids_(info, textureCount))
+				throw lut::Error("load_sectioned_model_(): %s: material refers to a texture beyond the %u textures", aInputName, textureCount);
+
+			checked_read_(materials, sizeof(float) * 3, &info.baseColor.x);
+			checked_read_(materials, sizeof(float) * 3, &info.emissiveColor.x);
+			checked_read_(materials, sizeof(float), &info.roughness);
+			checked_read_(materials, sizeof(float), &info.metalness);
+		}
+
+		// Read mesh records
+		auto meshes = model_section_(kSectionMeshes);
+		if (0 != meshes.size() % kMeshRecordSize)
+			throw lut::Error("load_sectioned_model_(): %s: invalid mesh section size", aInputName);
+
+		struct MeshRecord_
+		{
+			std::uint32_t vertexCount, frames, levelCount, meshletCount;
+		};
+
+		std::vector<MeshRecord_> records(meshes.size() / kMeshRecordSize);
+		std::vector<BakedMeshView> meshViews(records.size());
+
+		for (std::size_t i = 0; i < records.size(); ++i)
+		{
+			auto& data = meshViews[i];
+			auto& record = records[i];
+
+			data.materialId = read_uint32_(meshes);
+			record.vertexCount = read_uint32_(meshes);
+			data.indexCount = read_uint32_(meshes);
+			data.bytesPerIndex = read_uint32_(meshes);
+			record.frames = read_uint32_(meshes);
+			record.levelCount = read_uint32_(meshes);
+			record.meshletCount = read_uint32_(meshes);
+			read_uint32_(meshes); // reserved
+
+			checked_read_(meshes, sizeof(glm::vec3), &data.positionMin.x);
+			checked_read_(meshes, sizeof(glm::vec3), &data.positionScale.x);
+
+			if (data.materialId >= materialInfos.size())
+				throw lut::Error("load_sectioned_model_(): %s: invalid material index %u", aInputName, data.materialId);
+			if (sizeof(std::uint16_t) != data.bytesPerIndex && sizeof(std::uint32_t) != data.bytesPerIndex)
+				throw lut::Error("load_sectioned_model_(): %s: invalid index size %u", aInputName, data.bytesPerIndex);
+			if (kFramesNormalTangent != record.frames && kFramesQTangent != record.frames)
+				throw lut::Error("load_sectioned_model_(): %s: invalid tangent frame encoding %u", aInputName, record.frames);
+			if (0 == record.levelCount)
+				throw lut::Error("load_sectioned_model_(): %s: mesh without levels of detail", aInputName);
+		}
+
+		// Find the sections of each mesh
+		std::vector<std::array<FileSection_ const*, kSectionTypeCount>> meshSections(records.size());
+		for (auto const& section : table)
+		{
+			if (kSectionNoMesh == section.mesh || section.type >= kSectionTypeCount)
+				continue;
+
+			if (section.mesh >= meshSections.size())
+				throw lut::Error("load_sectioned_model_(): %s: section %u refers to mesh %u of %zu", aInputName, section.type, section.mesh, meshSections.size());
+
+			auto& slot = meshSections[section.mesh][section.type];
+			if (slot)
+				throw lut::Error("load_sectioned_model_(): %s: duplicate section %u for mesh %u", aInputName, section.type, section.mesh);
+
+			slot = &section;
+		}
+
+		// Check the sections of each mesh against its record, before any
+		// memory is allocated for them
+		auto const check_section_ = [&] (std::size_t aMesh, std::uint32_t aType, std::uint64_t aSize) {
+			auto const* section = meshSections[aMesh][aType];
+			if (!section)
+				throw lut::Error("load_sectioned_model_(): %s: mesh %zu lacks section %u", aInputName, aMesh, aType);
+
+			std::uint64_t size = section->size;
+			if (aCompressed)
+			{
+				std::uint8_t header[lut::kStreamHeaderSize]{};
+				read_bytes_(aSource, section->offset, std::size_t(std::min<std::uint64_t>(sizeof(header), section->size)), header);
+				size = lut::decompressed_stream_size(header, std::size_t(section->size));
+			}
+
+			if (aSize != size)
+				throw lut::Error("load_sectioned_model_(): %s: section %u of mesh %zu holds %llu bytes, expected %llu", aInputName, aType, aMesh, static_cast<unsigned long long>(size), static_cast<unsigned long long>(aSize));
+		};
+
+		for (std::size_t i = 0; i < records.size(); ++i)
+		{
+			auto const& record = records[i];
+			std::uint64_t const V = record.vertexCount;
+
+			check_section_(i, kSectionPositions, V * sizeof(glm::u16vec4));
+			if (kFramesQTangent == record.frames)
+			{
+				check_section_(i, kSectionQTangents, V * sizeof(glm::i16vec4));
+			}
+			else
+			{
+				check_section_(i, kSectionNormals, V * sizeof(glm::i16vec2));
+				check_section_(i, kSectionTangents, V * sizeof(glm::i16vec4));
+			}
+			check_section_(i, kSectionTexcoords, V * sizeof(glm::u16vec2));
+			check_section_(i, kSectionIndices, std::uint64_t(meshViews[i].indexCount) * meshViews[i].bytesPerIndex);
+			check_section_(i, kSectionLevels, record.levelCount * kLevelRecordSize);
+			check_section_(i, kSectionMeshlets, record.meshletCount * sizeof(BakedMeshlet));
+		}
+
+		// Size the arena. It holds the model's arrays and strings, and all
+		// mesh data that cannot be used in place (unless it goes to aModel):
+		// everything if the file is read, decompressed sections and converted
+		// tangent frames if it is mapped.
+		auto& arena = aStorage->arena;
+		arena.reserve(textureCount * sizeof(BakedTextureView));
+		arena.reserve(materialInfos.size() * sizeof(BakedMaterialInfo));
+		arena.reserve(meshViews.size() * sizeof(BakedMeshView));
+
+		std::size_t pathBytes = 0;
+		for (auto const& path : texturePaths)
+			pathBytes += path.size() + 1;
+
+		arena.reserve(pathBytes);
+
+		for (std::size_t i = 0; i < records.size() && !aModel; ++i)
+		{
+			auto const& record = records[i];
+			std::size_t const V = record.vertexCount;
+
+			if (!inPlace)
+			{
+				arena.reserve(V * sizeof(glm::u16vec4));
+				arena.reserve(V * sizeof(glm::u16vec2));
+				arena.reserve(std::size_t(meshViews[i].indexCount) * meshViews[i].bytesPerIndex);
+				arena.reserve(record.levelCount * sizeof(BakedMeshLod));
+				arena.reserve(record.meshletCount * sizeof(BakedMeshlet));
+			}
+
+			if (!inPlace || kFramesNormalTangent == record.frames)
+				arena.reserve(V * sizeof(glm::i16vec4));
+		}
+
+		arena.allocate_block();
+
+		BakedModelView ret;
+
+		auto* textureViews = arena.allocate<BakedTextureView>(textureCount);
+		auto* paths = arena.allocate<char>(pathBytes);
+		for (std::uint32_t i = 0; i < textureCount; ++i)
+		{
+			std::memcpy(paths, texturePaths[i].c_str(), texturePaths[i].size() + 1);
+
+			textureViews[i].path = paths;
+			textureViews[i].channels = textureChannels[i];
+
+			paths += texturePaths[i].size() + 1;
+		}
+
+		ret.textures = { textureViews, textureCount };
+
+		auto* materialArray = arena.allocate<BakedMaterialInfo>(materialInfos.size());
+		std::copy(materialInfos.begin(), materialInfos.end(), materialArray);
+		ret.materials = { materialArray, materialInfos.size() };
+
+		auto* meshArray = arena.allocate<BakedMeshView>(meshViews.size());
+		std::copy(meshViews.begin(), meshViews.end(), meshArray);
+		ret.meshes = { meshArray, meshViews.size() };
+
+		if (aModel)
+		{
+			for (std::uint32_t i = 0; i < textureCount; ++i)
+				aModel->textures.emplace_back(BakedTextureInfo{ std::move(texturePaths[i]), textureChannels[i] });
+
+			aModel->materials = std::move(materialInfos);
+
+			aModel->meshes.resize(meshViews.size());
+			for (std::size_t i = 0; i < meshViews.size(); ++i)
+			{
+				auto& mesh = aModel->meshes[i];
+				mesh.materialId = meshViews[i].materialId;
+				mesh.positionMin = meshViews[i].positionMin;
+				mesh.positionScale = meshViews[i].positionScale;
+				mesh.indexCount = meshViews[i].indexCount;
+				mesh.bytesPerIndex = meshViews[i].bytesPerIndex;
+			}
+		}
+
+		// Point the arrays of each mesh at their data. Sections are 16-byte
+		// aligned, and a mapping starts at a page boundary, so the sections
+		// of mapped files can be used in place. Other data is read or
+		// decompressed into aModel or the arena; data that is only needed
+		// during loading goes to temporary buffers instead.
+		std::vector<std::uint8_t> compressed, scratch, normalsTemp, tangentsTemp;
+		for (std::size_t i = 0; i < records.size(); ++i)
+		{
+			auto& data = meshArray[i];
+			auto* owned = aModel ? &aModel->meshes[i] : nullptr;
+			auto const& record = records[i];
+			std::size_t const V = record.vertexCount;
+
+			// Returns the data of the section, which is written to aDst
+			// unless aDst is null and the section can be used in place. The
+			// size of the section has been checked above.
+			auto const section_data_ = [&] (std::uint32_t aType, std::uint64_t aSize, std::size_t aAlign, void* aDst) -> void const* {
+				auto const& section = *meshSections[i][aType];
+
+				if (aCompressed)
+				{
+					auto const stream = section_bytes_(aSource, section, compressed);
+					lut::decompress_stream(stream.pos, stream.size(), aDst, std::size_t(aSize), scratch);
+					return aDst;
+				}
+
+				if (!aDst)
+				{
+					if (0 != section.offset % aAlign)
+						throw lut::Error("load_sectioned_model_(): %s: section %u of mesh %zu is misaligned", aInputName, aType, i);
+
+					return aSource.mapped + section.offset;
+				}
+
+				read_bytes_(aSource, section.offset, std::size_t(aSize), aDst);
+				return aDst;
+			};
+
+			auto const mesh_array_ = [&] (std::uint32_t aType, auto aArray, std::size_t aCount) {
+				auto* dst = inPlace ? nullptr : array_storage_(owned, aArray, arena, aCount);
+
+				using Element_ = std::remove_pointer_t<decltype(dst)>;
+				auto const* src = section_data_(aType, aCount * sizeof(Element_), alignof(Element_), dst);
+				return BakedArrayView<Element_>(static_cast<Element_ const*>(src), aCount);
+			};
+
+			data.positions = mesh_array_(kSectionPositions, &BakedMeshData::positions, V);
+
+			if (kFramesQTangent == record.frames)
+			{
+				data.frames = mesh_array_(kSectionQTangents, &BakedMeshData::frames, V);
+			}
+			else
+			{
+				auto const temporary_ = [&] (std::vector<std::uint8_t>& aBuffer, std::size_t aBytes) -> void* {
+					if (inPlace)
+						return nullptr;
+
+					aBuffer.resize(aBytes);
+					return aBuffer.data();
+				};
+
+				auto const* normals = static_cast<glm::i16vec2 const*>(section_data_(kSectionNormals, V * sizeof(glm::i16vec2), alignof(glm::i16vec2), temporary_(normalsTemp, V * sizeof(glm::i16vec2))));
+				auto const* tangents = static_cast<glm::i16vec4 const*>(section_data_(kSectionTangents, V * sizeof(glm::i16vec4), alignof(glm::i16vec4), temporary_(tangentsTemp, V * sizeof(glm::i16vec4))));
+
+				auto* frames = array_storage_(owned, &BakedMeshData::frames, arena, V);
+				convert_tangent_frames_(V, normals, tangents, frames);
+
+				data.frames = { frames, V };
+			}
+
+			data.texcoords = mesh_array_(kSectionTexcoords, &BakedMeshData::texcoords, V);
+			data.indices = mesh_array_(kSectionIndices, &BakedMeshData::indices, std::size_t(data.indexCount) * data.bytesPerIndex);
+
+			if (!valid_indices_(data.indices.data(), data.indexCount, data.bytesPerIndex, V))
+				throw lut::Error("load_sectioned_model_(): %s: index of mesh %zu exceeds its %zu vertices", aInputName, i, V);
+
+			// Levels of detail and meshlets are stored in the layouts of
+			// BakedMeshLod and BakedMeshlet, respectively.
+			data.lods = mesh_array_(kSectionLevels, &BakedMeshData::lods, record.levelCount);
+			data.meshlets = mesh_array_(kSectionMeshlets, &BakedMeshData::meshlets, record.meshletCount);
+
+			for (auto const& lod : data.lods)
+			{
+				if (std::uint64_t(lod.firstIndex) + lod.indexCount > data.indexCount)
+					throw lut::Error("load_sectioned_model_(): %s: level of detail exceeds index range", aInputName);
+				if (std::uint64_t(lod.firstMeshlet) + lod.meshletCount > data.meshlets.size())
+					throw lut::Error("load_sectioned_model_(): %s: level of detail exceeds meshlet range", aInputName);
+
+				for (std::uint32_t m = lod.firstMeshlet; m < lod.firstMeshlet + lod.meshletCount; ++m)
+				{
+					auto const& meshlet = data.meshlets[m];
+					if (meshlet.firstIndex < lod.firstIndex || std::uint64_t(meshlet.firstIndex) + meshlet.indexCount > std::uint64_t(lod.firstIndex) + lod.indexCount)
+						throw lut::Error("load_sectioned_model_(): %s: meshlet exceeds index range", aInputName);
+				}
+			}
+		}
+
+		ret.storage = std::move(aStorage);
+		return ret;
+	}
+
+}
+
+BakedMeshView view_baked_mesh(BakedMeshData const& aMesh)
+{
+	BakedMeshView ret;
+	ret.materialId = aMesh.materialId;
+	ret.positionMin = aMesh.positionMin;
+	ret.positionScale = aMesh.positionScale;
+	ret.positions = aMesh.positions;
+	ret.texcoords = aMesh.texcoords;
+	ret.frames = aMesh.frames;
+	ret.indexCount = aMesh.indexCount;
+	ret.bytesPerIndex = aMesh.bytesPerIndex;
+	ret.indices = aMesh.indices;
+	ret.meshlets = aMesh.meshlets;
+	ret.lods = aMesh.lods;
+	return ret;
+}
+
+void touch_baked_mesh(BakedMeshView const& aMesh)
+{
+	touch_pages_(aMesh.positions.data(), aMesh.positions.size() * sizeof(glm::u16vec4));
+	touch_pages_(aMesh.texcoords.data(), aMesh.texcoords.size() * sizeof(glm::u16vec2));
+	touch_pages_(aMesh.frames.data(), aMesh.frames.size() * sizeof(glm::i16vec4));
+	touch_pages_(aMesh.indices.data(), aMesh.indices.size());
+	touch_pages_(aMesh.meshlets.data(), aMesh.meshlets.size() * sizeof(BakedMeshlet));
+}
+
+namespace
+{
+	void narrow_legacy_indices_(BakedMeshData& aData, std::vector<std::uint32_t> const& aIndices)
+	{
+		if (aData.positions.size() <= std::size_t(std::numeric_limits<std::uint16_t>::max()) + 1)
+		{
+			std::vector<std::uint16_t> const narrow(aIndices.begin(), aIndices.end());
+
+			aData.bytesPerIndex = sizeof(std::uint16_t);
+			aData.indices.resize(narrow.size() * sizeof(std::uint16_t));
+			std::memcpy(aData.indices.data(), narrow.data(), aData.indices.size());
+		}
+		else
+		{
+			aData.bytesPerIndex = sizeof(std::uint32_t);
+			aData.indices.resize(aIndices.size() * sizeof(std::uint32_t));
+			std::memcpy(aData.indices.data(), aIndices.data(), aData.indices.size());
+		}
+	}
+
+	void single_legacy_level_(BakedMeshData& aData)
+	{
+		// Conservative sphere around the mesh's AABB; the cone test is
+		// disabled with a cutoff of one.
+		glm::vec3 const extent = aData.positionScale * 65535.f;
+
+		BakedMeshlet meshlet{};
+		meshlet.sphere = glm::vec4(aData.positionMin + 0.5f * extent, 0.5f * glm::length(extent));
+		meshlet.cone = glm::vec4(0.f, 0.f, 1.f, 1.f);
+		meshlet.firstIndex = 0;
+		meshlet.indexCount = aData.indexCount;
+
+		aData.meshlets.assign(1, meshlet);
+
+		BakedMeshLod lod{};
+		lod.firstIndex = 0;
+		lod.indexCount = aData.indexCount;
+		lod.error = 0.f;
+		lod.firstMeshlet = 0;
+		lod.meshletCount = 1;
+
+		aData.lods.assign(1, lod);
+	}
+
+	// Same encoding as cw3-bake/quantize_mesh.cpp
+	void quantize_legacy_mesh_(BakedMeshData& aData, std::vector<glm::vec3> const& aPositions, std::vector<glm::vec3> const& aNormals, std::vector<glm::vec2> const& aTexcoords)
+	{
+		glm::vec3 bmin(0.f), bmax(0.f);
+		if (!aPositions.empty())
+		{
+			bmin = bmax = aPositions[0];
+			for (auto const& p : aPositions)
+			{
+				bmin = glm::min(bmin, p);
+				bmax = glm::max(bmax, p);
+			}
+		}
+
+		glm::vec3 const extent = bmax - bmin;
+		glm::vec3 const invExtent(
+			extent.x > 0.f ? 1.f / extent.x : 0.f,
+			extent.y > 0.f ? 1.f / extent.y : 0.f,
+			extent.z > 0.f ? 1.f / extent.z : 0.f
+		);
+
+		aData.positionMin = bmin;
+		aData.positionScale = extent / 65535.f;
+
+		std::size_t const count = aPositions.size();
+		aData.positions.resize(count);
+		aData.frames.resize(count);
+		aData.texcoords.resize(count);
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			glm::vec3 const rel = (aPositions[i] - bmin) * invExtent;
+			aData.positions[i] = glm::u16vec4(glm::packUnorm1x16(rel.x), glm::packUnorm1x16(rel.y), glm::packUnorm1x16(rel.z), 0);
+
+			// No tangents; encode_qtangent_() picks one
+			aData.frames[i] = encode_qtangent_(aNormals[i], glm::vec4(0.f, 0.f, 0.f, 1.f));
+			aData.texcoords[i] = glm::u16vec2(glm::packHalf1x16(aTexcoords[i].x), glm::packHalf1x16(aTexcoords[i].y));
+		}
+	}
+
+	// Octahedral normals and tangents, see cw3-bake/quantize_mesh.cpp
+	void convert_tangent_frames_(std::size_t aCount, glm::i16vec2 const* aNormals, glm::i16vec4 const* aTangents, glm::i16vec4* aFrames)
+	{
+		for (std::size_t i = 0; i < aCount; ++i)
+		{
+			glm::vec2 const e(glm::unpackSnorm1x16(std::uint16_t(aNormals[i].x)), glm::unpackSnorm1x16(std::uint16_t(aNormals[i].y)));
+
+			glm::vec3 n(e.x, e.y, 1.f - std::abs(e.x) - std::abs(e.y));
+			float const t = std::max(-n.z, 0.f);
+			n.x += n.x >= 0.f ? -t : t;
+			n.y += n.y >= 0.f ? -t : t;
+
+			glm::vec4 const tangent(
+				glm::unpackSnorm1x16(std::uint16_t(aTangents[i].x)),
+				glm::unpackSnorm1x16(std::uint16_t(aTangents[i].y)),
+				glm::unpackSnorm1x16(std::uint16_t(aTangents[i].z)),
+				aTangents[i].w < 0 ? -1.f : 1.f
+			);
+
+			aFrames[i] = encode_qtangent_(n, tangent);
+		}
+	}
+
+	// Same encoding as cw3-bake/quantize_mesh.cpp
+	glm::i16vec4 encode_qtangent_(glm::vec3 aNormal, glm::vec4 aTangent)
+	{
+		float const len = glm::length(aNormal);
+		glm::vec3 const n = len > 0.f ? aNormal / len : glm::vec3(0.f, 0.f, 1.f);
+
+		glm::vec3 t = glm::vec3(aTangent) - n * glm::dot(n, glm::vec3(aTangent));
+		if (!(glm::length(t) > 1e-6f))
+			t = std::abs(n.x) < 0.9f ? glm::vec3(1.f, 0.f, 0.f) - n * n.x : glm::vec3(0.f, 1.f, 0.f) - n * n.y;
+		t = glm::normalize(t);
+
+		glm::quat q = glm::normalize(glm::quat_cast(glm::mat3(t, glm::cross(n, t), n)));
+		if (q.w < 0.f)
+			q = -q;
+
+		// Keep w away from zero, so that its sign survives quantization
+		constexpr float bias = 1.f / 32767.f;
+		if (q.w < bias)
+		{
+			float const scale = std::sqrt(1.f - bias * bias);
+			q.x *= scale;
+			q.y *= scale;
+			q.z *= scale;
+			q.w = bias;
+		}
+
+		if (aTangent.w < 0.f)
+			q = -q;
+
+		return glm::i16vec4(
+			std::int16_t(glm::packSnorm1x16(q.x)),
+			std::int16_t(glm::packSnorm1x16(q.y)),
+			std::int16_t(glm::packSnorm1x16(q.z)),
+			std::int16_t(glm::packSnorm1x16(q.w))
+		);
+	}
+
+	void touch_pages_(void const* aData, std::size_t aBytes)
+	{
+		constexpr std::size_t kPageSize = 4096;
+
+		auto const* bytes = static_cast<std::uint8_t const*>(aData);
+
+		// volatile: keeps the reads from being optimized away
+		std::uint8_t volatile sum = 0;
+		for (std::size_t i = 0; i < aBytes; i += kPageSize)
+			sum = sum + bytes[i];
+		if (aBytes)
+			sum = sum + bytes[aBytes-1];
+	}
+
+	bool valid_texture_ids_(BakedMaterialInfo const& aInfo, std::size_t aTextureCount)
+	{
+		// The alpha mask and the normal map are optional
+		auto const optional_ = [&] (std::uint32_t aId) {
+			return 0xffffffff == aId || aId < aTextureCount;
+		};
+
+		return aInfo.baseColorTextureId < aTextureCount
+			&& aInfo.roughnessTextureId < aTextureCount
+			&& aInfo.metalnessTextureId < aTextureCount
+			&& optional_(aInfo.alphaMaskTextureId)
+			&& optional_(aInfo.normalMapTextureId);
+	}
+
+	bool valid_indices_(std::uint8_t const* aIndices, std::size_t aCount, std::uint32_t aBytesPerIndex, std::size_t aVertexCount)
+	{
+		// Largest index; memcpy, since the indices are stored as bytes
+		std::uint32_t largest = 0;
+		if (sizeof(std::uint16_t) == aBytesPerIndex)
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+			{
+				std::uint16_t index;
+				std::memcpy(&index, aIndices + i * sizeof(std::uint16_t), sizeof(std::uint16_t));
+				largest = std::max<std::uint32_t>(largest, index);
+			}
+		}
+		else
+		{
+			for (std::size_t i = 0; i < aCount; ++i)
+			{
+				std::uint32_t index;
+				std::memcpy(&index, aIndices + i * sizeof(std::uint32_t), sizeof(std::uint32_t));
+				largest = std::max(largest, index);
+			}
+		}
+
+		return 0 == aCount || largest < aVertexCount;
+	}
 }
@@ -1,13 +1,21 @@
 #ifndef BAKED_MODEL_HPP_7D7BFF3A_1743_43DF_8D4F_D67D80FD8282
 #define BAKED_MODEL_HPP_7D7BFF3A_1743_43DF_8D4F_D67D80FD8282
 
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 
+#include <cstddef>
 #include <cstdint>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/ext/vector_int2_sized.hpp>
+#include <glm/ext/vector_int4_sized.hpp>
+#include <glm/ext/vector_uint2_sized.hpp>
+#include <glm/ext/vector_uint4_sized.hpp>
 
 /* Baked file format:
  *
@@ -25,7 +33,34 @@
  *
  *  1. Header:
  *    - 16*char: file magic = "\0\0COMP5822Mmesh"
- *    - 16*char: variant = "default" (changes later)
+ *    - 16*char: variant = "compact-cw3-7" or "compact-cw3-7z" ("compact-cw3-6"
+ *      and "default-cw3" are still accepted)
+ *
+ *    In "compact-cw3-7" files, the header continues with a section table:  COMPACT-NEW
+ *    - uint32_t: S = number of sections
+ *    - uint32_t: reserved
+ *    - repeat S times:
+ *      - uint32_t: section type
+ *      - uint32_t: mesh index, or 0xffffffff for sections of the whole model
+ *      - uint64_t: offset from the start of the file (multiple of 16)
+ *      - uint64_t: size in bytes
+ *
+ *    The sections hold the data described below, but with one section per
+ *    stream: textures (type 1), materials (2), mesh records (3), and per mesh
+ *    its positions (4), normals (5), tangents (6) or QTangents (7), texture
+ *    coordinates (8), indices (9), levels of detail (10) and meshlets (11).
+ *    Lists of fixed-size records have no count; it follows from the section
+ *    size. Mesh records add L and C (the number of levels and meshlets), and
+ *    meshlets are stored in the layout of BakedMeshlet. The exact layout of
+ *    each section is documented in cw3-bake/main.cpp (write_model_data_()).
+ *    Readers can thus seek directly to the data of any mesh.
+ *
+ *    "compact-cw3-7z" files (cw3-bake --compress) are identical, except that
+ *    each per-mesh section holds a compressed stream of its data (see
+ *    labutils/compression.hpp).
+ *
+ *    "compact-cw3-6" and older files store everything sequentially, in
+ *    the order below.
  *
  *  2. Textures
  *    - 1*uint32_t: U = number of (unique) textures
@@ -46,16 +81,62 @@
  *      - float:   base roughness           COURSEWORK3-NEW
  *      - float:   base metalness           COURSEWORK3-NEW
  *
+ *    Roughness, metalness and the alpha mask share one packed texture  COMPACT-NEW
+ *    (R = roughness, G = metalness, A = alpha mask), so their indices are
+ *    equal (the alpha mask index may still be 0xffffffff). In "default-cw3"
+ *    files, they refer to separate single-channel textures.
+ *
  *  4. Mesh data
  *    - 1*uint32_t: M = number of meshes
  *    - repeat M times:
  *      - uint32_t : material index
  *      - uint32_t : V = number of vertices
- *      - uint32_t : I = number of indices
- *      - repeat V times: vec3 position
- *      - repeat V times: vec3 normal
- *      - repeat V times: vec2 texture coordinate
- *      - repeat I times: uint32_t index
+ *      - uint32_t : I = number of indices (all levels of detail)
+ *      - uint32_t : B = bytes per index (2 or 4)     COMPACT-NEW
+ *      - uint32_t : F = tangent frame encoding       COMPACT-NEW
+ *      - vec3 : position offset                      COMPACT-NEW
+ *      - vec3 : position scale                       COMPACT-NEW
+ *      - repeat V times: u16vec4 position (uint16)   COMPACT-NEW
+ *      - if F = 1:                                   COMPACT-NEW
+ *        - repeat V times: i16vec2 normal (octahedral)
+ *        - repeat V times: i16vec4 tangent (snorm, w = handedness)
+ *      - if F = 2:                                   COMPACT-NEW
+ *        - repeat V times: i16vec4 QTangent (snorm)
+ *      - repeat V times: u16vec2 texture coord (half) COMPACT-NEW
+ *      - repeat I times: uint16_t (B = 2) or uint32_t (B = 4) index
+ *
+ *    Tangent frames are always converted to QTangents when loaded: a unit
+ *    quaternion that rotates +X onto the tangent and +Z onto the normal. The
+ *    sign of w is the handedness, i.e., bitangent = sign(w) * cross(N, T).
+ *    See cw3-bake/quantize_mesh.hpp.
+ *
+ *    In the older "default-cw3" variant, B, the position offset and scale
+ *    are absent, vertices are stored as vec3 position, vec3 normal and vec2
+ *    texture coordinates, and indices are always uint32_t. Such files are
+ *    converted when loaded, so that BakedMeshData always holds compact
+ *    vertices and, where possible, 16-bit indices. They have no tangents;
+ *    an arbitrary tangent perpendicular to the normal is used instead.
+ *
+ *  5. Levels of detail and meshlets                     COMPACT-NEW
+ *    - repeat M times (once for each mesh, in the same order):
+ *      - uint32_t : L = number of levels of detail (at least one)
+ *      - repeat L times (finest first):
+ *        - uint32_t : first index
+ *        - uint32_t : index count
+ *        - float : simplification error, in model units
+ *        - uint32_t : C = number of meshlets
+ *        - repeat C times:
+ *          - uint32_t : first index
+ *          - uint32_t : index count
+ *          - vec4 : bounding sphere (xyz = center, w = radius)
+ *          - vec4 : normal cone (xyz = axis, w = cutoff)
+ *
+ *    All levels share the mesh's vertices; their indices are stored back to
+ *    back in section 4.
+ *
+ *    "default-cw3" files lack this section. Each of their meshes is loaded
+ *    as a single level with a single meshlet, which has a bounding sphere
+ *    and a disabled cone.
  *
  * Strings are stored as
  *   - 1*uint32_t: N = length of string in chars, including terminating \0
@@ -92,8 +173,8 @@ struct BakedTextureInfo
 struct BakedMaterialInfo
 {
 	std::uint32_t baseColorTextureId;
-	std::uint32_t roughnessTextureId;
-	std::uint32_t metalnessTextureId;
+	std::uint32_t roughnessTextureId; // packed texture (R); see above
+	std::uint32_t metalnessTextureId; // packed texture (G); separate in "default-cw3"
 	std::uint32_t alphaMaskTextureId; // May be set to 0xffffffff if no alpha mask
 	std::uint32_t normalMapTextureId; // May be set to 0xffffffff if no normal map
 
@@ -102,15 +183,50 @@ struct BakedMaterialInfo
 	float roughness, metalness;
 };
 
+// Layout matches the Meshlet struct in shaders/cull.comp (std430)
+struct BakedMeshlet
+{
+	glm::vec4 sphere; // xyz: center, w: radius
+	glm::vec4 cone;   // xyz: axis, w: cutoff; see cw3-bake/meshlets.hpp
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+	std::uint32_t pad_[2];
+};
+
+static_assert(sizeof(BakedMeshlet) == 48, "BakedMeshlet must match the std430 layout in cull.comp");
+
+// A level of detail: a range of the mesh's indices and of its meshlets
+struct BakedMeshLod
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+	float error; // in model units; zero for the full-resolution level
+
+	std::uint32_t firstMeshlet;
+	std::uint32_t meshletCount;
+};
+
 struct BakedMeshData
 {
 	std::uint32_t materialId;
 
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec2> texcoords;
-	std::vector<glm::vec3> normals;
+	// Dequantized position = positionMin + positionScale * positions[i].xyz
+	glm::vec3 positionMin;
+	glm::vec3 positionScale;
+
+	std::vector<glm::u16vec4> positions; // xyz: uint16, w: unused
+	std::vector<glm::u16vec2> texcoords; // half floats
+	std::vector<glm::i16vec4> frames;    // QTangents, snorm16
+
+	// Raw index data; indexCount indices of bytesPerIndex (2 or 4) bytes each
+	std::uint32_t indexCount;
+	std::uint32_t bytesPerIndex;
+	std::vector<std::uint8_t> indices;
 
-	std::vector<std::uint32_t> indices;
+	std::vector<BakedMeshlet> meshlets;
+
+	// Finest first; always at least one
+	std::vector<BakedMeshLod> lods;
 };
 
 struct BakedModel
@@ -122,5 +238,103 @@ struct BakedModel
 
 BakedModel load_baked_model(char const* aModelPath);
 
+
+// Read-only view of an array, with the parts of the std::vector interface
+// that BakedMeshData users rely on.
+template< typename tType >
+struct BakedArrayView
+{
+	tType const* first = nullptr;
+	std::size_t count = 0;
+
+	BakedArrayView() noexcept = default;
+	BakedArrayView(tType const* aFirst, std::size_t aCount) noexcept
+		: first(aFirst)
+		, count(aCount)
+	{}
+	BakedArrayView(std::vector<tType> const& aVector) noexcept
+		: first(aVector.data())
+		, count(aVector.size())
+	{}
+
+	tType const* data() const noexcept { return first; }
+	std::size_t size() const noexcept { return count; }
+	bool empty() const noexcept { return 0 == count; }
+
+	tType const* begin() const noexcept { return first; }
+	tType const* end() const noexcept { return first + count; }
+
+	tType const& operator[](std::size_t aIndex) const noexcept { return first[aIndex]; }
+};
+
+// BakedMeshData, with the arrays referring to storage owned by the
+// BakedModelView
+struct BakedMeshView
+{
+	std::uint32_t materialId;
+
+	glm::vec3 positionMin;
+	glm::vec3 positionScale;
+
+	BakedArrayView<glm::u16vec4> positions;
+	BakedArrayView<glm::u16vec2> texcoords;
+	BakedArrayView<glm::i16vec4> frames;
+
+	std::uint32_t indexCount;
+	std::uint32_t bytesPerIndex;
+	BakedArrayView<std::uint8_t> indices;
+
+	BakedArrayView<BakedMeshlet> meshlets;
+	BakedArrayView<BakedMeshLod> lods;
+};
+
+struct BakedTextureView
+{
+	char const* path; // null-terminated
+	std::uint8_t channels;
+};
+
+// A baked model whose arrays and strings refer to memory owned by `storage`:
+// a read-only mapping of the file, a single arena, or both. The arrays stay
+// valid for as long as any copy of the view holding the storage exists.
+struct BakedModelView
+{
+	BakedArrayView<BakedTextureView> textures;
+	BakedArrayView<BakedMaterialInfo> materials;
+	BakedArrayView<BakedMeshView> meshes;
+
+	std::shared_ptr<void const> storage;
+};
+
+// Maps the file and validates it like load_baked_model(). The vertex, index,
+// level and meshlet data of "compact-cw3-7" files is used in place, so that
+// only the pages that are accessed are read, and only once. Everything else
+// (strings, the arrays of the model, decoded data) lives in one arena. Other
+// variants are loaded with load_baked_model() and viewed.
+BakedModelView map_baked_model(char const* aModelPath);
+
+// Runs map_baked_model() on a separate thread and then touches the mapped
+// mesh data, so that the file is read while the caller does other work (e.g.
+// creates the Vulkan device and pipelines). Errors are rethrown by get().
+// Without aTouchMeshData, mesh data is only read when it is first accessed
+// (e.g. by MeshResidency in cw3/mesh_residency.hpp).
+std::future<BakedModelView> load_baked_model_async(char const* aModelPath, bool aTouchMeshData = true);
+
+// Reads a "compact-cw3-7" file into a single arena, sized from its section
+// table and mesh records before any mesh data is read; no mapping is kept.
+// Other variants are loaded with load_baked_model() and viewed.
+BakedModelView load_baked_model_arena(char const* aModelPath);
+
+// Makes a view of an in-memory model, taking ownership of it
+BakedModelView view_baked_model(BakedModel&&);
+
+// View of a single in-memory mesh; the view refers to aMesh
+BakedMeshView view_baked_mesh(BakedMeshData const& aMesh);
+
+// Reads one page of each array of the mesh, so that the pages of a mapped
+// file are faulted in by the caller rather than by whoever uses them next.
+// Does nothing useful (but is harmless) for meshes in memory.
+void touch_baked_mesh(BakedMeshView const&);
+
 #endif // BAKED_MODEL_HPP_7D7BFF3A_1743_43DF_8D4F_D67D80FD8282
 
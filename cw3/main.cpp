@@ -2,8 +2,11 @@
 
 
 #include <tuple>
+#include <algorithm>
 #include <chrono>
+#include <future>
 #include <limits>
+#include <map>
 #include <vector>
 #include <stdexcept>
 
@@ -40,6 +43,7 @@ namespace lut = labutils;
 
 #include "baked_model.hpp"
 #include "MeshLoader.hpp"
+#include "mesh_residency.hpp"
 
 #include <chrono>
 #include<vulkan/vulkan.h>
@@ -80,6 +84,8 @@ namespace
 		constexpr char const* kPostprocessVertShaderPath = SHADERDIR_ "postprocess.vert.spv";
 		constexpr char const* kPostprocessFragShaderPath = SHADERDIR_ "postprocess.frag.spv";
 
+		constexpr char const* kCullCompShaderPath = SHADERDIR_ "cull.comp.spv";
+
 
 #		undef SHADERDIR_
 
@@ -105,6 +111,19 @@ namespace
 		constexpr float kCameraFar = 100.f;
 		constexpr auto kCameraFov = 60.0_degf;
 
+		// Level of detail selection: maximum simplification error on screen,
+		// in pixels, and the relative band in which the level is kept
+		constexpr float kLodPixelError = 1.f;
+		constexpr float kLodHysteresis = 0.25f;
+
+		// Mesh residency (see mesh_residency.hpp): memory for the mesh data
+		// read from the model (including the staging ring) and for the GPU
+		// buffers of meshes, and uploads started per frame
+		constexpr std::uint64_t kMeshCpuBudget = std::uint64_t(256) << 20;
+		constexpr std::uint64_t kMeshGpuBudget = std::uint64_t(512) << 20;
+		constexpr std::uint64_t kMeshUploadBytesPerFrame = std::uint64_t(8) << 20;
+		constexpr std::uint32_t kMeshUploadsPerFrame = 64;
+
 
 		constexpr float kCameraBaseSpeed = 1.7f; // units/second 
 		constexpr float kCameraFastMult = 5.f; // speed multiplier 
@@ -177,8 +196,19 @@ namespace
 			float data[22];
 		};
 
+		// Vertex stage push constants for meshes with compact vertices. These
+		// follow the fragment stage's two ints, at a vec4-aligned offset.
+		struct MeshPushConstants
+		{
+			glm::vec4 positionMin;
+			glm::vec4 positionScale;
+		};
+
+		constexpr std::uint32_t kMeshPushConstantsOffset = 16;
+
 		static_assert(sizeof(SceneUniform) <= 65536, "SceneUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
 		static_assert(sizeof(SceneUniform) % 4 == 0, "SceneUniform size must be a multiple of 4 bytes");
+		static_assert(kMeshPushConstantsOffset + sizeof(MeshPushConstants) <= 128, "Push constants must fit in the guaranteed 128 bytes");
 
 	}
 
@@ -211,6 +241,8 @@ namespace
 	lut::DescriptorSetLayout create_horizontal_descriptor_layout(lut::VulkanWindow const&);
 	lut::DescriptorSetLayout create_PBR_descriptor_layout(lut::VulkanWindow const&);
 
+	lut::DescriptorSetLayout create_meshlet_descriptor_layout(lut::VulkanWindow const&);
+
 
 
 
@@ -228,6 +260,8 @@ namespace
 
 	lut::PipelineLayout create_postprocess_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout const& aGaussianLayout, VkDescriptorSetLayout const& aPBRLayout);
 
+	lut::PipelineLayout create_cull_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout const& aSceneLayout, VkDescriptorSetLayout const& aMeshletLayout);
+
 
 	lut::Pipeline create_piepline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
 	lut::Pipeline create_alpha_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout);
@@ -239,6 +273,8 @@ namespace
 	lut::Pipeline create_filter_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout,
 		char const* kVertShaderPath, char const* kFragShaderPath, uint32_t subpassIndex);
 
+	lut::Pipeline create_cull_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout);
+
 
 	void create_swapchain_framebuffers
 		(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, std::vector<lut::Framebuffer>& aFramebuffers,
@@ -280,7 +316,7 @@ namespace
 		VkDescriptorSet aSceneDescriptors,
 		VkDescriptorSet lightDescriptors,
 		VkDescriptorSet interImageDescriptor,
-		BakedModel const& bakedModel,
+		BakedModelView const& bakedModel,
 		glsl::MaterialUniform& aMaterialUniform,
 		std::vector<VkDescriptorSet*>* materialDescriptor,
 		std::vector<VkBuffer*>* materialBuffer,
@@ -315,7 +351,13 @@ namespace
 
 		glsl::GaussianUniform& hGaussianUniform,
 		VkBuffer hGaussianUBO,
-		VkDescriptorSet hGaussianDescriptors
+		VkDescriptorSet hGaussianDescriptors,
+
+		//Meshlet culling
+		VkPipeline cullPipe,
+		VkPipelineLayout cullPipeLayout,
+		VkDescriptorSet meshletDescriptors,
+		MeshletBuffers const& meshletBuffers
 	);
 	void submit_commands(
 		lut::VulkanContext const&,
@@ -337,6 +379,12 @@ int main() try
 {
 	//TODO-implement me.
 
+	// Start loading the model right away; the file is parsed while the
+	// window, device and pipelines are created below. Mesh data is read by
+	// MeshResidency when the meshes are first needed.
+	auto const startupStart = Clock_::now();
+	std::future<BakedModelView> bakedModelFuture = load_baked_model_async("assets/cw3/ship.comp5822mesh", false);
+
 	// Create our Vulkan Window
 	lut::VulkanWindow window = lut::make_vulkan_window();
 
@@ -376,6 +424,8 @@ int main() try
 	lut::DescriptorSetLayout verticalLayout = create_intermediateImage_descriptor_layout(window);
 	lut::DescriptorSetLayout horizontalLayout = create_intermediateImage_descriptor_layout(window);
 
+	//Meshlet culling
+	lut::DescriptorSetLayout meshletLayout = create_meshlet_descriptor_layout(window);
 
 
 	// Intialize render passes
@@ -398,6 +448,8 @@ int main() try
 	lut::PipelineLayout horizontalPipeLayout = create_horizontal_pipeline_layout(window, verticalLayout.handle, hGaussianLayout.handle);
 	lut::PipelineLayout postProcessPipelayout = create_postprocess_pipeline_layout(window, horizontalLayout.handle, PBR_layout.handle);
 
+	lut::PipelineLayout cullPipeLayout = create_cull_pipeline_layout(window, sceneLayout.handle, meshletLayout.handle);
+
 
 	//Pipe line
 	lut::Pipeline pipe = create_piepline(window, renderPass.handle, pipeLayout.handle);
@@ -410,6 +462,9 @@ int main() try
 	lut::Pipeline horizontalPipeline = create_filter_pipeline(window, filterPass.handle, horizontalPipeLayout.handle, cfg::kHorizontalVertShaderPath, cfg::kHorizontalFragShaderPath, 2);//No vertexinput
 	lut::Pipeline postprocessPipeline = create_filter_pipeline(window, postProcessPass.handle, postProcessPipelayout.handle, cfg::kPostprocessVertShaderPath, cfg::kPostprocessFragShaderPath, 0);//No vertexinput
 
+	//Meshlet culling (compute; independent of the swapchain)
+	lut::Pipeline cullPipeline = create_cull_pipeline(window, cullPipeLayout.handle);
+
 
 	//Samling sampler---------------
 	lut::Sampler defalutSampler = lut::create_default_sampler(window);
@@ -565,13 +620,58 @@ int main() try
 
 
 	//Load model and meshes----------------------------------------------------------------------
-	BakedModel bakedModel = load_baked_model("assets/cw3/ship.comp5822mesh");
-	std::vector<IndexedMesh>* indexedMesh = new std::vector<IndexedMesh>;
-	for (int i = 0; i < bakedModel.meshes.size(); i++)
+	auto const setupDone = Clock_::now();
+	BakedModelView bakedModel = bakedModelFuture.get();
+	auto const modelReady = Clock_::now();
+
+	std::printf("Startup: Vulkan setup %.1f ms, then waited %.1f ms for the model\n",
+		std::chrono::duration<float, std::milli>(setupDone - startupStart).count(),
+		std::chrono::duration<float, std::milli>(modelReady - setupDone).count()
+	);
+
+	// Meshes are loaded and uploaded when they first become visible, and
+	// evicted when they have not been visible for a while and a budget is
+	// exceeded. Until then, their IndexedMesh has no buffers and is skipped.
+	MeshResidency residency(window, allocator, bakedModel, MeshResidencyBudget{
+		cfg::kMeshCpuBudget,
+		cfg::kMeshGpuBudget,
+		cfg::kMeshUploadBytesPerFrame,
+		cfg::kMeshUploadsPerFrame
+	});
+	std::vector<IndexedMesh>* indexedMesh = &residency.meshes();
+
+	// Meshlets of all meshes and one indirect draw per meshlet, filled in by
+	// the culling pass each frame
+	MeshletBuffers meshletBuffers = create_meshlet_buffers(window, allocator, bakedModel, *indexedMesh);
+
+	VkDescriptorSet meshletDescriptors = lut::alloc_desc_set(window, dpool.handle, meshletLayout.handle);
 	{
-		auto mesh = bakedModel.meshes[i];
-		IndexedMesh temp = create_indexed_mesh(window, allocator, bakedModel, i);
-		indexedMesh->emplace_back(std::move(temp));
+		VkWriteDescriptorSet desc[2]{};
+
+		VkDescriptorBufferInfo meshletInfo{};
+		meshletInfo.buffer = meshletBuffers.meshlets.buffer;
+		meshletInfo.range = VK_WHOLE_SIZE;
+
+		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[0].dstSet = meshletDescriptors;
+		desc[0].dstBinding = 0;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		desc[0].descriptorCount = 1;
+		desc[0].pBufferInfo = &meshletInfo;
+
+		VkDescriptorBufferInfo drawInfo{};
+		drawInfo.buffer = meshletBuffers.draws.buffer;
+		drawInfo.range = VK_WHOLE_SIZE;
+
+		desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[1].dstSet = meshletDescriptors;
+		desc[1].dstBinding = 1;
+		desc[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		desc[1].descriptorCount = 1;
+		desc[1].pBufferInfo = &drawInfo;
+
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
 	}
 
 
@@ -583,6 +683,52 @@ int main() try
 	std::vector<lut::Image> imageSet;
 	std::vector<lut::ImageView>imageViewSet;
 
+	// Each texture is loaded once, on first use; meshes that share a texture
+	// share the image. Textures baked by cw3-bake already contain their mip
+	// levels, and are uploaded directly; they may be block-compressed, so
+	// views use the format of the image.
+	std::vector<std::size_t> textureSlots(bakedModel.textures.size(), ~std::size_t(0));
+	auto const texture_view_ = [&](std::uint32_t aTextureId) -> VkImageView
+	{
+		auto& slot = textureSlots[aTextureId];
+		if (~std::size_t(0) == slot)
+		{
+			const char* path = bakedModel.textures[aTextureId].path;
+
+			slot = imageSet.size();
+			imageSet.push_back(lut::is_baked_texture(path)
+				? lut::load_baked_texture2d(path, window, loadCmdPool.handle, allocator)
+				: lut::load_image_texture2d(path, window, loadCmdPool.handle, allocator)
+			);
+			imageViewSet.push_back(lut::create_image_view_texture2d(window, imageSet[slot].image, imageSet[slot].format));
+		}
+
+		return imageViewSet[slot].handle;
+	};
+
+	// Roughness and metalness are packed into one texture by cw3-bake (R and
+	// G). Models baked before that ("default-cw3") reference two separate
+	// images, which are packed here instead.
+	std::map<std::pair<std::uint32_t, std::uint32_t>, std::size_t> legacyRoughMetalSlots;
+	auto const rough_metal_view_ = [&](std::uint32_t aRoughnessId, std::uint32_t aMetalnessId) -> VkImageView
+	{
+		if (aRoughnessId == aMetalnessId)
+			return texture_view_(aRoughnessId);
+
+		auto const [it, isNew] = legacyRoughMetalSlots.emplace(std::make_pair(aRoughnessId, aMetalnessId), imageSet.size());
+		if (isNew)
+		{
+			imageSet.push_back(lut::load_packed_texture2d(
+				bakedModel.textures[aRoughnessId].path,
+				bakedModel.textures[aMetalnessId].path,
+				window, loadCmdPool.handle, allocator
+			));
+			imageViewSet.push_back(lut::create_image_view_texture2d(window, imageSet.back().image, imageSet.back().format));
+		}
+
+		return imageViewSet[it->second].handle;
+	};
+
 	for (int i = 0; i < indexedMesh->size(); i++)//changed
 	{
 
@@ -590,24 +736,16 @@ int main() try
 
 		//Sampling base color
 		std::uint32_t baseColorId = bakedModel.materials[materialId].baseColorTextureId;
-		const char* baseColorPath = bakedModel.textures[baseColorId].path.c_str();
 
-		imageSet.push_back(std::move((lut::load_image_texture2d(baseColorPath, window, loadCmdPool.handle, allocator))));
-		imageViewSet.push_back(std::move((lut::create_image_view_texture2d(window, imageSet[3 * i].image, VK_FORMAT_R8G8B8A8_SRGB))));
-
-		//Sampling roughness
+		//Sampling roughness (R) and metalness (G)
 		std::uint32_t roughnessId = bakedModel.materials[materialId].roughnessTextureId;
-		const char* roughnessPath = bakedModel.textures[roughnessId].path.c_str();
-
-		imageSet.push_back(std::move((lut::load_image_texture2d(roughnessPath, window, loadCmdPool.handle, allocator))));
-		imageViewSet.push_back(std::move((lut::create_image_view_texture2d(window, imageSet[3 * i + 1].image, VK_FORMAT_R8G8B8A8_SRGB))));
-
-		//Sampling metalness
 		std::uint32_t metalnessId = bakedModel.materials[materialId].metalnessTextureId;
-		const char* metalnessPath = bakedModel.textures[metalnessId].path.c_str();
 
-		imageSet.push_back(std::move((lut::load_image_texture2d(metalnessPath, window, loadCmdPool.handle, allocator))));
-		imageViewSet.push_back(std::move((lut::create_image_view_texture2d(window, imageSet[3 * i + 2].image, VK_FORMAT_R8G8B8A8_SRGB))));
+		//Normal map; materials without one never sample it (isNormalMap), but
+		//the descriptor must still be valid
+		std::uint32_t normalMapId = bakedModel.materials[materialId].normalMapTextureId;
+		if (0xffffffff == normalMapId)
+			normalMapId = baseColorId;
 
 
 		VkDescriptorSet* textureDescriptors = new VkDescriptorSet;
@@ -620,7 +758,7 @@ int main() try
 
 			//Base color
 			textureInfo[0].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			textureInfo[0].imageView = imageViewSet[3 * i].handle;
+			textureInfo[0].imageView = texture_view_(baseColorId);
 			textureInfo[0].sampler = defalutSampler.handle;
 
 			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -630,9 +768,9 @@ int main() try
 			desc[0].descriptorCount = 1;
 			desc[0].pImageInfo = &textureInfo[0];
 
-			//Roughness
+			//Roughness and metalness
 			textureInfo[1].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			textureInfo[1].imageView = imageViewSet[3 * i + 1].handle;
+			textureInfo[1].imageView = rough_metal_view_(roughnessId, metalnessId);
 			textureInfo[1].sampler = defalutSampler.handle;
 
 			desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -642,9 +780,9 @@ int main() try
 			desc[1].descriptorCount = 1;
 			desc[1].pImageInfo = &textureInfo[1];
 
-			//Metalness
+			//Normal map
 			textureInfo[2].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-			textureInfo[2].imageView = imageViewSet[3 * i + 2].handle;
+			textureInfo[2].imageView = texture_view_(normalMapId);
 			textureInfo[2].sampler = defalutSampler.handle;
 
 			desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
@@ -820,6 +958,12 @@ int main() try
 	bool recreateSwapchain = false;
 	auto previousClock = Clock_::now();
 
+	// Frames are numbered from one; cbFrames holds the last frame submitted
+	// with each command buffer. Waiting for a command buffer's fence means
+	// that this frame and all frames before it have completed.
+	std::uint64_t frameNumber = 0, completedFrame = 0;
+	std::vector<std::uint64_t> cbFrames(cbuffers.size(), 0);
+
 	while (!glfwWindowShouldClose(window.window))
 	{
 
@@ -830,6 +974,7 @@ int main() try
 		{
 			//TODO: re-create swapchain and associated resources!
 			vkDeviceWaitIdle(window.device);
+			completedFrame = frameNumber;
 
 			// Recreate them 
 			auto const changes = recreate_swapchain(window);
@@ -1013,6 +1158,26 @@ int main() try
 			throw lut::Error("Unable to reset command buffer fence %u\n" "vkResetFences() returned %s", imageIndex, lut::to_string(res).c_str());
 		}
 
+		completedFrame = std::max(completedFrame, cbFrames[imageIndex]);
+		cbFrames[imageIndex] = ++frameNumber;
+
+		// Update the camera and pick the levels of detail of this frame before
+		// recording it, so that the cull pass and the draws agree
+		auto const now = Clock_::now();
+		auto const dt = std::chrono::duration_cast<Secondsf_>(now - previousClock).count();
+		previousClock = now;
+
+		update_user_state(state, dt);
+		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, state);
+
+		float const pixelsPerUnit = window.swapchainExtent.height / (2.f * std::tan(0.5f * lut::Radians(cfg::kCameraFov).value()));
+		select_lod_levels(*indexedMesh, sceneUniforms.cameraPos, pixelsPerUnit, cfg::kLodPixelError, cfg::kLodHysteresis);
+
+		residency.request_visible(sceneUniforms.projCam, sceneUniforms.cameraPos);
+
+		// Finish mesh loads and uploads; never waits
+		residency.update(frameNumber, completedFrame);
+
 		//TODO: record and submit commands
 
 		assert(std::size_t(imageIndex) < cbuffers.size());
@@ -1069,7 +1234,12 @@ int main() try
 			vGaussianDescriptors,
 			hGaussianUniform,
 			hGaussianUBO.buffer,
-			hGaussianDescriptors
+			hGaussianDescriptors,
+
+			cullPipeline.handle,
+			cullPipeLayout.handle,
+			meshletDescriptors,
+			meshletBuffers
 		);
 
 		submit_commands(
@@ -1087,13 +1257,6 @@ int main() try
 			renderFinished.handle,
 			recreateSwapchain);
 
-
-		auto const now = Clock_::now();
-		auto const dt = std::chrono::duration_cast<Secondsf_>(now - previousClock).count();
-		previousClock = now;
-
-		update_user_state(state, dt);
-		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, state);
 	}
 
 	// Cleanup takes place automatically in the destructors, but we sill need
@@ -1120,7 +1283,15 @@ int main() try
 
 	delete textureDescriptorsSet;
 	delete bufferVec;
-	delete indexedMesh;
+
+	auto const& residencyStats = residency.stats();
+	std::printf("Mesh residency: %llu loads, %llu uploads (%.1f MiB staging), %llu CPU and %llu GPU evictions\n",
+		(unsigned long long)residencyStats.loads,
+		(unsigned long long)residencyStats.uploads,
+		residencyStats.stagingBytes / (1024.0 * 1024.0),
+		(unsigned long long)residencyStats.cpuEvictions,
+		(unsigned long long)residencyStats.gpuEvictions
+	);
 	return 0;
 }
 catch (std::exception const& eErr)
@@ -1761,18 +1932,23 @@ namespace
 		aLightSource
 		};
 
-		VkPushConstantRange pushConstantRange{};
-		pushConstantRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-		pushConstantRange.offset = 0;
-		pushConstantRange.size = sizeof(int) + sizeof(int);
+		VkPushConstantRange pushConstantRanges[2]{};
+		pushConstantRanges[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+		pushConstantRanges[0].offset = 0;
+		pushConstantRanges[0].size = sizeof(int) + sizeof(int);
+
+		//Dequantization of compact vertex positions
+		pushConstantRanges[1].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRanges[1].offset = glsl::kMeshPushConstantsOffset;
+		pushConstantRanges[1].size = sizeof(glsl::MeshPushConstants);
 
 		//create a pipeline layout object(VkPipelineLayout),
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
 		layoutInfo.pSetLayouts = layouts;
-		layoutInfo.pushConstantRangeCount = 1;
-		layoutInfo.pPushConstantRanges = &pushConstantRange;
+		layoutInfo.pushConstantRangeCount = sizeof(pushConstantRanges) / sizeof(pushConstantRanges[0]);
+		layoutInfo.pPushConstantRanges = pushConstantRanges;
 
 		VkPipelineLayout layout = VK_NULL_HANDLE;
 		if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
@@ -1875,6 +2051,37 @@ namespace
 
 
 
+	lut::PipelineLayout create_cull_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout const& aSceneLayout, VkDescriptorSetLayout const& aMeshletLayout)
+	{
+		VkDescriptorSetLayout layouts[] = { // Order must match the set = N in the shaders 
+			aSceneLayout,
+			aMeshletLayout
+		};
+
+		// Meshlet range of one level of detail (uCull.firstMeshlet, uCull.meshletCount)
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = 2 * sizeof(std::uint32_t);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
+		layoutInfo.pSetLayouts = layouts;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushConstantRange;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create pipeline layout\n""vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str());
+		}
+		return lut::PipelineLayout(aContext.device, layout);
+	}
+
+
+
+
 	lut::Pipeline create_piepline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout)
 	{
 
@@ -2372,33 +2579,34 @@ namespace
 		depthInfo.minDepthBounds = 0.f;
 		depthInfo.maxDepthBounds = 1.f;
 
+		//Compact vertices (see baked_model.hpp); 20 bytes per vertex in total
 		VkVertexInputBindingDescription vertexInputs[3]{};
 		vertexInputs[0].binding = 0;
-		vertexInputs[0].stride = sizeof(float) * 3;
+		vertexInputs[0].stride = sizeof(std::uint16_t) * 4;
 		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		vertexInputs[1].binding = 1;
-		vertexInputs[1].stride = sizeof(float) * 2;
+		vertexInputs[1].stride = sizeof(std::uint16_t) * 2;
 		vertexInputs[1].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		vertexInputs[2].binding = 2;
-		vertexInputs[2].stride = sizeof(float) * 3;
+		vertexInputs[2].stride = sizeof(std::int16_t) * 4;
 		vertexInputs[2].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
 		VkVertexInputAttributeDescription vertexAttributes[3]{};
 		vertexAttributes[0].binding = 0; // must match binding above 
 		vertexAttributes[0].location = 0; // must match shader 
-		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		vertexAttributes[0].format = VK_FORMAT_R16G16B16A16_UINT; // steps of positionScale from positionMin
 		vertexAttributes[0].offset = 0;
 
 		vertexAttributes[1].binding = 1; // must match binding above 
 		vertexAttributes[1].location = 1; // must match shader 
-		vertexAttributes[1].format = VK_FORMAT_R32G32_SFLOAT;
+		vertexAttributes[1].format = VK_FORMAT_R16G16_SFLOAT;
 		vertexAttributes[1].offset = 0;
 
 		vertexAttributes[2].binding = 2; // must match binding above 
 		vertexAttributes[2].location = 2; // must match shader 
-		vertexAttributes[2].format = VK_FORMAT_R32G32B32_SFLOAT;
+		vertexAttributes[2].format = VK_FORMAT_R16G16B16A16_SNORM; // QTangent
 		vertexAttributes[2].offset = 0;
 
 
@@ -2619,6 +2827,31 @@ namespace
 
 
 
+	lut::Pipeline create_cull_pipeline(lut::VulkanWindow const& aWindow, VkPipelineLayout aPipelineLayout)
+	{
+		lut::ShaderModule comp = lut::load_shader_module(aWindow, cfg::kCullCompShaderPath);
+
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeInfo.stage.module = comp.handle;
+		pipeInfo.stage.pName = "main";
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aWindow.device,
+			VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create compute pipeline\n"
+				"vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aWindow.device, pipe);
+	}
+
+
+
 	void create_swapchain_framebuffers(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, std::vector<lut::Framebuffer>& aFramebuffers, 
 		VkImageView aDepthView,VkImageView aInterImageView)
 	{
@@ -2854,7 +3087,7 @@ namespace
 		VkDescriptorSet aSceneDescriptors,
 		VkDescriptorSet lightDescriptors,
 		VkDescriptorSet interImageDescriptors,
-		BakedModel const& bakedModel,
+		BakedModelView const& bakedModel,
 		glsl::MaterialUniform& aMaterialUniform,
 		std::vector<VkDescriptorSet*>* materialDescriptor,
 		std::vector<VkBuffer*>* materialBuffer,
@@ -2890,7 +3123,13 @@ namespace
 
 		glsl::GaussianUniform& hGaussianUniform,
 		VkBuffer hGaussianUBO,
-		VkDescriptorSet hGaussianDescriptors
+		VkDescriptorSet hGaussianDescriptors,
+
+		//Meshlet culling
+		VkPipeline cullPipe,
+		VkPipelineLayout cullPipeLayout,
+		VkDescriptorSet meshletDescriptors,
+		MeshletBuffers const& meshletBuffers
 	)
 	{
 		// Begin recording commands 
@@ -2909,7 +3148,7 @@ namespace
 		lut::buffer_barrier(aCmdBuff, aSceneUBO,
 			VK_ACCESS_UNIFORM_READ_BIT,
 			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT);
 
 		vkCmdUpdateBuffer(aCmdBuff, aSceneUBO, 0, sizeof(glsl::SceneUniform), &aSceneUniform);
@@ -2919,7 +3158,7 @@ namespace
 			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_ACCESS_UNIFORM_READ_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
 		);
 
 		// Upload light uniforms
@@ -2970,6 +3209,45 @@ namespace
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 
+		// Cull meshlets: one indirect draw per meshlet, with zero instances
+		// if the meshlet is outside of the view frustum or facing away. Only
+		// the meshlets of the selected level of each resident mesh are culled;
+		// these are the only ones drawn below.
+		if (meshletBuffers.meshletCount > 0)
+		{
+			lut::buffer_barrier(aCmdBuff, meshletBuffers.draws.buffer,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipe);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeLayout, 0, 1, &aSceneDescriptors, 0, nullptr);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeLayout, 1, 1, &meshletDescriptors, 0, nullptr);
+
+			for (std::size_t i = 0; i < indexedMesh->size(); ++i)
+			{
+				auto const& mesh = (*indexedMesh)[i];
+				if (VK_NULL_HANDLE == mesh.pos.buffer)
+					continue;
+
+				auto const& lod = mesh.lods[mesh.lodLevel];
+				if (0 == lod.meshletCount)
+					continue;
+
+				std::uint32_t const range[2] = { mesh.firstMeshlet + lod.firstMeshlet, lod.meshletCount };
+				vkCmdPushConstants(aCmdBuff, cullPipeLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(range), range);
+
+				vkCmdDispatch(aCmdBuff, (lod.meshletCount + 63) / 64, 1, 1); // local_size_x = 64 in cull.comp
+			}
+
+			lut::buffer_barrier(aCmdBuff, meshletBuffers.draws.buffer,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT);
+		}
+
 		// Begin render pass 
 		VkClearValue clearValues[5]{};
 		clearValues[0].color.float32[0] = 0.0f; // Clear to a dark gray background. 
@@ -3015,16 +3293,19 @@ namespace
 		//Bind vertex input for indexed mesh
 		for (int i = 0; i < indexedMesh->size(); i++)
 		{
+			// Not resident (yet), see MeshResidency
+			if (VK_NULL_HANDLE == (*indexedMesh)[i].pos.buffer)
+				continue;
 
 			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, bright_PBR_layout, 1, 1, (*materialDescriptor)[i], 0, nullptr);
 
 			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, bright_PBR_layout, 2, 1, (*textureDescriptorsSet)[i], 0, nullptr);
 
-			VkBuffer buffers[3] = { (*indexedMesh)[i].pos.buffer,(*indexedMesh)[i].texcoords.buffer,(*indexedMesh)[i].normals.buffer };
+			VkBuffer buffers[3] = { (*indexedMesh)[i].pos.buffer,(*indexedMesh)[i].texcoords.buffer,(*indexedMesh)[i].frames.buffer };
 			VkDeviceSize offsets[3]{};
 			vkCmdBindVertexBuffers(aCmdBuff, 0, 3, buffers, offsets);
 
-			vkCmdBindIndexBuffer(aCmdBuff, (*indexedMesh)[i].indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			vkCmdBindIndexBuffer(aCmdBuff, (*indexedMesh)[i].indices.buffer, 0, (*indexedMesh)[i].indexType);
 
 			int isAlpha = 0;
 			int isNormalMap = 0;
@@ -3032,9 +3313,28 @@ namespace
 			{
 				isNormalMap = 1;
 			}
-			vkCmdPushConstants(aCmdBuff, aGraphicsLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &isAlpha);
-			vkCmdPushConstants(aCmdBuff, aGraphicsLayout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(int), sizeof(int), &isNormalMap);
-			vkCmdDrawIndexed(aCmdBuff, (*indexedMesh)[i].indexSize, 1, 0, 0, 0);
+			vkCmdPushConstants(aCmdBuff, bright_PBR_layout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(int), &isAlpha);
+			vkCmdPushConstants(aCmdBuff, bright_PBR_layout, VK_SHADER_STAGE_FRAGMENT_BIT, sizeof(int), sizeof(int), &isNormalMap);
+
+			glsl::MeshPushConstants meshConstants{};
+			meshConstants.positionMin = glm::vec4((*indexedMesh)[i].positionMin, 0.f);
+			meshConstants.positionScale = glm::vec4((*indexedMesh)[i].positionScale, 0.f);
+			vkCmdPushConstants(aCmdBuff, bright_PBR_layout, VK_SHADER_STAGE_VERTEX_BIT, glsl::kMeshPushConstantsOffset, sizeof(meshConstants), &meshConstants);
+
+			// One draw per meshlet of the selected level of detail; culled
+			// meshlets have zero instances. Without multiDrawIndirect, the
+			// draw count must be one, so each meshlet gets its own call.
+			auto const& lod = (*indexedMesh)[i].lods[(*indexedMesh)[i].lodLevel];
+			VkDeviceSize const firstDraw = ((*indexedMesh)[i].firstMeshlet + lod.firstMeshlet) * sizeof(VkDrawIndexedIndirectCommand);
+			if (meshletBuffers.multiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(aCmdBuff, meshletBuffers.draws.buffer, firstDraw, lod.meshletCount, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else
+			{
+				for (std::uint32_t m = 0; m < lod.meshletCount; ++m)
+					vkCmdDrawIndexedIndirect(aCmdBuff, meshletBuffers.draws.buffer, firstDraw + m * sizeof(VkDrawIndexedIndirectCommand), 1, sizeof(VkDrawIndexedIndirectCommand));
+			}
 		}
 
 
@@ -3076,7 +3376,7 @@ namespace
 
 		//	vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, bright_PBR_layout, 2, 1, (*textureDescriptorsSet)[i], 0, nullptr);
 
-		//	VkBuffer buffers[3] = { (*indexedMesh)[i].pos.buffer,(*indexedMesh)[i].texcoords.buffer,(*indexedMesh)[i].normals.buffer };
+		//	VkBuffer buffers[3] = { (*indexedMesh)[i].pos.buffer,(*indexedMesh)[i].texcoords.buffer,(*indexedMesh)[i].frames.buffer };
 		//	VkDeviceSize offsets[3]{};
 		//	vkCmdBindVertexBuffers(aCmdBuff, 0, 3, buffers, offsets);
 
@@ -3172,7 +3472,7 @@ namespace
 		// binding = N declaration in the shader(s)! 
 		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 		bindings[0].descriptorCount = 1;
-		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT; // compute: meshlet culling
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -3193,6 +3493,34 @@ namespace
 	}
 
 
+	lut::DescriptorSetLayout create_meshlet_descriptor_layout(lut::VulkanWindow const& aWindow)
+	{
+		VkDescriptorSetLayoutBinding bindings[2]{};
+		bindings[0].binding = 0; // Meshlets
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[1].binding = 1; // Draws
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aWindow.device, layout);
+	}
+
+
 	lut::DescriptorSetLayout create_lightSource_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
 		VkDescriptorSetLayoutBinding bindings[1]{};
@@ -3269,6 +3597,8 @@ namespace
 
 	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
+		// Base colour, roughness/metalness packed into one texture, and the
+		// normal map
 		VkDescriptorSetLayoutBinding bindings[3]{};
 		bindings[0].binding = 0; // this must match the shaders 
 		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
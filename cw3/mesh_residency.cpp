@@ -0,0 +1,442 @@
+#include "mesh_residency.hpp"
+
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/to_string.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	std::uint64_t cpu_bytes_(BakedMeshView const& aMesh)
+	{
+		return indexed_mesh_bytes(aMesh)
+			+ aMesh.meshlets.size() * sizeof(BakedMeshlet)
+			+ aMesh.lods.size() * sizeof(BakedMeshLod);
+	}
+}
+
+MeshResidency::MeshResidency(lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, BakedModelView aModel, MeshResidencyBudget aBudget)
+	: mContext(aContext)
+	, mAllocator(aAllocator)
+	, mModel(std::move(aModel))
+	, mBudget(aBudget)
+	, mEntries(mModel.meshes.size())
+	, mUploadPool(lut::create_command_pool(aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT))
+{
+	mMeshes.reserve(mModel.meshes.size());
+	mCpuBytes.reserve(mModel.meshes.size());
+	mGpuBytes.reserve(mModel.meshes.size());
+	mStagingBytes.reserve(mModel.meshes.size());
+
+	VkDeviceSize largest = 0;
+	for (std::uint32_t i = 0; i < mModel.meshes.size(); ++i)
+	{
+		mMeshes.emplace_back(describe_indexed_mesh(mModel, i));
+		mCpuBytes.emplace_back(cpu_bytes_(mModel.meshes[i]));
+		mGpuBytes.emplace_back(indexed_mesh_bytes(mModel.meshes[i]));
+		mStagingBytes.emplace_back(indexed_mesh_staging_bytes(mModel.meshes[i]));
+
+		largest = std::max<VkDeviceSize>(largest, mStagingBytes.back());
+	}
+
+	// One frame's uploads can be written while the previous frame's are
+	// still being copied
+	mStaging.capacity = std::max<VkDeviceSize>(2 * mBudget.uploadBytesPerFrame, largest);
+	mStaging.buffer = lut::create_buffer(
+		mAllocator,
+		mStaging.capacity,
+		VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU,
+		VMA_ALLOCATION_CREATE_MAPPED_BIT
+	);
+	mStaging.mapped = lut::mapped_pointer(mAllocator, mStaging.buffer);
+	mStats.stagingBytes = mStaging.capacity;
+
+	mWorker = std::thread([this] { worker_(); });
+}
+
+MeshResidency::~MeshResidency()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWake.notify_all();
+	mWorker.join();
+
+	// Uploads may still be in flight. Frames that use the meshes are not
+	// tracked here; as with other resources, the caller waits for them.
+	for (auto const& batch : mUploads)
+		vkWaitForFences(mContext.device, 1, &batch->done.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max());
+}
+
+void MeshResidency::request(std::uint32_t aMeshIndex)
+{
+	assert(aMeshIndex < mEntries.size());
+
+	auto& entry = mEntries[aMeshIndex];
+	if (mRound == entry.lastRequest)
+		return;
+
+	entry.lastRequest = mRound;
+	mRequested.emplace_back(aMeshIndex);
+}
+
+void MeshResidency::request_visible(glm::mat4 const& aProjCam, glm::vec3 const& aCameraPos)
+{
+	// Side and far planes, as in shaders/cull.comp
+	glm::mat4 const m = glm::transpose(aProjCam);
+	glm::vec4 planes[5] = {
+		m[3] + m[0],
+		m[3] - m[0],
+		m[3] + m[1],
+		m[3] - m[1],
+		m[3] - m[2]
+	};
+	for (auto& plane : planes)
+		plane /= glm::length(glm::vec3(plane));
+
+	std::vector<std::pair<float, std::uint32_t>> visible;
+	for (std::uint32_t i = 0; i < mMeshes.size(); ++i)
+	{
+		// Bounding sphere of the mesh's AABB, see select_lod_levels()
+		glm::vec3 const extent = mMeshes[i].positionScale * 65535.f;
+		glm::vec3 const center = mMeshes[i].positionMin + 0.5f * extent;
+		float const radius = 0.5f * glm::length(extent);
+
+		bool inside = true;
+		for (auto const& plane : planes)
+		{
+			if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+			{
+				inside = false;
+				break;
+			}
+		}
+
+		if (inside)
+			visible.emplace_back(glm::length(center - aCameraPos) - radius, i);
+	}
+
+	std::sort(visible.begin(), visible.end());
+	for (auto const& [distance, index] : visible)
+		request(index);
+}
+
+void MeshResidency::update(std::uint64_t aFrame, std::uint64_t aCompletedFrame)
+{
+	// Release the buffers of evicted meshes that are no longer in use
+	mRetired.erase(std::remove_if(mRetired.begin(), mRetired.end(), [&](Retired_ const& aRetired) {
+		return aRetired.lastFrame <= aCompletedFrame;
+	}), mRetired.end());
+
+	// Finish completed uploads. Batches are retired in submission order, so
+	// that the staging memory in use stays contiguous (see
+	// allocate_staging_()).
+	for (auto it = mUploads.begin(); it != mUploads.end(); )
+	{
+		auto& batch = **it;
+
+		auto const res = vkGetFenceStatus(mContext.device, batch.done.handle);
+		if (VK_NOT_READY == res)
+			break;
+		if (VK_SUCCESS != res)
+		{
+			throw lut::Error("Checking mesh upload\n"
+				"vkGetFenceStatus() returned %s", lut::to_string(res).c_str());
+		}
+
+		for (auto& upload : batch.meshes)
+		{
+			auto& mesh = mMeshes[upload.meshIndex];
+			mesh.pos = std::move(upload.mesh.pos);
+			mesh.texcoords = std::move(upload.mesh.texcoords);
+			mesh.frames = std::move(upload.mesh.frames);
+			mesh.indices = std::move(upload.mesh.indices);
+
+			auto& entry = mEntries[upload.meshIndex];
+			entry.uploading = false;
+			entry.gpu = true;
+		}
+
+		vkFreeCommandBuffers(mContext.device, mUploadPool.handle, 1, &batch.cmd);
+		it = mUploads.erase(it);
+	}
+
+	// Take over meshes read by the worker
+	decltype(mLoaded) loaded;
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		std::swap(loaded, mLoaded);
+	}
+
+	for (auto const index : loaded)
+	{
+		auto& entry = mEntries[index];
+		entry.loading = false;
+		entry.cpu = true;
+
+		mLoadingBytes -= mCpuBytes[index];
+		mStats.cpuBytes += mCpuBytes[index];
+		++mStats.loads;
+	}
+
+	// Evict down to the budgets (these may have been lowered, and loads may
+	// have completed after the meshes were no longer requested)
+	make_room_cpu_(0);
+	make_room_gpu_(0, aFrame);
+
+	// Upload requested meshes whose pages have been read, and read those of
+	// the others. Staging memory from the oldest batch in flight on is
+	// still in use.
+	bool stagingInUse = !mUploads.empty();
+	VkDeviceSize stagingTail = stagingInUse ? mUploads.front()->stagingBegin : 0;
+
+	std::uint64_t staged = 0;
+	std::vector<std::pair<std::uint32_t, VkDeviceSize>> toUpload;
+	std::vector<std::uint32_t> toLoad;
+	for (auto const index : mRequested)
+	{
+		auto& entry = mEntries[index];
+		if (entry.gpu || entry.uploading || entry.loading)
+			continue;
+
+		if (entry.cpu)
+		{
+			if (!toUpload.empty() && (toUpload.size() >= mBudget.uploadMeshesPerFrame || staged + mGpuBytes[index] > mBudget.uploadBytesPerFrame))
+				continue;
+			auto const head = mStagingHead;
+
+			VkDeviceSize offset;
+			if (!allocate_staging_(mStagingBytes[index], stagingInUse, stagingTail, offset))
+				continue;
+
+			if (!make_room_gpu_(mGpuBytes[index], aFrame))
+			{
+				mStagingHead = head;
+				continue;
+			}
+
+			if (!stagingInUse)
+			{
+				stagingInUse = true;
+				stagingTail = offset;
+			}
+
+			// Counted from here on, so that make_room_gpu_() accounts for it
+			entry.uploading = true;
+			mStats.gpuBytes += mGpuBytes[index];
+
+			toUpload.emplace_back(index, offset);
+			staged += mGpuBytes[index];
+		}
+		else
+		{
+			if (!make_room_cpu_(mCpuBytes[index]))
+				continue;
+
+			entry.loading = true;
+			mLoadingBytes += mCpuBytes[index];
+			toLoad.emplace_back(index);
+		}
+	}
+
+	if (!toUpload.empty())
+		start_uploads_(toUpload);
+
+	if (!toLoad.empty())
+	{
+		{
+			std::lock_guard<std::mutex> lock(mMutex);
+			mLoadQueue.insert(mLoadQueue.end(), toLoad.begin(), toLoad.end());
+		}
+		mWake.notify_one();
+	}
+
+	mRequested.clear();
+	++mRound;
+}
+
+bool MeshResidency::make_room_cpu_(std::uint64_t aBytes)
+{
+	while (mStats.cpuBytes + mStats.stagingBytes + mLoadingBytes + aBytes > mBudget.cpuBytes)
+	{
+		// Least recently requested mesh that has been read and isn't waiting
+		// to be uploaded
+		std::size_t victim = mEntries.size();
+		for (std::size_t i = 0; i < mEntries.size(); ++i)
+		{
+			auto const& entry = mEntries[i];
+			if (!entry.cpu)
+				continue;
+			if (mRound == entry.lastRequest && !entry.gpu)
+				continue;
+
+			if (victim == mEntries.size() || entry.lastRequest < mEntries[victim].lastRequest)
+				victim = i;
+		}
+
+		if (victim == mEntries.size())
+			return false;
+
+		mEntries[victim].cpu = false;
+		mStats.cpuBytes -= mCpuBytes[victim];
+		++mStats.cpuEvictions;
+	}
+
+	return true;
+}
+
+bool MeshResidency::make_room_gpu_(std::uint64_t aBytes, std::uint64_t aFrame)
+{
+	while (mStats.gpuBytes + aBytes > mBudget.gpuBytes)
+	{
+		// Least recently requested resident mesh that wasn't requested since
+		// the last update()
+		std::size_t victim = mEntries.size();
+		for (std::size_t i = 0; i < mEntries.size(); ++i)
+		{
+			auto const& entry = mEntries[i];
+			if (!entry.gpu || mRound == entry.lastRequest)
+				continue;
+
+			if (victim == mEntries.size() || entry.lastRequest < mEntries[victim].lastRequest)
+				victim = i;
+		}
+
+		if (victim == mEntries.size())
+			return false;
+
+		// Frames up to aFrame-1 may still draw the mesh
+		auto& mesh = mMeshes[victim];
+		mRetired.emplace_back(Retired_{
+			aFrame - 1,
+			std::move(mesh.pos),
+			std::move(mesh.texcoords),
+			std::move(mesh.frames),
+			std::move(mesh.indices)
+		});
+
+		mEntries[victim].gpu = false;
+		mStats.gpuBytes -= mGpuBytes[victim];
+		++mStats.gpuEvictions;
+	}
+
+	return true;
+}
+
+bool MeshResidency::allocate_staging_(VkDeviceSize aBytes, bool aInUse, VkDeviceSize aTail, VkDeviceSize& aOffset)
+{
+	// mStaging is a ring: the bytes from aTail (the start of the oldest
+	// batch in flight) up to mStagingHead are in use. A mesh's payloads are
+	// never split, so space left at the end is skipped when wrapping.
+	if (!aInUse)
+		mStagingHead = 0;
+
+	auto const capacity = mStaging.capacity;
+	if (!aInUse || mStagingHead > aTail)
+	{
+		if (mStagingHead + aBytes <= capacity)
+			aOffset = mStagingHead;
+		else if (aInUse && aBytes <= aTail)
+			aOffset = 0;
+		else
+			return false;
+	}
+	else if (mStagingHead < aTail && mStagingHead + aBytes <= aTail)
+		aOffset = mStagingHead;
+	else
+		return false; // mStagingHead == aTail: full
+
+	mStagingHead = aOffset + aBytes;
+	return true;
+}
+
+void MeshResidency::start_uploads_(std::vector<std::pair<std::uint32_t, VkDeviceSize>> const& aUploads)
+{
+	assert(!aUploads.empty());
+
+	auto batch = std::make_unique<UploadBatch_>(UploadBatch_{
+		{},
+		lut::alloc_command_buffer(mContext, mUploadPool.handle),
+		lut::create_fence(mContext),
+		aUploads.front().second
+	});
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if (auto const res = vkBeginCommandBuffer(batch->cmd, &beginInfo); VK_SUCCESS != res)
+	{
+		throw lut::Error("Beginning command buffer recording\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	batch->meshes.reserve(aUploads.size());
+	for (auto const& [index, offset] : aUploads)
+	{
+		assert(mEntries[index].cpu);
+
+		// Staged straight from the model; for a mapped model, this reads the
+		// pages that the worker faulted in
+
+		auto& upload = batch->meshes.emplace_back(UploadBatch_::Mesh_{
+			index,
+			describe_indexed_mesh(mModel, index)
+		});
+
+		record_indexed_mesh_upload(batch->cmd, mAllocator, mModel.meshes[index], mStaging, offset, upload.mesh);
+		++mStats.uploads;
+	}
+
+	if (auto const res = vkEndCommandBuffer(batch->cmd); VK_SUCCESS != res)
+	{
+		throw lut::Error("Ending command buffer recording\n"
+			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+	}
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch->cmd;
+	if (auto const res = vkQueueSubmit(mContext.graphicsQueue, 1, &submitInfo, batch->done.handle); VK_SUCCESS != res)
+	{
+		throw lut::Error("Submitting mesh uploads\n"
+			"vkQueueSubmit() returned %s", lut::to_string(res).c_str());
+	}
+
+	mUploads.emplace_back(std::move(batch));
+}
+
+void MeshResidency::worker_()
+{
+	for (;;)
+	{
+		std::uint32_t index;
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWake.wait(lock, [this] { return mQuit || !mLoadQueue.empty(); });
+
+			if (mQuit)
+				return;
+
+			index = mLoadQueue.front();
+			mLoadQueue.pop_front();
+		}
+
+		// Reads the mesh's pages if the model is mapped
+		touch_baked_mesh(mModel.meshes[index]);
+
+		std::lock_guard<std::mutex> lock(mMutex);
+		mLoaded.emplace_back(index);
+	}
+}
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <condition_variable>
+
+#include <cstdint>
+
+#include <glm/mat4x4.hpp>
+
+#include "../labutils/vulkan_context.hpp"
+
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/allocator.hpp"
+
+#include "baked_model.hpp"
+#include "MeshLoader.hpp"
+
+
+// Limits for MeshResidency
+struct MeshResidencyBudget
+{
+	// Mesh data read from the model (the faulted-in pages of a mapped
+	// file) and the staging memory of the uploads, in bytes
+	std::uint64_t cpuBytes;
+	std::uint64_t gpuBytes; // GPU buffers of meshes (IndexedMesh), in bytes
+
+	// Limits of the uploads started by each update(); at least one mesh is
+	// uploaded if there is staging memory for it. The staging ring holds
+	// two frames' worth of uploads, or the largest mesh if that is larger.
+	std::uint64_t uploadBytesPerFrame;
+	std::uint32_t uploadMeshesPerFrame;
+};
+
+// Keeps the meshes that are in use resident, within a CPU and a GPU budget.
+//
+// A mesh is loaded when it is first requested: a worker thread faults in its
+// pages (touch_baked_mesh()), so that the file is read off the frame loop.
+// Meshes are not copied out of the model; update() stages each mesh straight
+// from the model's view into a persistently mapped staging ring and submits
+// its upload, in one batch per frame. The IndexedMesh receives its buffers
+// once the batch has completed, and the batch's staging memory is reused
+// from then on. Nothing in this waits for the file or for the GPU, so the
+// frame loop is never stalled; meshes that are not resident yet are simply
+// not drawn.
+//
+// When a budget would be exceeded, the least recently requested meshes are
+// evicted: a mesh's pages are no longer counted (they are faulted in again
+// on the next request; the OS reclaims clean file pages as needed), and GPU
+// buffers are released once the frames that may use them have completed.
+// Meshes requested since the last update() are never evicted. A mesh that is
+// larger than a budget is never made resident.
+class MeshResidency
+{
+public:
+	// aModel must stay valid (it is shared with the caller)
+	MeshResidency(labutils::VulkanContext const&, labutils::Allocator const&, BakedModelView aModel, MeshResidencyBudget);
+	~MeshResidency();
+
+	MeshResidency(MeshResidency const&) = delete;
+	MeshResidency& operator=(MeshResidency const&) = delete;
+
+	// One entry per mesh of the model; the buffers of meshes that are not
+	// resident are empty (see describe_indexed_mesh())
+	std::vector<IndexedMesh>& meshes() noexcept { return mMeshes; }
+
+	// Marks a mesh as needed and, if it is not resident, queues its load
+	void request(std::uint32_t aMeshIndex);
+
+	// Requests the meshes whose bounding spheres intersect the view frustum,
+	// nearest first
+	void request_visible(glm::mat4 const& aProjCam, glm::vec3 const& aCameraPos);
+
+	// Call once per frame, before recording frame aFrame. All commands
+	// submitted up to and including frame aCompletedFrame must have
+	// completed. Finishes loads and uploads, evicts meshes and starts new
+	// loads and uploads for the meshes requested since the last call.
+	void update(std::uint64_t aFrame, std::uint64_t aCompletedFrame);
+
+	struct Stats
+	{
+		std::uint64_t cpuBytes = 0, gpuBytes = 0, stagingBytes = 0;
+		std::uint64_t loads = 0, uploads = 0;
+		std::uint64_t cpuEvictions = 0, gpuEvictions = 0;
+	};
+
+	Stats const& stats() const noexcept { return mStats; }
+
+private:
+	struct Entry_
+	{
+		std::uint64_t lastRequest = 0;
+		bool cpu = false;       // pages faulted in by the worker
+		bool loading = false;   // queued for, or being read by, the worker
+		bool uploading = false; // upload started, but not completed
+		bool gpu = false;       // IndexedMesh buffers are valid
+	};
+
+	// Uploads started by one update(), submitted together
+	struct UploadBatch_
+	{
+		struct Mesh_
+		{
+			std::uint32_t meshIndex;
+			IndexedMesh mesh; // receives the buffers
+		};
+
+		std::vector<Mesh_> meshes;
+		VkCommandBuffer cmd;
+		labutils::Fence done;
+
+		VkDeviceSize stagingBegin; // first byte of mStaging used by the batch
+	};
+
+	// GPU buffers of an evicted mesh, released after frame `lastFrame`
+	struct Retired_
+	{
+		std::uint64_t lastFrame;
+		labutils::Buffer pos, texcoords, frames, indices;
+	};
+
+	bool make_room_cpu_(std::uint64_t aBytes);
+	bool make_room_gpu_(std::uint64_t aBytes, std::uint64_t aFrame);
+	bool allocate_staging_(VkDeviceSize aBytes, bool aInUse, VkDeviceSize aTail, VkDeviceSize& aOffset);
+	void start_uploads_(std::vector<std::pair<std::uint32_t, VkDeviceSize>> const& aUploads);
+	void worker_();
+
+	labutils::VulkanContext const& mContext;
+	labutils::Allocator const& mAllocator;
+
+	BakedModelView mModel;
+	MeshResidencyBudget mBudget;
+
+	std::vector<IndexedMesh> mMeshes;
+	std::vector<Entry_> mEntries;
+	std::vector<std::uint64_t> mCpuBytes, mGpuBytes, mStagingBytes; // per mesh
+
+	std::uint64_t mRound = 1; // incremented by each update()
+	std::vector<std::uint32_t> mRequested; // since the last update()
+
+	std::uint64_t mLoadingBytes = 0;
+
+	labutils::CommandPool mUploadPool;
+	std::vector<std::unique_ptr<UploadBatch_>> mUploads; // in submission order
+
+	MeshStaging mStaging;
+	VkDeviceSize mStagingHead = 0; // next free byte of mStaging
+	std::vector<Retired_> mRetired;
+
+	Stats mStats;
+
+	// Shared with the worker thread
+	std::mutex mMutex;
+	std::condition_variable mWake;
+	bool mQuit = false;
+	std::deque<std::uint32_t> mLoadQueue;
+	std::vector<std::uint32_t> mLoaded;
+
+	std::thread mWorker;
+};
@@ -16,13 +16,14 @@ layout( location = 0 ) in vec2 v2fTexCoord;
 layout( location = 1) in vec3 v2fNormal;
 layout( location = 2) in vec3 v2fFragCoord;
 layout( location = 3) in vec3 v2fCameraPos;
+layout( location = 4) in vec4 v2fTangent; // xyz: tangent, w: handedness
 
 layout( location = 0 ) out vec4 oColor; 
 layout( location = 1) out vec4 PBRcolor;
 
 layout( set = 2, binding = 0 ) uniform sampler2D uTexColor;
-layout( set = 2, binding = 1 ) uniform sampler2D uRoughtness;
-layout( set = 2, binding = 2 ) uniform sampler2D uMetalness;
+layout( set = 2, binding = 1 ) uniform sampler2D uRoughMetal; // R: roughness, G: metalness (packed by cw3-bake)
+layout( set = 2, binding = 2 ) uniform sampler2D uNormalMap; // tangent space, linear
 
 
 
@@ -51,13 +52,22 @@ void main()
 	vec3 emissiveColor = material.emissiveColor.rgb * 1.5;
 
 	float alpha = 1.0;
-	float roughness = texture(uRoughtness,v2fTexCoord).r *material.roughAndMentalness.x; //Shininess
+	vec2 roughMetal = texture(uRoughMetal,v2fTexCoord).rg;
+	float roughness = roughMetal.x *material.roughAndMentalness.x; //Shininess
 	float shininess = 2.0 / (pow(roughness,4) + 0.001) - 2;
-	float metalness = texture(uMetalness,v2fTexCoord).r *material.roughAndMentalness.y;
+	float metalness = roughMetal.y *material.roughAndMentalness.y;
 	
 
 	//Direction settings
 	vec3 N = normalize(v2fNormal);
+	if (vertexPushConst.isNormalMap != 0)
+	{
+		// Tangents come from the vertex data (baked by cw3-bake)
+		vec3 T = normalize(v2fTangent.xyz - N * dot(N, v2fTangent.xyz));
+		vec3 B = v2fTangent.w * cross(N, T);
+		vec3 tn = texture(uNormalMap, v2fTexCoord).xyz * 2.0 - 1.0;
+		N = normalize(mat3(T, B, N) * tn);
+	}
 	vec3 V = normalize(cameraPos - fragPos);
     vec3 L = normalize(lightPos - fragPos);
 	vec3 H = normalize(L + V);
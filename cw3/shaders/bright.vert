@@ -1,8 +1,9 @@
 #version 450
 
-layout( location = 0 ) in vec3 iPosition;
-layout( location = 1 ) in vec2 iTexCoord;
-layout( location = 2 ) in vec3 iNormal;
+// Compact vertices, see baked_model.hpp
+layout( location = 0 ) in uvec4 iPosition; // uint16, relative to the mesh AABB
+layout( location = 1 ) in vec2 iTexCoord; // half floats
+layout( location = 2 ) in vec4 iFrame;    // snorm16, QTangent
 
 
 layout( set = 0, binding = 0 ) uniform UScene
@@ -13,19 +14,37 @@ layout( set = 0, binding = 0 ) uniform UScene
 	vec3 cameraPos;
 } uScene;
 
+// Offset 0..7 is used by the fragment shader
+layout( push_constant ) uniform MeshPushConstants
+{
+	layout( offset = 16 ) vec4 positionMin;
+	vec4 positionScale;
+} uMesh;
+
 
 layout( location = 0 ) out vec2 v2fTexCoord;
 layout( location = 1) out vec3 v2fNormal;
-layout( location = 2) out vec3 v2fFragCoord;	
+layout( location = 2) out vec3 v2fFragCoord;
 layout( location = 3) out vec3 v2fCameraPos;
+layout( location = 4) out vec4 v2fTangent; // xyz: tangent, w: handedness
+
 
+// The QTangent rotates +X onto the tangent and +Z onto the normal; the sign
+// of w is the handedness of the frame (see cw3-bake/quantize_mesh.hpp)
+vec3 quat_rotate( vec4 q, vec3 v )
+{
+	return v + 2.0 * cross( q.xyz, cross( q.xyz, v ) + q.w * v );
+}
 
 void main()
 {
+	vec3 position = uMesh.positionMin.xyz + uMesh.positionScale.xyz * vec3( iPosition.xyz );
 
 	v2fTexCoord = iTexCoord;
-	v2fNormal = iNormal;
-	v2fFragCoord = iPosition;
+	vec4 q = normalize( iFrame );
+	v2fNormal = quat_rotate( q, vec3( 0.0, 0.0, 1.0 ) );
+	v2fTangent = vec4( quat_rotate( q, vec3( 1.0, 0.0, 0.0 ) ), q.w < 0.0 ? -1.0 : 1.0 );
+	v2fFragCoord = position;
 	v2fCameraPos = uScene.cameraPos;
-	gl_Position = uScene.projCam * vec4( iPosition, 1.f ); 
+	gl_Position = uScene.projCam * vec4( position, 1.f );
 }
@@ -20,8 +20,7 @@ layout( location = 0 ) out vec4 oColor;
 
 
 layout( set = 2, binding = 0 ) uniform sampler2D uTexColor;
-layout( set = 2, binding = 1 ) uniform sampler2D uRoughtness;
-layout( set = 2, binding = 2 ) uniform sampler2D uMetalness;
+layout( set = 2, binding = 1 ) uniform sampler2D uRoughMetal; // R: roughness, G: metalness (packed by cw3-bake)
 
 
 
@@ -50,9 +49,10 @@ vec3 lightPos = vec3((lightData.light.position).xyz);
 	vec3 emissiveColor = material.emissiveColor.rgb;
 
 	float alpha = 1.0;
-	float roughness = texture(uRoughtness,v2fTexCoord).r *material.roughAndMentalness.x; //Shininess
+	vec2 roughMetal = texture(uRoughMetal,v2fTexCoord).rg;
+	float roughness = roughMetal.x *material.roughAndMentalness.x; //Shininess
 	float shininess = 2.0 / (pow(roughness,4) + 0.001) - 2;
-	float metalness = texture(uMetalness,v2fTexCoord).r *material.roughAndMentalness.y;
+	float metalness = roughMetal.y *material.roughAndMentalness.y;
 	
 
 	//Direction settings
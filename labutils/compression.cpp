@@ -0,0 +1,704 @@
+#include "compression.hpp"
+
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <type_traits>
+#include <initializer_list>
+
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	define COMPRESSION_SSE2_ 1
+#	include <emmintrin.h>
+#else
+#	define COMPRESSION_SSE2_ 0
+#endif
+
+#include "error.hpp"
+
+namespace
+{
+	// LZ sequences: a token byte (high nibble: number of literals, low
+	// nibble: match length - kMinMatch_; 15 = more length bytes follow), the
+	// literals, and a 16-bit little-endian match offset. Lengths of 15 and
+	// above continue with bytes that are added up until one is below 255.
+	// The last sequence consists only of literals (possibly none).
+	constexpr std::size_t kMinMatch_ = 4;
+
+	// The encoder ignores shorter matches than this. Short matches barely
+	// save any space over literals, but each one costs the decoder a full
+	// sequence; skipping them roughly doubles decompression throughput on
+	// baked meshes for a few percent of compressed size.
+	constexpr std::size_t kMinEncodedMatch_ = 8;
+	constexpr std::size_t kMaxOffset_ = 65535;
+
+	constexpr unsigned kHashBits_ = 16;
+	constexpr std::size_t kMaxChain_ = 64; // candidates tried per position
+
+	constexpr std::uint8_t kCodecStored_ = 0;
+	constexpr std::uint8_t kCodecLZ_ = 1;
+
+	std::uint32_t read32_( std::uint8_t const* aPtr )
+	{
+		std::uint32_t ret;
+		std::memcpy( &ret, aPtr, sizeof(ret) );
+		return ret;
+	}
+
+	std::uint32_t hash4_( std::uint32_t aValue )
+	{
+		return (aValue * 2654435761u) >> (32 - kHashBits_);
+	}
+
+	void put_length_( std::vector<std::uint8_t>& aOut, std::size_t aLength )
+	{
+		for( ; aLength >= 255; aLength -= 255 )
+			aOut.push_back( 255 );
+
+		aOut.push_back( std::uint8_t(aLength) );
+	}
+
+	void put_sequence_( std::vector<std::uint8_t>& aOut, std::uint8_t const* aLiterals, std::size_t aLiteralCount, std::size_t aOffset, std::size_t aMatchLength )
+	{
+		// aMatchLength = 0 marks the last sequence
+		std::size_t const matchCode = aMatchLength ? aMatchLength - kMinMatch_ : 0;
+
+		aOut.push_back( std::uint8_t( (std::min<std::size_t>( aLiteralCount, 15 ) << 4) | std::min<std::size_t>( matchCode, 15 ) ) );
+		if( aLiteralCount >= 15 )
+			put_length_( aOut, aLiteralCount - 15 );
+
+		aOut.insert( aOut.end(), aLiterals, aLiterals + aLiteralCount );
+
+		if( !aMatchLength )
+			return;
+
+		aOut.push_back( std::uint8_t(aOffset & 0xff) );
+		aOut.push_back( std::uint8_t(aOffset >> 8) );
+
+		if( matchCode >= 15 )
+			put_length_( aOut, matchCode - 15 );
+	}
+
+	std::size_t get_length_( std::uint8_t const*& aIn, std::uint8_t const* aEnd, std::size_t aLength )
+	{
+		if( 15 != aLength )
+			return aLength;
+
+		std::uint8_t byte;
+		do
+		{
+			if( aIn == aEnd )
+				throw labutils::Error( "lz_decompress(): truncated length" );
+
+			byte = *aIn++;
+			aLength += byte;
+		} while( 255 == byte );
+
+		return aLength;
+	}
+
+	// Filters, see StreamFilter
+	template< typename tLane >
+	tLane zigzag_( tLane aValue )
+	{
+		using Signed_ = std::make_signed_t<tLane>;
+		return tLane( tLane(aValue << 1) ^ (Signed_(aValue) < 0 ? tLane(~tLane(0)) : tLane(0)) );
+	}
+
+	template< typename tLane >
+	tLane unzigzag_( tLane aValue )
+	{
+		return tLane( tLane(aValue >> 1) ^ tLane(0 - (aValue & 1)) );
+	}
+
+	template< typename tLane >
+	void delta_encode_( std::uint8_t* aData, std::size_t aCount, std::size_t aStride )
+	{
+		// Back to front, so that each element still sees its predecessor
+		for( std::size_t i = aCount; i-- > 0; )
+		{
+			for( std::size_t lane = 0; lane < aStride; lane += sizeof(tLane) )
+			{
+				tLane value, previous = 0;
+				std::memcpy( &value, aData + i*aStride + lane, sizeof(tLane) );
+				if( i > 0 )
+					std::memcpy( &previous, aData + (i-1)*aStride + lane, sizeof(tLane) );
+
+				value = zigzag_<tLane>( tLane(value - previous) );
+				std::memcpy( aData + i*aStride + lane, &value, sizeof(tLane) );
+			}
+		}
+	}
+
+	void split_byte_planes_( std::uint8_t const* aSrc, std::size_t aCount, std::size_t aStride, std::uint8_t* aDst )
+	{
+		for( std::size_t k = 0; k < aStride; ++k )
+		{
+			std::uint8_t* plane = aDst + k*aCount;
+			for( std::size_t i = 0; i < aCount; ++i )
+				plane[i] = aSrc[i*aStride + k];
+		}
+	}
+
+	template< std::size_t tStride >
+	void merge_byte_planes_( std::uint8_t const* aSrc, std::size_t aCount, std::uint8_t* aDst, std::size_t aDstStride = tStride )
+	{
+		// Fixed strides; one element per (little-endian) word. Wider elements
+		// are merged eight planes at a time, into every aDstStride bytes.
+		using Word_ = std::conditional_t< 2 == tStride, std::uint16_t,
+			std::conditional_t< 4 == tStride, std::uint32_t, std::uint64_t >
+		>;
+		static_assert( sizeof(Word_) == tStride, "Unsupported stride" );
+
+		std::size_t i = 0;
+
+#		if COMPRESSION_SSE2_
+		// Interleave 16 elements at a time: bytes, then pairs of bytes, then
+		// groups of four.
+		for( ; i + 16 <= aCount; i += 16 )
+		{
+			auto const load_ = [&] (std::size_t aPlane) {
+				return _mm_loadu_si128( reinterpret_cast<__m128i const*>(aSrc + aPlane*aCount + i) );
+			};
+			auto const store_ = [&] (std::size_t aChunk, __m128i aValue) {
+				if( tStride == aDstStride )
+				{
+					_mm_storeu_si128( reinterpret_cast<__m128i*>(aDst + i*tStride + 16*aChunk), aValue );
+				}
+				else
+				{
+					// Two elements per chunk
+					std::size_t const element = i + aChunk*16/tStride;
+					_mm_storel_epi64( reinterpret_cast<__m128i*>(aDst + element*aDstStride), aValue );
+					_mm_storel_epi64( reinterpret_cast<__m128i*>(aDst + (element+1)*aDstStride), _mm_unpackhi_epi64( aValue, aValue ) );
+				}
+			};
+
+			if constexpr( 2 == tStride )
+			{
+				__m128i const p0 = load_( 0 ), p1 = load_( 1 );
+				store_( 0, _mm_unpacklo_epi8( p0, p1 ) );
+				store_( 1, _mm_unpackhi_epi8( p0, p1 ) );
+			}
+			else if constexpr( 4 == tStride )
+			{
+				__m128i const p0 = load_( 0 ), p1 = load_( 1 ), p2 = load_( 2 ), p3 = load_( 3 );
+
+				__m128i const lo01 = _mm_unpacklo_epi8( p0, p1 ), hi01 = _mm_unpackhi_epi8( p0, p1 );
+				__m128i const lo23 = _mm_unpacklo_epi8( p2, p3 ), hi23 = _mm_unpackhi_epi8( p2, p3 );
+
+				store_( 0, _mm_unpacklo_epi16( lo01, lo23 ) );
+				store_( 1, _mm_unpackhi_epi16( lo01, lo23 ) );
+				store_( 2, _mm_unpacklo_epi16( hi01, hi23 ) );
+				store_( 3, _mm_unpackhi_epi16( hi01, hi23 ) );
+			}
+			else
+			{
+				// Bytes 0-3 of each element as above, then bytes 4-7, then
+				// interleave the two halves.
+				__m128i const p0 = load_( 0 ), p1 = load_( 1 ), p2 = load_( 2 ), p3 = load_( 3 );
+				__m128i const p4 = load_( 4 ), p5 = load_( 5 ), p6 = load_( 6 ), p7 = load_( 7 );
+
+				__m128i const lo01 = _mm_unpacklo_epi8( p0, p1 ), hi01 = _mm_unpackhi_epi8( p0, p1 );
+				__m128i const lo23 = _mm_unpacklo_epi8( p2, p3 ), hi23 = _mm_unpackhi_epi8( p2, p3 );
+				__m128i const lo45 = _mm_unpacklo_epi8( p4, p5 ), hi45 = _mm_unpackhi_epi8( p4, p5 );
+				__m128i const lo67 = _mm_unpacklo_epi8( p6, p7 ), hi67 = _mm_unpackhi_epi8( p6, p7 );
+
+				__m128i const a0 = _mm_unpacklo_epi16( lo01, lo23 ), a1 = _mm_unpackhi_epi16( lo01, lo23 );
+				__m128i const a2 = _mm_unpacklo_epi16( hi01, hi23 ), a3 = _mm_unpackhi_epi16( hi01, hi23 );
+				__m128i const b0 = _mm_unpacklo_epi16( lo45, lo67 ), b1 = _mm_unpackhi_epi16( lo45, lo67 );
+				__m128i const b2 = _mm_unpacklo_epi16( hi45, hi67 ), b3 = _mm_unpackhi_epi16( hi45, hi67 );
+
+				store_( 0, _mm_unpacklo_epi32( a0, b0 ) );
+				store_( 1, _mm_unpackhi_epi32( a0, b0 ) );
+				store_( 2, _mm_unpacklo_epi32( a1, b1 ) );
+				store_( 3, _mm_unpackhi_epi32( a1, b1 ) );
+				store_( 4, _mm_unpacklo_epi32( a2, b2 ) );
+				store_( 5, _mm_unpackhi_epi32( a2, b2 ) );
+				store_( 6, _mm_unpacklo_epi32( a3, b3 ) );
+				store_( 7, _mm_unpackhi_epi32( a3, b3 ) );
+			}
+		}
+#		endif // ~ COMPRESSION_SSE2_
+
+		for( ; i < aCount; ++i )
+		{
+			Word_ value = 0;
+			for( std::size_t k = 0; k < tStride; ++k )
+				value = Word_( value | (Word_(aSrc[k*aCount + i]) << (8*k)) );
+
+			std::memcpy( aDst + i*aDstStride, &value, tStride );
+		}
+	}
+
+	void merge_byte_planes_( std::uint8_t const* aSrc, std::size_t aCount, std::size_t aStride, std::uint8_t* aDst )
+	{
+		switch( aStride )
+		{
+			case 2: merge_byte_planes_<2>( aSrc, aCount, aDst ); return;
+			case 4: merge_byte_planes_<4>( aSrc, aCount, aDst ); return;
+			case 8: merge_byte_planes_<8>( aSrc, aCount, aDst ); return;
+		}
+
+		std::size_t k = 0;
+		for( ; k + 8 <= aStride; k += 8 )
+			merge_byte_planes_<8>( aSrc + k*aCount, aCount, aDst + k, aStride );
+
+		for( ; k < aStride; ++k )
+		{
+			std::uint8_t const* plane = aSrc + k*aCount;
+			for( std::size_t i = 0; i < aCount; ++i )
+				aDst[i*aStride + k] = plane[i];
+		}
+	}
+
+	template< typename tLane >
+	void delta_decode_( std::uint8_t* aData, std::size_t aCount, std::size_t aStride )
+	{
+		// Running sum of each lane, in place. Common element sizes (up to
+		// eight bytes) are summed 16 bytes at a time; within a register this
+		// is a log-step prefix sum, to which the last element of the
+		// previous register is added. Elements that are a multiple of 16
+		// bytes simply add the previous element register by register.
+		std::size_t i = 0;
+
+#		if COMPRESSION_SSE2_
+		auto const add_ = [] (__m128i aX, __m128i aY) {
+			if constexpr( 2 == sizeof(tLane) )
+				return _mm_add_epi16( aX, aY );
+			else
+				return _mm_add_epi32( aX, aY );
+		};
+
+		auto const load_unzigzag_ = [&] (std::size_t aOffset) {
+			// Undo the zigzag encoding: (x >> 1) ^ -(x & 1)
+			__m128i const x = _mm_loadu_si128( reinterpret_cast<__m128i const*>(aData + aOffset) );
+			if constexpr( 2 == sizeof(tLane) )
+				return _mm_xor_si128( _mm_srli_epi16( x, 1 ), _mm_sub_epi16( _mm_setzero_si128(), _mm_and_si128( x, _mm_set1_epi16( 1 ) ) ) );
+			else
+				return _mm_xor_si128( _mm_srli_epi32( x, 1 ), _mm_sub_epi32( _mm_setzero_si128(), _mm_and_si128( x, _mm_set1_epi32( 1 ) ) ) );
+		};
+
+		std::size_t const total = aCount * aStride;
+
+		auto const prefix_ = [&] (auto aElementBytes) {
+			constexpr std::size_t bytes = decltype(aElementBytes)::value;
+
+			__m128i carry = _mm_setzero_si128();
+			for( ; i + 16 <= total; i += 16 )
+			{
+				__m128i x = load_unzigzag_( i );
+
+				if constexpr( bytes < 16 ) x = add_( x, _mm_slli_si128( x, bytes ) );
+				if constexpr( bytes < 8 ) x = add_( x, _mm_slli_si128( x, 2*bytes ) );
+				if constexpr( bytes < 4 ) x = add_( x, _mm_slli_si128( x, 4*bytes ) );
+
+				x = add_( x, carry );
+				_mm_storeu_si128( reinterpret_cast<__m128i*>(aData + i), x );
+
+				// Broadcast the last element
+				if constexpr( 2 == bytes )
+					carry = _mm_unpackhi_epi64( _mm_shufflehi_epi16( x, 0xff ), _mm_shufflehi_epi16( x, 0xff ) );
+				else if constexpr( 4 == bytes )
+					carry = _mm_shuffle_epi32( x, 0xff );
+				else
+					carry = _mm_shuffle_epi32( x, 0xee );
+			}
+
+			i /= aStride;
+		};
+
+		switch( aStride )
+		{
+			case 2: if( 2 == sizeof(tLane) ) prefix_( std::integral_constant<std::size_t,2>{} ); break;
+			case 4: prefix_( std::integral_constant<std::size_t,4>{} ); break;
+			case 8: prefix_( std::integral_constant<std::size_t,8>{} ); break;
+
+			default:
+				if( 0 == aStride % 16 )
+				{
+					for( ; i < total; i += 16 )
+					{
+						__m128i x = load_unzigzag_( i );
+						if( i >= aStride )
+							x = add_( x, _mm_loadu_si128( reinterpret_cast<__m128i const*>(aData + i - aStride) ) );
+
+						_mm_storeu_si128( reinterpret_cast<__m128i*>(aData + i), x );
+					}
+
+					i = aCount;
+				}
+				break;
+		}
+#		endif // ~ COMPRESSION_SSE2_
+
+		// Remaining elements (or all of them)
+		std::size_t const lanes = aStride / sizeof(tLane);
+		for( std::size_t value = i * lanes; value < aCount * lanes; ++value )
+		{
+			tLane current, previous = 0;
+			std::memcpy( &current, aData + value*sizeof(tLane), sizeof(tLane) );
+			if( value >= lanes )
+				std::memcpy( &previous, aData + (value-lanes)*sizeof(tLane), sizeof(tLane) );
+
+			current = tLane( previous + unzigzag_<tLane>( current ) );
+			std::memcpy( aData + value*sizeof(tLane), &current, sizeof(tLane) );
+		}
+	}
+
+	std::size_t lane_size_( labutils::StreamFilter aFilter )
+	{
+		switch( aFilter )
+		{
+			case labutils::StreamFilter::delta16BytePlanes: return sizeof(std::uint16_t);
+			case labutils::StreamFilter::delta32BytePlanes: return sizeof(std::uint32_t);
+			default: return 1;
+		}
+	}
+}
+
+namespace labutils
+{
+	std::vector<std::uint8_t> compress_stream( void const* aData, std::size_t aBytes, StreamFilter aFilter, std::size_t aStride )
+	{
+		if( 0 == aStride || aStride > 255 || 0 != aBytes % aStride || 0 != aStride % lane_size_( aFilter ) )
+			throw Error( "compress_stream(): invalid stride %zu for %zu bytes", aStride, aBytes );
+
+		auto const* data = static_cast<std::uint8_t const*>(aData);
+		std::size_t const count = aBytes / aStride;
+
+		// Filter
+		std::vector<std::uint8_t> filtered;
+		if( StreamFilter::none == aFilter )
+		{
+			filtered.assign( data, data + aBytes );
+		}
+		else
+		{
+			std::vector<std::uint8_t> elements( data, data + aBytes );
+			if( StreamFilter::delta16BytePlanes == aFilter )
+				delta_encode_<std::uint16_t>( elements.data(), count, aStride );
+			else if( StreamFilter::delta32BytePlanes == aFilter )
+				delta_encode_<std::uint32_t>( elements.data(), count, aStride );
+
+			filtered.resize( aBytes );
+			split_byte_planes_( elements.data(), count, aStride, filtered.data() );
+		}
+
+		// Compress; keep the original data if that does not help
+		auto compressed = lz_compress( filtered.data(), filtered.size() );
+
+		std::uint8_t codec = kCodecLZ_;
+		if( compressed.size() >= aBytes )
+		{
+			codec = kCodecStored_;
+			aFilter = StreamFilter::none;
+			compressed.assign( data, data + aBytes );
+		}
+
+		std::uint8_t header[kStreamHeaderSize]{};
+		header[0] = std::uint8_t(aFilter);
+		header[1] = std::uint8_t(aStride);
+		header[2] = codec;
+
+		std::uint64_t const rawBytes = aBytes;
+		std::memcpy( header + 8, &rawBytes, sizeof(rawBytes) );
+
+		compressed.insert( compressed.begin(), header, header + kStreamHeaderSize );
+		return compressed;
+	}
+
+	std::vector<std::uint8_t> compress_stream( void const* aData, std::size_t aBytes, std::size_t aStride )
+	{
+		std::vector<std::uint8_t> best;
+		for( auto const filter : { StreamFilter::none, StreamFilter::bytePlanes, StreamFilter::delta16BytePlanes, StreamFilter::delta32BytePlanes } )
+		{
+			if( 0 != aStride % lane_size_( filter ) || (StreamFilter::none != filter && 1 == aStride) )
+				continue;
+
+			auto compressed = compress_stream( aData, aBytes, filter, aStride );
+			if( best.empty() || compressed.size() < best.size() )
+				best = std::move(compressed);
+		}
+
+		return best;
+	}
+
+	std::uint64_t decompressed_stream_size( void const* aStream, std::size_t aStreamBytes )
+	{
+		if( aStreamBytes < kStreamHeaderSize )
+			throw Error( "decompressed_stream_size(): truncated stream header" );
+
+		auto const* header = static_cast<std::uint8_t const*>(aStream);
+
+		std::uint64_t rawBytes;
+		std::memcpy( &rawBytes, header + 8, sizeof(rawBytes) );
+
+		auto const filter = StreamFilter(header[0]);
+		std::size_t const stride = header[1];
+		std::uint8_t const codec = header[2];
+
+		if( filter > StreamFilter::delta32BytePlanes || 0 == stride || 0 != stride % lane_size_( filter ) || 0 != rawBytes % stride )
+			throw Error( "decompressed_stream_size(): invalid filter %u with stride %zu", unsigned(header[0]), stride );
+		if( kCodecStored_ != codec && kCodecLZ_ != codec )
+			throw Error( "decompressed_stream_size(): unknown codec %u", unsigned(codec) );
+		if( kCodecStored_ == codec && (StreamFilter::none != filter || rawBytes != aStreamBytes - kStreamHeaderSize) )
+			throw Error( "decompressed_stream_size(): invalid stored stream" );
+
+		return rawBytes;
+	}
+
+	void decompress_stream( void const* aStream, std::size_t aStreamBytes, void* aDst, std::size_t aDstBytes, std::vector<std::uint8_t>& aScratch )
+	{
+		if( decompressed_stream_size( aStream, aStreamBytes ) != aDstBytes )
+			throw Error( "decompress_stream(): stream holds %llu bytes, expected %zu", static_cast<unsigned long long>(decompressed_stream_size( aStream, aStreamBytes )), aDstBytes );
+
+		auto const* header = static_cast<std::uint8_t const*>(aStream);
+		auto const* payload = header + kStreamHeaderSize;
+		std::size_t const payloadBytes = aStreamBytes - kStreamHeaderSize;
+
+		auto const filter = StreamFilter(header[0]);
+		std::size_t const stride = header[1];
+
+		if( kCodecStored_ == header[2] )
+		{
+			std::memcpy( aDst, payload, aDstBytes );
+			return;
+		}
+
+		auto* dst = static_cast<std::uint8_t*>(aDst);
+		if( StreamFilter::none == filter )
+		{
+			if( lz_decompress( payload, payloadBytes, dst, aDstBytes ) != aDstBytes )
+				throw Error( "decompress_stream(): stream is too short" );
+			return;
+		}
+
+		// Only ever grow the scratch buffer; resizing it down and back up
+		// would clear the new bytes each time.
+		if( aScratch.size() < aDstBytes )
+			aScratch.resize( aDstBytes );
+
+		if( lz_decompress( payload, payloadBytes, aScratch.data(), aDstBytes ) != aDstBytes )
+			throw Error( "decompress_stream(): stream is too short" );
+
+		std::size_t const count = aDstBytes / stride;
+		switch( filter )
+		{
+			case StreamFilter::bytePlanes:
+				merge_byte_planes_( aScratch.data(), count, stride, dst );
+				break;
+			case StreamFilter::delta16BytePlanes:
+				merge_byte_planes_( aScratch.data(), count, stride, dst );
+				delta_decode_<std::uint16_t>( dst, count, stride );
+				break;
+			case StreamFilter::delta32BytePlanes:
+				merge_byte_planes_( aScratch.data(), count, stride, dst );
+				delta_decode_<std::uint32_t>( dst, count, stride );
+				break;
+			case StreamFilter::none:
+				break;
+		}
+	}
+
+
+	std::vector<std::uint8_t> lz_compress( void const* aData, std::size_t aBytes )
+	{
+		// Greedy parse. Candidate matches come from hash chains over all
+		// earlier positions within the window; the longest one wins. This is
+		// meant for offline use, so it favours the compression ratio over
+		// speed. Decompression speed does not depend on it.
+		auto const* data = static_cast<std::uint8_t const*>(aData);
+
+		std::vector<std::uint8_t> out;
+		out.reserve( aBytes / 2 + 16 );
+
+		std::vector<std::int64_t> head( std::size_t(1) << kHashBits_, -1 );
+		std::vector<std::int64_t> chain( kMaxOffset_ + 1, -1 );
+
+		auto const insert_ = [&] (std::size_t aPos) {
+			auto& first = head[hash4_( read32_( data + aPos ) )];
+			chain[aPos & kMaxOffset_] = first;
+			first = std::int64_t(aPos);
+		};
+
+		std::size_t pos = 0, anchor = 0;
+		while( pos + kMinMatch_ <= aBytes )
+		{
+			std::uint32_t const value = read32_( data + pos );
+
+			std::size_t bestLength = 0, bestOffset = 0;
+
+			std::int64_t candidate = head[hash4_( value )];
+			for( std::size_t tries = 0; candidate >= 0 && tries < kMaxChain_; ++tries )
+			{
+				auto const cand = std::size_t(candidate);
+				if( pos - cand > kMaxOffset_ )
+					break;
+
+				if( read32_( data + cand ) == value )
+				{
+					std::size_t length = kMinMatch_;
+					while( pos + length < aBytes && data[cand + length] == data[pos + length] )
+						++length;
+
+					if( length > bestLength )
+					{
+						bestLength = length;
+						bestOffset = pos - cand;
+
+						if( pos + length == aBytes )
+							break;
+					}
+				}
+
+				// Older entries of the chain may have been overwritten
+				auto const next = chain[cand & kMaxOffset_];
+				if( next >= candidate )
+					break;
+
+				candidate = next;
+			}
+
+			insert_( pos );
+
+			if( bestLength < kMinEncodedMatch_ )
+			{
+				++pos;
+				continue;
+			}
+
+			put_sequence_( out, data + anchor, pos - anchor, bestOffset, bestLength );
+
+			for( std::size_t i = pos + 1; i < pos + bestLength && i + kMinMatch_ <= aBytes; ++i )
+				insert_( i );
+
+			pos += bestLength;
+			anchor = pos;
+		}
+
+		put_sequence_( out, data + anchor, aBytes - anchor, 0, 0 );
+		return out;
+	}
+
+	std::size_t lz_decompress( void const* aSrc, std::size_t aSrcBytes, void* aDst, std::size_t aDstBytes )
+	{
+		auto const* ip = static_cast<std::uint8_t const*>(aSrc);
+		auto const* const iend = ip + aSrcBytes;
+
+		auto* const dst = static_cast<std::uint8_t*>(aDst);
+		auto* op = dst;
+		auto* const oend = dst + aDstBytes;
+
+		// Copies are done in 16-byte chunks where there is room to spare,
+		// and exactly otherwise.
+		constexpr std::size_t chunk = 16;
+
+		while( ip < iend )
+		{
+			std::size_t const token = *ip++;
+
+			// Fast path: short literals and a short match, far enough from
+			// the ends of both buffers that fixed-size copies are safe.
+			// (With 18+ bytes left, this cannot be the last sequence.)
+			if( (token >> 4) < 15 && (token & 15) < 15 && iend - ip >= std::ptrdiff_t(chunk+2) && oend - op >= std::ptrdiff_t(3*chunk) )
+			{
+				std::size_t const literals = token >> 4;
+				std::memcpy( op, ip, chunk );
+				op += literals;
+				ip += literals;
+
+				std::size_t const offset = std::size_t(ip[0]) | (std::size_t(ip[1]) << 8);
+				ip += 2;
+
+				if( 0 == offset || offset > std::size_t(op - dst) )
+					throw Error( "lz_decompress(): invalid match offset %zu", offset );
+
+				std::size_t const length = (token & 15) + kMinMatch_;
+				std::uint8_t const* match = op - offset;
+
+				if( offset >= chunk )
+				{
+					std::memcpy( op, match, chunk );
+					std::memcpy( op + chunk, match + chunk, chunk );
+				}
+				else if( offset >= 8 )
+				{
+					std::memcpy( op, match, 8 );
+					std::memcpy( op + 8, match + 8, 8 );
+					std::memcpy( op + 16, match + 16, 8 );
+				}
+				else
+				{
+					for( std::size_t i = 0; i < length; ++i )
+						op[i] = match[i];
+				}
+
+				op += length;
+				continue;
+			}
+
+			// Literals
+			std::size_t const literals = get_length_( ip, iend, token >> 4 );
+			if( literals > std::size_t(iend - ip) || literals > std::size_t(oend - op) )
+				throw Error( "lz_decompress(): literals exceed buffer" );
+
+			if( std::size_t(iend - ip) >= literals + chunk && std::size_t(oend - op) >= literals + chunk )
+			{
+				for( std::size_t i = 0; i < literals; i += chunk )
+					std::memcpy( op + i, ip + i, chunk );
+			}
+			else
+			{
+				std::memcpy( op, ip, literals );
+			}
+
+			op += literals;
+			ip += literals;
+
+			if( ip == iend )
+				break; // last sequence
+
+			// Match
+			if( iend - ip < 2 )
+				throw Error( "lz_decompress(): truncated offset" );
+
+			std::size_t const offset = std::size_t(ip[0]) | (std::size_t(ip[1]) << 8);
+			ip += 2;
+
+			std::size_t const length = get_length_( ip, iend, token & 15 ) + kMinMatch_;
+
+			if( 0 == offset || offset > std::size_t(op - dst) )
+				throw Error( "lz_decompress(): invalid match offset %zu", offset );
+			if( length > std::size_t(oend - op) )
+				throw Error( "lz_decompress(): match exceeds buffer" );
+
+			std::uint8_t const* match = op - offset;
+			if( offset >= chunk && std::size_t(oend - op) >= length + chunk )
+			{
+				for( std::size_t i = 0; i < length; i += chunk )
+					std::memcpy( op + i, match + i, chunk );
+			}
+			else
+			{
+				// Overlapping match: repeat the period; any multiple of it
+				// is a period as well, so the copies can grow.
+				std::size_t period = offset;
+				for( std::size_t done = 0; done < length; )
+				{
+					std::size_t const n = std::min( period, length - done );
+					std::memcpy( op + done, op + done - period, n );
+					done += n;
+					period *= 2;
+				}
+			}
+
+			op += length;
+		}
+
+		return std::size_t(op - dst);
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
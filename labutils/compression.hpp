@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace labutils
+{
+	// Lossless compression of baked vertex and index streams. A stream is
+	// first filtered, which rearranges the data so that similar bytes end up
+	// next to each other, and then compressed with a small LZ77-class codec
+	// (byte-aligned sequences of literals and matches, in the spirit of LZ4).
+	// Decompression is a single pass over the compressed data followed by a
+	// single pass that undoes the filter.
+	//
+	// Compressed streams start with a kStreamHeaderSize-byte header:
+	//   - uint8_t : filter (StreamFilter)
+	//   - uint8_t : stride = element size in bytes
+	//   - uint8_t : codec (0 = stored, 1 = LZ)
+	//   - uint8_t : reserved (zero)
+	//   - uint32_t : reserved (zero)
+	//   - uint64_t : size of the decompressed data in bytes
+	// Streams that do not compress are stored unfiltered, so that the data
+	// following the header can be used directly.
+	enum class StreamFilter : std::uint8_t
+	{
+		none = 0,
+
+		// Byte k of each element goes to plane k; the planes are stored
+		// one after the other. Groups high and low bytes of 16-bit values,
+		// for example.
+		bytePlanes = 1,
+
+		// Elements consist of 16-bit (32-bit) lanes. Each lane is replaced
+		// by the (zigzag-encoded) difference to the same lane of the
+		// previous element, followed by byte planes. Suited to indices and
+		// to quantized attributes of spatially sorted vertices.
+		delta16BytePlanes = 2,
+		delta32BytePlanes = 3
+	};
+
+	constexpr std::size_t kStreamHeaderSize = 16;
+
+	std::vector<std::uint8_t> compress_stream( void const* aData, std::size_t aBytes, StreamFilter, std::size_t aStride );
+
+	// Tries each filter that applies to aStride and keeps the smallest result
+	std::vector<std::uint8_t> compress_stream( void const* aData, std::size_t aBytes, std::size_t aStride );
+
+	// Size of the decompressed data; throws if the header is invalid
+	std::uint64_t decompressed_stream_size( void const* aStream, std::size_t aStreamBytes );
+
+	// Decompress into aDst, which must hold exactly the decompressed size.
+	// aScratch is reused between calls to avoid allocations. Throws
+	// labutils::Error if the stream is malformed.
+	void decompress_stream( void const* aStream, std::size_t aStreamBytes, void* aDst, std::size_t aDstBytes, std::vector<std::uint8_t>& aScratch );
+
+	// The LZ codec on its own. lz_decompress() returns the number of bytes
+	// written, which must fit into aDstBytes.
+	std::vector<std::uint8_t> lz_compress( void const* aData, std::size_t aBytes );
+	std::size_t lz_decompress( void const* aSrc, std::size_t aSrcBytes, void* aDst, std::size_t aDstBytes );
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,143 @@
+#include "mapped_file.hpp"
+
+#include <limits>
+#include <utility>
+
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+
+#if defined(_WIN32)
+#	define WIN32_LEAN_AND_MEAN
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "error.hpp"
+
+namespace labutils
+{
+	MappedFile::MappedFile() noexcept = default;
+
+	MappedFile::~MappedFile()
+	{
+		if( data )
+		{
+#			if defined(_WIN32)
+			UnmapViewOfFile( data );
+#			else
+			munmap( const_cast<void*>(data), size );
+#			endif
+		}
+	}
+
+	MappedFile::MappedFile( void const* aData, std::size_t aSize ) noexcept
+		: data( aData )
+		, size( aSize )
+	{}
+
+	MappedFile::MappedFile( MappedFile&& aOther ) noexcept
+		: data( std::exchange( aOther.data, nullptr ) )
+		, size( std::exchange( aOther.size, 0 ) )
+	{}
+	MappedFile& MappedFile::operator=( MappedFile&& aOther ) noexcept
+	{
+		std::swap( data, aOther.data );
+		std::swap( size, aOther.size );
+		return *this;
+	}
+}
+
+namespace labutils
+{
+#	if defined(_WIN32)
+	MappedFile map_file( char const* aPath )
+	{
+		HANDLE file = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if( INVALID_HANDLE_VALUE == file )
+			throw Error( "map_file(): unable to open '%s' (error %lu)", aPath, GetLastError() );
+
+		LARGE_INTEGER fileSize{};
+		if( !GetFileSizeEx( file, &fileSize ) )
+		{
+			auto const err = GetLastError();
+			CloseHandle( file );
+			throw Error( "map_file(): unable to determine size of '%s' (error %lu)", aPath, err );
+		}
+
+		if( std::uint64_t(fileSize.QuadPart) > std::numeric_limits<std::size_t>::max() )
+		{
+			CloseHandle( file );
+			throw Error( "map_file(): '%s' is too large to map", aPath );
+		}
+
+		if( 0 == fileSize.QuadPart )
+		{
+			CloseHandle( file );
+			return MappedFile();
+		}
+
+		// The view keeps the mapping alive; neither handle is needed once it
+		// exists.
+		HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		auto const mapErr = GetLastError();
+		CloseHandle( file );
+
+		if( !mapping )
+			throw Error( "map_file(): unable to map '%s' (error %lu)", aPath, mapErr );
+
+		void const* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+		auto const viewErr = GetLastError();
+		CloseHandle( mapping );
+
+		if( !view )
+			throw Error( "map_file(): unable to map '%s' (error %lu)", aPath, viewErr );
+
+		return MappedFile( view, std::size_t(fileSize.QuadPart) );
+	}
+#	else // !_WIN32
+	MappedFile map_file( char const* aPath )
+	{
+		int const fd = open( aPath, O_RDONLY | O_CLOEXEC );
+		if( -1 == fd )
+			throw Error( "map_file(): unable to open '%s': %s", aPath, std::strerror( errno ) );
+
+		struct stat info{};
+		if( 0 != fstat( fd, &info ) )
+		{
+			auto const err = errno;
+			close( fd );
+			throw Error( "map_file(): unable to determine size of '%s': %s", aPath, std::strerror( err ) );
+		}
+
+		if( std::uint64_t(info.st_size) > std::numeric_limits<std::size_t>::max() )
+		{
+			close( fd );
+			throw Error( "map_file(): '%s' is too large to map", aPath );
+		}
+
+		if( 0 == info.st_size )
+		{
+			close( fd );
+			return MappedFile();
+		}
+
+		// The mapping stays valid after the descriptor is closed
+		void* view = mmap( nullptr, std::size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0 );
+		auto const err = errno;
+		close( fd );
+
+		if( MAP_FAILED == view )
+			throw Error( "map_file(): unable to map '%s': %s", aPath, std::strerror( err ) );
+
+		return MappedFile( view, std::size_t(info.st_size) );
+	}
+#	endif // ~ _WIN32
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+
+namespace labutils
+{
+	// Read-only mapping of a whole file (mmap() or MapViewOfFile()). Pages are
+	// read from the file on first access and are shared with the OS's file
+	// cache, so mapping a file does not copy it.
+	class MappedFile
+	{
+	public:
+		MappedFile() noexcept, ~MappedFile();
+
+		explicit MappedFile( void const* aData, std::size_t aSize ) noexcept;
+
+		MappedFile( MappedFile const& ) = delete;
+		MappedFile& operator= (MappedFile const&) = delete;
+
+		MappedFile( MappedFile&& ) noexcept;
+		MappedFile& operator = (MappedFile&&) noexcept;
+
+	public:
+		// nullptr for empty files
+		void const* data = nullptr;
+		std::size_t size = 0;
+	};
+
+	// Throws labutils::Error if the file cannot be opened or mapped
+	MappedFile map_file( char const* aPath );
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
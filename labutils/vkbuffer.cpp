@@ -45,7 +45,7 @@ namespace labutils
 
 namespace labutils
 {
-	Buffer create_buffer(Allocator const& aAllocator, VkDeviceSize aSize, VkBufferUsageFlags aBufferUsage, VmaMemoryUsage aMemoryUsage)
+	Buffer create_buffer(Allocator const& aAllocator, VkDeviceSize aSize, VkBufferUsageFlags aBufferUsage, VmaMemoryUsage aMemoryUsage, VmaAllocationCreateFlags aAllocFlags)
 	{
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -54,6 +54,7 @@ namespace labutils
 
 		VmaAllocationCreateInfo allocInfo{};
 		allocInfo.usage = aMemoryUsage;
+		allocInfo.flags = aAllocFlags;
 
 		VkBuffer buffer = VK_NULL_HANDLE;
 		VmaAllocation allocation = VK_NULL_HANDLE;
@@ -67,4 +68,15 @@ namespace labutils
 
 		return Buffer(aAllocator.allocator, buffer, allocation);
 	}
+
+	void* mapped_pointer(Allocator const& aAllocator, Buffer const& aBuffer)
+	{
+		VmaAllocationInfo info{};
+		vmaGetAllocationInfo(aAllocator.allocator, aBuffer.allocation, &info);
+
+		if (!info.pMappedData)
+			throw Error("Buffer is not persistently mapped (see VMA_ALLOCATION_CREATE_MAPPED_BIT)");
+
+		return info.pMappedData;
+	}
 }
@@ -32,5 +32,9 @@ namespace labutils
 		VmaAllocator mAllocator = VK_NULL_HANDLE;
 	};
 
-	Buffer create_buffer(Allocator const&, VkDeviceSize, VkBufferUsageFlags, VmaMemoryUsage);
+	// Pass VMA_ALLOCATION_CREATE_MAPPED_BIT in aAllocFlags for a persistently
+	// mapped buffer; see mapped_pointer()
+	Buffer create_buffer(Allocator const&, VkDeviceSize, VkBufferUsageFlags, VmaMemoryUsage, VmaAllocationCreateFlags aAllocFlags = 0);
+
+	void* mapped_pointer(Allocator const&, Buffer const&);
 }
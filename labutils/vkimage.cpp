@@ -45,6 +45,44 @@ namespace
 
 		return res;
 	}
+
+	// Bytes per texel block (1x1 texels for RGBA8, 4x4 for BC) of the formats
+	// written by cw3-bake (see cw3-bake/mip_texture.hpp); 0 for any other
+	// format.
+	std::uint32_t baked_block_bytes_(VkFormat aFormat)
+	{
+		switch (aFormat)
+		{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				return 4;
+
+			case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+			case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				return 8;
+
+			case VK_FORMAT_BC3_UNORM_BLOCK:
+			case VK_FORMAT_BC3_SRGB_BLOCK:
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return 16;
+
+			default:
+				return 0;
+		}
+	}
+
+	// Bytes that vkCmdCopyBufferToImage() reads for mip level aLevel
+	std::uint64_t expected_level_bytes_(VkFormat aFormat, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aLevel)
+	{
+		std::uint64_t const w = std::max(aWidth >> aLevel, 1u);
+		std::uint64_t const h = std::max(aHeight >> aLevel, 1u);
+
+		std::uint64_t const block = (VK_FORMAT_R8G8B8A8_UNORM == aFormat || VK_FORMAT_R8G8B8A8_SRGB == aFormat) ? 1 : 4;
+		return ((w + block - 1) / block) * ((h + block - 1) / block) * baked_block_bytes_(aFormat);
+	}
 }
 
 namespace labutils
@@ -72,16 +110,203 @@ namespace labutils
 		, allocation(std::exchange(aOther.allocation, VK_NULL_HANDLE))
 		, mAllocator(std::exchange(aOther.mAllocator, VK_NULL_HANDLE))
 		, maxMipLevel(aOther.maxMipLevel)
+		, format(aOther.format)
 	{}
 	Image& Image::operator=(Image&& aOther) noexcept
 	{
 		std::swap(image, aOther.image);
 		std::swap(allocation, aOther.allocation);
 		std::swap(mAllocator, aOther.mAllocator);
+		std::swap(maxMipLevel, aOther.maxMipLevel);
+		std::swap(format, aOther.format);
 		return *this;
 	}
 }
 
+namespace labutils
+{
+	namespace
+	{
+		// Upload RGBA8 texels to a new sRGB image, and generate its mip levels
+		// by blitting.
+		Image upload_texture2d_(std::uint8_t const* aRGBA, std::uint32_t aWidth, std::uint32_t aHeight, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator)
+		{
+			auto const sizeInBytes = aHeight * aWidth * 4;
+
+			auto staging = create_buffer(aAllocator, sizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+			void* sptr = nullptr;
+			if (const auto res = vmaMapMemory(aAllocator.allocator, staging.allocation, &sptr); VK_SUCCESS != res)
+			{
+				throw Error("Mapping memory for writing\n"
+					"vmaMapMemory() returned %s", to_string(res).c_str()
+				);
+			}
+
+			std::memcpy(sptr, aRGBA, sizeInBytes);
+			vmaUnmapMemory(aAllocator.allocator, staging.allocation);
+
+			Image ret = create_image_texture2d(aAllocator, aWidth, aHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+			VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool);
+
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = 0;
+			beginInfo.pInheritanceInfo = nullptr;
+
+			if (const auto res = vkBeginCommandBuffer(cbuff, &beginInfo); VK_SUCCESS != res)
+			{
+				throw Error("Beginning command buffer recording\n"
+					"vkBeginCommandBuffer() returned %s", to_string(res).c_str()
+				);
+			}
+
+			const auto mipLevels = compute_mip_level_count(aWidth, aHeight);
+			ret.maxMipLevel = mipLevels;
+
+			image_barrier(cbuff, ret.image,
+				0,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VkImageSubresourceRange{
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					0, mipLevels,
+					0, 1
+				}
+			);
+
+			VkBufferImageCopy copy;
+			copy.bufferOffset = 0;
+			copy.bufferRowLength = 0;
+			copy.bufferImageHeight = 0;
+			copy.imageSubresource = VkImageSubresourceLayers{
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				0,
+				0,1
+			};
+			copy.imageOffset = VkOffset3D{ 0,0,0 };
+			copy.imageExtent = VkExtent3D{ aWidth,aHeight,1 };
+
+			vkCmdCopyBufferToImage(cbuff, staging.buffer, ret.image,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+
+			image_barrier(cbuff, ret.image,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VkImageSubresourceRange{
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					0, 1,
+					0, 1
+				}
+			);
+
+			std::uint32_t width = aWidth, height = aHeight;
+
+			for (std::uint32_t level = 1; level < mipLevels; ++level)
+			{
+				VkImageBlit blit{};
+				blit.srcSubresource = VkImageSubresourceLayers{
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					level - 1,
+					0,1
+				};
+				blit.srcOffsets[0] = { 0,0,0 };
+				blit.srcOffsets[1] = { std::int32_t(width),std::int32_t(height),1 };
+
+				width >>= 1; if (width == 0) width = 1;
+				height >>= 1; if (height == 0) height = 1;
+
+				blit.dstSubresource = VkImageSubresourceLayers{
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					level,
+					0,1
+				};
+
+				blit.dstOffsets[0] = { 0,0,0 };
+				blit.dstOffsets[1] = { std::int32_t(width),std::int32_t(height),1 };
+
+				vkCmdBlitImage(cbuff,
+					ret.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					1, &blit,
+					VK_FILTER_LINEAR
+				);
+
+				image_barrier(cbuff, ret.image,
+					VK_ACCESS_TRANSFER_WRITE_BIT,
+					VK_ACCESS_TRANSFER_READ_BIT,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VkImageSubresourceRange{
+						VK_IMAGE_ASPECT_COLOR_BIT,
+						level, 1,
+						0, 1
+					}
+				);
+			}
+
+			image_barrier(cbuff, ret.image,
+				VK_ACCESS_TRANSFER_READ_BIT,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				VkImageSubresourceRange{
+					VK_IMAGE_ASPECT_COLOR_BIT,
+					0, mipLevels,
+					0, 1
+				}
+			);
+
+			if (const auto res = vkEndCommandBuffer(cbuff);
+				VK_SUCCESS != res)
+			{
+				throw Error("Ending command buffer recording\n"
+					"vkEndCommandBuffer() returned %s", to_string(res).c_str()
+				);
+			}
+
+			Fence uploadComplete = create_fence(aContext);
+
+			VkSubmitInfo submitInfo{};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &cbuff;
+
+			if (const auto res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle);
+				VK_SUCCESS != res)
+			{
+				throw Error("Submitting commands\n"
+					"vkQueueSubmit() returned %s", to_string(res).c_str()
+				);
+			}
+
+			if (const auto res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+			{
+				throw Error("Waiting for upload to complete\n"
+					"vkWaitForFences() returned %s", to_string(res).c_str()
+				);
+			}
+
+			vkFreeCommandBuffers(aContext.device, aCmdPool, 1, &cbuff);
+
+			ret.maxMipLevel = mipLevels;
+			return ret;
+		}
+	}
+}
+
 namespace labutils
 {
 	Image load_image_texture2d(char const* aPath, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator)
@@ -102,8 +327,135 @@ namespace labutils
 		const auto baseWidth = std::uint32_t(baseWidthi);
 		const auto baseHeight = std::uint32_t(baseHeighti);
 
-		auto const sizeInBytes = baseHeight * baseWidth * 4;
+		Image ret = upload_texture2d_(data, baseWidth, baseHeight, aContext, aCmdPool, aAllocator);
+		stbi_image_free(data);
+
+		return ret;
+	}
+
+	Image load_packed_texture2d(char const* aRedPath, char const* aGreenPath, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator)
+	{
+		stbi_set_flip_vertically_on_load(1);
+
+		int widths[2], heights[2], channels[2];
+		stbi_uc* data[2] = {
+			stbi_load(aRedPath, &widths[0], &heights[0], &channels[0], 4),
+			stbi_load(aGreenPath, &widths[1], &heights[1], &channels[1], 4)
+		};
+
+		if (!data[0] || !data[1])
+		{
+			stbi_image_free(data[0]);
+			stbi_image_free(data[1]);
+			throw Error("%s: unable to load texture image (%s)", data[0] ? aGreenPath : aRedPath, stbi_failure_reason());
+		}
+
+		// Images of different sizes are packed at the size of the larger one;
+		// the smaller one is scaled up with nearest-neighbour sampling, as in
+		// make_packed_mip_texture() of cw3-bake.
+		const auto width = std::uint32_t(std::max(widths[0], widths[1]));
+		const auto height = std::uint32_t(std::max(heights[0], heights[1]));
+
+		auto const sample_ = [&](std::size_t aImage, std::uint32_t aX, std::uint32_t aY) {
+			auto const sx = std::uint32_t(std::uint64_t(aX) * std::uint32_t(widths[aImage]) / width);
+			auto const sy = std::uint32_t(std::uint64_t(aY) * std::uint32_t(heights[aImage]) / height);
+			return data[aImage][4 * (std::size_t(sy) * std::uint32_t(widths[aImage]) + sx)];
+		};
+
+		std::vector<std::uint8_t> packed(std::size_t(width) * height * 4);
+		for (std::uint32_t y = 0; y < height; ++y)
+		{
+			for (std::uint32_t x = 0; x < width; ++x)
+			{
+				auto const i = std::size_t(y) * width + x;
+				packed[4 * i + 0] = sample_(0, x, y);
+				packed[4 * i + 1] = sample_(1, x, y);
+				packed[4 * i + 2] = 0;
+				packed[4 * i + 3] = 255;
+			}
+		}
+
+		stbi_image_free(data[0]);
+		stbi_image_free(data[1]);
+
+		return upload_texture2d_(packed.data(), width, height, aContext, aCmdPool, aAllocator);
+	}
+
+	Image load_baked_texture2d(char const* aPath, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator)
+	{
+		// See write_texture_container() in cw3-bake/mip_texture.hpp for the
+		// format.
+		static constexpr char kMagic[16] = "\0\0COMP5822Mtex";
+		static constexpr char kVariant[16] = "mips-1";
+
+		FILE* fin = std::fopen(aPath, "rb");
+		if (!fin)
+			throw Error("%s: unable to open texture container", aPath);
+
+		struct FileCloser_
+		{
+			FILE* file;
+			~FileCloser_() { std::fclose(file); }
+		} closer{ fin };
+
+		char magic[16], variant[16];
+		std::uint32_t header[4]; // format, width, height, levels
+		std::uint64_t sourceKey;
+
+		if (1 != std::fread(magic, sizeof(magic), 1, fin) ||
+			1 != std::fread(variant, sizeof(variant), 1, fin) ||
+			1 != std::fread(header, sizeof(header), 1, fin) ||
+			1 != std::fread(&sourceKey, sizeof(sourceKey), 1, fin))
+		{
+			throw Error("%s: truncated texture container header", aPath);
+		}
+
+		if (0 != std::memcmp(magic, kMagic, sizeof(magic)))
+			throw Error("%s: not a texture container", aPath);
+		if (0 != std::strncmp(variant, kVariant, sizeof(variant)))
+			throw Error("%s: texture container variant is '%.16s', expected '%s'", aPath, variant, kVariant);
+
+		auto const format = VkFormat(header[0]);
+		auto const baseWidth = header[1], baseHeight = header[2], mipLevels = header[3];
+
+		if (0 == baked_block_bytes_(format))
+			throw Error("%s: unknown texture format (VkFormat %d)", aPath, int(format));
+
+		if (0 == baseWidth || 0 == baseHeight || compute_mip_level_count(baseWidth, baseHeight) != mipLevels)
+			throw Error("%s: invalid texture size %ux%u with %u levels", aPath, baseWidth, baseHeight, mipLevels);
+
+		std::vector<std::uint64_t> table(std::size_t(mipLevels) * 2); // offset, size
+		if (mipLevels != std::fread(table.data(), 2 * sizeof(std::uint64_t), mipLevels, fin))
+			throw Error("%s: truncated texture container level table", aPath);
+
+		// The levels are stored back to back. Upload everything from the
+		// first level to the end of the last one in one go.
+		std::uint64_t const first = table[0];
+		std::uint64_t const last = table[2 * (mipLevels - 1)] + table[2 * (mipLevels - 1) + 1];
 
+		for (std::uint32_t level = 0; level < mipLevels; ++level)
+		{
+			auto const offset = table[2 * level], size = table[2 * level + 1];
+			// Copies must start at a multiple of the texel block size (at
+			// most 16 bytes); the baker aligns all levels to 16 bytes.
+			if (offset < first || offset + size > last || offset + size < offset || 0 != (offset - first) % 16)
+				throw Error("%s: invalid data range for level %u", aPath, level);
+
+			// The copy reads the whole level from the staging buffer
+			if (size < expected_level_bytes_(format, baseWidth, baseHeight, level))
+				throw Error("%s: level %u holds %llu bytes, expected %llu", aPath, level, (unsigned long long)size, (unsigned long long)expected_level_bytes_(format, baseWidth, baseHeight, level));
+		}
+
+		VkFormatProperties props{};
+		vkGetPhysicalDeviceFormatProperties(aContext.physicalDevice, format, &props);
+		if (!(props.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		{
+			throw Error("%s: texture format (VkFormat %d) is not supported by this device\n"
+				"Rebake the textures uncompressed (cw3-bake --bc none).", aPath, int(format)
+			);
+		}
+
+		auto const sizeInBytes = VkDeviceSize(last - first);
 		auto staging = create_buffer(aAllocator, sizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
 
 		void* sptr = nullptr;
@@ -114,19 +466,22 @@ namespace labutils
 			);
 		}
 
-		std::memcpy(sptr, data, sizeInBytes);
+		bool const readOk = 0 == std::fseek(fin, long(first), SEEK_SET)
+			&& 1 == std::fread(sptr, std::size_t(sizeInBytes), 1, fin);
+
 		vmaUnmapMemory(aAllocator.allocator, staging.allocation);
 
-		stbi_image_free(data);
+		if (!readOk)
+			throw Error("%s: unable to read texture data", aPath);
 
-		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight, format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+		ret.maxMipLevel = mipLevels;
 
 		VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool);
 
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
 		if (const auto res = vkBeginCommandBuffer(cbuff, &beginInfo); VK_SUCCESS != res)
 		{
@@ -135,8 +490,11 @@ namespace labutils
 			);
 		}
 
-		const auto mipLevels = compute_mip_level_count(baseWidth, baseHeight);
-		ret.maxMipLevel = mipLevels;
+		VkImageSubresourceRange const allLevels{
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0, mipLevels,
+			0, 1
+		};
 
 		image_barrier(cbuff, ret.image,
 			0,
@@ -145,105 +503,44 @@ namespace labutils
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				0, mipLevels,
-				0, 1
-			}
+			allLevels
 		);
 
-		VkBufferImageCopy copy;
-		copy.bufferOffset = 0;
-		copy.bufferRowLength = 0;
-		copy.bufferImageHeight = 0;
-		copy.imageSubresource = VkImageSubresourceLayers{
-			VK_IMAGE_ASPECT_COLOR_BIT,
-			0,
-			0,1
-		};
-		copy.imageOffset = VkOffset3D{ 0,0,0 };
-		copy.imageExtent = VkExtent3D{ baseWidth,baseHeight,1 };
-
-		vkCmdCopyBufferToImage(cbuff, staging.buffer, ret.image,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
-
-		image_barrier(cbuff, ret.image,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_TRANSFER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VkImageSubresourceRange{
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				0, 1,
-				0, 1
-			}
-		);
+		std::vector<VkBufferImageCopy> copies(mipLevels);
 
 		std::uint32_t width = baseWidth, height = baseHeight;
-
-		for (std::uint32_t level = 1; level < mipLevels; ++level)
+		for (std::uint32_t level = 0; level < mipLevels; ++level)
 		{
-			VkImageBlit blit{};
-			blit.srcSubresource = VkImageSubresourceLayers{
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				level - 1,
-				0,1
-			};
-			blit.srcOffsets[0] = { 0,0,0 };
-			blit.srcOffsets[1] = { std::int32_t(width),std::int32_t(height),1 };
-
-			width >>= 1; if (width == 0) width = 1;
-			height >>= 1; if (height == 0) height = 1;
-
-			blit.dstSubresource = VkImageSubresourceLayers{
+			auto& copy = copies[level];
+			copy.bufferOffset = VkDeviceSize(table[2 * level] - first);
+			copy.bufferRowLength = 0;
+			copy.bufferImageHeight = 0;
+			copy.imageSubresource = VkImageSubresourceLayers{
 				VK_IMAGE_ASPECT_COLOR_BIT,
 				level,
-				0,1
+				0, 1
 			};
+			copy.imageOffset = VkOffset3D{ 0, 0, 0 };
+			copy.imageExtent = VkExtent3D{ width, height, 1 };
 
-			blit.dstOffsets[0] = { 0,0,0 };
-			blit.dstOffsets[1] = { std::int32_t(width),std::int32_t(height),1 };
-
-			vkCmdBlitImage(cbuff,
-				ret.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				1, &blit,
-				VK_FILTER_LINEAR
-			);
-
-			image_barrier(cbuff, ret.image,
-				VK_ACCESS_TRANSFER_WRITE_BIT,
-				VK_ACCESS_TRANSFER_READ_BIT,
-				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VkImageSubresourceRange{
-					VK_IMAGE_ASPECT_COLOR_BIT,
-					level, 1,
-					0, 1
-				}
-			);
+			width = std::max(width >> 1, 1u);
+			height = std::max(height >> 1, 1u);
 		}
 
+		vkCmdCopyBufferToImage(cbuff, staging.buffer, ret.image,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, copies.data());
+
 		image_barrier(cbuff, ret.image,
-			VK_ACCESS_TRANSFER_READ_BIT,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_ACCESS_SHADER_READ_BIT,
-			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			VkImageSubresourceRange{
-				VK_IMAGE_ASPECT_COLOR_BIT,
-				0, mipLevels,
-				0, 1
-			}
+			allLevels
 		);
 
-		if (const auto res = vkEndCommandBuffer(cbuff);
-			VK_SUCCESS != res)
+		if (const auto res = vkEndCommandBuffer(cbuff); VK_SUCCESS != res)
 		{
 			throw Error("Ending command buffer recording\n"
 				"vkEndCommandBuffer() returned %s", to_string(res).c_str()
@@ -274,10 +571,20 @@ namespace labutils
 
 		vkFreeCommandBuffers(aContext.device, aCmdPool, 1, &cbuff);
 
-		ret.maxMipLevel = mipLevels;
 		return ret;
 	}
 
+	bool is_baked_texture(char const* aPath)
+	{
+		assert(aPath);
+
+		static constexpr char kExtension[] = ".comp5822tex";
+		auto const length = std::strlen(aPath);
+		auto const extLength = sizeof(kExtension) - 1;
+
+		return length >= extLength && 0 == std::strcmp(aPath + length - extLength, kExtension);
+	}
+
 	Image create_image_texture2d(Allocator const& aAllocator, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat aFormat, VkImageUsageFlags aUsage)
 	{
 		//TODO- (Section 4) implement me!(have done)
@@ -311,7 +618,9 @@ namespace labutils
 				"vmaCreateImage() returned %s", to_string(res).c_str()
 			);
 		}
-		return Image(aAllocator.allocator, image, allocation);
+		Image ret(aAllocator.allocator, image, allocation);
+		ret.format = aFormat;
+		return ret;
 	}
 
 	std::uint32_t compute_mip_level_count(std::uint32_t aWidth, std::uint32_t aHeight)
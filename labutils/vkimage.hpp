@@ -28,6 +28,7 @@ namespace labutils
 		VkImage image = VK_NULL_HANDLE;
 		VmaAllocation allocation = VK_NULL_HANDLE;
 		std::uint32_t maxMipLevel;
+		VkFormat format = VK_FORMAT_UNDEFINED;
 	private:
 		VmaAllocator mAllocator = VK_NULL_HANDLE;
 	};
@@ -35,6 +36,20 @@ namespace labutils
 
 	Image load_image_texture2d(char const* aPath, VulkanContext const&, VkCommandPool, Allocator const&);
 
+	// Load two images and pack their first channels into the red and green
+	// channels of one RGBA8 sRGB texture (blue is zero, alpha one). The
+	// smaller image is scaled up to the size of the larger one with nearest-
+	// neighbour sampling, as cw3-bake does. Used for models baked before
+	// cw3-bake packed roughness/metalness.
+	Image load_packed_texture2d(char const* aRedPath, char const* aGreenPath, VulkanContext const&, VkCommandPool, Allocator const&);
+
+	// Load a texture container (.comp5822tex) written by cw3-bake. The
+	// container already holds all mip levels in the final format (RGBA8 or
+	// block-compressed), so they are read straight into a staging buffer and
+	// uploaded with a single copy. Views of the image should use its format.
+	Image load_baked_texture2d(char const* aPath, VulkanContext const&, VkCommandPool, Allocator const&);
+	bool is_baked_texture(char const* aPath);
+
 	Image create_image_texture2d(Allocator const&, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat, VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT);
 
 	std::uint32_t compute_mip_level_count(std::uint32_t aWidth, std::uint32_t aHeight);
@@ -202,6 +202,7 @@ namespace labutils
 		VkDescriptorPoolSize const pools[] = {
 			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,aMaxDescriptors},
 			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,aMaxDescriptors},
 		};
 
 		VkDescriptorPoolCreateInfo poolInfo{};
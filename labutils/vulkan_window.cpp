@@ -672,6 +672,17 @@ namespace
 		VkPhysicalDeviceFeatures deviceFeatures{};
 		deviceFeatures.samplerAnisotropy = VK_TRUE;
 		deviceFeatures.geometryShader = VK_TRUE;
+
+		VkPhysicalDeviceFeatures supported{};
+		vkGetPhysicalDeviceFeatures(aPhysicalDev, &supported);
+
+		// Block-compressed textures (BC1-BC7), if available. Baked textures
+		// check for format support when they are loaded.
+		deviceFeatures.textureCompressionBC = supported.textureCompressionBC;
+
+		// One indirect draw call for all meshlets of a mesh, if available;
+		// otherwise cw3 issues one indirect draw per meshlet.
+		deviceFeatures.multiDrawIndirect = supported.multiDrawIndirect;
 		// No extra features for now.
 
 		VkDeviceCreateInfo deviceInfo{};
@@ -113,12 +113,52 @@ project "cw3-bake"
 
 	files( sources )
 
-	links "labutils" -- for lut::Error
+	links "labutils" -- for lut::Error and lut::compress_stream()
 	links "x-tgen"
+	links "x-stb"
 
 	dependson "x-glm" 
 	dependson "x-rapidobj"
 
+project "cw3-bake-bench"
+	local sources = { 
+		"cw3-bake/**.cpp",
+		"cw3-bake/**.hpp",
+		"cw3-bake/**.hxx"
+	}
+
+	kind "ConsoleApp"
+	location "cw3-bake-bench"
+
+	files( sources )
+
+	-- Same sources as cw3-bake; main.cpp runs the stage benchmark instead
+	-- (see cw3-bake/benchmark.hxx)
+	defines { "CW3_BAKE_BENCHMARK=1" }
+
+	links "labutils"
+	links "x-tgen"
+	links "x-stb"
+
+	dependson "x-glm" 
+	dependson "x-rapidobj"
+
+project "cw3-load-bench"
+	local sources = { 
+		"cw3-load-bench/**.cpp",
+		"cw3/baked_model.cpp",
+		"cw3/baked_model.hpp"
+	}
+
+	kind "ConsoleApp"
+	location "cw3-load-bench"
+
+	files( sources )
+
+	links "labutils" -- for lut::Error, lut::map_file() and lut::decompress_stream()
+
+	dependson "x-glm" 
+
 project "labutils"
 	local sources = { 
 		"labutils/**.cpp",